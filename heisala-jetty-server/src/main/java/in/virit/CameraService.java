@@ -2,20 +2,44 @@ package in.virit;
 
 import in.virit.libcamera4j.CameraCapture;
 import in.virit.libcamera4j.CameraSettings;
+import in.virit.libcamera4j.CaptureLatency;
 import in.virit.libcamera4j.CaptureResult;
+import in.virit.libcamera4j.CaptureSession;
+import in.virit.libcamera4j.DngStream;
+import in.virit.libcamera4j.FocusSweep;
+import in.virit.libcamera4j.FrameExport;
+import in.virit.libcamera4j.FrameSequenceStats;
+import in.virit.libcamera4j.FrameServer;
+import in.virit.libcamera4j.FrameStore;
+import in.virit.libcamera4j.ImageMetadata;
+import in.virit.libcamera4j.LatencyHistogram;
+import in.virit.libcamera4j.MotionDetector;
+import in.virit.libcamera4j.MotionEvent;
+import in.virit.libcamera4j.Waterline;
 import io.quarkus.scheduler.Scheduled;
 import jakarta.annotation.PostConstruct;
+import jakarta.annotation.PreDestroy;
 import jakarta.enterprise.context.ApplicationScoped;
 import jakarta.inject.Inject;
 import org.eclipse.microprofile.config.inject.ConfigProperty;
 import org.jboss.logging.Logger;
 
+import javax.imageio.ImageIO;
+import java.awt.image.BufferedImage;
 import java.io.IOException;
 import java.nio.file.Files;
 import java.nio.file.Path;
+import java.time.Duration;
 import java.time.LocalDateTime;
+import java.time.ZoneId;
 import java.time.format.DateTimeFormatter;
+import java.util.EnumMap;
+import java.util.List;
+import java.util.Map;
+import java.util.Optional;
 import java.util.concurrent.CompletableFuture;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
 import java.util.concurrent.Semaphore;
 
 /**
@@ -28,7 +52,11 @@ public class CameraService {
     private static final int WIDTH = 1920;
     private static final int HEIGHT = 1080;
     private static final String LATEST_PHOTO_FILENAME = "latest.jpg";
+    // Same as the ImageIO default used for UI captures
+    private static final int JPEG_QUALITY = 75;
     private static final DateTimeFormatter TIMESTAMP_FORMAT = DateTimeFormatter.ofPattern("yyyy-MM-dd HH:mm:ss");
+    // Room for a WIDTH x HEIGHT YUV 4:2:0 frame and its JPEG
+    private static final long EXPORT_SLOT_SIZE = 6L * 1024 * 1024;
 
     @Inject
     @ConfigProperty(name = "camera.rotation", defaultValue = "0")
@@ -54,21 +82,304 @@ public class CameraService {
     @ConfigProperty(name = "camera.exposure.gain", defaultValue = "1.0")
     float defaultAnalogueGain;
 
+    @Inject
+    @ConfigProperty(name = "camera.export.name", defaultValue = "heisala-latest")
+    String exportName;
+
+    @Inject
+    @ConfigProperty(name = "camera.export.slots", defaultValue = "3")
+    int exportSlots;
+
+    @Inject
+    @ConfigProperty(name = "camera.frame-server.socket")
+    Optional<Path> frameServerSocket;
+
+    @Inject
+    @ConfigProperty(name = "camera.frame-server.max-outstanding", defaultValue = "2")
+    int frameServerMaxOutstanding;
+
+    @Inject
+    @ConfigProperty(name = "camera.burst.frames", defaultValue = "4")
+    int burstFrames;
+
+    @Inject
+    @ConfigProperty(name = "camera.burst.min-gain", defaultValue = "4.0")
+    double burstMinGain;
+
+    @Inject
+    @ConfigProperty(name = "camera.denoise.min-gain", defaultValue = "4.0")
+    double denoiseMinGain;
+
+    @Inject
+    @ConfigProperty(name = "camera.denoise.strength", defaultValue = "1.5")
+    double denoiseStrength;
+
+    @Inject
+    @ConfigProperty(name = "camera.waterline.region")
+    Optional<List<Double>> waterlineRegion;
+
+    @Inject
+    @ConfigProperty(name = "camera.waterline.calibration")
+    Optional<List<Double>> waterlineCalibration;
+
+    @Inject
+    @ConfigProperty(name = "camera.waterline.min-confidence", defaultValue = "0.5")
+    double waterlineMinConfidence;
+
+    @Inject
+    @ConfigProperty(name = "camera.hdr.brackets")
+    Optional<List<Double>> hdrBrackets;
+
+    @Inject
+    @ConfigProperty(name = "camera.motion.enabled", defaultValue = "false")
+    boolean motionEnabled;
+
+    @Inject
+    @ConfigProperty(name = "camera.motion.lores-width", defaultValue = "320")
+    int motionLoresWidth;
+
+    @Inject
+    @ConfigProperty(name = "camera.motion.lores-height", defaultValue = "240")
+    int motionLoresHeight;
+
+    @Inject
+    @ConfigProperty(name = "camera.motion.threshold", defaultValue = "20")
+    int motionThreshold;
+
+    @Inject
+    @ConfigProperty(name = "camera.motion.min-interval", defaultValue = "5s")
+    Duration motionMinInterval;
+
+    @Inject
+    @ConfigProperty(name = "camera.motion.ignore-mask")
+    Optional<Path> motionIgnoreMask;
+
+    @Inject
+    @ConfigProperty(name = "camera.schedule.adaptive", defaultValue = "false")
+    boolean adaptiveSchedule;
+
+    @Inject
+    @ConfigProperty(name = "camera.schedule.hash-distance", defaultValue = "6")
+    int scheduleHashDistance;
+
+    @Inject
+    @ConfigProperty(name = "camera.schedule.min-interval", defaultValue = "15s")
+    Duration scheduleMinInterval;
+
+    @Inject
+    @ConfigProperty(name = "camera.schedule.max-interval", defaultValue = "5m")
+    Duration scheduleMaxInterval;
+
     @Inject
     TimelapseService timelapseService;
 
+    @Inject
+    WaterDistanceService waterDistanceService;
+
     private final Semaphore cameraSemaphore = new Semaphore(1);
+    // Motion detection and scene scheduling between captures, or null when both
+    // are disabled or unavailable
+    private MotionDetector motionDetector;
+    private Thread motionPoller;
+    private volatile boolean shuttingDown;
+    private volatile long lastMotionCaptureNanos;
+    // Of the last timelapse capture; high gain means night, and a burst for the next one
+    private volatile double lastAnalogueGain = 1.0;
+    // Stage timings of every capture through a CaptureSession since startup
+    private volatile CaptureLatency captureLatency = CaptureLatency.empty();
+    // And their latency distributions, replaced whole on every update
+    private volatile Map<LatencyHistogram.Kind, LatencyHistogram> latencyHistograms = emptyHistograms();
+    // Keeps the camera open and monitored between timelapse captures, which go
+    // through it; closed while the UI captures through the handle API, as
+    // libcamera allows only one CameraManager per process.
+    private final Object monitorLock = new Object();
+    private CaptureSession monitorSession;
+    // Runs the timelapse and motion captures, each through a CaptureSession
+    private final ExecutorService sessionExecutor = Executors.newSingleThreadExecutor(r -> {
+        Thread t = new Thread(r, "SessionCapture");
+        t.setDaemon(true);
+        return t;
+    });
 
     private CameraSettings currentSettings;
+    // Where captures look for the waterline, or null
+    private Waterline.Params waterlineParams;
     private LocalDateTime lastCaptureTime;
     private boolean cameraAvailable;
+    // Shared-memory export of the latest frames, or null when disabled or unavailable
+    private FrameExport frameExport;
+    // Hands captured dmabufs to local subscriber processes, or null when disabled or unavailable
+    private FrameServer frameServer;
 
     @PostConstruct
     void init() {
         currentSettings = buildSettingsFromConfig();
+        waterlineParams = buildWaterlineParams();
         cameraAvailable = checkCameraAvailable();
         if (!cameraAvailable) {
             LOG.warn("Camera not available - running in UI-only mode. Camera features will be disabled.");
+        } else if (!exportName.isBlank()) {
+            try {
+                frameExport = FrameExport.create(exportName, exportSlots, EXPORT_SLOT_SIZE);
+                LOG.info("Publishing captured frames to /dev/shm/" + exportName);
+            } catch (Throwable e) {
+                LOG.warn("Frame export not available: " + e.getMessage());
+            }
+        }
+        if (cameraAvailable && frameServerSocket.isPresent()) {
+            try {
+                frameServer = FrameServer.open(frameServerSocket.get(), frameServerMaxOutstanding);
+                LOG.info("Serving captured frames on " + frameServerSocket.get());
+            } catch (Throwable e) {
+                LOG.warn("Frame server not available: " + e.getMessage());
+            }
+        }
+        if (cameraAvailable && (motionEnabled || adaptiveSchedule)) {
+            startMotionDetection();
+        }
+    }
+
+    @PreDestroy
+    void shutdown() {
+        shuttingDown = true;
+        suspendMotionMonitor();
+        if (motionDetector != null) {
+            // Also ends the poller
+            motionDetector.close();
+        }
+        sessionExecutor.shutdown();
+        if (frameExport != null) {
+            frameExport.close();
+        }
+        if (frameServer != null) {
+            frameServer.close();
+        }
+    }
+
+    private void startMotionDetection() {
+        try {
+            motionDetector = MotionDetector.create(MotionDetector.Params.defaults().withThreshold(motionThreshold));
+            if (motionIgnoreMask.isPresent()) {
+                loadIgnoreMask(motionIgnoreMask.get());
+            }
+            if (adaptiveSchedule) {
+                motionDetector.setSchedule(new MotionDetector.Schedule(scheduleHashDistance, scheduleMinInterval,
+                        scheduleMaxInterval));
+            }
+        } catch (Throwable e) {
+            LOG.warn("Motion detection not available: " + e.getMessage());
+            if (motionDetector != null) {
+                motionDetector.close();
+                motionDetector = null;
+            }
+            return;
+        }
+        lastMotionCaptureNanos = System.nanoTime() - motionMinInterval.toNanos();
+        resumeMotionMonitor();
+        motionPoller = Thread.ofPlatform().name("MotionPoller").daemon().start(this::pollMotion);
+        String triggers = !adaptiveSchedule ? "motion" : motionEnabled ? "motion and scene changes" : "scene changes";
+        LOG.info("Capturing on " + triggers + " in a " + motionLoresWidth + "x" + motionLoresHeight + " stream");
+    }
+
+    // Non-black pixels of the mask image are ignored; the detector stretches it over the frame
+    private void loadIgnoreMask(Path path) throws IOException {
+        BufferedImage image = ImageIO.read(path.toFile());
+        if (image == null) {
+            throw new IOException("Unsupported image format: " + path);
+        }
+        int width = image.getWidth();
+        int height = image.getHeight();
+        byte[] mask = new byte[width * height];
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                mask[y * width + x] = (byte) ((image.getRGB(x, y) & 0xFFFFFF) != 0 ? 1 : 0);
+            }
+        }
+        motionDetector.setIgnoreMask(mask, width, height);
+        LOG.info("Ignoring motion in the masked regions of " + path);
+    }
+
+    // Opens the monitoring session unless it is open, motion detection and
+    // scheduling are off or the service is stopping.
+    private void resumeMotionMonitor() {
+        synchronized (monitorLock) {
+            if (motionDetector == null || monitorSession != null || shuttingDown) {
+                return;
+            }
+            CaptureSession session = null;
+            try {
+                session = CaptureSession.open(WIDTH, HEIGHT);
+                session.applySettings(currentSettings);
+                session.startMonitor(motionDetector, motionLoresWidth, motionLoresHeight);
+                monitorSession = session;
+            } catch (Throwable e) {
+                LOG.warn("Motion monitor not available: " + e.getMessage());
+                if (session != null) {
+                    session.close();
+                }
+            }
+        }
+    }
+
+    // Closes the monitoring session, freeing the camera for the handle API.
+    private void suspendMotionMonitor() {
+        synchronized (monitorLock) {
+            if (monitorSession != null) {
+                monitorSession.close();
+                monitorSession = null;
+            }
+        }
+    }
+
+    // Takes the camera for a capture through the handle API, or returns false if it is busy.
+    private boolean acquireCamera() {
+        if (!cameraSemaphore.tryAcquire()) {
+            return false;
+        }
+        suspendMotionMonitor();
+        return true;
+    }
+
+    private void releaseCamera() {
+        resumeMotionMonitor();
+        cameraSemaphore.release();
+    }
+
+    private void pollMotion() {
+        while (!shuttingDown) {
+            List<MotionEvent> events;
+            try {
+                events = motionDetector.poll(Duration.ofSeconds(1));
+            } catch (IllegalStateException e) {
+                return;     // closed
+            }
+            if (events.isEmpty()) {
+                continue;
+            }
+            // The schedule spaces its own events; motion is limited here
+            MotionEvent event = events.reversed().stream()
+                    .filter(e -> e.scheduled() || motionEnabled && System.nanoTime() - lastMotionCaptureNanos
+                            >= motionMinInterval.toNanos())
+                    .findFirst().orElse(null);
+            if (event == null || timelapseService.isGenerating()) {
+                continue;
+            }
+            String kind = event.scheduled() ? "Scheduled" : "Motion";
+            if (!cameraSemaphore.tryAcquire()) {
+                LOG.debug("Skipping " + kind.toLowerCase() + " capture - camera busy with another capture");
+                continue;
+            }
+            if (event.trigger() == MotionEvent.Trigger.SCENE_CHANGE) {
+                LOG.infof("Scene changed by %d hash bits in frame %d, capturing", event.hashDistance(),
+                        event.sequence());
+            } else if (event.trigger() == MotionEvent.Trigger.INTERVAL) {
+                LOG.debugf("Scene unchanged for %s, capturing", scheduleMaxInterval);
+            } else {
+                lastMotionCaptureNanos = System.nanoTime();
+                LOG.infof("Motion in frame %d (%.1f%% of the view), capturing", event.sequence(),
+                        event.changedPercent());
+            }
+            captureToTimelapse(kind);
         }
     }
 
@@ -116,6 +427,21 @@ public class CameraService {
         return builder.build();
     }
 
+    // The waterline region and calibration, if both are configured
+    private Waterline.Params buildWaterlineParams() {
+        if (waterlineRegion.isEmpty() || waterlineCalibration.isEmpty()) {
+            return null;
+        }
+        List<Double> region = waterlineRegion.get();
+        List<Double> calibration = waterlineCalibration.get();
+        if (region.size() != 4 || calibration.size() != 4) {
+            LOG.warn("Waterline disabled: camera.waterline.region and camera.waterline.calibration need 4 values each");
+            return null;
+        }
+        return new Waterline.Params(region.get(0), region.get(1), region.get(2), region.get(3),
+                calibration.get(0), calibration.get(1), calibration.get(2), calibration.get(3));
+    }
+
     /**
      * Returns the current camera settings.
      *
@@ -162,6 +488,84 @@ public class CameraService {
         return lastCaptureTime != null ? lastCaptureTime.format(TIMESTAMP_FORMAT) : "Never";
     }
 
+    /**
+     * Returns where the time of the timelapse and motion captures has gone
+     * since startup, stage by stage.
+     *
+     * @return the summed stage timings
+     */
+    public CaptureLatency getCaptureLatency() {
+        return captureLatency;
+    }
+
+    /**
+     * Returns the distribution of one latency of the timelapse and motion
+     * captures since startup, failed captures included.
+     *
+     * @param kind which latency
+     * @return the summed histogram
+     */
+    public LatencyHistogram getLatencyHistogram(LatencyHistogram.Kind kind) {
+        return latencyHistograms.get(kind);
+    }
+
+    /**
+     * Logs the percentiles of the capture latencies every hour, so that tail
+     * latencies, such as request timeouts under thermal throttling, can be
+     * followed in production logs.
+     */
+    @Scheduled(every = "1h", delayed = "1h")
+    void logLatencyPercentiles() {
+        Map<LatencyHistogram.Kind, LatencyHistogram> histograms = latencyHistograms;
+        if (histograms.get(LatencyHistogram.Kind.CAPTURE).count() == 0) {
+            return;
+        }
+        StringBuilder table = new StringBuilder("Capture latency percentiles since startup:");
+        histograms.forEach((kind, histogram) -> {
+            table.append(String.format("%n  %-20s n=%d", kind, histogram.count()));
+            histogram.percentiles().forEach((name, value) ->
+                    table.append(String.format(" %s=%.1fms", name, value.toNanos() / 1e6)));
+        });
+        LOG.info(table);
+    }
+
+    /**
+     * Logs every hour whether the monitored stream keeps up with the sensor,
+     * warning when frames were dropped, duplicated or completed late.
+     */
+    @Scheduled(every = "1h", delayed = "1h")
+    void logSequenceStats() {
+        CaptureSession monitoring;
+        synchronized (monitorLock) {
+            monitoring = monitorSession;
+        }
+        if (monitoring == null) {
+            return;
+        }
+        FrameSequenceStats stats;
+        try {
+            stats = monitoring.sequenceStats(CaptureSession.STREAM_MONITOR, true);
+        } catch (IllegalStateException e) {
+            return; // closed meanwhile
+        }
+        String summary = String.format("Camera stream in the last hour: %d frames at %.1f fps, jitter %.2f ms, "
+                + "%d dropped, %d duplicate, %d late", stats.frames(), stats.frameRate(), stats.jitterNs() / 1e6,
+                stats.dropped(), stats.duplicates(), stats.late());
+        if (stats.hasGaps()) {
+            LOG.warn(summary);
+        } else {
+            LOG.info(summary);
+        }
+    }
+
+    private static Map<LatencyHistogram.Kind, LatencyHistogram> emptyHistograms() {
+        Map<LatencyHistogram.Kind, LatencyHistogram> histograms = new EnumMap<>(LatencyHistogram.Kind.class);
+        for (LatencyHistogram.Kind kind : LatencyHistogram.Kind.values()) {
+            histograms.put(kind, LatencyHistogram.empty());
+        }
+        return histograms;
+    }
+
     /**
      * Asynchronously captures a JPEG image with metadata at standard resolution.
      *
@@ -172,11 +576,11 @@ public class CameraService {
         if (!cameraAvailable) {
             return CompletableFuture.failedFuture(new UnsupportedOperationException("Camera not available"));
         }
-        if (!cameraSemaphore.tryAcquire()) {
+        if (!acquireCamera()) {
             return CompletableFuture.failedFuture(new IllegalStateException("Camera is busy with another capture, please wait and try again"));
         }
         return CameraCapture.captureWithMetadataAsync(WIDTH, HEIGHT, settings)
-            .whenComplete((result, ex) -> cameraSemaphore.release());
+            .whenComplete((result, ex) -> releaseCamera());
     }
 
     /**
@@ -189,28 +593,62 @@ public class CameraService {
         if (!cameraAvailable) {
             return CompletableFuture.failedFuture(new UnsupportedOperationException("Camera not available"));
         }
-        if (!cameraSemaphore.tryAcquire()) {
+        if (!acquireCamera()) {
             return CompletableFuture.failedFuture(new IllegalStateException("Camera is busy with another capture, please wait and try again"));
         }
         return CameraCapture.captureFullResolutionWithMetadataAsync(settings)
-            .whenComplete((result, ex) -> cameraSemaphore.release());
+            .whenComplete((result, ex) -> releaseCamera());
     }
 
     /**
-     * Asynchronously captures a raw image and returns it as DNG bytes.
+     * Asynchronously captures a raw image for streaming as a DNG file. The
+     * camera is free again once the future completes; the DNG is produced as
+     * the stream is read.
      *
      * @param settings camera settings to apply
-     * @return a CompletableFuture that completes with the DNG file content
+     * @return a CompletableFuture that completes with the DNG, to be closed by the caller
      */
-    public CompletableFuture<byte[]> captureDngAsync(CameraSettings settings) {
+    public CompletableFuture<DngStream> captureDngAsync(CameraSettings settings) {
         if (!cameraAvailable) {
             return CompletableFuture.failedFuture(new UnsupportedOperationException("Camera not available"));
         }
+        if (!acquireCamera()) {
+            return CompletableFuture.failedFuture(new IllegalStateException("Camera is busy with another capture, please wait and try again"));
+        }
+        return CameraCapture.captureDngStreamAsync(settings)
+            .whenComplete((result, ex) -> releaseCamera());
+    }
+
+    /**
+     * Asynchronously sweeps the lens across its range to find the sharpest
+     * manual focus position for the centre of the view. The current settings
+     * are left unchanged; apply the position found to keep it.
+     *
+     * @return a CompletableFuture that completes with the sweep
+     */
+    public CompletableFuture<FocusSweep> focusSweepAsync() {
+        if (!cameraAvailable) {
+            return CompletableFuture.failedFuture(new UnsupportedOperationException("Camera not available"));
+        }
+        // A session sweeps, through the monitor's if it is open, as captures to the store do
         if (!cameraSemaphore.tryAcquire()) {
             return CompletableFuture.failedFuture(new IllegalStateException("Camera is busy with another capture, please wait and try again"));
         }
-        return CameraCapture.captureDngBytesAsync(settings)
-            .whenComplete((result, ex) -> cameraSemaphore.release());
+        CaptureSession monitoring;
+        synchronized (monitorLock) {
+            monitoring = monitorSession;
+        }
+        CameraSettings settings = currentSettings;
+        return CompletableFuture.supplyAsync(() -> {
+            if (monitoring != null) {
+                monitoring.applySettings(settings);
+                return monitoring.focusSweep(FocusSweep.Params.defaults());
+            }
+            try (CaptureSession session = CaptureSession.open(WIDTH, HEIGHT)) {
+                session.applySettings(settings);
+                return session.focusSweep(FocusSweep.Params.defaults());
+            }
+        }, sessionExecutor).whenComplete((result, ex) -> cameraSemaphore.release());
     }
 
     /**
@@ -223,27 +661,35 @@ public class CameraService {
         return captureWithMetadataAsync(settings)
             .thenApply(result -> {
                 saveLatestPhoto(result.jpeg());
+                // Captures to the store are published natively; this one went through Java
+                if (frameExport != null) {
+                    frameExport.publish(result.metadata().timestamp(), result.metadata().width(),
+                        result.metadata().height(), result.jpeg());
+                }
                 return result;
             });
     }
 
     /**
      * Saves the given JPEG bytes as the latest photo on disk and for timelapse.
+     * Both files are written asynchronously; this method does not block on disk I/O.
      *
      * @param jpeg the JPEG image data
      */
     public void saveLatestPhoto(byte[] jpeg) {
-        try {
-            Path photoPath = Path.of(LATEST_PHOTO_FILENAME);
-            Files.write(photoPath, jpeg);
-            lastCaptureTime = LocalDateTime.now();
-            LOG.info("Latest photo saved to " + photoPath.toAbsolutePath());
+        Path photoPath = Path.of(LATEST_PHOTO_FILENAME);
+        lastCaptureTime = LocalDateTime.now();
+        timelapseService.writeFile(photoPath, jpeg)
+            .whenComplete((ignored, ex) -> {
+                if (ex != null) {
+                    LOG.error("Failed to save latest photo", ex);
+                } else {
+                    LOG.info("Latest photo saved to " + photoPath.toAbsolutePath());
+                }
+            });
 
-            // Also save for timelapse
-            timelapseService.saveTimelapseImage(jpeg, lastCaptureTime);
-        } catch (IOException e) {
-            LOG.error("Failed to save latest photo", e);
-        }
+        // Also save for timelapse
+        timelapseService.saveTimelapseImage(jpeg, lastCaptureTime);
     }
 
     /**
@@ -282,7 +728,8 @@ public class CameraService {
     }
 
     /**
-     * Scheduled task that captures a photo every 15 seconds.
+     * Scheduled task that captures a photo every 15 seconds, unless the
+     * monitor schedules the captures by scene changes.
      */
     @Scheduled(every = "15s")
     void periodicCapture() {
@@ -290,6 +737,13 @@ public class CameraService {
             LOG.debug("Skipping periodic capture - camera not available");
             return;
         }
+        if (adaptiveSchedule && motionDetector != null) {
+            synchronized (monitorLock) {
+                if (monitorSession != null) {
+                    return;
+                }
+            }
+        }
         if (timelapseService.isGenerating()) {
             LOG.debug("Skipping periodic capture - timelapse generation in progress");
             return;
@@ -299,15 +753,91 @@ public class CameraService {
             return;
         }
         LOG.info("Starting periodic capture...");
-        CameraCapture.captureWithMetadataAsync(WIDTH, HEIGHT, currentSettings)
+        captureToTimelapse("Periodic");
+    }
+
+    // Captures into the timelapse store with the camera semaphore held, and releases it when done.
+    private void captureToTimelapse(String kind) {
+        FrameStore store = timelapseService.frameStore();
+        if (store == null) {
+            cameraSemaphore.release();
+            LOG.debug("Skipping " + kind.toLowerCase() + " capture - frame store not available");
+            return;
+        }
+        // Encoded natively and appended straight to the timelapse store
+        LocalDateTime captureTime = LocalDateTime.now();
+        long key = TimelapseService.storeKey(captureTime);
+        captureToStoreAsync(store, key)
             .whenComplete((result, ex) -> cameraSemaphore.release())
             .thenAccept(result -> {
-                saveLatestPhoto(result.jpeg());
-                LOG.info("Periodic capture completed successfully");
+                lastCaptureTime = captureTime;
+                lastAnalogueGain = result.analogueGain();
+                Waterline waterline = result.waterline();
+                if (waterline != null && waterline.confidence() >= waterlineMinConfidence) {
+                    waterDistanceService.addCameraLevel(
+                            captureTime.atZone(ZoneId.systemDefault()).toInstant().toEpochMilli(), waterline.level());
+                }
+                try {
+                    // Copied natively from the store, never through the heap
+                    store.export(key, Path.of(LATEST_PHOTO_FILENAME));
+                } catch (RuntimeException e) {
+                    LOG.error("Failed to save latest photo", e);
+                }
+                LOG.info(kind + " capture completed successfully");
             })
             .exceptionally(ex -> {
-                LOG.error("Periodic capture failed", ex);
+                LOG.error(kind + " capture failed", ex);
                 return null;
             });
     }
+
+    // Through the monitoring session if it is open, which pauses the monitor
+    // for the capture; otherwise in a session of its own. Night captures
+    // average a burst, day captures fuse the exposure bracket if one is set.
+    private CompletableFuture<ImageMetadata> captureToStoreAsync(FrameStore store, long key) {
+        int frames = lastAnalogueGain >= burstMinGain ? Math.clamp(burstFrames, 1, CaptureSession.MAX_BURST_FRAMES) : 1;
+        double[] bracket = frames > 1 ? new double[0]
+                : hdrBrackets.map(stops -> stops.stream().mapToDouble(Double::doubleValue).toArray())
+                        .orElse(new double[0]);
+        if (frames > 1) {
+            LOG.debug("Averaging " + frames + " frames at analogue gain " + lastAnalogueGain);
+        }
+        CaptureSession monitoring;
+        synchronized (monitorLock) {
+            monitoring = monitorSession;
+        }
+        return CompletableFuture.supplyAsync(() -> {
+            if (monitoring != null) {
+                return captureToStore(monitoring, store, key, frames, bracket);
+            }
+            try (CaptureSession session = CaptureSession.open(WIDTH, HEIGHT)) {
+                return captureToStore(session, store, key, frames, bracket);
+            }
+        }, sessionExecutor);
+    }
+
+    private ImageMetadata captureToStore(CaptureSession session, FrameStore store, long key, int burstFrames,
+                                         double[] bracket) {
+        session.applySettings(currentSettings);
+        session.setBurst(burstFrames, true);
+        session.setBracket(bracket);
+        session.setWaterline(waterlineParams);
+        session.setDenoise(Math.clamp(denoiseMinGain, 0, CaptureSession.MAX_DENOISE_GAIN),
+                Math.clamp(denoiseStrength, 0, CaptureSession.MAX_DENOISE_STRENGTH));
+        try {
+            return session.captureToStore(store, key, JPEG_QUALITY, timelapseService.thumbnails());
+        } finally {
+            collectLatency(session);
+        }
+    }
+
+    // Sessions other than the monitoring one close after the capture, so the
+    // counters are collected after each, failed ones too; only the session
+    // executor writes them
+    private void collectLatency(CaptureSession session) {
+        captureLatency = captureLatency.plus(session.latency(true));
+        Map<LatencyHistogram.Kind, LatencyHistogram> histograms = new EnumMap<>(latencyHistograms);
+        histograms.replaceAll((kind, histogram) -> histogram.plus(session.latencyHistogram(kind, true)));
+        latencyHistograms = histograms;
+    }
 }
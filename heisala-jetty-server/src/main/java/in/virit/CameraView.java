@@ -25,6 +25,8 @@ import com.vaadin.flow.router.Menu;
 import com.vaadin.flow.router.Route;
 import in.virit.libcamera4j.AfMode;
 import in.virit.libcamera4j.CameraSettings;
+import in.virit.libcamera4j.DngStream;
+import in.virit.libcamera4j.FrameStats;
 import in.virit.libcamera4j.ImageMetadata;
 import jakarta.inject.Inject;
 
@@ -153,6 +155,7 @@ public class CameraView extends VerticalLayout {
         private final RadioButtonGroup<Integer> rotationGroup = new RadioButtonGroup<>("Rotation");
         private final RadioButtonGroup<String> focusModeGroup = new RadioButtonGroup<>("Focus Mode");
         private final NumberField lensPositionField = new NumberField("Lens Position (dioptres)");
+        private final Button findFocusButton = new Button("Find Focus", e -> findFocus());
         private final RadioButtonGroup<String> exposureModeGroup = new RadioButtonGroup<>("Exposure Mode");
         private final ComboBox<ShutterSpeed> shutterSpeedField = new ComboBox<>("Shutter Speed");
         private final ComboBox<IsoGain> gainField = new ComboBox<>("ISO");
@@ -183,6 +186,8 @@ public class CameraView extends VerticalLayout {
 
             **Tip:** For shooting through a window, use manual focus at 0.0 (infinity) to prevent autofocus from focusing on the glass.
 
+            **Find Focus** sweeps the lens across its range and switches to manual focus at the position where the centre of the view is sharpest. Taking a photo then makes it the focus of the periodic captures too.
+
             ### Exposure Mode
             - **Auto** - Camera automatically sets shutter speed and gain
             - **Manual** - You control shutter speed and gain
@@ -233,7 +238,7 @@ public class CameraView extends VerticalLayout {
 
             lensPositionField.setMin(0);
             lensPositionField.setMax(15);
-            lensPositionField.setStep(0.5);
+            lensPositionField.setStep(0.1);
             lensPositionField.setHelperText("0 = infinity, higher = closer");
             lensPositionField.setVisible(false);
 
@@ -255,11 +260,33 @@ public class CameraView extends VerticalLayout {
 
             loadDefaultSettings();
 
-            content.add(rotationGroup, focusModeGroup, lensPositionField,
+            content.add(rotationGroup, focusModeGroup, lensPositionField, findFocusButton,
                        exposureModeGroup, shutterSpeedField, gainField);
             this.add(content);
         }
 
+        private void findFocus() {
+            UI ui = UI.getCurrent();
+            findFocusButton.setEnabled(false);
+            cameraService.focusSweepAsync()
+                .thenAccept(sweep -> ui.access(() -> {
+                    findFocusButton.setEnabled(true);
+                    focusModeGroup.setValue("Manual");
+                    lensPositionField.setValue(Math.round(sweep.bestPosition() * 10) / 10.0);
+                    String fom = sweep.focusFoM() >= 0 ? ", FoM " + sweep.focusFoM() : "";
+                    Notification.show(String.format("Sharpest at %.2f dioptres of %d positions (sharpness %.3f%s)",
+                            sweep.bestPosition(), sweep.positions().length, sweep.bestSharpness(), fom),
+                        5000, Notification.Position.BOTTOM_CENTER);
+                }))
+                .exceptionally(ex -> {
+                    ui.access(() -> {
+                        findFocusButton.setEnabled(true);
+                        Notification.show("Focus sweep failed: " + ex.getMessage(), 5000, Notification.Position.MIDDLE);
+                    });
+                    return null;
+                });
+        }
+
         private void loadDefaultSettings() {
             CameraSettings settings = cameraService.getCurrentSettings();
 
@@ -337,18 +364,20 @@ public class CameraView extends VerticalLayout {
                 UI ui = downloadEvent.getUI();
                 try {
                     CameraSettings settings = settingsPanel.getSettings();
-                    byte[] dngBytes = cameraService.captureDngAsync(settings).get();
-                    String timestamp = LocalDateTime.now().format(TIMESTAMP_FORMAT);
-                    String fileTimestamp = LocalDateTime.now().format(FILE_TIMESTAMP_FORMAT);
-                    String fileName = "capture_" + fileTimestamp + ".dng";
-                    downloadEvent.setFileName(fileName);
-                    downloadEvent.setContentType("image/x-adobe-dng");
-                    downloadEvent.setContentLength(dngBytes.length);
-                    downloadEvent.getOutputStream().write(dngBytes);
-                    ui.access(() -> {
-                        metadataGrid.setVisible(false);
-                        endCapture("DNG captured at " + timestamp);
-                    });
+                    // Streamed to the client as it is produced, never held whole
+                    try (DngStream dng = cameraService.captureDngAsync(settings).get()) {
+                        String timestamp = LocalDateTime.now().format(TIMESTAMP_FORMAT);
+                        String fileTimestamp = LocalDateTime.now().format(FILE_TIMESTAMP_FORMAT);
+                        String fileName = "capture_" + fileTimestamp + ".dng";
+                        downloadEvent.setFileName(fileName);
+                        downloadEvent.setContentType("image/x-adobe-dng");
+                        downloadEvent.setContentLength(dng.size());
+                        dng.transferTo(downloadEvent.getOutputStream());
+                        ui.access(() -> {
+                            metadataGrid.setVisible(false);
+                            endCapture("DNG captured at " + timestamp);
+                        });
+                    }
                 } catch (Exception e) {
                     handleCaptureError(ui, e);
                 }
@@ -396,6 +425,13 @@ public class CameraView extends VerticalLayout {
             if (metadata.lux() > 0) {
                 entries.add(new MetadataEntry("Lux", String.format("%.1f", metadata.lux())));
             }
+            FrameStats stats = metadata.stats();
+            if (stats != null) {
+                entries.add(new MetadataEntry("Luma Mean / Median",
+                        String.format("%.0f / %d", stats.mean(), stats.median())));
+                entries.add(new MetadataEntry("Clipped Dark / Bright",
+                        String.format("%.1f%% / %.1f%%", stats.clippedLowPercent(), stats.clippedHighPercent())));
+            }
             entries.add(new MetadataEntry("Sequence", String.valueOf(metadata.sequence())));
             entries.forEach(md -> {
                 add(new Term(md.property()));
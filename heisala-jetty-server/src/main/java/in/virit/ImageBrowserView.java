@@ -116,8 +116,7 @@ public class ImageBrowserView extends VerticalLayout {
         
         imageGrid.addColumn(new ComponentRenderer<>(image -> {
             Image thumb = new Image();
-            String relativePath = timelapseService.TIMELAPSE_DIR.relativize(image.path()).toString();
-            thumb.setSrc("/api/images/" + relativePath.replace("\\", "/"));
+            thumb.setSrc("/api/images/" + image.getFileName() + "?size=160");
             thumb.setWidth("120px");
             thumb.setHeight("80px");
             thumb.setAlt("Thumbnail: " + image.getDisplayTime());
@@ -130,13 +129,8 @@ public class ImageBrowserView extends VerticalLayout {
             .setSortable(true)
             .setWidth("250px");
 
-        imageGrid.addColumn(image -> {
-            try {
-                return Files.size(image.path()) / 1024 + " KB";
-            } catch (IOException e) {
-                return "N/A";
-            }
-        }).setHeader("Size").setWidth("100px");
+        imageGrid.addColumn(image -> image.size() / 1024 + " KB")
+            .setHeader("Size").setWidth("100px");
 
         imageGrid.asSingleSelect().addValueChangeListener(event -> {
             if (event.getValue() != null) {
@@ -223,15 +217,10 @@ public class ImageBrowserView extends VerticalLayout {
 
 
     private void showImagePreview(TimelapseService.TimelapseImage image) {
-        try {
-            // Use the same approach as thumbnails for consistency
-            String relativePath = timelapseService.TIMELAPSE_DIR.relativize(image.path()).toString();
-            previewImage.setSrc("/api/images/" + relativePath.replace("\\", "/"));
-            previewInfo.setText("Taken: " + image.getDisplayTime() + " | Size: " + 
-                (Files.size(image.path()) / 1024) + " KB | Path: " + image.path());
-        } catch (IOException e) {
-            Notification.show("Error loading image: " + e.getMessage(), 3000, Notification.Position.MIDDLE);
-        }
+        // Use the same approach as thumbnails for consistency
+        previewImage.setSrc("/api/images/" + image.getFileName());
+        previewInfo.setText("Taken: " + image.getDisplayTime() + " | Size: " + 
+            (image.size() / 1024) + " KB | Name: " + image.getFileName());
     }
 
     /**
@@ -244,10 +233,8 @@ public class ImageBrowserView extends VerticalLayout {
 
         LocalDateTime targetDateTime = dateTimeFilter.getValue();
         
-        // Find the closest image to the target datetime
-        TimelapseService.TimelapseImage closestImage = allImages.stream()
-            .min(Comparator.comparingLong(img -> Math.abs(java.time.Duration.between(img.timestamp(), targetDateTime).getSeconds())))
-            .orElse(null);
+        // Binary search in the store index instead of scanning all images
+        TimelapseService.TimelapseImage closestImage = timelapseService.findClosest(targetDateTime);
 
         if (closestImage != null) {
             getUI().ifPresent(ui -> 
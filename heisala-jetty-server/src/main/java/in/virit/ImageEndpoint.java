@@ -1,41 +1,45 @@
 package in.virit;
 
+import jakarta.inject.Inject;
 import jakarta.ws.rs.GET;
 import jakarta.ws.rs.PathParam;
 import jakarta.ws.rs.Produces;
+import jakarta.ws.rs.QueryParam;
 import jakarta.ws.rs.core.Response;
-import java.io.IOException;
-import java.nio.file.Files;
-import java.nio.file.Path;
+import java.time.LocalDateTime;
 
 /**
- * REST endpoint to serve timelapse images
+ * REST endpoint to serve timelapse images from the frame store.
+ * Images are addressed by name (yyyyMMdd_HHmmss.jpg); any leading directories,
+ * as in the old YYYY/MM/DD layout, are ignored. With {@code ?size=N} the
+ * smallest stored thumbnail whose longer side is at least N pixels is served
+ * instead, or the full image if there is none that large.
  */
 @jakarta.ws.rs.Path("/images")
 public class ImageEndpoint {
-    
-    private static final Path TIMELAPSE_DIR = Path.of("timelapse");
-    
+
+    @Inject
+    TimelapseService timelapseService;
+
     @GET
     @jakarta.ws.rs.Path("{path:.+}")
     @Produces("image/jpeg")
-    public Response serveImage(@PathParam("path") String path) {
+    public Response serveImage(@PathParam("path") String path, @QueryParam("size") int size) {
         try {
-            Path imagePath = TIMELAPSE_DIR.resolve(path);
-            
-            // Security check: ensure the path is within the timelapse directory
-            if (!imagePath.normalize().startsWith(TIMELAPSE_DIR.normalize())) {
-                return Response.status(Response.Status.FORBIDDEN).build();
+            String name = path.substring(path.lastIndexOf('/') + 1);
+            LocalDateTime timestamp = TimelapseService.parseTimestamp(name);
+            if (timestamp == null) {
+                return Response.status(Response.Status.NOT_FOUND).build();
             }
-            
-            if (Files.exists(imagePath) && Files.isRegularFile(imagePath)) {
-                byte[] imageData = Files.readAllBytes(imagePath);
+
+            byte[] imageData = timelapseService.readImage(timestamp, size);
+            if (imageData != null) {
                 return Response.ok(imageData).build();
             } else {
                 return Response.status(Response.Status.NOT_FOUND).build();
             }
-        } catch (IOException e) {
+        } catch (RuntimeException e) {
             return Response.status(Response.Status.INTERNAL_SERVER_ERROR).entity(e.getMessage()).build();
         }
     }
-}
\ No newline at end of file
+}
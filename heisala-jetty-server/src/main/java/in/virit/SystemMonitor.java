@@ -6,6 +6,8 @@ import com.vaadin.flow.component.html.Div;
 import com.vaadin.flow.component.html.Span;
 import com.vaadin.flow.component.orderedlayout.VerticalLayout;
 import com.vaadin.flow.component.progressbar.ProgressBar;
+import in.virit.libcamera4j.CaptureLatency;
+import in.virit.libcamera4j.CaptureLatency.Stage;
 
 import java.lang.management.ManagementFactory;
 import java.lang.management.OperatingSystemMXBean;
@@ -15,10 +17,12 @@ import java.util.concurrent.ScheduledExecutorService;
 import java.util.concurrent.ScheduledFuture;
 import java.util.concurrent.Executors;
 import java.util.concurrent.TimeUnit;
+import java.util.function.Supplier;
 
 /**
  * A widget that displays system CPU and memory usage, updated every 2 seconds.
- * Also tracks file generation progress with ETA.
+ * Also tracks file generation progress with ETA, and shows where the time of
+ * the camera captures goes when given their latency.
  */
 public class SystemMonitor extends VerticalLayout {
 
@@ -32,6 +36,11 @@ public class SystemMonitor extends VerticalLayout {
     private final Span progressLabel = new Span();
     private final Div tempSection;
     private final Div progressSection;
+    private final ProgressBar captureBar = new ProgressBar(0, 1);
+    private final Span captureLabel = new Span();
+    private final Span captureBreakdown = new Span();
+    private final Div captureSection;
+    private final Supplier<CaptureLatency> captureLatency;
 
     private final ScheduledExecutorService executor = Executors.newSingleThreadScheduledExecutor();
     private ScheduledFuture<?> updateTask;
@@ -42,6 +51,15 @@ public class SystemMonitor extends VerticalLayout {
     private long lastFileSizeTime;
 
     public SystemMonitor() {
+        this(null);
+    }
+
+    /**
+     * @param captureLatency source of the capture stage timings, or null to
+     *                       leave them out
+     */
+    public SystemMonitor(Supplier<CaptureLatency> captureLatency) {
+        this.captureLatency = captureLatency;
         setSpacing(false);
         setPadding(true);
         setWidth("200px");
@@ -64,6 +82,18 @@ public class SystemMonitor extends VerticalLayout {
         progressBar.setIndeterminate(true);
         add(progressSection);
 
+        // Capture latency section (hidden until a capture has been timed); the
+        // bar is the share of a capture spent encoding and writing
+        captureSection = createSection("Capture", captureBar, captureLabel);
+        captureSection.setVisible(false);
+        captureBreakdown.getStyle()
+            .setFontSize("var(--lumo-font-size-xxs)")
+            .setColor("var(--lumo-secondary-text-color)")
+            .set("white-space", "pre-line");
+        captureSection.add(captureBreakdown);
+        captureBar.setWidth("100%");
+        add(captureSection);
+
         // Style the bars
         cpuBar.setWidth("100%");
         memoryBar.setWidth("100%");
@@ -184,6 +214,8 @@ public class SystemMonitor extends VerticalLayout {
                     }
                 }
 
+                CaptureLatency latency = captureLatency != null ? captureLatency.get() : null;
+
                 final double finalProgress = progress;
                 final String finalProgressText = progressText;
                 final long finalFileSize = currentFileSize;
@@ -206,6 +238,10 @@ public class SystemMonitor extends VerticalLayout {
                         tempBar.getStyle().set("--vaadin-progress-color", color);
                     }
 
+                    if (latency != null && latency.get(Stage.TOTAL).count() > 0) {
+                        showCaptureLatency(latency);
+                    }
+
                     if (monitoredFile != null) {
                         progressLabel.setText(finalProgressText);
 
@@ -232,6 +268,24 @@ public class SystemMonitor extends VerticalLayout {
         }
     }
 
+    private void showCaptureLatency(CaptureLatency latency) {
+        CaptureLatency.Counter total = latency.get(Stage.TOTAL);
+        captureSection.setVisible(true);
+        captureLabel.setText(String.format("%d ms, max %d ms", total.mean().toMillis(), total.max().toMillis()));
+        long output = latency.get(Stage.ENCODE).sumNs() + latency.get(Stage.WRITE).sumNs();
+        captureBar.setValue(Math.min(1.0, (double) output / total.sumNs()));
+
+        StringBuilder breakdown = new StringBuilder();
+        for (Stage stage : Stage.values()) {
+            CaptureLatency.Counter counter = latency.get(stage);
+            if (stage != Stage.TOTAL && counter.count() > 0) {
+                breakdown.append(String.format("%s %.1f ms (max %.1f)%n", stage.name().toLowerCase(),
+                    counter.mean().toNanos() / 1e6, counter.max().toNanos() / 1e6));
+            }
+        }
+        captureBreakdown.setText(breakdown.toString().trim());
+    }
+
     private double getCpuLoad() {
         OperatingSystemMXBean os = ManagementFactory.getOperatingSystemMXBean();
         if (os instanceof com.sun.management.OperatingSystemMXBean sunOs) {
@@ -1,21 +1,52 @@
 package in.virit;
 
+import in.virit.libcamera4j.CaptureSession;
+import in.virit.libcamera4j.FrameIndex;
+import in.virit.libcamera4j.FrameStore;
+import in.virit.libcamera4j.FrameWriter;
+import in.virit.libcamera4j.ImageScan;
+import in.virit.libcamera4j.TimelapseFrames;
 import io.quarkus.scheduler.Scheduled;
 import jakarta.annotation.PostConstruct;
+import jakarta.annotation.PreDestroy;
 import jakarta.enterprise.context.ApplicationScoped;
+import jakarta.inject.Inject;
+import org.eclipse.microprofile.config.inject.ConfigProperty;
 import org.jboss.logging.Logger;
 
+import javax.imageio.IIOImage;
+import javax.imageio.ImageIO;
+import javax.imageio.ImageWriteParam;
+import javax.imageio.ImageWriter;
+import javax.imageio.stream.ImageOutputStream;
+import java.awt.Graphics2D;
+import java.awt.Image;
+import java.awt.image.BufferedImage;
 import java.io.BufferedReader;
+import java.io.ByteArrayInputStream;
+import java.io.ByteArrayOutputStream;
 import java.io.IOException;
 import java.io.InputStreamReader;
+import java.io.OutputStream;
 import java.nio.file.Files;
 import java.nio.file.Path;
+import java.time.Duration;
+import java.time.Instant;
 import java.time.LocalDateTime;
+import java.time.ZoneId;
 import java.time.format.DateTimeFormatter;
+import java.time.temporal.ChronoUnit;
+import java.util.ArrayList;
 import java.util.Comparator;
 import java.util.HashSet;
 import java.util.List;
+import java.util.Map;
+import java.util.NavigableMap;
 import java.util.Set;
+import java.util.TreeMap;
+import java.util.concurrent.CompletableFuture;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
 import java.util.function.Consumer;
 import java.util.stream.Stream;
 
@@ -27,16 +58,73 @@ public class TimelapseService {
 
     private static final Logger LOG = Logger.getLogger(TimelapseService.class);
     public static final Path TIMELAPSE_DIR = Path.of("timelapse");
+    private static final Path STORE_DIR = TIMELAPSE_DIR.resolve("store");
+    // One store per thumbnail size, keyed like the full images
+    private static final Path THUMBNAILS_DIR = TIMELAPSE_DIR.resolve("thumbs");
+    private static final int[] THUMBNAIL_SIZES = {160, 480};
+    private static final int THUMBNAIL_QUALITY = 70;
+    // Store key up to which images have been recompressed, so that each night
+    // only reads the images that have aged past the limit since
+    private static final Path RECOMPRESSED_UNTIL = TIMELAPSE_DIR.resolve("recompressed-until");
+    // Share of deleted data at which thinning and cleanup rewrite a day's segment
+    private static final double COMPACT_RATIO = 0.2;
+    // JPEG quality of frames re-encoded by deflicker or stabilization before FFmpeg scales them
+    private static final int CORRECTED_QUALITY = 92;
+    // Legacy images moved into the store per sync, before their files are deleted
+    private static final int MIGRATE_BATCH = 256;
     private static final DateTimeFormatter FILE_FORMAT = DateTimeFormatter.ofPattern("yyyyMMdd_HHmmss");
+    private static final DateTimeFormatter DAY_DIR_FORMAT = DateTimeFormatter.ofPattern("yyyy/MM/dd");
     private static final DateTimeFormatter DISPLAY_FORMAT = DateTimeFormatter.ofPattern("yyyy-MM-dd HH:mm:ss");
 
+    @Inject
+    @ConfigProperty(name = "timelapse.commit.interval", defaultValue = "60s")
+    Duration commitInterval;
+
+    @Inject
+    @ConfigProperty(name = "timelapse.commit.bytes", defaultValue = "16777216")
+    long commitBytes;
+
+    @Inject
+    @ConfigProperty(name = "timelapse.thin.hash-distance", defaultValue = "6")
+    int thinHashDistance;
+
+    @Inject
+    @ConfigProperty(name = "timelapse.recompress.days", defaultValue = "0")
+    int recompressDays;
+
+    @Inject
+    @ConfigProperty(name = "timelapse.recompress.width", defaultValue = "1280")
+    int recompressWidth;
+
+    @Inject
+    @ConfigProperty(name = "timelapse.recompress.quality", defaultValue = "60")
+    int recompressQuality;
+
+    @Inject
+    @ConfigProperty(name = "timelapse.deflicker.window", defaultValue = "9")
+    int deflickerWindow;
+
+    @Inject
+    @ConfigProperty(name = "timelapse.stabilize.window", defaultValue = "15")
+    int stabilizeWindow;
+
     private boolean ffmpegAvailable;
     private volatile Process currentProcess;
     private volatile boolean cancelled;
 
-    // Cached image list - loaded on boot, updated programmatically
-    private volatile List<TimelapseImage> cachedImages;
+    // Set once legacy images have been moved into the store, or listed without one
     private volatile boolean cacheLoaded;
+    // Images of the one-file-per-image layout, served when the native store is
+    // not available (UI-only and development runs); sorted by timestamp
+    private volatile List<TimelapseImage> legacyImages = List.of();
+
+    // Native asynchronous writer, or null when the native library is unavailable
+    private FrameWriter frameWriter;
+    // Native segment store holding the timelapse images, or null when unavailable
+    private FrameStore store;
+    // Thumbnail stores by the longer side of their images; empty when unavailable
+    private final NavigableMap<Integer, FrameStore> thumbnailStores = new TreeMap<>();
+    private final ExecutorService storeExecutor = Executors.newVirtualThreadPerTaskExecutor();
 
     @PostConstruct
     void init() {
@@ -46,6 +134,31 @@ public class TimelapseService {
             LOG.error("Failed to create timelapse directory", e);
         }
 
+        try {
+            frameWriter = FrameWriter.create();
+            LOG.info("Frame writer started (" + frameWriter.backend() + ")");
+        } catch (Throwable e) {
+            LOG.warn("Native frame writer not available - saving images synchronously: " + e.getMessage());
+        }
+
+        try {
+            store = FrameStore.open(STORE_DIR);
+            store.setGroupCommit(commitInterval, commitBytes);
+        } catch (Throwable e) {
+            LOG.warn("Native frame store not available - serving timelapse images from files: " + e.getMessage());
+        }
+        if (store != null) {
+            for (int size : THUMBNAIL_SIZES) {
+                try {
+                    FrameStore thumbnails = FrameStore.open(THUMBNAILS_DIR.resolve(String.valueOf(size)));
+                    thumbnails.setGroupCommit(commitInterval, commitBytes);
+                    thumbnailStores.put(size, thumbnails);
+                } catch (Throwable e) {
+                    LOG.warn("Failed to open " + size + "px thumbnail store - serving full images: " + e.getMessage());
+                }
+            }
+        }
+
         // Check if FFmpeg is available
         try {
             Process process = new ProcessBuilder("ffmpeg", "-version")
@@ -63,61 +176,146 @@ public class TimelapseService {
             LOG.warn("FFmpeg not available - timelapse video generation will be disabled: " + e.getMessage());
         }
 
-        // Warm image cache asynchronously
-        Thread.startVirtualThread(this::refreshImageCache);
+        // Move images from the old one-file-per-image layout, or list them
+        // to serve when there is no store
+        Thread.startVirtualThread(() -> {
+            if (store != null) {
+                migrateLegacyImages();
+            } else {
+                legacyImages = scanLegacyImages();
+            }
+            cacheLoaded = true;
+        });
     }
 
-    /**
-     * Refreshes the cached image list by scanning disk.
-     * Called on boot and after bulk operations (cleanup/thinning).
-     */
-    void refreshImageCache() {
-        try {
-            List<TimelapseImage> images = scanImagesFromDisk();
-            this.cachedImages = images;
-            this.cacheLoaded = true;
-            LOG.debug("Image cache refreshed: " + images.size() + " images");
-        } catch (Exception e) {
-            LOG.error("Failed to refresh image cache", e);
+    @PreDestroy
+    void shutdown() {
+        storeExecutor.close();
+        if (frameWriter != null) {
+            frameWriter.close();
+        }
+        thumbnailStores.values().forEach(FrameStore::close);
+        if (store != null) {
+            store.close();
         }
     }
 
     /**
-     * Adds a single image to the cache in sorted order, avoiding a full disk rescan.
+     * Returns whether the image list is complete, i.e. images from the old
+     * one-file-per-image layout have been moved into the store, or listed if
+     * there is none.
      */
-    private void addToCache(TimelapseImage image) {
-        List<TimelapseImage> current = this.cachedImages;
-        if (current == null) {
-            return; // cache not yet initialized
-        }
-        var updated = new java.util.ArrayList<>(current);
-        // Insert in sorted position by timestamp
-        int pos = java.util.Collections.binarySearch(updated, image, Comparator.comparing(TimelapseImage::timestamp));
-        if (pos < 0) pos = -pos - 1;
-        updated.add(pos, image);
-        this.cachedImages = List.copyOf(updated);
+    public boolean isCacheLoaded() {
+        return cacheLoaded;
     }
 
     /**
-     * Returns whether the image cache has been loaded at least once.
+     * Appends images saved as timelapse/YYYY/MM/DD/yyyyMMdd_HHmmss.jpg by earlier
+     * versions to the store and removes the files and emptied directories.
+     * Files are only removed once the store has synced their images, a batch
+     * at a time. The tree is listed with the native scanner, so the check is
+     * cheap on startups where there is nothing left to move.
      */
-    public boolean isCacheLoaded() {
-        return cacheLoaded;
+    private void migrateLegacyImages() {
+        if (store == null) {
+            return;
+        }
+        ImageScan scan;
+        try {
+            scan = ImageScan.scan(TIMELAPSE_DIR);
+        } catch (RuntimeException e) {
+            LOG.error("Failed to scan legacy timelapse images", e);
+            return;
+        }
+        if (scan.size() == 0) {
+            return;
+        }
+        LOG.info("Moving " + scan.size() + " timelapse images into the frame store");
+        int migrated = 0;
+        List<Path> batch = new ArrayList<>();
+        for (int i = 0; i < scan.size(); i++) {
+            Path file = scan.path(i);
+            try {
+                store.append(scan.timestampMs(i), Files.readAllBytes(file));
+                batch.add(file);
+            } catch (Exception e) {
+                LOG.error("Failed to migrate timelapse image " + file, e);
+            }
+            if (batch.size() == MIGRATE_BATCH || i == scan.size() - 1) {
+                int deleted = deleteMigrated(batch);
+                if (deleted < 0) {
+                    break;
+                }
+                migrated += deleted;
+                batch.clear();
+            }
+        }
+        // Day directories, then their month and year directories, if now empty
+        Set<Path> dirs = new java.util.TreeSet<>(Comparator.reverseOrder());
+        for (String day : scan.directories()) {
+            Path dir = TIMELAPSE_DIR.resolve(day);
+            dirs.add(dir);
+            dirs.add(dir.getParent());
+            dirs.add(dir.getParent().getParent());
+        }
+        for (Path dir : dirs) {
+            try (Stream<Path> entries = Files.list(dir)) {
+                if (entries.findAny().isEmpty()) {
+                    Files.delete(dir);
+                }
+            } catch (IOException e) {
+                LOG.debug("Could not remove directory " + dir + ": " + e.getMessage());
+            }
+        }
+        LOG.info("Moved " + migrated + " timelapse images into the frame store");
     }
 
-    private List<TimelapseImage> scanImagesFromDisk() {
-        if (!Files.exists(TIMELAPSE_DIR)) {
+    // Deletes the files of migrated images once the store has made them
+    // durable. Returns how many were deleted, or -1 if the sync failed.
+    private int deleteMigrated(List<Path> files) {
+        if (files.isEmpty()) {
+            return 0;
+        }
+        try {
+            store.sync();
+        } catch (RuntimeException e) {
+            LOG.error("Failed to sync migrated timelapse images - keeping their files", e);
+            return -1;
+        }
+        int deleted = 0;
+        for (Path file : files) {
+            try {
+                Files.delete(file);
+                deleted++;
+            } catch (IOException e) {
+                LOG.error("Failed to delete migrated timelapse image " + file, e);
+            }
+        }
+        return deleted;
+    }
+
+    // Lists the images of the one-file-per-image layout without the native
+    // scanner, for when the native library is not available
+    private static List<TimelapseImage> scanLegacyImages() {
+        if (!Files.isDirectory(TIMELAPSE_DIR)) {
             return List.of();
         }
-        try (Stream<Path> files = Files.walk(TIMELAPSE_DIR)) {
+        try (Stream<Path> files = Files.walk(TIMELAPSE_DIR, 4)) {
             return files
-                .filter(p -> p.toString().endsWith(".jpg"))
-                .map(this::parseTimelapseImage)
-                .filter(img -> img != null)
+                .filter(path -> path.getFileName().toString().endsWith(".jpg"))
+                .map(path -> {
+                    LocalDateTime timestamp = parseTimestamp(path.getFileName().toString());
+                    try {
+                        return timestamp == null ? null : new TimelapseImage(timestamp, (int) Files.size(path));
+                    } catch (IOException e) {
+                        return null;
+                    }
+                })
+                .filter(image -> image != null)
                 .sorted(Comparator.comparing(TimelapseImage::timestamp))
                 .toList();
-        } catch (IOException e) {
-            LOG.error("Failed to scan timelapse images from disk", e);
+        } catch (IOException | RuntimeException e) {
+            LOG.error("Failed to list timelapse images", e);
             return List.of();
         }
     }
@@ -219,60 +417,224 @@ public class TimelapseService {
     }
 
     /**
-     * Saves a JPEG image for timelapse with timestamp filename in year/month/day structure.
+     * Appends a JPEG image to the timelapse store. The write happens
+     * asynchronously; the image is listed once it is stored.
      *
      * @param jpeg the JPEG image data
      * @param timestamp the capture timestamp
+     * @return a future that completes when the image has been stored
+     */
+    public CompletableFuture<Void> saveTimelapseImage(byte[] jpeg, LocalDateTime timestamp) {
+        if (store == null) {
+            return CompletableFuture.failedFuture(new IllegalStateException("Frame store not available"));
+        }
+        LocalDateTime key = timestamp.truncatedTo(ChronoUnit.SECONDS);
+        return CompletableFuture.runAsync(() -> store.append(storeKey(key), jpeg), storeExecutor)
+            .thenRun(() -> LOG.debug("Timelapse image saved: " + key))
+            .whenComplete((ignored, ex) -> {
+                if (ex != null) {
+                    LOG.error("Failed to save timelapse image " + key, ex);
+                }
+            });
+    }
+
+    /**
+     * Returns the timestamp of the newest image known to be on stable storage,
+     * i.e. one that would survive a power loss now.
+     *
+     * @return the timestamp, or null if nothing has been synced since startup
+     */
+    public LocalDateTime getDurableUpTo() {
+        if (store == null) {
+            return null;
+        }
+        FrameStore.Durability durability = store.durability();
+        return durability.durable() == 0 ? null : fromStoreKey(durability.durableTimestampMs());
+    }
+
+    /**
+     * Returns the store holding the timelapse images, or null if the native
+     * library is not available.
      */
-    public void saveTimelapseImage(byte[] jpeg, LocalDateTime timestamp) {
-        // Create directory structure: timelapse/YYYY/MM/DD/
-        String year = String.valueOf(timestamp.getYear());
-        String month = String.format("%02d", timestamp.getMonthValue());
-        String day = String.format("%02d", timestamp.getDayOfMonth());
+    FrameStore frameStore() {
+        return store;
+    }
+
+    /**
+     * Returns the thumbnail sizes to store along with each captured image, for
+     * {@link CaptureSession#captureToStore(FrameStore, long, int, List)}.
+     */
+    List<CaptureSession.Thumbnail> thumbnails() {
+        return thumbnailStores.entrySet().stream()
+            .map(e -> new CaptureSession.Thumbnail(e.getValue(), e.getKey(), THUMBNAIL_QUALITY))
+            .toList();
+    }
+
+    /**
+     * Returns the store key of the image captured at the given local time: the
+     * instant in milliseconds, at one second resolution, so that the hour
+     * repeated when daylight saving time ends does not overwrite the first.
+     */
+    static long storeKey(LocalDateTime timestamp) {
+        return timestamp.truncatedTo(ChronoUnit.SECONDS).atZone(ZoneId.systemDefault()).toInstant().toEpochMilli();
+    }
+
+    private static LocalDateTime fromStoreKey(long key) {
+        return LocalDateTime.ofInstant(Instant.ofEpochMilli(key), ZoneId.systemDefault());
+    }
 
-        Path dayDir = TIMELAPSE_DIR.resolve(year).resolve(month).resolve(day);
+    // Where the one-file-per-image layout kept the image captured at the given time
+    private static Path legacyPath(LocalDateTime timestamp) {
+        return TIMELAPSE_DIR.resolve(timestamp.format(DAY_DIR_FORMAT)).resolve(timestamp.format(FILE_FORMAT) + ".jpg");
+    }
+
+    /**
+     * Reads a timelapse image.
+     *
+     * @param timestamp the capture timestamp
+     * @return the JPEG image data, or null if there is no such image
+     */
+    public byte[] readImage(LocalDateTime timestamp) {
+        if (store != null) {
+            return store.read(storeKey(timestamp));
+        }
         try {
-            Files.createDirectories(dayDir);
+            return Files.readAllBytes(legacyPath(timestamp.truncatedTo(ChronoUnit.SECONDS)));
         } catch (IOException e) {
-            LOG.error("Failed to create timelapse directory: " + dayDir, e);
-            return;
+            return null;
+        }
+    }
+
+    /**
+     * Reads a timelapse image at the smallest stored size whose longer side is
+     * at least {@code size} pixels, or at full size if no thumbnail is that
+     * large. Thumbnails missing for images captured before they were stored
+     * are made from the full image and stored on first use.
+     *
+     * @param timestamp the capture timestamp
+     * @param size the wanted length of the longer side in pixels, or 0 for full size
+     * @return the JPEG image data, or null if there is no such image
+     */
+    public byte[] readImage(LocalDateTime timestamp, int size) {
+        Map.Entry<Integer, FrameStore> tier = size > 0 ? thumbnailStores.ceilingEntry(size) : null;
+        if (tier == null) {
+            return readImage(timestamp);
+        }
+        long key = storeKey(timestamp);
+        byte[] thumbnail = tier.getValue().read(key);
+        if (thumbnail != null) {
+            return thumbnail;
+        }
+        byte[] full = readImage(timestamp);
+        if (full == null) {
+            return null;
+        }
+        try {
+            thumbnail = scaleJpeg(full, tier.getKey());
+            tier.getValue().append(key, thumbnail);
+            return thumbnail;
+        } catch (IOException | RuntimeException e) {
+            LOG.warn("Failed to create " + tier.getKey() + "px thumbnail of " + timestamp + ": " + e.getMessage());
+            return full;
+        }
+    }
+
+    // Area-averaged like the native thumbnails, so backfilled ones look the same
+    private static byte[] scaleJpeg(byte[] jpeg, int maxSize) throws IOException {
+        BufferedImage source = ImageIO.read(new ByteArrayInputStream(jpeg));
+        if (source == null) {
+            throw new IOException("Not a JPEG image");
+        }
+        double scale = Math.min(1.0, (double) maxSize / Math.max(source.getWidth(), source.getHeight()));
+        int width = Math.max(2, (int) (source.getWidth() * scale) & ~1);
+        int height = Math.max(2, (int) (source.getHeight() * scale) & ~1);
+        BufferedImage scaled = new BufferedImage(width, height, BufferedImage.TYPE_INT_RGB);
+        Graphics2D g = scaled.createGraphics();
+        try {
+            g.drawImage(source.getScaledInstance(width, height, Image.SCALE_AREA_AVERAGING), 0, 0, null);
+        } finally {
+            g.dispose();
+        }
+        ImageWriter writer = ImageIO.getImageWritersByFormatName("jpeg").next();
+        ByteArrayOutputStream out = new ByteArrayOutputStream();
+        try (ImageOutputStream stream = ImageIO.createImageOutputStream(out)) {
+            writer.setOutput(stream);
+            ImageWriteParam param = writer.getDefaultWriteParam();
+            param.setCompressionMode(ImageWriteParam.MODE_EXPLICIT);
+            param.setCompressionQuality(THUMBNAIL_QUALITY / 100f);
+            writer.write(null, new IIOImage(scaled, null, null), param);
+        } finally {
+            writer.dispose();
+        }
+        return out.toByteArray();
+    }
+
+    /**
+     * Parses a timestamp from an image name of the form yyyyMMdd_HHmmss.jpg.
+     *
+     * @return the timestamp, or null if the name does not match
+     */
+    static LocalDateTime parseTimestamp(String fileName) {
+        try {
+            return LocalDateTime.parse(fileName.replace(".jpg", ""), FILE_FORMAT);
+        } catch (Exception e) {
+            LOG.debug("Could not parse timelapse image name: " + fileName);
+            return null;
         }
+    }
 
-        String filename = timestamp.format(FILE_FORMAT) + ".jpg";
-        Path imagePath = dayDir.resolve(filename);
+    /**
+     * Writes a file, creating parent directories, without blocking the caller.
+     * The file appears under its final name only once completely written.
+     * Falls back to a synchronous write when the native writer is unavailable.
+     *
+     * @param path the file to write
+     * @param data the file content
+     * @return a future that completes when the file has been written
+     */
+    public CompletableFuture<Void> writeFile(Path path, byte[] data) {
+        if (frameWriter != null) {
+            return frameWriter.write(path, data,
+                    FrameWriter.Option.CREATE_DIRECTORIES, FrameWriter.Option.ATOMIC)
+                .thenApply(result -> null);
+        }
         try {
-            Files.write(imagePath, jpeg);
-            LOG.debug("Timelapse image saved: " + imagePath);
-            addToCache(new TimelapseImage(timestamp, imagePath));
+            Path parent = path.getParent();
+            if (parent != null) {
+                Files.createDirectories(parent);
+            }
+            Files.write(path, data);
+            return CompletableFuture.completedFuture(null);
         } catch (IOException e) {
-            LOG.error("Failed to save timelapse image", e);
+            return CompletableFuture.failedFuture(e);
         }
     }
 
     /**
-     * Record representing a timelapse image with its timestamp and path.
+     * Record representing a stored timelapse image with its timestamp and size in bytes.
      */
-    public record TimelapseImage(LocalDateTime timestamp, Path path) {
+    public record TimelapseImage(LocalDateTime timestamp, int size) {
         public String getDisplayTime() {
             return timestamp.format(DISPLAY_FORMAT);
         }
+
+        /**
+         * Returns the name the image is served under, yyyyMMdd_HHmmss.jpg.
+         */
+        public String getFileName() {
+            return timestamp.format(FILE_FORMAT) + ".jpg";
+        }
     }
 
     /**
      * Lists all available timelapse images, sorted by timestamp.
-     * Returns cached data that is loaded on boot and updated when images are saved or deleted.
+     * Read directly from the store's memory-mapped index, or listed from the
+     * image files at startup if there is no store.
      *
      * @return list of timelapse images
      */
     public List<TimelapseImage> listImages() {
-        List<TimelapseImage> cached = this.cachedImages;
-        if (cached != null) {
-            return cached;
-        }
-        // Cache not yet warmed (app just started), fall back to synchronous scan
-        refreshImageCache();
-        cached = this.cachedImages;
-        return cached != null ? cached : List.of();
+        return listImages(LocalDateTime.MIN, LocalDateTime.MAX);
     }
 
     /**
@@ -283,44 +645,70 @@ public class TimelapseService {
      * @return list of timelapse images in range
      */
     public List<TimelapseImage> listImages(LocalDateTime from, LocalDateTime to) {
-        return listImages().stream()
-            .filter(img -> !img.timestamp().isBefore(from) && !img.timestamp().isAfter(to))
+        if (store == null) {
+            return legacyImages.stream()
+                .filter(image -> !image.timestamp().isBefore(from) && !image.timestamp().isAfter(to))
+                .toList();
+        }
+        return store.index().range(rangeKey(from), rangeKey(to)).stream()
+            .map(TimelapseService::toImage)
             .toList();
     }
 
+    /**
+     * Returns the image closest to the given time.
+     *
+     * @return the closest image, or null if there are no images
+     */
+    public TimelapseImage findClosest(LocalDateTime timestamp) {
+        if (store == null) {
+            return legacyImages.stream()
+                .min(Comparator.comparing(image -> Duration.between(image.timestamp(), timestamp).abs()))
+                .orElse(null);
+        }
+        return toImage(store.index().nearest(rangeKey(timestamp)));
+    }
+
     /**
      * Returns the time range of available images.
      *
      * @return array with [earliest, latest] or null if no images
      */
     public LocalDateTime[] getTimeRange() {
-        List<TimelapseImage> images = listImages();
-        if (images.isEmpty()) {
+        if (store == null) {
+            List<TimelapseImage> images = legacyImages;
+            return images.isEmpty() ? null
+                    : new LocalDateTime[] { images.getFirst().timestamp(), images.getLast().timestamp() };
+        }
+        FrameIndex index = store.index();
+        TimelapseImage first = toImage(index.first());
+        TimelapseImage last = toImage(index.last());
+        if (first == null || last == null) {
             return null;
         }
-        return new LocalDateTime[] {
-            images.get(0).timestamp(),
-            images.get(images.size() - 1).timestamp()
-        };
+        return new LocalDateTime[] { first.timestamp(), last.timestamp() };
     }
 
     /**
      * Returns the count of available timelapse images.
      */
     public int getImageCount() {
-        return listImages().size();
+        return store == null ? legacyImages.size() : store.index().size();
     }
 
-    private TimelapseImage parseTimelapseImage(Path path) {
-        try {
-            String filename = path.getFileName().toString();
-            String timestampStr = filename.replace(".jpg", "");
-            LocalDateTime timestamp = LocalDateTime.parse(timestampStr, FILE_FORMAT);
-            return new TimelapseImage(timestamp, path);
-        } catch (Exception e) {
-            LOG.debug("Could not parse timelapse image: " + path);
-            return null;
+    private static TimelapseImage toImage(FrameStore.Entry entry) {
+        return entry == null ? null : new TimelapseImage(fromStoreKey(entry.timestampMs()), entry.length());
+    }
+
+    // Like storeKey, but keeps sub-second precision and clamps to the years the store accepts
+    private static long rangeKey(LocalDateTime timestamp) {
+        if (timestamp.getYear() < 1) {
+            return Long.MIN_VALUE;
         }
+        if (timestamp.getYear() > 9999) {
+            return Long.MAX_VALUE;
+        }
+        return timestamp.atZone(ZoneId.systemDefault()).toInstant().toEpochMilli();
     }
 
     /**
@@ -371,49 +759,31 @@ public class TimelapseService {
         String outputFilename = "timelapse_" + from.format(FILE_FORMAT) + "_to_" + to.format(FILE_FORMAT) + ".mp4";
         Path outputPath = TIMELAPSE_DIR.resolve(outputFilename);
 
-        try {
-            // Create a temporary file list for FFmpeg concat demuxer
-            Path fileList = Files.createTempFile("timelapse_", ".txt");
-            StringBuilder listContent = new StringBuilder();
-            for (TimelapseImage image : images) {
-                listContent.append("file '").append(image.path().toAbsolutePath()).append("'\n");
-            }
-            Files.writeString(fileList, listContent.toString());
-
-            if (outputConsumer != null) outputConsumer.accept("Created file list with " + images.size() + " images");
-
-            // Try hardware encoder first (Raspberry Pi), then fall back to software
-            int exitCode = tryFfmpeg(fileList, fps, scale, outputPath, outputConsumer,
-                // Hardware encoder (Raspberry Pi V4L2 M2M)
-                "h264_v4l2m2m", "-b:v", bitrate
+        // Try hardware encoder first (Raspberry Pi), then fall back to software
+        int exitCode = tryFfmpeg(images, fps, scale, outputPath, outputConsumer,
+            // Hardware encoder (Raspberry Pi V4L2 M2M)
+            "h264_v4l2m2m", "-b:v", bitrate
+        );
+
+        if (exitCode != 0) {
+            if (outputConsumer != null) outputConsumer.accept("Hardware encoder failed, trying software encoder...");
+            exitCode = tryFfmpeg(images, fps, scale, outputPath, outputConsumer,
+                // Software encoder with minimal resource usage
+                "libx264", "-preset", "ultrafast", "-b:v", bitrate, "-threads", "1"
             );
+        }
 
-            if (exitCode != 0) {
-                if (outputConsumer != null) outputConsumer.accept("Hardware encoder failed, trying software encoder...");
-                exitCode = tryFfmpeg(fileList, fps, scale, outputPath, outputConsumer,
-                    // Software encoder with minimal resource usage
-                    "libx264", "-preset", "ultrafast", "-b:v", bitrate, "-threads", "1"
-                );
-            }
-
-            Files.deleteIfExists(fileList);
-
-            if (exitCode != 0) {
-                String errorMsg = "FFmpeg failed with exit code " + exitCode;
-                LOG.error(errorMsg);
-                if (outputConsumer != null) outputConsumer.accept(errorMsg);
-                return null;
-            }
-
-            String successMsg = "Timelapse generated: " + outputPath + " (" + images.size() + " frames)";
-            LOG.info(successMsg);
-            if (outputConsumer != null) outputConsumer.accept(successMsg);
-            return outputPath;
-
-        } catch (IOException e) {
-            LOG.error("Failed to generate timelapse", e);
+        if (exitCode != 0) {
+            String errorMsg = "FFmpeg failed with exit code " + exitCode;
+            LOG.error(errorMsg);
+            if (outputConsumer != null) outputConsumer.accept(errorMsg);
             return null;
         }
+
+        String successMsg = "Timelapse generated: " + outputPath + " (" + images.size() + " frames)";
+        LOG.info(successMsg);
+        if (outputConsumer != null) outputConsumer.accept(successMsg);
+        return outputPath;
     }
 
     /**
@@ -423,9 +793,10 @@ public class TimelapseService {
      * @return number of images deleted
      */
     /**
-     * Attempts to run FFmpeg with the specified encoder settings.
+     * Attempts to run FFmpeg with the specified encoder settings. The JPEG frames
+     * are read from the store and piped to FFmpeg's stdin.
      */
-    private int tryFfmpeg(Path fileList, int fps, String scale, Path outputPath, Consumer<String> outputConsumer, String... encoderArgs) {
+    private int tryFfmpeg(List<TimelapseImage> images, int fps, String scale, Path outputPath, Consumer<String> outputConsumer, String... encoderArgs) {
         if (cancelled) {
             if (outputConsumer != null) outputConsumer.accept("Generation cancelled");
             return -1;
@@ -437,10 +808,9 @@ public class TimelapseService {
             command.addAll(List.of("nice", "-n", "19", "ionice", "-c", "3"));
             command.addAll(List.of(
                 "ffmpeg", "-y",
-                "-f", "concat",
-                "-safe", "0",
-                "-i", fileList.toString(),
-                "-framerate", String.valueOf(fps)
+                "-f", "image2pipe",
+                "-framerate", String.valueOf(fps),
+                "-i", "-"
             ));
 
             // Add scale filter if resolution specified
@@ -461,7 +831,9 @@ public class TimelapseService {
             ProcessBuilder pb = new ProcessBuilder(command);
             pb.redirectErrorStream(true);
 
-            currentProcess = pb.start();
+            Process process = pb.start();
+            currentProcess = process;
+            Thread feeder = Thread.startVirtualThread(() -> feedFrames(images, process));
 
             try (BufferedReader reader = new BufferedReader(new InputStreamReader(currentProcess.getInputStream()))) {
                 String line;
@@ -471,7 +843,8 @@ public class TimelapseService {
                 }
             }
 
-            int exitCode = currentProcess.waitFor();
+            int exitCode = process.waitFor();
+            feeder.join();
             currentProcess = null;
 
             if (cancelled) {
@@ -487,25 +860,57 @@ public class TimelapseService {
         }
     }
 
+    /**
+     * Writes the images to FFmpeg's stdin one after another and closes it,
+     * deflickered and stabilized natively when windows are configured for them.
+     */
+    private void feedFrames(List<TimelapseImage> images, Process process) {
+        try (OutputStream stdin = process.getOutputStream()) {
+            if (store != null && (deflickerWindow > 0 || stabilizeWindow > 0)) {
+                feedCorrected(images, stdin);
+                return;
+            }
+            for (TimelapseImage image : images) {
+                if (cancelled) {
+                    return;
+                }
+                byte[] jpeg = readImage(image.timestamp());
+                if (jpeg != null) {
+                    stdin.write(jpeg);
+                }
+            }
+        } catch (IOException e) {
+            // FFmpeg exited early; its exit code reports the failure
+            LOG.debug("FFmpeg input closed: " + e.getMessage());
+        }
+    }
+
+    private void feedCorrected(List<TimelapseImage> images, OutputStream stdin) throws IOException {
+        long[] keys = images.stream().mapToLong(image -> storeKey(image.timestamp())).toArray();
+        TimelapseFrames.Params params = new TimelapseFrames.Params(correctionWindow(deflickerWindow),
+            correctionWindow(stabilizeWindow), CORRECTED_QUALITY);
+        try (TimelapseFrames frames = TimelapseFrames.open(store, keys, params)) {
+            for (byte[] jpeg = frames.next(); jpeg != null && !cancelled; jpeg = frames.next()) {
+                stdin.write(jpeg);
+            }
+        }
+    }
+
+    // A configured window as the native side takes it: 0 for off, otherwise odd
+    // (even ones widened by one so that they centre on the frame) and in range
+    private static int correctionWindow(int window) {
+        return window <= 0 ? 0 : Math.clamp(window | 1, 3, TimelapseFrames.MAX_WINDOW);
+    }
+
     public int cleanupOldImages(int daysToKeep) {
         LocalDateTime cutoff = LocalDateTime.now().minusDays(daysToKeep);
         List<TimelapseImage> oldImages = listImages().stream()
             .filter(img -> img.timestamp().isBefore(cutoff))
             .toList();
 
-        int deleted = 0;
-        for (TimelapseImage img : oldImages) {
-            try {
-                Files.delete(img.path());
-                deleted++;
-            } catch (IOException e) {
-                LOG.error("Failed to delete old timelapse image: " + img.path(), e);
-            }
-        }
-
+        int deleted = deleteImages(oldImages.stream().mapToLong(img -> storeKey(img.timestamp())).toArray());
         if (deleted > 0) {
             LOG.info("Cleaned up " + deleted + " old timelapse images");
-            refreshImageCache();
         }
         return deleted;
     }
@@ -527,43 +932,133 @@ public class TimelapseService {
      * @param usedImages set of images used in generated videos (will not be deleted)
      * @return number of images deleted
      */
-    public int thinOutImages(LocalDateTime from, LocalDateTime to, int keepEveryNth, Set<Path> usedImages) {
+    public int thinOutImages(LocalDateTime from, LocalDateTime to, int keepEveryNth, Set<LocalDateTime> usedImages) {
         List<TimelapseImage> images = listImages(from, to);
-        int deleted = 0;
+        List<Long> toDelete = new java.util.ArrayList<>();
         int index = 0;
 
         for (TimelapseImage img : images) {
             // Skip images used in generated videos
-            if (usedImages.contains(img.path())) {
+            if (usedImages.contains(img.timestamp())) {
                 continue;
             }
             
             if (index % keepEveryNth != 0) {
-                try {
-                    Files.delete(img.path());
-                    deleted++;
-                } catch (IOException e) {
-                    LOG.error("Failed to delete timelapse image: " + img.path(), e);
-                }
+                toDelete.add(storeKey(img.timestamp()));
             }
             index++;
         }
 
+        int deleted = deleteImages(toDelete.stream().mapToLong(Long::longValue).toArray());
         if (deleted > 0) {
             LOG.info("Thinned out " + deleted + " images from " + from + " to " + to);
-            refreshImageCache();
         }
         return deleted;
     }
 
+    /**
+     * Thins out images in a time range by how much they differ from the image
+     * kept before them. An image is kept when it is at least {@code minSpacing}
+     * after the previously kept one and its perceptual hash is more than
+     * timelapse.thin.hash-distance bits away from that image's hash, or
+     * {@code maxSpacing} has passed. Long still stretches, such as the night,
+     * thus keep one image per {@code maxSpacing} while changing scenes keep up
+     * to one per {@code minSpacing}. Images without a hash are hashed first.
+     *
+     * @param from start time
+     * @param to end time
+     * @param minSpacing shortest time between kept images
+     * @param maxSpacing longest time between kept images
+     * @param usedImages set of images used in generated videos (will not be deleted)
+     * @return number of images deleted
+     */
+    public int thinOutSimilarImages(LocalDateTime from, LocalDateTime to, Duration minSpacing, Duration maxSpacing,
+                                    Set<LocalDateTime> usedImages) {
+        if (store == null) {
+            return 0;
+        }
+        long fromKey = storeKey(from);
+        long toKey = storeKey(to);
+        List<FrameStore.TaggedEntry> images;
+        try {
+            int hashed = store.hashFrames(fromKey, toKey);
+            if (hashed > 0) {
+                LOG.debug("Hashed " + hashed + " timelapse images from " + from + " to " + to);
+            }
+            images = store.listTags(fromKey, toKey);
+        } catch (Exception e) {
+            LOG.error("Failed to read timelapse image hashes", e);
+            return 0;
+        }
+
+        List<Long> toDelete = new java.util.ArrayList<>();
+        FrameStore.TaggedEntry kept = null;
+        for (FrameStore.TaggedEntry img : images) {
+            // Skip images used in generated videos
+            if (usedImages.contains(fromStoreKey(img.timestampMs()))) {
+                continue;
+            }
+
+            if (kept == null || keepImage(kept, img, minSpacing, maxSpacing)) {
+                kept = img;
+            } else {
+                toDelete.add(img.timestampMs());
+            }
+        }
+
+        int deleted = deleteImages(toDelete.stream().mapToLong(Long::longValue).toArray());
+        if (deleted > 0) {
+            LOG.info("Thinned out " + deleted + " similar images from " + from + " to " + to);
+        }
+        return deleted;
+    }
+
+    private boolean keepImage(FrameStore.TaggedEntry kept, FrameStore.TaggedEntry img, Duration minSpacing,
+                              Duration maxSpacing) {
+        long elapsed = img.timestampMs() - kept.timestampMs();
+        if (elapsed < minSpacing.toMillis()) {
+            return false;
+        }
+        if (elapsed >= maxSpacing.toMillis() || !kept.tagged() || !img.tagged()) {
+            return true;
+        }
+        return FrameStore.hashDistance(kept.tag(), img.tag()) > thinHashDistance;
+    }
+
+    /**
+     * Deletes images from the store index and compacts the affected segments.
+     *
+     * @return number of images deleted
+     */
+    private int deleteImages(long[] keys) {
+        if (store == null || keys.length == 0) {
+            return 0;
+        }
+        try {
+            int deleted = store.delete(keys);
+            long reclaimed = store.compact(COMPACT_RATIO);
+            for (FrameStore thumbnails : thumbnailStores.values()) {
+                thumbnails.delete(keys);
+                reclaimed += thumbnails.compact(COMPACT_RATIO);
+            }
+            LOG.debug("Frame store compaction reclaimed " + reclaimed / 1024 + " KB");
+            return deleted;
+        } catch (Exception e) {
+            LOG.error("Failed to delete timelapse images", e);
+            return 0;
+        }
+    }
+
     // Overloaded version for backward compatibility
     public int thinOutImages(LocalDateTime from, LocalDateTime to, int keepEveryNth) {
         return thinOutImages(from, to, keepEveryNth, new HashSet<>());
     }
 
     /**
-     * Nightly cleanup: ensure maximum 1 image per minute for photos 48-96 hours old.
-     * Protects all images less than 48 hours old.
+     * Nightly cleanup: ensure maximum 1 image per minute for photos 48-96 hours old,
+     * and only 1 per 10 minutes while the scene does not change.
+     * Protects all images less than 48 hours old. Recompression of old images
+     * follows in the same maintenance window.
      */
     @Scheduled(cron = "0 0 3 * * ?")
     void nightlyCleanup48to96Hours() {
@@ -571,15 +1066,16 @@ public class TimelapseService {
         LocalDateTime from = now.minusHours(96);
         LocalDateTime to = now.minusHours(48); // Protect images less than 48 hours old
 
-        // Target: 1 image per minute = keep every 4th image (since we capture 4 images/minute)
-        int deleted = thinOutImages(from, to, 4);
+        int deleted = thinOutSimilarImages(from, to, Duration.ofMinutes(1), Duration.ofMinutes(10), new HashSet<>());
         if (deleted > 0) {
             LOG.info("Nightly cleanup (48-96h): removed " + deleted + " images, keeping max 1 per minute");
         }
+        recompressOldImages();
     }
 
     /**
-     * Nightly cleanup: ensure maximum 1 image per 5 minutes for photos older than 1 week.
+     * Nightly cleanup: ensure maximum 1 image per 5 minutes for photos older than 1 week,
+     * and only 1 per hour while the scene does not change.
      * This runs after the 48-96 hour cleanup.
      */
     @Scheduled(cron = "0 15 3 * * ?")
@@ -588,9 +1084,7 @@ public class TimelapseService {
         LocalDateTime from = now.minusYears(1); // Go back 1 year for comprehensive cleanup
         LocalDateTime to = now.minusDays(7); // Protect images less than 1 week old
 
-        // Target: 1 image per 5 minutes = keep every 20th image (since we capture 4 images/minute)
-        // 4 images/minute × 5 minutes = 20 images, so keep every 20th
-        int deleted = thinOutImages(from, to, 20);
+        int deleted = thinOutSimilarImages(from, to, Duration.ofMinutes(5), Duration.ofHours(1), new HashSet<>());
         if (deleted > 0) {
             LOG.info("Nightly cleanup (>1 week): removed " + deleted + " images, keeping max 1 per 5 minutes");
         }
@@ -608,14 +1102,58 @@ public class TimelapseService {
         }
     }
 
+    /**
+     * Re-encodes images older than timelapse.recompress.days at lower resolution
+     * and quality; disabled by default. Part of the 03:00 maintenance window.
+     * Images that old have been thinned on earlier nights already, so few of
+     * the re-encoded ones are deleted later.
+     */
+    void recompressOldImages() {
+        if (store == null || recompressDays <= 0) {
+            return;
+        }
+        long from = readRecompressedUntil();
+        long to = storeKey(LocalDateTime.now().minusDays(recompressDays));
+        if (from > to) {
+            return;
+        }
+        try {
+            FrameStore.Recompression result = store.recompress(from, to, recompressWidth, recompressQuality);
+            long reclaimed = store.compact(COMPACT_RATIO);
+            writeFile(RECOMPRESSED_UNTIL, Long.toString(to + 1).getBytes())
+                .whenComplete((ignored, ex) -> {
+                    if (ex != null) {
+                        LOG.error("Failed to save recompression progress", ex);
+                    }
+                });
+            if (result.recompressed() > 0) {
+                LOG.info("Nightly recompression: re-encoded " + result.recompressed() + " images, saved "
+                    + result.savedBytes() / (1024 * 1024) + " MB (" + reclaimed / (1024 * 1024) + " MB reclaimed)");
+            }
+            if (result.failed() > 0) {
+                LOG.warn("Nightly recompression: " + result.failed() + " images could not be decoded");
+            }
+        } catch (Exception e) {
+            LOG.error("Failed to recompress timelapse images", e);
+        }
+    }
+
+    private static long readRecompressedUntil() {
+        try {
+            return Long.parseLong(Files.readString(RECOMPRESSED_UNTIL).trim());
+        } catch (IOException | NumberFormatException e) {
+            return Long.MIN_VALUE;
+        }
+    }
+
     /**
      * Gets all images that are used in generated timelapse videos.
      * 
      * @param videos list of generated videos
-     * @return set of image paths used in videos
+     * @return set of timestamps of images used in videos
      */
-    private Set<Path> getImagesUsedInVideos(List<GeneratedVideo> videos) {
-        Set<Path> usedImages = new HashSet<>();
+    private Set<LocalDateTime> getImagesUsedInVideos(List<GeneratedVideo> videos) {
+        Set<LocalDateTime> usedImages = new HashSet<>();
         
         // Note: This would require parsing video generation logs or maintaining a separate
         // database of which images are used in which videos. For now, we return an empty set
@@ -30,7 +30,7 @@ public class TimelapseView extends VerticalLayout {
     private static final String RETENTION_POLICY_HELP = """
         ## Image Retention Policy
 
-        Images are captured every **15 seconds** and automatically managed to optimize storage while preserving enough detail for timelapses at various time scales.
+        Images are captured every **15 seconds** (or, with scene-change scheduling enabled, when the scene changes, at least every 5 minutes) and automatically managed to optimize storage while preserving enough detail for timelapses at various time scales.
 
         ### Storage Timeline
 
@@ -72,7 +72,7 @@ public class TimelapseView extends VerticalLayout {
     private final Button cancelButton = new Button("Cancel");
     private final Span statusLabel = new Span();
     private final Pre ffmpegOutput = new Pre();
-    private final SystemMonitor systemMonitor = new SystemMonitor();
+    private final SystemMonitor systemMonitor;
     private final VerticalLayout downloadArea = new VerticalLayout();
     private final VerticalLayout existingVideosArea = new VerticalLayout();
     private final Paragraph statsLabel = new Paragraph("Loading image statistics...");
@@ -81,8 +81,9 @@ public class TimelapseView extends VerticalLayout {
     private boolean formConfigured;
 
     @Inject
-    public TimelapseView(TimelapseService timelapseService) {
+    public TimelapseView(TimelapseService timelapseService, CameraService cameraService) {
         this.timelapseService = timelapseService;
+        systemMonitor = new SystemMonitor(cameraService::getCaptureLatency);
 
         form = new TimelapseSettingsForm();
         form.getSaveButton().setVisible(false);
@@ -168,6 +169,7 @@ public class TimelapseView extends VerticalLayout {
 
             int imageCount = timelapseService.getImageCount();
             LocalDateTime[] range = timelapseService.getTimeRange();
+            LocalDateTime durableUpTo = timelapseService.getDurableUpTo();
 
             ui.access(() -> {
                 if (imageCount == 0) {
@@ -179,6 +181,10 @@ public class TimelapseView extends VerticalLayout {
                         range[0].format(java.time.format.DateTimeFormatter.ofPattern("yyyy-MM-dd HH:mm")),
                         range[1].format(java.time.format.DateTimeFormatter.ofPattern("yyyy-MM-dd HH:mm"))
                     ));
+                    if (durableUpTo != null) {
+                        statsLabel.setText(statsLabel.getText() + ", saved to disk up to "
+                            + durableUpTo.format(java.time.format.DateTimeFormatter.ofPattern("HH:mm:ss")));
+                    }
 
                     if (!formConfigured) {
                         configureFormFields(range);
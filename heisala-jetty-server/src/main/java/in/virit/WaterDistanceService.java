@@ -27,6 +27,7 @@ public class WaterDistanceService {
     private static final Logger LOG = Logger.getLogger(WaterDistanceService.class);
     private static final Path DATA_FILE = Path.of("water-distance-data.csv");
     private static final Path RAW_LOG_FILE = Path.of("water-distance-raw.csv");
+    private static final Path CAMERA_DATA_FILE = Path.of("water-level-camera.csv");
     private static final int MAX_AGE_DAYS = 7;
 
     // Plausible distance range for the sensor installation (150mm - 5000mm).
@@ -49,11 +50,15 @@ public class WaterDistanceService {
 
     public enum Transport { REST, BLE }
 
+    /** Water level read from the waterline in a camera capture, already calibrated. */
+    public record CameraLevel(long epochMillis, double levelCm) {}
+
     /** Stores values exactly as received from the ESP32, before any filtering. */
     public record RawMeasurement(long epochMillis, int radarMm, int ultrasonicMm, int wifiRssi, long batchId, Transport transport) {}
 
     private final ArrayList<Measurement> measurements = new ArrayList<>();
     private final ArrayList<RawMeasurement> rawMeasurements = new ArrayList<>();
+    private final ArrayList<CameraLevel> cameraLevels = new ArrayList<>();
     private final ReadWriteLock lock = new ReentrantReadWriteLock();
     private final AtomicLong batchIdCounter = new AtomicLong(1);
 
@@ -71,7 +76,9 @@ public class WaterDistanceService {
     @PostConstruct
     void init() {
         loadFromCsv();
-        LOG.infof("Loaded %d water distance measurements from CSV", measurements.size());
+        loadCameraLevels();
+        LOG.infof("Loaded %d water distance measurements and %d camera levels from CSV",
+                measurements.size(), cameraLevels.size());
     }
 
     public long nextBatchId() {
@@ -112,6 +119,37 @@ public class WaterDistanceService {
         appendRawLog(raw);
     }
 
+    /**
+     * Adds a water level read by the camera, to be plotted against the sensor readings.
+     */
+    public void addCameraLevel(long epochMillis, double levelCm) {
+        lock.writeLock().lock();
+        try {
+            cameraLevels.add(new CameraLevel(epochMillis, levelCm));
+        } finally {
+            lock.writeLock().unlock();
+        }
+    }
+
+    public List<CameraLevel> getCameraLevelsSince(Instant since) {
+        long sinceMillis = since.toEpochMilli();
+        lock.readLock().lock();
+        try {
+            int lo = 0, hi = cameraLevels.size();
+            while (lo < hi) {
+                int mid = (lo + hi) >>> 1;
+                if (cameraLevels.get(mid).epochMillis() < sinceMillis) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            return new ArrayList<>(cameraLevels.subList(lo, cameraLevels.size()));
+        } finally {
+            lock.readLock().unlock();
+        }
+    }
+
     private void appendRawLog(RawMeasurement raw) {
         try {
             String line = raw.epochMillis() + "," + raw.radarMm() + "," + raw.ultrasonicMm()
@@ -273,11 +311,11 @@ public class WaterDistanceService {
     /**
      * Downsamples data to at most maxPoints by picking evenly spaced entries.
      */
-    public static List<Measurement> getDownsampled(List<Measurement> data, int maxPoints) {
+    public static <T> List<T> getDownsampled(List<T> data, int maxPoints) {
         if (data.size() <= maxPoints) {
             return data;
         }
-        List<Measurement> result = new ArrayList<>(maxPoints);
+        List<T> result = new ArrayList<>(maxPoints);
         double step = (double) (data.size() - 1) / (maxPoints - 1);
         for (int i = 0; i < maxPoints; i++) {
             result.add(data.get((int) Math.round(i * step)));
@@ -293,9 +331,11 @@ public class WaterDistanceService {
     @Scheduled(every = "1h")
     void persistToCsv() {
         List<Measurement> snapshot;
+        List<CameraLevel> cameraSnapshot;
         lock.readLock().lock();
         try {
             snapshot = new ArrayList<>(measurements);
+            cameraSnapshot = new ArrayList<>(cameraLevels);
         } finally {
             lock.readLock().unlock();
         }
@@ -309,6 +349,14 @@ public class WaterDistanceService {
         } catch (IOException e) {
             LOG.error("Failed to persist water distance data", e);
         }
+        try (BufferedWriter writer = Files.newBufferedWriter(CAMERA_DATA_FILE)) {
+            for (CameraLevel c : cameraSnapshot) {
+                writer.write(c.epochMillis() + "," + c.levelCm());
+                writer.newLine();
+            }
+        } catch (IOException e) {
+            LOG.error("Failed to persist camera water levels", e);
+        }
     }
 
     @Scheduled(cron = "0 0 4 * * ?")
@@ -324,6 +372,8 @@ public class WaterDistanceService {
                 LOG.infof("Pruned %d old water distance entries", removed);
             }
 
+            cameraLevels.removeIf(c -> c.epochMillis() < cutoff);
+
             int rawBefore = rawMeasurements.size();
             rawMeasurements.removeIf(m -> m.epochMillis() < rawCutoff);
             int rawRemoved = rawBefore - rawMeasurements.size();
@@ -370,4 +420,22 @@ public class WaterDistanceService {
             LOG.error("Failed to load water distance data from CSV", e);
         }
     }
+
+    private void loadCameraLevels() {
+        if (!Files.exists(CAMERA_DATA_FILE)) {
+            return;
+        }
+        try (BufferedReader reader = Files.newBufferedReader(CAMERA_DATA_FILE)) {
+            String line;
+            while ((line = reader.readLine()) != null) {
+                String[] parts = line.split(",");
+                if (parts.length >= 2) {
+                    cameraLevels.add(new CameraLevel(Long.parseLong(parts[0].trim()),
+                            Double.parseDouble(parts[1].trim())));
+                }
+            }
+        } catch (IOException | NumberFormatException e) {
+            LOG.error("Failed to load camera water levels from CSV", e);
+        }
+    }
 }
@@ -132,7 +132,8 @@ public class WaterLevelView extends VerticalLayout {
         Instant since = Instant.now().minus(range.duration);
         var data = service.getMeasurementsSince(since);
         var downsampled = WaterDistanceService.getDownsampled(data, 800);
-        waterLevelChart.updateData(downsampled);
+        var camera = WaterDistanceService.getDownsampled(service.getCameraLevelsSince(since), 800);
+        waterLevelChart.updateData(downsampled, camera);
     }
 
     // --- Calibration ---
@@ -499,7 +500,6 @@ public class WaterLevelView extends VerticalLayout {
             super(ChartType.SPLINE);
             Configuration conf = getConfiguration();
             conf.setTitle((String) null);
-            conf.getLegend().setEnabled(false);
             conf.getyAxis().setTitle("Water level (cm)");
 
             PlotLine zeroLine = new PlotLine();
@@ -526,7 +526,8 @@ public class WaterLevelView extends VerticalLayout {
             conf.getTime().setUseUTC(false);
         }
 
-        void updateData(List<WaterDistanceService.Measurement> data) {
+        void updateData(List<WaterDistanceService.Measurement> data,
+                        List<WaterDistanceService.CameraLevel> camera) {
             Configuration conf = getConfiguration();
             double[] levels = smoothedWaterLevels(data);
             DataSeries series = new DataSeries("Water level");
@@ -536,7 +537,21 @@ public class WaterLevelView extends VerticalLayout {
                 item.setY(Double.isNaN(levels[i]) ? null : levels[i]);
                 series.add(item);
             }
-            conf.setSeries(series);
+            // The waterline seen by the camera, as a cross-check of the sensor
+            conf.getLegend().setEnabled(!camera.isEmpty());
+            if (camera.isEmpty()) {
+                conf.setSeries(series);
+            } else {
+                DataSeries cameraSeries = new DataSeries("Camera");
+                PlotOptionsLine cameraOptions = new PlotOptionsLine();
+                cameraOptions.setDashStyle(DashStyle.SHORTDOT);
+                cameraOptions.setMarker(new Marker(false));
+                cameraSeries.setPlotOptions(cameraOptions);
+                for (var c : camera) {
+                    cameraSeries.add(new DataSeriesItem(c.epochMillis(), c.levelCm()));
+                }
+                conf.setSeries(series, cameraSeries);
+            }
             drawChart();
         }
     }
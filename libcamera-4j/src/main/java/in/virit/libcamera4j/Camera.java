@@ -1,5 +1,7 @@
 package in.virit.libcamera4j;
 
+import java.lang.foreign.Arena;
+import java.lang.foreign.MemorySegment;
 import java.util.List;
 import java.util.Map;
 import java.util.function.Consumer;
@@ -277,6 +279,32 @@ public class Camera {
         return null; // Placeholder - needs proper request tracking
     }
 
+    /**
+     * Returns whether a stream has kept up with the sensor: the dropped,
+     * duplicate and late frames among the buffers it completed, and the
+     * intervals between them. Counted since the camera was acquired or the
+     * stream's statistics were last reset.
+     *
+     * @param streamIndex the stream of the current configuration
+     * @param reset whether to start counting afresh
+     * @return the sequence statistics
+     * @throws IllegalStateException if the camera is not configured
+     * @throws LibCameraException if the statistics cannot be read
+     */
+    public FrameSequenceStats sequenceStats(int streamIndex, boolean reset) {
+        if (configuration == null) {
+            throw new IllegalStateException("Camera must be configured before reading sequence stats");
+        }
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment out = arena.allocate(Native.SEQUENCE_STATS_SIZE, 8);
+            int result = Native.camSequenceStats(nativeHandle, configuration.nativeHandle(), streamIndex, out, reset);
+            if (result != 0) {
+                throw LibCameraException.forOperation("Camera.sequenceStats", result);
+            }
+            return FrameSequenceStats.read(out);
+        }
+    }
+
     /**
      * Returns the controls supported by this camera.
      *
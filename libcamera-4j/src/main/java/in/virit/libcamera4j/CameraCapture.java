@@ -6,7 +6,6 @@ import java.awt.geom.AffineTransform;
 import java.awt.image.BufferedImage;
 import java.io.ByteArrayOutputStream;
 import java.io.IOException;
-import java.nio.file.Files;
 import java.nio.file.Path;
 import java.util.List;
 import java.util.concurrent.CompletableFuture;
@@ -46,6 +45,11 @@ public class CameraCapture {
         return t;
     });
 
+    // Lazily started on the first asynchronous DNG save
+    private static final class DngFileWriter {
+        static final FrameWriter INSTANCE = FrameWriter.create(4);
+    }
+
     /**
      * Captures a JPEG image at the specified resolution.
      *
@@ -581,9 +585,8 @@ public class CameraCapture {
                     }
 
                     // Extract metadata before reading buffer
-                    ImageMetadata metadata = request.getMetadata(0);
-
                     FrameBuffer buffer = new FrameBuffer(allocator, config, 0, 0);
+                    ImageMetadata metadata = withStats(request.getMetadata(0), buffer);
                     byte[] rawData = buffer.getData();
 
                     BufferedImage image = PixelFormatConverter.convert(
@@ -604,6 +607,13 @@ public class CameraCapture {
         }
     }
 
+    // Adds the luma statistics of the frame, measured natively from its mapping
+    private static ImageMetadata withStats(ImageMetadata metadata, FrameBuffer buffer) {
+        try (MappedFrame frame = buffer.map()) {
+            return metadata.withStats(frame.statistics(FrameStats.DEFAULT_ZONES, FrameStats.DEFAULT_ZONES));
+        }
+    }
+
     /**
      * Captures a full resolution JPEG with metadata.
      *
@@ -694,9 +704,8 @@ public class CameraCapture {
                         throw new LibCameraException("Capture failed: " + request.status());
                     }
 
-                    ImageMetadata metadata = request.getMetadata(0);
-
                     FrameBuffer buffer = new FrameBuffer(allocator, config, 0, 0);
+                    ImageMetadata metadata = withStats(request.getMetadata(0), buffer);
                     byte[] rawData = buffer.getData();
 
                     BufferedImage image = PixelFormatConverter.convert(
@@ -955,6 +964,19 @@ public class CameraCapture {
      * @throws LibCameraException if capture or DNG writing fails
      */
     public static void captureDng(String path, int warmupFrames, CameraSettings settings) {
+        DngWriter writer = captureDngWriter(warmupFrames, settings);
+        try {
+            writer.write(Path.of(path));
+        } catch (IOException e) {
+            throw new LibCameraException("Failed to write DNG file: " + e.getMessage(), e);
+        }
+    }
+
+    /**
+     * Captures a raw frame and prepares a DNG writer for it. The camera is
+     * released before this returns, so encoding and disk I/O never hold it.
+     */
+    private static DngWriter captureDngWriter(int warmupFrames, CameraSettings settings) {
         try (CameraManager manager = CameraManager.create()) {
             manager.start();
 
@@ -1053,20 +1075,14 @@ public class CameraCapture {
                     double blueGain = colourGains[1] > 0 ? colourGains[1] : 1.0;
                     double[] asShotNeutral = {1.0 / redGain, 1.0, 1.0 / blueGain};
 
-                    // Write DNG using pure Java writer
+                    // Build DNG using pure Java writer
                     DngWriter writer = new DngWriter(width, height, 10, bayerOrder, unpackedData);
-                    writer.setMake("Raspberry Pi")
+                    return writer.setMake("Raspberry Pi")
                           .setModel("Camera Module")
                           .setSoftware("libcamera4j")
                           .setColorMatrix(colourMatrix)
                           .setAsShotNeutral(asShotNeutral)
                           .setBlackLevel(blackLevels);
-
-                    try {
-                        writer.write(java.nio.file.Path.of(path));
-                    } catch (IOException e) {
-                        throw new LibCameraException("Failed to write DNG file: " + e.getMessage(), e);
-                    }
                 }
             } finally {
                 camera.release();
@@ -1104,7 +1120,12 @@ public class CameraCapture {
      * @return a CompletableFuture that completes when the DNG is saved
      */
     public static CompletableFuture<Void> captureDngAsync(String path, int warmupFrames, CameraSettings settings) {
-        return CompletableFuture.runAsync(() -> captureDng(path, warmupFrames, settings), executor);
+        // Capture on the camera executor, then hand the encoded file to the
+        // asynchronous writer instead of blocking a thread on the disk.
+        return CompletableFuture.supplyAsync(() -> toDngBytes(captureDngWriter(warmupFrames, settings)), executor)
+            .thenCompose(dng -> DngFileWriter.INSTANCE.write(Path.of(path), dng,
+                    FrameWriter.Option.CREATE_DIRECTORIES, FrameWriter.Option.ATOMIC))
+            .thenApply(result -> null);
     }
 
     /**
@@ -1148,15 +1169,14 @@ public class CameraCapture {
      * @throws LibCameraException if capture or DNG creation fails
      */
     public static byte[] captureDngBytes(int warmupFrames, CameraSettings settings) {
+        return toDngBytes(captureDngWriter(warmupFrames, settings));
+    }
+
+    private static byte[] toDngBytes(DngWriter writer) {
         try {
-            // Create a temporary file for the DNG
-            Path tempFile = Files.createTempFile("capture_", ".dng");
-            try {
-                captureDng(tempFile.toString(), warmupFrames, settings);
-                return Files.readAllBytes(tempFile);
-            } finally {
-                Files.deleteIfExists(tempFile);
-            }
+            ByteArrayOutputStream out = new ByteArrayOutputStream();
+            writer.write(out);
+            return out.toByteArray();
         } catch (IOException e) {
             throw new LibCameraException("Failed to create DNG: " + e.getMessage(), e);
         }
@@ -1202,6 +1222,205 @@ public class CameraCapture {
         return CompletableFuture.supplyAsync(() -> captureDngBytes(warmupFrames, settings), executor);
     }
 
+    /**
+     * Captures a raw image for streaming as a DNG file.
+     *
+     * <p>Unlike {@link #captureDngBytes(CameraSettings)}, the DNG is never held
+     * in memory as a whole: it is produced natively from the packed raw frame
+     * a chunk at a time as the stream is read.</p>
+     *
+     * @param settings camera settings for focus and exposure
+     * @return the DNG, to be closed by the caller
+     * @throws LibCameraException if capture fails
+     */
+    public static DngStream captureDngStream(CameraSettings settings) {
+        try (CaptureSession session = CaptureSession.open(0, 0)) {
+            session.applySettings(settings);
+            return session.captureDngStream();
+        }
+    }
+
+    /**
+     * Asynchronously captures a raw image for streaming as a DNG file.
+     *
+     * @param settings camera settings for focus and exposure
+     * @return a CompletableFuture that completes with the DNG, to be closed by the caller
+     * @see #captureDngStream(CameraSettings)
+     */
+    public static CompletableFuture<DngStream> captureDngStreamAsync(CameraSettings settings) {
+        return CompletableFuture.supplyAsync(() -> captureDngStream(settings), executor);
+    }
+
+    /**
+     * Captures a JPEG and writes it directly to a file.
+     *
+     * <p>The frame is encoded natively from the camera buffer and written
+     * atomically; no image data is copied into Java. Parent directories are
+     * created as needed.</p>
+     *
+     * @param path the destination file
+     * @param width desired image width
+     * @param height desired image height
+     * @param settings camera settings for focus, exposure and transform
+     * @param quality JPEG quality 1-100
+     * @return the written file and the capture metadata
+     * @throws LibCameraException if capture, encoding or writing fails
+     */
+    public static FileCaptureResult captureToFile(Path path, int width, int height, CameraSettings settings, int quality) {
+        try (CaptureSession session = CaptureSession.open(width, height)) {
+            session.applySettings(settings);
+            return session.captureToFile(path, CaptureSession.Format.JPEG, quality);
+        }
+    }
+
+    /**
+     * Asynchronously captures a JPEG and writes it directly to a file.
+     *
+     * @param path the destination file
+     * @param width desired image width
+     * @param height desired image height
+     * @param settings camera settings for focus, exposure and transform
+     * @param quality JPEG quality 1-100
+     * @return a CompletableFuture that completes once the file has been written
+     * @see #captureToFile(Path, int, int, CameraSettings, int)
+     */
+    public static CompletableFuture<FileCaptureResult> captureToFileAsync(Path path, int width, int height,
+                                                                          CameraSettings settings, int quality) {
+        return CompletableFuture.supplyAsync(() -> captureToFile(path, width, height, settings, quality), executor);
+    }
+
+    /**
+     * Captures a JPEG and appends it to a frame store.
+     *
+     * @param store the frame store
+     * @param timestampMs the store timestamp of the frame
+     * @param width desired image width
+     * @param height desired image height
+     * @param settings camera settings for focus, exposure and transform
+     * @param quality JPEG quality 1-100
+     * @return the capture metadata
+     * @throws LibCameraException if capture, encoding or storing fails
+     */
+    public static ImageMetadata captureToStore(FrameStore store, long timestampMs, int width, int height,
+                                               CameraSettings settings, int quality) {
+        try (CaptureSession session = CaptureSession.open(width, height)) {
+            session.applySettings(settings);
+            return session.captureToStore(store, timestampMs, quality);
+        }
+    }
+
+    /**
+     * Asynchronously captures a JPEG and appends it to a frame store.
+     *
+     * @param store the frame store
+     * @param timestampMs the store timestamp of the frame
+     * @param width desired image width
+     * @param height desired image height
+     * @param settings camera settings for focus, exposure and transform
+     * @param quality JPEG quality 1-100
+     * @return a CompletableFuture that completes once the frame has been stored
+     * @see #captureToStore(FrameStore, long, int, int, CameraSettings, int)
+     */
+    public static CompletableFuture<ImageMetadata> captureToStoreAsync(FrameStore store, long timestampMs, int width,
+                                                                       int height, CameraSettings settings, int quality) {
+        return CompletableFuture.supplyAsync(() -> captureToStore(store, timestampMs, width, height, settings, quality),
+                executor);
+    }
+
+    /**
+     * Captures a JPEG and appends it to a frame store, together with downscaled
+     * thumbnails in their own stores.
+     *
+     * @param store the frame store
+     * @param timestampMs the store timestamp of the frame
+     * @param width desired image width
+     * @param height desired image height
+     * @param settings camera settings for focus, exposure and transform
+     * @param quality JPEG quality 1-100
+     * @param thumbnails the thumbnail sizes to store
+     * @return the capture metadata
+     * @throws LibCameraException if capture, encoding or storing fails
+     */
+    public static ImageMetadata captureToStore(FrameStore store, long timestampMs, int width, int height,
+                                               CameraSettings settings, int quality,
+                                               List<CaptureSession.Thumbnail> thumbnails) {
+        try (CaptureSession session = CaptureSession.open(width, height)) {
+            session.applySettings(settings);
+            return session.captureToStore(store, timestampMs, quality, thumbnails);
+        }
+    }
+
+    /**
+     * Asynchronously captures a JPEG and appends it to a frame store, together
+     * with downscaled thumbnails in their own stores.
+     *
+     * @param store the frame store
+     * @param timestampMs the store timestamp of the frame
+     * @param width desired image width
+     * @param height desired image height
+     * @param settings camera settings for focus, exposure and transform
+     * @param quality JPEG quality 1-100
+     * @param thumbnails the thumbnail sizes to store
+     * @return a CompletableFuture that completes once the frame and thumbnails have been stored
+     * @see #captureToStore(FrameStore, long, int, int, CameraSettings, int, List)
+     */
+    public static CompletableFuture<ImageMetadata> captureToStoreAsync(FrameStore store, long timestampMs, int width,
+                                                                       int height, CameraSettings settings, int quality,
+                                                                       List<CaptureSession.Thumbnail> thumbnails) {
+        return CompletableFuture.supplyAsync(
+                () -> captureToStore(store, timestampMs, width, height, settings, quality, thumbnails), executor);
+    }
+
+    /**
+     * Captures a JPEG averaged from a burst of frames and appends it to a
+     * frame store, together with downscaled thumbnails in their own stores.
+     *
+     * @param store the frame store
+     * @param timestampMs the store timestamp of the frame
+     * @param width desired image width
+     * @param height desired image height
+     * @param settings camera settings for focus, exposure and transform
+     * @param quality JPEG quality 1-100
+     * @param thumbnails the thumbnail sizes to store
+     * @param burstFrames frames to average, see {@link CaptureSession#setBurst(int, boolean)}
+     * @return the capture metadata
+     * @throws LibCameraException if capture, encoding or storing fails
+     */
+    public static ImageMetadata captureToStore(FrameStore store, long timestampMs, int width, int height,
+                                               CameraSettings settings, int quality,
+                                               List<CaptureSession.Thumbnail> thumbnails, int burstFrames) {
+        try (CaptureSession session = CaptureSession.open(width, height)) {
+            session.applySettings(settings);
+            session.setBurst(burstFrames, true);
+            return session.captureToStore(store, timestampMs, quality, thumbnails);
+        }
+    }
+
+    /**
+     * Asynchronously captures a JPEG averaged from a burst of frames and
+     * appends it to a frame store, together with downscaled thumbnails in
+     * their own stores.
+     *
+     * @param store the frame store
+     * @param timestampMs the store timestamp of the frame
+     * @param width desired image width
+     * @param height desired image height
+     * @param settings camera settings for focus, exposure and transform
+     * @param quality JPEG quality 1-100
+     * @param thumbnails the thumbnail sizes to store
+     * @param burstFrames frames to average, see {@link CaptureSession#setBurst(int, boolean)}
+     * @return a CompletableFuture that completes once the frame and thumbnails have been stored
+     * @see #captureToStore(FrameStore, long, int, int, CameraSettings, int, List, int)
+     */
+    public static CompletableFuture<ImageMetadata> captureToStoreAsync(FrameStore store, long timestampMs, int width,
+                                                                       int height, CameraSettings settings, int quality,
+                                                                       List<CaptureSession.Thumbnail> thumbnails,
+                                                                       int burstFrames) {
+        return CompletableFuture.supplyAsync(
+                () -> captureToStore(store, timestampMs, width, height, settings, quality, thumbnails, burstFrames),
+                executor);
+    }
+
     private static void applyCameraSettings(Request request, CameraSettings settings) {
         // Focus settings
         request.setAfMode(settings.afMode());
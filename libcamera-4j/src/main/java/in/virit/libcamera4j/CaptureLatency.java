@@ -0,0 +1,114 @@
+package in.virit.libcamera4j;
+
+import java.lang.foreign.MemorySegment;
+import java.time.Duration;
+import java.util.Arrays;
+
+import static java.lang.foreign.ValueLayout.JAVA_LONG;
+
+/**
+ * Where the time of a {@link CaptureSession}'s captures goes: how often each
+ * {@link Stage} was passed through and how long it took, counted natively for
+ * every capture.
+ *
+ * <p>Read with {@link CaptureSession#latency(boolean)}. Counters of several
+ * reads, or of several sessions, add up with {@link #plus(CaptureLatency)}.</p>
+ *
+ * @param counters one counter per stage, indexed by {@link Stage#ordinal()}
+ */
+public record CaptureLatency(Counter[] counters) {
+
+    /**
+     * The stages of a capture.
+     */
+    public enum Stage {
+        /** Configuring the camera for the capture. */
+        CONFIGURE,
+        /** Starting the camera. */
+        START,
+        /** Queueing a request. */
+        QUEUE,
+        /** From a frame's sensor timestamp to its request completing, for every frame including warm-up. */
+        COMPLETE,
+        /** From a request completing to the capture picking it up. */
+        WAIT,
+        /** Mapping a frame buffer. */
+        MAP,
+        /** Merging a burst or bracket, and denoising. */
+        CONVERT,
+        /** Encoding the JPEG or DNG. */
+        ENCODE,
+        /** Writing the encoded frame to its file or store. */
+        WRITE,
+        /** The whole capture. */
+        TOTAL
+    }
+
+    /**
+     * Time spent in one stage.
+     *
+     * @param count times the stage was passed through
+     * @param sumNs total time in nanoseconds
+     * @param minNs shortest time, 0 if {@code count} is 0
+     * @param maxNs longest time
+     */
+    public record Counter(long count, long sumNs, long minNs, long maxNs) {
+
+        static final Counter EMPTY = new Counter(0, 0, 0, 0);
+
+        /** The mean time, zero if the stage was never passed through. */
+        public Duration mean() {
+            return count == 0 ? Duration.ZERO : Duration.ofNanos(sumNs / count);
+        }
+
+        /** The longest time. */
+        public Duration max() {
+            return Duration.ofNanos(maxNs);
+        }
+
+        Counter plus(Counter other) {
+            if (count == 0) {
+                return other;
+            }
+            if (other.count == 0) {
+                return this;
+            }
+            return new Counter(count + other.count, sumNs + other.sumNs,
+                    Math.min(minNs, other.minNs), Math.max(maxNs, other.maxNs));
+        }
+    }
+
+    /** No captures timed. */
+    public static CaptureLatency empty() {
+        Counter[] counters = new Counter[Stage.values().length];
+        Arrays.fill(counters, Counter.EMPTY);
+        return new CaptureLatency(counters);
+    }
+
+    /** The counter of {@code stage}. */
+    public Counter get(Stage stage) {
+        return counters[stage.ordinal()];
+    }
+
+    /** Both counters added up, stage by stage. */
+    public CaptureLatency plus(CaptureLatency other) {
+        Counter[] sum = new Counter[counters.length];
+        for (int i = 0; i < sum.length; i++) {
+            sum[i] = counters[i].plus(other.counters[i]);
+        }
+        return new CaptureLatency(sum);
+    }
+
+    /**
+     * Reads an {@code lc4j_stats}.
+     */
+    static CaptureLatency read(MemorySegment stats) {
+        Counter[] counters = new Counter[Stage.values().length];
+        for (int i = 0; i < counters.length; i++) {
+            long offset = Native.STAGE_COUNTER_SIZE * i;
+            counters[i] = new Counter(stats.get(JAVA_LONG, offset), stats.get(JAVA_LONG, offset + 8),
+                    stats.get(JAVA_LONG, offset + 16), stats.get(JAVA_LONG, offset + 24));
+        }
+        return new CaptureLatency(counters);
+    }
+}
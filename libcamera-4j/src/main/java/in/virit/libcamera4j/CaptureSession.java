@@ -0,0 +1,549 @@
+package in.virit.libcamera4j;
+
+import java.lang.foreign.Arena;
+import java.lang.foreign.MemorySegment;
+import java.nio.file.Path;
+import java.util.List;
+
+import static java.lang.foreign.ValueLayout.JAVA_DOUBLE;
+import static java.lang.foreign.ValueLayout.JAVA_FLOAT;
+import static java.lang.foreign.ValueLayout.JAVA_INT;
+import static java.lang.foreign.ValueLayout.JAVA_LONG;
+
+/**
+ * Captures stills straight to files without the image data passing through Java.
+ *
+ * <p>The frame is encoded natively (JPEG via libjpeg-turbo directly from the
+ * YUV planes, or DNG from the raw Bayer stream) from the mapped camera buffer
+ * and written atomically to its destination, creating parent directories as
+ * needed, or appended to a {@link FrameStore}, optionally with downscaled
+ * {@link Thumbnail thumbnails} in stores of their own. Only the file size and
+ * capture metadata, including the {@link FrameStats} of the frame, are
+ * returned. Raw frames can also be kept for reading out as a
+ * {@link DngStream}.</p>
+ *
+ * <p>Between captures the session can {@linkplain #startMonitor(MotionDetector,
+ * int, int) monitor} a low-resolution stream for motion. Captures and settings
+ * changes pause the monitor for as long as they need the camera, and so does
+ * a {@linkplain #focusSweep(FocusSweep.Params) focus sweep}.</p>
+ *
+ * <p>Every stage of a capture is timed; {@link #latency(boolean)} tells
+ * where the time goes, and {@link #latencyHistogram(LatencyHistogram.Kind,
+ * boolean)} how long its tail is.</p>
+ *
+ * <pre>{@code
+ * try (CaptureSession session = CaptureSession.open(1920, 1080)) {
+ *     session.applySettings(CameraSettings.defaults().withRotation(180));
+ *     FileCaptureResult result = session.captureToFile(Path.of("photo.jpg"),
+ *             CaptureSession.Format.JPEG, 90);
+ * }
+ * }</pre>
+ *
+ * <p>A session owns libcamera's CameraManager and the first camera while it is
+ * open. libcamera supports only one CameraManager per process, so no other
+ * session or {@link CameraManager} may be open at the same time.</p>
+ */
+public final class CaptureSession implements AutoCloseable {
+
+    static {
+        NativeLoader.load();
+    }
+
+    private static final int DEFAULT_WARMUP_FRAMES = 10;
+    private static final int BURST_ALIGN = 0x1;
+
+    /** Largest number of frames {@link #setBurst(int, boolean)} averages. */
+    public static final int MAX_BURST_FRAMES = 16;
+
+    /** Largest number of exposures {@link #setBracket(double...)} fuses. */
+    public static final int MAX_BRACKET_FRAMES = 5;
+
+    /** Furthest, in stops from the metered exposure, a bracket reaches. */
+    public static final double MAX_BRACKET_EV = 4.0;
+
+    /** Highest analogue gain {@link #setDenoise(double, double)} accepts as the threshold. */
+    public static final double MAX_DENOISE_GAIN = 64.0;
+
+    /** Largest denoise strength. */
+    public static final double MAX_DENOISE_STRENGTH = 16.0;
+
+    /** Most lens positions per pass of a {@link #focusSweep(FocusSweep.Params) focus sweep}. */
+    public static final int MAX_FOCUS_STEPS = 32;
+
+    /** The stream of the captures, for {@link #sequenceStats(int, boolean)}. */
+    public static final int STREAM_CAPTURE = 0;
+
+    /** The stream of the focus sweeps, for {@link #sequenceStats(int, boolean)}. */
+    public static final int STREAM_FOCUS = 1;
+
+    /** The stream of the monitor, for {@link #sequenceStats(int, boolean)}. */
+    public static final int STREAM_MONITOR = 2;
+
+    /**
+     * File format written by {@link #captureToFile(Path, Format, int)}.
+     */
+    public enum Format {
+        /** Baseline JPEG from the processed still stream. */
+        JPEG(1),
+        /** Uncompressed 16-bit DNG from the raw Bayer stream. */
+        DNG(2);
+
+        private final int value;
+
+        Format(int value) {
+            this.value = value;
+        }
+
+        /**
+         * Returns the native format value.
+         *
+         * @return the native value
+         */
+        public int value() {
+            return value;
+        }
+    }
+
+    /**
+     * A thumbnail size stored with each frame by
+     * {@link #captureToStore(FrameStore, long, int, List)}.
+     *
+     * @param store the frame store receiving the thumbnails
+     * @param maxSize length of the longer side in pixels (rounded down to even)
+     * @param quality JPEG quality 1-100
+     */
+    public record Thumbnail(FrameStore store, int maxSize, int quality) {
+    }
+
+    private final long handle;
+    private boolean closed;
+
+    private CaptureSession(long handle) {
+        this.handle = handle;
+    }
+
+    /**
+     * Opens a session on the first camera with the default number of warm-up frames.
+     *
+     * @param width JPEG image width, or 0 for the camera's default
+     * @param height JPEG image height, or 0 for the camera's default
+     * @return the open session
+     * @throws LibCameraException if no camera is available
+     */
+    public static CaptureSession open(int width, int height) {
+        return open(width, height, DEFAULT_WARMUP_FRAMES);
+    }
+
+    /**
+     * Opens a session on the first camera.
+     *
+     * @param width JPEG image width, or 0 for the camera's default
+     * @param height JPEG image height, or 0 for the camera's default
+     * @param warmupFrames number of frames to run before the one that is saved (for auto-exposure)
+     * @return the open session
+     * @throws LibCameraException if no camera is available
+     */
+    public static CaptureSession open(int width, int height, int warmupFrames) {
+        long handle = Native.sessionOpen(width, height, warmupFrames);
+        if (handle == 0) {
+            throw new LibCameraException("Failed to open capture session: no camera available");
+        }
+        return new CaptureSession(handle);
+    }
+
+    /**
+     * Applies focus, exposure and transform settings to subsequent captures.
+     * DNG captures ignore the transform.
+     *
+     * @param settings the camera settings
+     */
+    public synchronized void applySettings(CameraSettings settings) {
+        ensureOpen();
+        Native.sessionSetTransform(handle, settings.transform().value());
+        Native.sessionSetControls(handle, settings.afMode().value(), settings.lensPosition(),
+                settings.autoExposure(), settings.exposureTimeMicros(), settings.analogueGain());
+    }
+
+    /**
+     * Sets the zone grid of the {@link FrameStats} returned with the metadata of
+     * subsequent captures, {@link FrameStats#DEFAULT_ZONES} squared by default.
+     *
+     * @param zonesX number of zone columns, 1 to {@link FrameStats#MAX_ZONES}
+     * @param zonesY number of zone rows, 1 to {@link FrameStats#MAX_ZONES}
+     * @throws LibCameraException if the grid is invalid
+     */
+    public synchronized void setStatsGrid(int zonesX, int zonesY) {
+        ensureOpen();
+        int result = Native.sessionSetStatsGrid(handle, zonesX, zonesY);
+        if (result != 0) {
+            throw LibCameraException.forOperation("Set statistics grid", result);
+        }
+    }
+
+    /**
+     * Makes subsequent captures average {@code frames} consecutive frames
+     * taken with the same controls, for low light: the noise drops like it
+     * would with an exposure {@code frames} times longer, without saturating.
+     * The frames are summed natively as they arrive, so a burst takes
+     * {@code frames - 1} frame times more than a single capture. A raw burst
+     * gives a DNG of up to log2(frames) more bits. The number of frames is
+     * returned as {@link ImageMetadata#frames()}.
+     *
+     * @param frames frames per capture, 1 (the default) to {@link #MAX_BURST_FRAMES}
+     * @param align whether to shift each frame to line up with the first,
+     *              for a camera that moves slightly between frames
+     * @throws LibCameraException if {@code frames} is out of range
+     */
+    public synchronized void setBurst(int frames, boolean align) {
+        ensureOpen();
+        int result = Native.sessionSetBurst(handle, frames, align ? BURST_ALIGN : 0);
+        if (result != 0) {
+            throw LibCameraException.forOperation("Set burst", result);
+        }
+    }
+
+    /**
+     * Makes subsequent JPEG captures exposure brackets, for scenes with more
+     * range than one exposure holds: after the warm-up the camera is switched
+     * to manual exposures {@code evStops} stops from the metered one, one frame
+     * each in the same stream, and the frames are fused natively into one
+     * tone-mapped image that keeps detail from the best exposed of them, such
+     * as {@code -2, 0, 2}. The metered exposure is returned in the
+     * {@link ImageMetadata}, and the number of frames as
+     * {@link ImageMetadata#frames()}. A bracket replaces any
+     * {@linkplain #setBurst(int, boolean) burst}; DNG captures stay single
+     * exposures.
+     *
+     * @param evStops 2 to {@link #MAX_BRACKET_FRAMES} exposure offsets of at
+     *                most {@link #MAX_BRACKET_EV} stops, or none to capture
+     *                single exposures again
+     * @throws LibCameraException if the bracket is out of range
+     */
+    public synchronized void setBracket(double... evStops) {
+        ensureOpen();
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment stops = arena.allocate(JAVA_FLOAT, Math.max(1, evStops.length));
+            for (int i = 0; i < evStops.length; i++) {
+                stops.setAtIndex(JAVA_FLOAT, i, (float) evStops[i]);
+            }
+            int result = Native.sessionSetBracket(handle, stops, evStops.length);
+            if (result != 0) {
+                throw LibCameraException.forOperation("Set bracket", result);
+            }
+        }
+    }
+
+    /**
+     * Makes subsequent JPEG captures taken at an analogue gain of at least
+     * {@code minGain} denoised natively before they are encoded, for night
+     * frames whose sensor noise would otherwise take most of the JPEG. An
+     * edge-preserving filter smooths out variations below
+     * {@code strength * sqrt(gain)} levels, in luma and chroma alike, and
+     * keeps edges and texture that stand out from it. Bursts, already less
+     * noisy, are smoothed less; brackets and DNG captures are left alone.
+     *
+     * @param minGain analogue gain from which captures are denoised, 0 to
+     *                {@link #MAX_DENOISE_GAIN}
+     * @param strength noise per square root of gain to take out, in 8-bit
+     *                 levels, 0 (the default) to turn denoising off, up to
+     *                 {@link #MAX_DENOISE_STRENGTH}
+     * @throws LibCameraException if a value is out of range
+     */
+    public synchronized void setDenoise(double minGain, double strength) {
+        ensureOpen();
+        int result = Native.sessionSetDenoise(handle, (float) minGain, (float) strength);
+        if (result != 0) {
+            throw LibCameraException.forOperation("Set denoise", result);
+        }
+    }
+
+    /**
+     * Makes subsequent captures look for the waterline in a region of the
+     * image, returned as {@link ImageMetadata#waterline()}. It costs well under
+     * a millisecond per capture. DNG captures are not measured.
+     *
+     * @param params the region and calibration, or null (the default) to stop
+     * @throws LibCameraException if the region is empty or outside the image,
+     *                            or the calibration rows are the same
+     */
+    public synchronized void setWaterline(Waterline.Params params) {
+        ensureOpen();
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment p = MemorySegment.NULL;
+            if (params != null) {
+                p = arena.allocate(Native.WATERLINE_PARAMS_SIZE, 4);
+                float[] values = {(float) params.left(), (float) params.top(), (float) params.right(),
+                        (float) params.bottom(), (float) params.row0(), (float) params.level0(),
+                        (float) params.row1(), (float) params.level1()};
+                for (int i = 0; i < values.length; i++) {
+                    p.setAtIndex(JAVA_FLOAT, i, values[i]);
+                }
+            }
+            int result = Native.sessionSetWaterline(handle, p);
+            if (result != 0) {
+                throw LibCameraException.forOperation("Set waterline", result);
+            }
+        }
+    }
+
+    /**
+     * Finds the sharpest lens position: runs a preview stream, steps
+     * {@code LensPosition} across the lens' range in manual focus, and
+     * measures how sharp a region of the preview is at each position. Takes a
+     * few seconds. The session's own settings, including its focus, are left
+     * as they are; set the position found with {@link #applySettings}.
+     *
+     * @param params the preview size, steps and region
+     * @return the positions measured and the sharpest of them
+     * @throws LibCameraException if the camera has no lens control or the
+     *                            sweep fails
+     */
+    public synchronized FocusSweep focusSweep(FocusSweep.Params params) {
+        ensureOpen();
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment p = arena.allocate(Native.FOCUS_PARAMS_SIZE, 4);
+            p.set(JAVA_INT, 0, params.width());
+            p.set(JAVA_INT, 4, params.height());
+            p.set(JAVA_INT, 8, params.steps());
+            p.set(JAVA_INT, 12, params.settleFrames());
+            p.set(JAVA_FLOAT, 16, (float) params.left());
+            p.set(JAVA_FLOAT, 20, (float) params.top());
+            p.set(JAVA_FLOAT, 24, (float) params.right());
+            p.set(JAVA_FLOAT, 28, (float) params.bottom());
+            MemorySegment out = arena.allocate(Native.FOCUS_RESULT_SIZE, 8);
+            int result = Native.sessionFocusSweep(handle, p, out);
+            if (result != 0) {
+                throw LibCameraException.forOperation("Focus sweep", result);
+            }
+            return FocusSweep.read(out);
+        }
+    }
+
+    /**
+     * Time spent in each stage of this session's captures since it was opened
+     * or last reset.
+     *
+     * @param reset whether to start counting afresh
+     * @return the counters of every stage
+     */
+    public synchronized CaptureLatency latency(boolean reset) {
+        ensureOpen();
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment out = arena.allocate(Native.STATS_SIZE, 8);
+            int result = Native.statsSnapshot(handle, out, reset);
+            if (result != 0) {
+                throw LibCameraException.forOperation("Read capture latency", result);
+            }
+            return CaptureLatency.read(out);
+        }
+    }
+
+    /**
+     * The distribution of one latency of this session's captures since it
+     * was opened or the histogram was last reset.
+     *
+     * @param kind which latency
+     * @param reset whether to start counting afresh
+     * @return the histogram
+     */
+    public synchronized LatencyHistogram latencyHistogram(LatencyHistogram.Kind kind, boolean reset) {
+        ensureOpen();
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment out = arena.allocate(Native.LATENCY_HISTOGRAM_SIZE, 8);
+            int result = Native.histogramSnapshot(handle, kind.ordinal(), out, reset);
+            if (result != 0) {
+                throw LibCameraException.forOperation("Read latency histogram", result);
+            }
+            return LatencyHistogram.read(out);
+        }
+    }
+
+    /**
+     * Whether a stream of this session kept up with the sensor: dropped,
+     * duplicate and late frames and the intervals between frames, since the
+     * session was opened or the stream's statistics were last reset.
+     *
+     * <p>Counted per libcamera stream, for the one the captures, focus sweeps
+     * or monitor last ran on; kinds that the pipeline runs on the same stream
+     * share the counts. The intervals start over when the stream's size or
+     * format changes. All zero if the stream has not run yet.</p>
+     *
+     * @param stream {@link #STREAM_CAPTURE}, {@link #STREAM_FOCUS} or {@link #STREAM_MONITOR}
+     * @param reset whether to start counting afresh
+     * @return the sequence statistics
+     */
+    public synchronized FrameSequenceStats sequenceStats(int stream, boolean reset) {
+        ensureOpen();
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment out = arena.allocate(Native.SEQUENCE_STATS_SIZE, 8);
+            int result = Native.sessionSequenceStats(handle, stream, out, reset);
+            if (result != 0) {
+                throw LibCameraException.forOperation("Read sequence stats", result);
+            }
+            return FrameSequenceStats.read(out);
+        }
+    }
+
+    /**
+     * Starts running the camera on a low-resolution stream between captures,
+     * feeding every frame to {@code detector} on a native thread. Replaces any
+     * monitor already running; ends when the detector is closed.
+     *
+     * @param detector the detector receiving the frames
+     * @param width stream width, e.g. 320
+     * @param height stream height, e.g. 240
+     * @throws LibCameraException if the monitor cannot be started
+     */
+    public synchronized void startMonitor(MotionDetector detector, int width, int height) {
+        ensureOpen();
+        int result = Native.sessionMonitorStart(handle, detector.handle(), width, height);
+        if (result != 0) {
+            throw LibCameraException.forOperation("Start motion monitor", result);
+        }
+    }
+
+    /**
+     * Stops the monitor started by {@link #startMonitor(MotionDetector, int, int)}, if any.
+     */
+    public synchronized void stopMonitor() {
+        ensureOpen();
+        Native.sessionMonitorStop(handle);
+    }
+
+    /**
+     * Captures a frame and writes it to {@code path}, replacing any existing file.
+     *
+     * @param path the destination file
+     * @param format the file format
+     * @param quality JPEG quality 1-100 (ignored for DNG)
+     * @return the written file and the capture metadata
+     * @throws LibCameraException if capturing, encoding or writing fails
+     */
+    public synchronized FileCaptureResult captureToFile(Path path, Format format, int quality) {
+        ensureOpen();
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment out = arena.allocate(Native.CAPTURE_RESULT_SIZE, 8);
+            int result = Native.captureToFile(handle, path.toString(), format.value(), quality, out);
+            if (result != 0) {
+                throw LibCameraException.forOperation("Capture to " + path, result);
+            }
+            return new FileCaptureResult(path, out.get(JAVA_LONG, 0), readMetadata(out));
+        }
+    }
+
+    /**
+     * Captures a JPEG and appends it to {@code store} under {@code timestampMs},
+     * replacing any frame with the same timestamp.
+     *
+     * @param store the frame store
+     * @param timestampMs the store timestamp of the frame
+     * @param quality JPEG quality 1-100
+     * @return the capture metadata
+     * @throws LibCameraException if capturing, encoding or storing fails
+     */
+    public synchronized ImageMetadata captureToStore(FrameStore store, long timestampMs, int quality) {
+        ensureOpen();
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment out = arena.allocate(Native.CAPTURE_RESULT_SIZE, 8);
+            int result = Native.captureToStore(handle, store.handle(), timestampMs, quality, out);
+            if (result != 0) {
+                throw LibCameraException.forOperation("Capture to " + store.directory(), result);
+            }
+            return readMetadata(out);
+        }
+    }
+
+    /**
+     * Captures a JPEG and appends it to {@code store} under {@code timestampMs},
+     * and a downscaled JPEG to each thumbnail store under the same timestamp.
+     * The thumbnails are scaled natively from the camera buffer, each from the
+     * next larger one, and only stored together with the full frame.
+     *
+     * @param store the frame store
+     * @param timestampMs the store timestamp of the frame
+     * @param quality JPEG quality 1-100
+     * @param thumbnails the thumbnail sizes to store, in any order
+     * @return the capture metadata
+     * @throws LibCameraException if capturing, encoding or storing fails
+     */
+    public synchronized ImageMetadata captureToStore(FrameStore store, long timestampMs, int quality,
+                                                     List<Thumbnail> thumbnails) {
+        ensureOpen();
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment tiers = arena.allocate(Math.max(1, thumbnails.size() * Native.THUMBNAIL_TIER_SIZE), 8);
+            for (int i = 0; i < thumbnails.size(); i++) {
+                Thumbnail thumbnail = thumbnails.get(i);
+                long base = i * Native.THUMBNAIL_TIER_SIZE;
+                tiers.set(JAVA_LONG, base, thumbnail.store().handle());
+                tiers.set(JAVA_INT, base + 8, thumbnail.maxSize());
+                tiers.set(JAVA_INT, base + 12, thumbnail.quality());
+            }
+            MemorySegment out = arena.allocate(Native.CAPTURE_RESULT_SIZE, 8);
+            int result = Native.captureToStoreTiers(handle, store.handle(), timestampMs, quality,
+                    tiers, thumbnails.size(), out);
+            if (result != 0) {
+                throw LibCameraException.forOperation("Capture to " + store.directory(), result);
+            }
+            return readMetadata(out);
+        }
+    }
+
+    /**
+     * Captures a raw frame for reading out as a DNG file in pieces. Only the
+     * packed sensor rows are kept (natively) until the stream is closed; the
+     * DNG is produced as it is read.
+     *
+     * @return the DNG, to be closed by the caller
+     * @throws LibCameraException if capturing fails
+     */
+    public synchronized DngStream captureDngStream() {
+        ensureOpen();
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment stream = arena.allocate(JAVA_LONG);
+            MemorySegment out = arena.allocate(Native.CAPTURE_RESULT_SIZE, 8);
+            int result = Native.captureToDngStream(handle, stream, out);
+            if (result != 0) {
+                throw LibCameraException.forOperation("DNG capture", result);
+            }
+            return new DngStream(stream.get(JAVA_LONG, 0), readMetadata(out));
+        }
+    }
+
+    private static ImageMetadata readMetadata(MemorySegment out) {
+        String pixelFormat = new PixelFormat(out.get(JAVA_INT, 84), 0).fourccString();
+        return new ImageMetadata.Builder()
+                .timestamp(out.get(JAVA_LONG, 8))
+                .sequence(out.get(JAVA_LONG, 16))
+                .exposureTimeMicros(out.get(JAVA_LONG, 24))
+                .analogueGain(out.get(JAVA_DOUBLE, 32))
+                .digitalGain(out.get(JAVA_DOUBLE, 40))
+                .redGain(out.get(JAVA_DOUBLE, 48))
+                .blueGain(out.get(JAVA_DOUBLE, 56))
+                .lux(out.get(JAVA_DOUBLE, 64))
+                .colourTemperature(out.get(JAVA_INT, 72))
+                .size(out.get(JAVA_INT, 76), out.get(JAVA_INT, 80))
+                .pixelFormat(pixelFormat)
+                .stats(FrameStats.read(out.asSlice(Native.CAPTURE_RESULT_STATS, Native.FRAME_STATS_SIZE)))
+                .frames(out.get(JAVA_INT, 88))
+                .waterline(Waterline.read(out.asSlice(Native.CAPTURE_RESULT_WATERLINE,
+                        Native.CAPTURE_RESULT_WATERLINE_SIZE)))
+                .build();
+    }
+
+    private void ensureOpen() {
+        if (closed) {
+            throw new IllegalStateException("CaptureSession is closed");
+        }
+    }
+
+    /**
+     * Stops any monitor and releases the camera and the CameraManager.
+     */
+    @Override
+    public synchronized void close() {
+        if (!closed) {
+            closed = true;
+            Native.sessionClose(handle);
+        }
+    }
+}
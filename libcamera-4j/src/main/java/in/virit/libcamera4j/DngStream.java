@@ -0,0 +1,143 @@
+package in.virit.libcamera4j;
+
+import java.io.IOException;
+import java.io.InputStream;
+import java.lang.foreign.Arena;
+import java.lang.foreign.MemorySegment;
+import java.util.Objects;
+
+import static java.lang.foreign.ValueLayout.JAVA_BYTE;
+
+/**
+ * A raw capture read as a DNG file, produced piece by piece.
+ *
+ * <p>Returned by {@link CaptureSession#captureDngStream()}. The native side
+ * keeps only the packed sensor rows and unpacks them into 16-bit DNG samples
+ * as the stream is read, a fixed-size chunk at a time, so sending a DNG
+ * somewhere costs the packed frame plus one chunk instead of the whole file
+ * (and, as {@link CameraCapture#captureDngBytes()} does, a second unpacked
+ * copy) on the heap.</p>
+ *
+ * <pre>{@code
+ * try (DngStream dng = CameraCapture.captureDngStream(settings)) {
+ *     response.setContentLength(dng.size());
+ *     dng.transferTo(response.getOutputStream());
+ * }
+ * }</pre>
+ *
+ * <p>The bytes are those {@link CaptureSession#captureToFile} writes for a DNG
+ * capture. The stream holds native memory until it is closed. Not thread
+ * safe.</p>
+ */
+public final class DngStream extends InputStream {
+
+    static {
+        NativeLoader.load();
+    }
+
+    private static final long CHUNK_SIZE = 256 * 1024;
+
+    private final long handle;
+    private final long size;
+    private final ImageMetadata metadata;
+    private final Arena arena;
+    private final MemorySegment chunk;
+    private long chunkPosition;
+    private long chunkLimit;
+    private long remaining;
+    private boolean closed;
+
+    DngStream(long handle, ImageMetadata metadata) {
+        this.handle = handle;
+        this.size = Native.dngStreamSize(handle);
+        this.metadata = metadata;
+        this.remaining = size;
+        // Shared: streams are usually captured on one thread and read on another
+        this.arena = Arena.ofShared();
+        this.chunk = arena.allocate(CHUNK_SIZE);
+    }
+
+    /**
+     * Returns the size of the whole DNG file.
+     *
+     * @return the size in bytes
+     */
+    public long size() {
+        return size;
+    }
+
+    /**
+     * Returns the capture metadata of the frame.
+     *
+     * @return the metadata
+     */
+    public ImageMetadata metadata() {
+        return metadata;
+    }
+
+    @Override
+    public int read() throws IOException {
+        if (!fill()) {
+            return -1;
+        }
+        return chunk.get(JAVA_BYTE, chunkPosition++) & 0xFF;
+    }
+
+    @Override
+    public int read(byte[] b, int off, int len) throws IOException {
+        Objects.checkFromIndexSize(off, len, b.length);
+        if (len == 0) {
+            return 0;
+        }
+        if (!fill()) {
+            return -1;
+        }
+        int n = (int) Math.min(len, chunkLimit - chunkPosition);
+        MemorySegment.copy(chunk, JAVA_BYTE, chunkPosition, b, off, n);
+        chunkPosition += n;
+        return n;
+    }
+
+    @Override
+    public int available() throws IOException {
+        ensureOpen();
+        return (int) Math.min(Integer.MAX_VALUE, remaining + chunkLimit - chunkPosition);
+    }
+
+    // Reads the next chunk if the current one is used up; false at the end.
+    private boolean fill() throws IOException {
+        ensureOpen();
+        if (chunkPosition < chunkLimit) {
+            return true;
+        }
+        if (remaining == 0) {
+            return false;
+        }
+        long n = Native.dngStreamRead(handle, chunk);
+        if (n <= 0) {
+            throw new IOException(LibCameraException.forOperation("DNG stream read", (int) n));
+        }
+        chunkPosition = 0;
+        chunkLimit = n;
+        remaining -= n;
+        return true;
+    }
+
+    private void ensureOpen() throws IOException {
+        if (closed) {
+            throw new IOException("DngStream is closed");
+        }
+    }
+
+    /**
+     * Releases the frame and the chunk buffer.
+     */
+    @Override
+    public void close() {
+        if (!closed) {
+            closed = true;
+            arena.close();
+            Native.dngStreamClose(handle);
+        }
+    }
+}
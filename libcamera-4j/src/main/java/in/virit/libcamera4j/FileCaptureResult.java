@@ -0,0 +1,13 @@
+package in.virit.libcamera4j;
+
+import java.nio.file.Path;
+
+/**
+ * Result of a capture that was written directly to a file.
+ *
+ * @param path the file that was written
+ * @param size size of the file in bytes
+ * @param metadata the capture metadata
+ */
+public record FileCaptureResult(Path path, long size, ImageMetadata metadata) {
+}
@@ -0,0 +1,68 @@
+package in.virit.libcamera4j;
+
+import java.lang.foreign.MemorySegment;
+
+import static java.lang.foreign.ValueLayout.JAVA_FLOAT;
+import static java.lang.foreign.ValueLayout.JAVA_INT;
+
+/**
+ * The outcome of a focus sweep: how sharp a region of the preview was at each
+ * lens position tried, and the sharpest of them.
+ *
+ * <p>Run natively with {@link CaptureSession#focusSweep(Params)}: the lens is
+ * stepped across its range, then more finely around the best of those
+ * positions, and each is measured with the Tenengrad of the region, its mean
+ * squared Sobel gradient relative to its brightness. Sharpness values only
+ * compare within one sweep.</p>
+ *
+ * @param bestPosition the sharpest lens position, in dioptres, for
+ *                     {@code LensPosition} in manual focus
+ * @param bestSharpness the sharpness measured there
+ * @param afState the {@code AfState} the camera reported with the sharpest
+ *                frame, -1 if it did not
+ * @param focusFoM the {@code FocusFoM} reported with the sharpest frame, -1 if none
+ * @param positions the lens positions measured, in order
+ * @param sharpness the sharpness measured at each of {@code positions}
+ */
+public record FocusSweep(double bestPosition, double bestSharpness, int afState, int focusFoM,
+                         double[] positions, double[] sharpness) {
+
+    /**
+     * How to sweep.
+     *
+     * @param width width of the preview stream
+     * @param height height of the preview stream
+     * @param steps lens positions per pass, 3 to {@link CaptureSession#MAX_FOCUS_STEPS}
+     * @param settleFrames frames the lens gets to arrive at each position
+     * @param left left edge of the region measured, 0-1 of the sensor image
+     * @param top top edge of the region
+     * @param right right edge of the region
+     * @param bottom bottom edge of the region
+     */
+    public record Params(int width, int height, int steps, int settleFrames,
+                         double left, double top, double right, double bottom) {
+
+        /**
+         * A 640x480 preview, 12 positions per pass settling for 2 frames each,
+         * measured in the centre half of the image.
+         */
+        public static Params defaults() {
+            return new Params(640, 480, 12, 2, 0.25, 0.25, 0.75, 0.75);
+        }
+    }
+
+    /**
+     * Reads an {@code lc4j_focus_result}.
+     */
+    static FocusSweep read(MemorySegment result) {
+        int count = result.get(JAVA_INT, 16);
+        double[] positions = new double[count];
+        double[] sharpness = new double[count];
+        for (int i = 0; i < count; i++) {
+            positions[i] = result.get(JAVA_FLOAT, Native.FOCUS_RESULT_POSITIONS + 4L * i);
+            sharpness[i] = result.get(JAVA_FLOAT, Native.FOCUS_RESULT_SHARPNESS + 4L * i);
+        }
+        return new FocusSweep(result.get(JAVA_FLOAT, 0), result.get(JAVA_FLOAT, 4), result.get(JAVA_INT, 8),
+                result.get(JAVA_INT, 12), positions, sharpness);
+    }
+}
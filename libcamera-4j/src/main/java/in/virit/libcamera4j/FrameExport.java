@@ -0,0 +1,257 @@
+package in.virit.libcamera4j;
+
+import java.lang.foreign.Arena;
+import java.lang.foreign.MemorySegment;
+import java.lang.invoke.VarHandle;
+import java.time.Instant;
+
+import static java.lang.foreign.ValueLayout.JAVA_BYTE;
+import static java.lang.foreign.ValueLayout.JAVA_INT;
+import static java.lang.foreign.ValueLayout.JAVA_LONG;
+
+/**
+ * Shares the latest captured frames with other local processes through POSIX
+ * shared memory.
+ *
+ * <p>An export created with {@link #create(String, int, long)} is a small ring
+ * of slots in {@code /dev/shm/<name>}. While it is open, every JPEG captured by
+ * a {@link CaptureSession} of this process is published to it natively - both
+ * the YUV planes as captured and the encoded JPEG - and {@link #publish} adds
+ * JPEGs encoded elsewhere. Consumers map the object read-only, with
+ * {@link #attach(String)} or directly from C or Python following the layout in
+ * {@code libcamera4j.h}, and read the newest slot in place; no file is written
+ * and nothing is copied for readers that do not want a copy.</p>
+ *
+ * <pre>{@code
+ * try (FrameExport export = FrameExport.attach("heisala-latest")) {
+ *     FrameExport.Frame frame = export.latest();
+ *     if (frame != null) {
+ *         Files.write(Path.of("snapshot.jpg"), frame.jpeg());
+ *     }
+ * }
+ * }</pre>
+ *
+ * <p>Slots are protected by sequence counters, so the writer never waits for
+ * readers: a read that overlaps the slot being rewritten is detected and
+ * retried. All methods are thread safe.</p>
+ */
+public final class FrameExport implements AutoCloseable {
+
+    static {
+        NativeLoader.load();
+    }
+
+    // Layout of lc4j_export_header / lc4j_export_slot
+    private static final long SLOT_COUNT = 12;
+    private static final long SLOT_SIZE = 16;
+    private static final long PUBLISHED = 24;
+    private static final long SLOTS = 64;
+    private static final long SLOT_HEADER_SIZE = 128;
+    private static final long SLOT_SEQUENCE = 0;
+    private static final long SLOT_NUMBER = 8;
+    private static final long SLOT_TIMESTAMP = 16;
+    private static final long SLOT_FRAME_SEQUENCE = 24;
+    private static final long SLOT_JPEG_WIDTH = 88;
+    private static final long SLOT_JPEG_HEIGHT = 92;
+    private static final long SLOT_JPEG_OFFSET = 96;
+    private static final long SLOT_JPEG_BYTES = 104;
+    private static final long SLOT_PUBLISHED_MS = 112;
+
+    private static final int EXPORT_RAW = 0x1;
+    private static final int EXPORT_JPEG = 0x2;
+    private static final int ENOSPC = -28;
+
+    private static final VarHandle LONG = JAVA_LONG.varHandle();
+
+    /**
+     * A published frame.
+     *
+     * @param number publish number of the frame, counting from 1
+     * @param timestampNs sensor timestamp, 0 if unknown
+     * @param frameSequence camera frame sequence number, 0 if unknown
+     * @param publishedAt when the frame was published
+     * @param width JPEG image width
+     * @param height JPEG image height
+     * @param jpeg the encoded frame, or null if it was published without one
+     */
+    public record Frame(long number, long timestampNs, long frameSequence, Instant publishedAt,
+                        int width, int height, byte[] jpeg) {
+    }
+
+    private final long handle;
+    private final String name;
+    private final boolean publisher;
+    private final Arena arena;
+    private final MemorySegment map;
+    private boolean closed;
+
+    private FrameExport(long handle, String name, boolean publisher) {
+        this.handle = handle;
+        this.name = name;
+        this.publisher = publisher;
+        // Shared: readers may poll from any thread. Closing the arena
+        // invalidates the view before the mapping goes away natively.
+        this.arena = Arena.ofShared();
+        try (Arena confined = Arena.ofConfined()) {
+            MemorySegment out = confined.allocate(JAVA_LONG, 2);
+            int result = Native.exportMap(handle, out);
+            if (result != 0) {
+                throw LibCameraException.forOperation("Frame export map", result);
+            }
+            this.map = MemorySegment.ofAddress(out.getAtIndex(JAVA_LONG, 0))
+                    .reinterpret(out.getAtIndex(JAVA_LONG, 1), arena, null);
+        } catch (RuntimeException e) {
+            arena.close();
+            Native.exportClose(handle);
+            throw e;
+        }
+    }
+
+    /**
+     * Creates an export, replacing any left over under the same name. Each slot
+     * should hold a captured frame's planes plus its JPEG, about twice the YUV
+     * size; frames that do not fit are published without their planes.
+     *
+     * @param name name of the shared-memory object, without the leading slash
+     * @param slotCount number of frames kept, at least 2; a reader has
+     *        {@code slotCount - 1} frame intervals to read a frame in place
+     * @param slotSize bytes per slot, a multiple of 64
+     * @return the export, publishing captured frames until it is closed
+     * @throws LibCameraException if the object cannot be created
+     */
+    public static FrameExport create(String name, int slotCount, long slotSize) {
+        long handle = Native.exportOpen("/" + name, slotCount, slotSize, EXPORT_RAW | EXPORT_JPEG);
+        if (handle == 0) {
+            throw new LibCameraException("Failed to create frame export " + name);
+        }
+        return new FrameExport(handle, name, true);
+    }
+
+    /**
+     * Maps an export created by this or another process, read-only.
+     *
+     * @param name name of the shared-memory object, without the leading slash
+     * @return the export
+     * @throws LibCameraException if there is no such export
+     */
+    public static FrameExport attach(String name) {
+        long handle = Native.exportAttach("/" + name);
+        if (handle == 0) {
+            throw new LibCameraException("Failed to attach to frame export " + name);
+        }
+        return new FrameExport(handle, name, false);
+    }
+
+    /**
+     * Returns the name of the shared-memory object.
+     *
+     * @return the name, without the leading slash
+     */
+    public String name() {
+        return name;
+    }
+
+    /**
+     * Publishes a JPEG encoded outside of a {@link CaptureSession}.
+     *
+     * @param timestampNs sensor timestamp, or 0 if unknown
+     * @param width image width
+     * @param height image height
+     * @param jpeg the encoded frame
+     * @return false if the frame does not fit in a slot
+     * @throws IllegalStateException if the export was attached rather than created
+     * @throws LibCameraException if publishing fails
+     */
+    public boolean publish(long timestampNs, int width, int height, byte[] jpeg) {
+        ensureOpen();
+        if (!publisher) {
+            throw new IllegalStateException("Frame export " + name + " is read-only");
+        }
+        try (Arena confined = Arena.ofConfined()) {
+            MemorySegment data = confined.allocateFrom(JAVA_BYTE, jpeg);
+            int result = Native.exportPublish(handle, timestampNs, width, height, data);
+            if (result == ENOSPC) {
+                return false;
+            }
+            if (result != 0) {
+                throw LibCameraException.forOperation("Frame export publish", result);
+            }
+            return true;
+        }
+    }
+
+    /**
+     * Returns the number of frames published so far.
+     *
+     * @return the publish number of the latest frame, 0 if none
+     */
+    public long published() {
+        ensureOpen();
+        return (long) LONG.getAcquire(map, PUBLISHED);
+    }
+
+    /**
+     * Returns the latest frame.
+     *
+     * @return a copy of the latest frame, or null if none has been published
+     */
+    public Frame latest() {
+        ensureOpen();
+        int slotCount = map.get(JAVA_INT, SLOT_COUNT);
+        long slotSize = map.get(JAVA_LONG, SLOT_SIZE);
+        while (true) {
+            long published = (long) LONG.getAcquire(map, PUBLISHED);
+            if (published == 0) {
+                return null;
+            }
+            long slot = SLOTS + ((published - 1) % slotCount) * slotSize;
+            long sequence = (long) LONG.getAcquire(map, slot + SLOT_SEQUENCE);
+            if ((sequence & 1) == 0) {
+                Frame frame = readSlot(slot, slotSize);
+                VarHandle.acquireFence();
+                if ((long) LONG.getOpaque(map, slot + SLOT_SEQUENCE) == sequence) {
+                    return frame;
+                }
+            }
+            Thread.onSpinWait();
+        }
+    }
+
+    // Reads a slot without checking its sequence; the caller validates the result.
+    private Frame readSlot(long slot, long slotSize) {
+        long offset = map.get(JAVA_LONG, slot + SLOT_JPEG_OFFSET);
+        long length = map.get(JAVA_LONG, slot + SLOT_JPEG_BYTES);
+        // A torn read may see garbage; never index outside the slot
+        long data = slot + SLOT_HEADER_SIZE;
+        if (offset < 0 || length < 0 || offset + length > slotSize - SLOT_HEADER_SIZE) {
+            return null;
+        }
+        return new Frame(
+                map.get(JAVA_LONG, slot + SLOT_NUMBER),
+                map.get(JAVA_LONG, slot + SLOT_TIMESTAMP),
+                map.get(JAVA_LONG, slot + SLOT_FRAME_SEQUENCE),
+                Instant.ofEpochMilli(map.get(JAVA_LONG, slot + SLOT_PUBLISHED_MS)),
+                map.get(JAVA_INT, slot + SLOT_JPEG_WIDTH),
+                map.get(JAVA_INT, slot + SLOT_JPEG_HEIGHT),
+                length == 0 ? null : map.asSlice(data + offset, length).toArray(JAVA_BYTE));
+    }
+
+    private void ensureOpen() {
+        if (closed) {
+            throw new IllegalStateException("FrameExport is closed");
+        }
+    }
+
+    /**
+     * Closes the export. Closing a created export stops publishing and removes
+     * the shared-memory object; readers keep what they have mapped.
+     */
+    @Override
+    public synchronized void close() {
+        if (!closed) {
+            closed = true;
+            arena.close();
+            Native.exportClose(handle);
+        }
+    }
+}
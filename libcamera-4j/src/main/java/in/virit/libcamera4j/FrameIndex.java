@@ -0,0 +1,216 @@
+package in.virit.libcamera4j;
+
+import java.lang.foreign.MemorySegment;
+import java.lang.invoke.VarHandle;
+import java.util.ArrayList;
+import java.util.List;
+import java.util.function.Supplier;
+
+import static java.lang.foreign.ValueLayout.JAVA_INT;
+import static java.lang.foreign.ValueLayout.JAVA_LONG;
+
+/**
+ * A zero-copy view of a {@link FrameStore}'s timestamp index.
+ *
+ * <p>The store keeps all of its frames in one timestamp-sorted index file that
+ * is memory-mapped natively; this class reads that mapping in place. Sizes and
+ * lookups are binary searches over the mapped entries, so nothing proportional
+ * to the number of stored frames is loaded or copied into the JVM heap. Only the
+ * results of {@link #range(long, long)} are materialised.</p>
+ *
+ * <p>The index changes as frames are appended, deleted and compacted. Every
+ * method returns a consistent answer: reads that overlap a change to existing
+ * entries are detected through the index's sequence counter and retried.
+ * Obtain the view with {@link FrameStore#index()}; it becomes unusable once the
+ * store is closed.</p>
+ */
+public final class FrameIndex {
+
+    // Layout of lc4j_store_index_header / lc4j_store_index_entry
+    private static final long COUNT = 16;
+    private static final long SEQUENCE = 24;
+    private static final long ENTRIES = 64;
+    private static final long ENTRY_SIZE = 24;
+    private static final long ENTRY_LENGTH = 16;
+
+    private static final VarHandle LONG = JAVA_LONG.varHandle();
+
+    private final MemorySegment map;
+
+    FrameIndex(MemorySegment map) {
+        this.map = map;
+    }
+
+    /**
+     * Returns the number of frames in the store.
+     *
+     * @return the frame count
+     */
+    public int size() {
+        return (int) count();
+    }
+
+    /**
+     * Returns whether the store holds no frames.
+     *
+     * @return true if empty
+     */
+    public boolean isEmpty() {
+        return count() == 0;
+    }
+
+    /**
+     * Returns the oldest frame.
+     *
+     * @return the oldest frame, or null if the store is empty
+     */
+    public FrameStore.Entry first() {
+        return read(() -> {
+            long n = count();
+            return n == 0 ? null : entry(0);
+        });
+    }
+
+    /**
+     * Returns the newest frame.
+     *
+     * @return the newest frame, or null if the store is empty
+     */
+    public FrameStore.Entry last() {
+        return read(() -> {
+            long n = count();
+            return n == 0 ? null : entry(n - 1);
+        });
+    }
+
+    /**
+     * Looks up a frame by timestamp.
+     *
+     * @param timestampMs the frame's timestamp
+     * @return the frame, or null if there is none with that timestamp
+     */
+    public FrameStore.Entry find(long timestampMs) {
+        return read(() -> {
+            long n = count();
+            long i = lowerBound(n, timestampMs);
+            return i < n && timestampAt(i) == timestampMs ? entry(i) : null;
+        });
+    }
+
+    /**
+     * Returns the frame whose timestamp is closest to {@code timestampMs}.
+     *
+     * @param timestampMs the wanted timestamp
+     * @return the closest frame, or null if the store is empty
+     */
+    public FrameStore.Entry nearest(long timestampMs) {
+        return read(() -> {
+            long n = count();
+            if (n == 0) {
+                return null;
+            }
+            long i = lowerBound(n, timestampMs);
+            if (i == n) {
+                return entry(n - 1);
+            }
+            if (i > 0 && timestampMs - timestampAt(i - 1) <= timestampAt(i) - timestampMs) {
+                return entry(i - 1);
+            }
+            return entry(i);
+        });
+    }
+
+    /**
+     * Counts the frames with timestamps in {@code [fromMs, toMs]}.
+     *
+     * @param fromMs start of the range, inclusive
+     * @param toMs end of the range, inclusive
+     * @return the number of frames in the range
+     */
+    public int count(long fromMs, long toMs) {
+        return read(() -> {
+            long n = count();
+            long first = lowerBound(n, fromMs);
+            long last = upperBound(n, toMs);
+            return (int) Math.max(0, last - first);
+        });
+    }
+
+    /**
+     * Returns the frames with timestamps in {@code [fromMs, toMs]}, oldest first.
+     *
+     * @param fromMs start of the range, inclusive
+     * @param toMs end of the range, inclusive
+     * @return a snapshot of the frames in the range
+     */
+    public List<FrameStore.Entry> range(long fromMs, long toMs) {
+        return read(() -> {
+            long n = count();
+            long first = lowerBound(n, fromMs);
+            long last = upperBound(n, toMs);
+            List<FrameStore.Entry> entries = new ArrayList<>((int) Math.max(0, last - first));
+            for (long i = first; i < last; i++) {
+                entries.add(entry(i));
+            }
+            return entries;
+        });
+    }
+
+    // Runs a read of the mapped entries until it did not overlap a change.
+    private <T> T read(Supplier<T> reader) {
+        while (true) {
+            long sequence = (long) LONG.getAcquire(map, SEQUENCE);
+            if ((sequence & 1) == 0) {
+                T result = reader.get();
+                VarHandle.acquireFence();
+                if ((long) LONG.getOpaque(map, SEQUENCE) == sequence) {
+                    return result;
+                }
+            }
+            Thread.onSpinWait();
+        }
+    }
+
+    private long count() {
+        return (long) LONG.getAcquire(map, COUNT);
+    }
+
+    private long timestampAt(long i) {
+        return map.get(JAVA_LONG, ENTRIES + i * ENTRY_SIZE);
+    }
+
+    private FrameStore.Entry entry(long i) {
+        long base = ENTRIES + i * ENTRY_SIZE;
+        return new FrameStore.Entry(map.get(JAVA_LONG, base), map.get(JAVA_INT, base + ENTRY_LENGTH));
+    }
+
+    // First index in [0, n) with a timestamp >= timestampMs.
+    private long lowerBound(long n, long timestampMs) {
+        long low = 0;
+        long high = n;
+        while (low < high) {
+            long mid = (low + high) >>> 1;
+            if (timestampAt(mid) < timestampMs) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low;
+    }
+
+    // First index in [0, n) with a timestamp > timestampMs.
+    private long upperBound(long n, long timestampMs) {
+        long low = 0;
+        long high = n;
+        while (low < high) {
+            long mid = (low + high) >>> 1;
+            if (timestampAt(mid) <= timestampMs) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low;
+    }
+}
@@ -0,0 +1,66 @@
+package in.virit.libcamera4j;
+
+import java.lang.foreign.MemorySegment;
+import java.time.Duration;
+
+import static java.lang.foreign.ValueLayout.JAVA_DOUBLE;
+import static java.lang.foreign.ValueLayout.JAVA_LONG;
+
+/**
+ * Whether a stream keeps up with the sensor, from the sequence numbers and
+ * timestamps of the buffers it completed.
+ *
+ * <p>Tracked natively as buffers complete; read with
+ * {@link Camera#sequenceStats(int, boolean)} or
+ * {@link CaptureSession#sequenceStats(int, boolean)}, per stream. A skipped
+ * sequence number is a frame the sensor produced that no request was queued
+ * for. The intervals and delays start over when the stream is configured
+ * differently, since another frame rate would make them meaningless.</p>
+ *
+ * @param frames buffers completed
+ * @param dropped sequence numbers skipped
+ * @param duplicates sequence numbers seen again, or going back
+ * @param late completions more than one frame interval after the usual delay
+ *             from exposure to completion
+ * @param lastSequence sequence number of the last buffer
+ * @param intervals intervals measured between consecutive frames
+ * @param meanIntervalNs mean interval between consecutive frames, in nanoseconds
+ * @param jitterNs standard deviation of the intervals
+ * @param minIntervalNs shortest interval
+ * @param maxIntervalNs longest interval
+ * @param meanLatencyNs mean delay from a frame's sensor timestamp to its completion
+ */
+public record FrameSequenceStats(long frames, long dropped, long duplicates, long late, long lastSequence,
+                                 long intervals, double meanIntervalNs, double jitterNs, long minIntervalNs,
+                                 long maxIntervalNs, double meanLatencyNs) {
+
+    /** Frames per second from the mean interval, 0 if none was measured. */
+    public double frameRate() {
+        return meanIntervalNs > 0 ? 1e9 / meanIntervalNs : 0;
+    }
+
+    /** The mean interval between consecutive frames. */
+    public Duration meanInterval() {
+        return Duration.ofNanos(Math.round(meanIntervalNs));
+    }
+
+    /** The standard deviation of the intervals between consecutive frames. */
+    public Duration jitter() {
+        return Duration.ofNanos(Math.round(jitterNs));
+    }
+
+    /** Whether any frame was dropped, duplicated or late. */
+    public boolean hasGaps() {
+        return dropped > 0 || duplicates > 0 || late > 0;
+    }
+
+    /**
+     * Reads an {@code lc4j_sequence_stats}.
+     */
+    static FrameSequenceStats read(MemorySegment stats) {
+        return new FrameSequenceStats(stats.get(JAVA_LONG, 0), stats.get(JAVA_LONG, 8), stats.get(JAVA_LONG, 16),
+                stats.get(JAVA_LONG, 24), stats.get(JAVA_LONG, 32), stats.get(JAVA_LONG, 40),
+                stats.get(JAVA_DOUBLE, 48), stats.get(JAVA_DOUBLE, 56), stats.get(JAVA_LONG, 64),
+                stats.get(JAVA_LONG, 72), stats.get(JAVA_DOUBLE, 80));
+    }
+}
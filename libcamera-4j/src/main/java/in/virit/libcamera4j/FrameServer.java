@@ -0,0 +1,94 @@
+package in.virit.libcamera4j;
+
+import java.nio.file.Path;
+
+/**
+ * Passes captured frames to other local processes as dmabuf file descriptors.
+ *
+ * <p>While a server is open, every YUV frame a {@link CaptureSession} of this
+ * process captures is offered to the processes connected to its Unix socket:
+ * each receives the frame's dmabuf fds over {@code SCM_RIGHTS} together with
+ * the plane layout and metadata ({@code lc4j_served_frame} in
+ * {@code libcamera4j.h}) and maps the camera's memory directly, so a local
+ * encoder or analysis process gets full-resolution frames without a copy.</p>
+ *
+ * <p>A subscriber returns each frame by sending its token back once it has
+ * closed the fds. One that holds {@code maxOutstanding} frames receives no
+ * more until it does, which bounds how much camera memory it can keep alive.
+ * Sending never blocks a capture; subscribers that fall behind miss frames.</p>
+ *
+ * <pre>{@code
+ * try (FrameServer server = FrameServer.open(Path.of("/run/heisala/frames.sock"), 2)) {
+ *     CameraCapture.captureToStore(store, key, 1920, 1080, settings, 75);
+ * }
+ * }</pre>
+ */
+public final class FrameServer implements AutoCloseable {
+
+    static {
+        NativeLoader.load();
+    }
+
+    private final long handle;
+    private final Path socket;
+    private boolean closed;
+
+    private FrameServer(long handle, Path socket) {
+        this.handle = handle;
+        this.socket = socket;
+    }
+
+    /**
+     * Starts a server listening on {@code socket}, replacing a socket file left
+     * by an earlier process.
+     *
+     * @param socket path of the Unix socket
+     * @param maxOutstanding frames a subscriber may hold at once, 1-64
+     * @return the running server
+     * @throws LibCameraException if the socket cannot be created
+     */
+    public static FrameServer open(Path socket, int maxOutstanding) {
+        long handle = Native.serverOpen(socket.toString(), maxOutstanding);
+        if (handle == 0) {
+            throw new LibCameraException("Failed to start frame server on " + socket);
+        }
+        return new FrameServer(handle, socket);
+    }
+
+    /**
+     * Returns the socket path.
+     *
+     * @return the path subscribers connect to
+     */
+    public Path socket() {
+        return socket;
+    }
+
+    /**
+     * Returns the number of connected subscribers.
+     *
+     * @return the subscriber count
+     */
+    public synchronized int subscribers() {
+        ensureOpen();
+        return Native.serverSubscribers(handle);
+    }
+
+    private void ensureOpen() {
+        if (closed) {
+            throw new IllegalStateException("FrameServer is closed");
+        }
+    }
+
+    /**
+     * Disconnects all subscribers and removes the socket. Frames they still
+     * hold stay valid until they close the fds.
+     */
+    @Override
+    public synchronized void close() {
+        if (!closed) {
+            closed = true;
+            Native.serverClose(handle);
+        }
+    }
+}
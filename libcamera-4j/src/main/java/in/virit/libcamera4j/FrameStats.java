@@ -0,0 +1,83 @@
+package in.virit.libcamera4j;
+
+import java.lang.foreign.MemorySegment;
+
+import static java.lang.foreign.ValueLayout.JAVA_DOUBLE;
+import static java.lang.foreign.ValueLayout.JAVA_FLOAT;
+import static java.lang.foreign.ValueLayout.JAVA_INT;
+import static java.lang.foreign.ValueLayout.JAVA_LONG;
+
+/**
+ * Luma histogram and exposure statistics of a captured frame.
+ *
+ * <p>Computed natively from the mapped camera buffer, on a subsampled grid of
+ * at most ~128k samples, so Java never touches the pixels. YUV frames are
+ * measured on the Y plane and RGB frames on green. Raw frames use the mean of
+ * each 2x2 Bayer quad: their levels are linear sensor values including the
+ * black level, not gamma-encoded ones. Zones are in sensor orientation,
+ * before any {@link Transform}.</p>
+ *
+ * @param histogram number of samples per luma level, 256 entries
+ * @param samples total number of samples
+ * @param mean mean luma level, 0-255
+ * @param median median luma level, 0-255
+ * @param clippedLowPercent percentage of samples at level 0
+ * @param clippedHighPercent percentage of samples at level 255
+ * @param zonesX number of zone columns
+ * @param zonesY number of zone rows
+ * @param zoneMeans mean luma level of each zone, row-major
+ */
+public record FrameStats(int[] histogram, long samples, double mean, int median,
+                         double clippedLowPercent, double clippedHighPercent,
+                         int zonesX, int zonesY, float[] zoneMeans) {
+
+    /** Zone columns and rows used unless configured otherwise. */
+    public static final int DEFAULT_ZONES = 8;
+
+    /** Largest number of zone columns or rows. */
+    public static final int MAX_ZONES = 16;
+
+    // Layout of lc4j_frame_stats
+    private static final long SAMPLES = 1024;
+    private static final long MEAN = 1032;
+    private static final long MEDIAN = 1040;
+    private static final long ZONES_X = 1044;
+    private static final long ZONES_Y = 1048;
+    private static final long CLIPPED_LOW = 1052;
+    private static final long CLIPPED_HIGH = 1056;
+    private static final long ZONE_MEANS = 1060;
+
+    /**
+     * Returns the mean luma level of a zone.
+     *
+     * @param x zone column, from the left
+     * @param y zone row, from the top
+     * @return the mean level, 0-255
+     */
+    public float zoneMean(int x, int y) {
+        return zoneMeans[y * zonesX + x];
+    }
+
+    /**
+     * Reads an {@code lc4j_frame_stats}.
+     *
+     * @return the statistics, or null if none were computed
+     */
+    static FrameStats read(MemorySegment stats) {
+        int zonesX = stats.get(JAVA_INT, ZONES_X);
+        int zonesY = stats.get(JAVA_INT, ZONES_Y);
+        if (zonesX == 0) {
+            return null;
+        }
+        return new FrameStats(
+                stats.asSlice(0, 256 * 4).toArray(JAVA_INT),
+                stats.get(JAVA_LONG, SAMPLES),
+                stats.get(JAVA_DOUBLE, MEAN),
+                stats.get(JAVA_INT, MEDIAN),
+                stats.get(JAVA_FLOAT, CLIPPED_LOW),
+                stats.get(JAVA_FLOAT, CLIPPED_HIGH),
+                zonesX,
+                zonesY,
+                stats.asSlice(ZONE_MEANS, (long) zonesX * zonesY * 4).toArray(JAVA_FLOAT));
+    }
+}
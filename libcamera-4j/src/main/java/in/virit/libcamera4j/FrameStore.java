@@ -0,0 +1,538 @@
+package in.virit.libcamera4j;
+
+import java.lang.foreign.Arena;
+import java.lang.foreign.MemorySegment;
+import java.nio.file.Path;
+import java.time.Duration;
+import java.time.Instant;
+import java.util.ArrayList;
+import java.util.List;
+
+import static java.lang.foreign.ValueLayout.JAVA_BYTE;
+import static java.lang.foreign.ValueLayout.JAVA_INT;
+import static java.lang.foreign.ValueLayout.JAVA_LONG;
+
+/**
+ * Append-only storage for encoded frames, keyed by millisecond timestamps.
+ *
+ * <p>Instead of one file per frame, each day is kept as a single segment file
+ * of concatenated frames plus an index of fixed-size records (timestamp,
+ * offset, length, flags). Appending is two positioned writes, reading a frame
+ * is a single {@code pread}, and deleting only flags the index record;
+ * {@link #compact(double)} later rewrites days with enough deleted data and
+ * removes days that have become empty. All frames are also listed in a sorted,
+ * memory-mapped index that lookups and range queries search in place (see
+ * {@link #index()}), so opening a store does not read the whole archive.</p>
+ *
+ * <p>Appends are written immediately but not synced one by one. With
+ * {@link #setGroupCommit(Duration, long)} a native thread makes everything
+ * appended so far durable in one batch per interval or byte budget, and
+ * {@link #durability()} reports how far that has got.</p>
+ *
+ * <p>Old JPEG frames can be shrunk in place with
+ * {@link #recompress(long, long, int, int)}.</p>
+ *
+ * <p>Each frame can carry a 64-bit tag in its index record. Frames captured
+ * with {@link CaptureSession#captureToStore} are tagged with a perceptual hash
+ * of the image, {@link #hashFrames(long, long)} tags other JPEG frames the same
+ * way, and {@link #hashDistance(long, long)} compares two hashes. Tags survive
+ * compaction and recompression.</p>
+ *
+ * <pre>{@code
+ * try (FrameStore store = FrameStore.open(Path.of("timelapse/store"))) {
+ *     store.append(timestamp, jpeg);
+ *     byte[] frame = store.read(timestamp);
+ * }
+ * }</pre>
+ *
+ * <p>Timestamps are milliseconds since the epoch and frames are grouped into
+ * days by UTC date. All methods are thread safe.</p>
+ */
+public final class FrameStore implements AutoCloseable {
+
+    static {
+        NativeLoader.load();
+    }
+
+    private static final int ENOENT = -2;
+    private static final int ENOSPC = -28;
+    private static final int STORE_TAGGED = 0x2;
+    private static final int LIST_BATCH = 1024;
+
+    /**
+     * A stored frame.
+     *
+     * @param timestampMs the frame's timestamp
+     * @param length size of the encoded frame in bytes
+     */
+    public record Entry(long timestampMs, int length) {
+    }
+
+    /**
+     * How much of what was appended is on stable storage. Appends are numbered
+     * from 1 in the order they complete since the store was opened.
+     *
+     * @param appended number of appends so far
+     * @param durable appends 1 to {@code durable} survive a power loss
+     * @param durableTimestampMs newest frame timestamp among the durable appends,
+     *        or {@link Long#MIN_VALUE} if there are none
+     * @param pendingBytes bytes appended since the last group commit
+     * @param commits number of completed group commits
+     * @param lastCommit when the last group commit completed, or null if none has
+     * @param lastCommitDuration how long the last group commit took
+     * @param lastError negative errno if the last group commit failed, otherwise 0
+     */
+    public record Durability(long appended, long durable, long durableTimestampMs, long pendingBytes,
+                             long commits, Instant lastCommit, Duration lastCommitDuration, int lastError) {
+
+        /**
+         * Returns whether every append so far is durable.
+         *
+         * @return true if nothing is waiting for a group commit
+         */
+        public boolean isComplete() {
+            return durable == appended;
+        }
+    }
+
+    /**
+     * A stored frame with its tag.
+     *
+     * @param timestampMs the frame's timestamp
+     * @param length size of the encoded frame in bytes
+     * @param tagged whether a tag has been set
+     * @param tag the tag, 0 if none has been set
+     */
+    public record TaggedEntry(long timestampMs, int length, boolean tagged, long tag) {
+    }
+
+    /**
+     * Outcome of {@link #recompress(long, long, int, int)}.
+     *
+     * @param recompressed number of frames replaced by a smaller encoding
+     * @param skipped frames left as they were: already recompressed, not made
+     *        smaller, or changed while the pass ran
+     * @param failed frames that could not be decoded as JPEG
+     * @param bytesBefore size of the recompressed frames before
+     * @param bytesAfter size of the recompressed frames after
+     */
+    public record Recompression(int recompressed, int skipped, int failed, long bytesBefore, long bytesAfter) {
+
+        /**
+         * Returns the number of bytes freed once the store is compacted.
+         *
+         * @return bytes saved
+         */
+        public long savedBytes() {
+            return bytesBefore - bytesAfter;
+        }
+    }
+
+    private final long handle;
+    private final Path directory;
+    private final Arena arena;
+    private final FrameIndex index;
+    private volatile boolean closed;
+
+    private FrameStore(long handle, Path directory) {
+        this.handle = handle;
+        this.directory = directory;
+        // Shared: the index may be read from any thread. Closing the arena
+        // invalidates the view before the mapping goes away natively.
+        this.arena = Arena.ofShared();
+        try (Arena confined = Arena.ofConfined()) {
+            MemorySegment out = confined.allocate(JAVA_LONG, 2);
+            int result = Native.storeIndexMap(handle, out);
+            if (result != 0) {
+                throw LibCameraException.forOperation("Frame store index", result);
+            }
+            MemorySegment map = MemorySegment.ofAddress(out.getAtIndex(JAVA_LONG, 0))
+                    .reinterpret(out.getAtIndex(JAVA_LONG, 1), arena, null);
+            this.index = new FrameIndex(map);
+        } catch (RuntimeException e) {
+            arena.close();
+            Native.storeClose(handle);
+            throw e;
+        }
+    }
+
+    /**
+     * Opens the store in {@code directory}, creating it if needed. Leftovers of
+     * an interrupted append or compaction are cleaned up.
+     *
+     * @param directory the store directory
+     * @return the open store
+     * @throws LibCameraException if the directory cannot be opened
+     */
+    public static FrameStore open(Path directory) {
+        long handle = Native.storeOpen(directory.toString());
+        if (handle == 0) {
+            throw new LibCameraException("Failed to open frame store " + directory);
+        }
+        return new FrameStore(handle, directory);
+    }
+
+    /**
+     * Returns the zero-copy view of the store's timestamp index.
+     *
+     * @return the index, valid until the store is closed
+     */
+    public FrameIndex index() {
+        ensureOpen();
+        return index;
+    }
+
+    /**
+     * Returns the store directory.
+     *
+     * @return the directory
+     */
+    public Path directory() {
+        return directory;
+    }
+
+    /**
+     * Appends a frame, replacing any frame with the same timestamp.
+     *
+     * @param timestampMs the frame's timestamp
+     * @param data the encoded frame
+     * @throws LibCameraException if writing fails
+     */
+    public void append(long timestampMs, byte[] data) {
+        ensureOpen();
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment segment = arena.allocateFrom(JAVA_BYTE, data);
+            int result = Native.storeAppend(handle, timestampMs, segment);
+            if (result != 0) {
+                throw LibCameraException.forOperation("Frame store append", result);
+            }
+        }
+    }
+
+    /**
+     * Reads a frame.
+     *
+     * @param timestampMs the frame's timestamp
+     * @return the encoded frame, or null if there is none with that timestamp
+     * @throws LibCameraException if reading fails
+     */
+    public byte[] read(long timestampMs) {
+        ensureOpen();
+        try (Arena arena = Arena.ofConfined()) {
+            while (true) {
+                Entry entry = index.find(timestampMs);
+                if (entry == null) {
+                    return null;
+                }
+                MemorySegment buffer = arena.allocate(entry.length());
+                long length = Native.storeRead(handle, timestampMs, buffer);
+                if (length == ENOENT) {
+                    return null;
+                }
+                if (length == ENOSPC) {
+                    continue;   // replaced by a larger frame in between
+                }
+                if (length < 0) {
+                    throw LibCameraException.forOperation("Frame store read", (int) length);
+                }
+                return buffer.asSlice(0, length).toArray(JAVA_BYTE);
+            }
+        }
+    }
+
+    /**
+     * Copies a frame to a file without passing it through the Java heap. The
+     * file is replaced atomically, so readers never see a partial frame.
+     *
+     * @param timestampMs the frame's timestamp
+     * @param path the file to write
+     * @return the frame's length in bytes, or -1 if there is no frame with that timestamp
+     * @throws LibCameraException if copying fails
+     */
+    public long export(long timestampMs, Path path) {
+        ensureOpen();
+        try (Arena arena = Arena.ofConfined()) {
+            long length = Native.storeExport(handle, timestampMs, arena.allocateFrom(path.toString()));
+            if (length == ENOENT) {
+                return -1;
+            }
+            if (length < 0) {
+                throw LibCameraException.forOperation("Frame store export to " + path, (int) length);
+            }
+            return length;
+        }
+    }
+
+    /**
+     * Lists the frames with timestamps in {@code [fromMs, toMs]}, oldest first.
+     *
+     * @param fromMs start of the range, inclusive
+     * @param toMs end of the range, inclusive
+     * @return the frames in the range
+     */
+    public List<Entry> list(long fromMs, long toMs) {
+        ensureOpen();
+        return index.range(fromMs, toMs);
+    }
+
+    /**
+     * Lists all frames, oldest first.
+     *
+     * @return all frames
+     */
+    public List<Entry> list() {
+        return list(Long.MIN_VALUE, Long.MAX_VALUE);
+    }
+
+    /**
+     * Deletes frames. The space is reclaimed by {@link #compact(double)}.
+     *
+     * @param timestampsMs timestamps of the frames to delete; unknown ones are ignored
+     * @return the number of frames deleted
+     * @throws LibCameraException if updating the index fails
+     */
+    public int delete(long... timestampsMs) {
+        ensureOpen();
+        if (timestampsMs.length == 0) {
+            return 0;
+        }
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment timestamps = arena.allocateFrom(JAVA_LONG, timestampsMs);
+            int result = Native.storeDelete(handle, timestamps, timestampsMs.length);
+            if (result < 0) {
+                throw LibCameraException.forOperation("Frame store delete", result);
+            }
+            return result;
+        }
+    }
+
+    /**
+     * Enables group commit: everything appended is made durable together every
+     * {@code interval}, or earlier once {@code maxBytes} have been appended
+     * since the last commit. A zero interval or budget disables that trigger;
+     * with both zero, appends are only synced by {@link #sync()} and
+     * {@link #close()}.
+     *
+     * @param interval longest time an append may stay unsynced
+     * @param maxBytes most bytes that may stay unsynced
+     * @throws LibCameraException if the commit thread cannot be started
+     */
+    public void setGroupCommit(Duration interval, long maxBytes) {
+        ensureOpen();
+        int result = Native.storeSetGroupCommit(handle, (int) Math.min(Integer.MAX_VALUE, interval.toMillis()), maxBytes);
+        if (result != 0) {
+            throw LibCameraException.forOperation("Frame store group commit", result);
+        }
+    }
+
+    /**
+     * Makes everything appended so far durable now.
+     *
+     * @throws LibCameraException if syncing fails
+     */
+    public void sync() {
+        ensureOpen();
+        int result = Native.storeSync(handle);
+        if (result != 0) {
+            throw LibCameraException.forOperation("Frame store sync", result);
+        }
+    }
+
+    /**
+     * Returns the durable watermark.
+     *
+     * @return how much of what was appended is on stable storage
+     */
+    public Durability durability() {
+        ensureOpen();
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment out = arena.allocate(Native.STORE_DURABILITY_SIZE, 8);
+            int result = Native.storeGetDurability(handle, out);
+            if (result != 0) {
+                throw LibCameraException.forOperation("Frame store durability", result);
+            }
+            long lastSyncMs = out.get(JAVA_LONG, 40);
+            return new Durability(
+                    out.get(JAVA_LONG, 0),
+                    out.get(JAVA_LONG, 8),
+                    out.get(JAVA_LONG, 16),
+                    out.get(JAVA_LONG, 24),
+                    out.get(JAVA_LONG, 32),
+                    lastSyncMs == 0 ? null : Instant.ofEpochMilli(lastSyncMs),
+                    Duration.ofNanos(out.get(JAVA_LONG, 48)),
+                    out.get(JAVA_INT, 56));
+        }
+    }
+
+    /**
+     * Re-encodes the JPEG frames with timestamps in {@code [fromMs, toMs]} at a
+     * lower quality and at most the given width, replacing each frame that gets
+     * smaller. Frames are decoded at a reduced DCT scale, so the width is only
+     * approximated from above, in steps of 1/8 of the original. Recompressed
+     * frames are marked and skipped by later passes. The work runs natively at
+     * idle CPU and I/O priority; the replaced data is reclaimed by
+     * {@link #compact(double)}.
+     *
+     * @param fromMs start of the range, inclusive
+     * @param toMs end of the range, inclusive
+     * @param maxWidth width to reduce frames to, or 0 to keep their size
+     * @param quality JPEG quality 1-100
+     * @return what was done
+     * @throws LibCameraException if reading or replacing frames fails
+     */
+    public Recompression recompress(long fromMs, long toMs, int maxWidth, int quality) {
+        ensureOpen();
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment out = arena.allocate(Native.RECOMPRESS_RESULT_SIZE, 8);
+            int result = Native.storeRecompress(handle, fromMs, toMs, maxWidth, quality, out);
+            if (result != 0) {
+                throw LibCameraException.forOperation("Frame store recompression", result);
+            }
+            return new Recompression(
+                    out.get(JAVA_INT, 0),
+                    out.get(JAVA_INT, 4),
+                    out.get(JAVA_INT, 8),
+                    out.get(JAVA_LONG, 16),
+                    out.get(JAVA_LONG, 24));
+        }
+    }
+
+    /**
+     * Tags frames, replacing their previous tags.
+     *
+     * @param timestampsMs timestamps of the frames to tag; unknown ones are ignored
+     * @param tags the tag for each timestamp
+     * @return the number of frames tagged
+     * @throws IllegalArgumentException if the arrays differ in length
+     * @throws LibCameraException if updating the index fails
+     */
+    public int setTags(long[] timestampsMs, long[] tags) {
+        ensureOpen();
+        if (timestampsMs.length != tags.length) {
+            throw new IllegalArgumentException("Got " + timestampsMs.length + " timestamps but " + tags.length + " tags");
+        }
+        if (timestampsMs.length == 0) {
+            return 0;
+        }
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment timestamps = arena.allocateFrom(JAVA_LONG, timestampsMs);
+            MemorySegment values = arena.allocateFrom(JAVA_LONG, tags);
+            int result = Native.storeSetTags(handle, timestamps, values, timestampsMs.length);
+            if (result < 0) {
+                throw LibCameraException.forOperation("Frame store tagging", result);
+            }
+            return result;
+        }
+    }
+
+    /**
+     * Lists the frames with timestamps in {@code [fromMs, toMs]} with their
+     * tags, oldest first. Unlike {@link #list(long, long)} this reads the day
+     * indexes from disk.
+     *
+     * @param fromMs start of the range, inclusive
+     * @param toMs end of the range, inclusive
+     * @return the frames in the range
+     * @throws LibCameraException if reading the indexes fails
+     */
+    public List<TaggedEntry> listTags(long fromMs, long toMs) {
+        ensureOpen();
+        List<TaggedEntry> entries = new ArrayList<>();
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment out = arena.allocate(Native.STORE_RECORD_SIZE * LIST_BATCH, 8);
+            long next = fromMs;
+            while (next <= toMs) {
+                int count = Native.storeListTags(handle, next, toMs, out, LIST_BATCH);
+                if (count < 0) {
+                    throw LibCameraException.forOperation("Frame store tag listing", count);
+                }
+                for (int i = 0; i < count; i++) {
+                    long base = i * Native.STORE_RECORD_SIZE;
+                    entries.add(new TaggedEntry(
+                            out.get(JAVA_LONG, base),
+                            out.get(JAVA_INT, base + 16),
+                            (out.get(JAVA_INT, base + 20) & STORE_TAGGED) != 0,
+                            out.get(JAVA_LONG, base + 24)));
+                }
+                if (count < LIST_BATCH || entries.getLast().timestampMs() == Long.MAX_VALUE) {
+                    break;
+                }
+                next = entries.getLast().timestampMs() + 1;
+            }
+        }
+        return entries;
+    }
+
+    /**
+     * Tags the untagged JPEG frames with timestamps in {@code [fromMs, toMs]}
+     * with their perceptual hash, as captures to the store already are. Frames
+     * are decoded at 1/8 scale, so this is cheap enough to run over old archives.
+     *
+     * @param fromMs start of the range, inclusive
+     * @param toMs end of the range, inclusive
+     * @return the number of frames hashed
+     * @throws LibCameraException if reading frames or updating the index fails
+     */
+    public int hashFrames(long fromMs, long toMs) {
+        ensureOpen();
+        int result = Native.storeHashFrames(handle, fromMs, toMs);
+        if (result < 0) {
+            throw LibCameraException.forOperation("Frame store hashing", result);
+        }
+        return result;
+    }
+
+    /**
+     * Returns how different two perceptual hashes say their images look: the
+     * number of differing bits, from 0 for near-identical images up to 64.
+     * Frames a few bits apart are usually the same scene.
+     *
+     * @param hash1 a perceptual hash
+     * @param hash2 another perceptual hash
+     * @return the Hamming distance of the hashes
+     */
+    public static int hashDistance(long hash1, long hash2) {
+        return Long.bitCount(hash1 ^ hash2);
+    }
+
+    /**
+     * Rewrites the days where deleted frames make up at least {@code minDeadRatio}
+     * of the segment, and removes days without frames. Readers and appends are
+     * only blocked while the rewritten index is swapped in.
+     *
+     * @param minDeadRatio share of deleted bytes (0-1) at which a day is rewritten
+     * @return the number of bytes reclaimed
+     * @throws LibCameraException if compaction fails
+     */
+    public long compact(double minDeadRatio) {
+        ensureOpen();
+        long result = Native.storeCompact(handle, minDeadRatio);
+        if (result < 0) {
+            throw LibCameraException.forOperation("Frame store compaction", (int) result);
+        }
+        return result;
+    }
+
+    long handle() {
+        ensureOpen();
+        return handle;
+    }
+
+    private void ensureOpen() {
+        if (closed) {
+            throw new IllegalStateException("FrameStore is closed");
+        }
+    }
+
+    /**
+     * Closes the store. Frames appended so far are synced first.
+     */
+    @Override
+    public synchronized void close() {
+        if (!closed) {
+            closed = true;
+            arena.close();
+            Native.storeClose(handle);
+        }
+    }
+}
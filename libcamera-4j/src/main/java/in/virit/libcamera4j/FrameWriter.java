@@ -0,0 +1,273 @@
+package in.virit.libcamera4j;
+
+import java.lang.foreign.Arena;
+import java.lang.foreign.MemorySegment;
+import java.nio.file.Path;
+import java.time.Duration;
+import java.util.Map;
+import java.util.concurrent.CompletableFuture;
+import java.util.concurrent.ConcurrentHashMap;
+import java.util.concurrent.atomic.AtomicLong;
+
+import static java.lang.foreign.ValueLayout.JAVA_INT;
+import static java.lang.foreign.ValueLayout.JAVA_LONG;
+
+/**
+ * Asynchronous writer for whole files such as encoded frames.
+ *
+ * <p>{@link #write(Path, byte[], Option...)} copies the data into native memory
+ * and returns immediately; the directory creation, open, write, optional fsync,
+ * close and rename run later as one linked io_uring chain on a native writer
+ * thread. On kernels without a usable io_uring the native side transparently
+ * falls back to a small thread pool (see {@link #backend()}).</p>
+ *
+ * <pre>{@code
+ * try (FrameWriter writer = FrameWriter.create()) {
+ *     writer.write(Path.of("timelapse/2026/01/01/20260101_120000.jpg"), jpeg,
+ *             FrameWriter.Option.CREATE_DIRECTORIES, FrameWriter.Option.ATOMIC)
+ *         .thenAccept(result -> System.out.println("Saved " + result.path()));
+ * }
+ * }</pre>
+ *
+ * <p>Closing the writer waits for all submitted writes to complete.</p>
+ */
+public final class FrameWriter implements AutoCloseable {
+
+    /** Default number of files that may be in flight in the kernel at once. */
+    public static final int DEFAULT_QUEUE_DEPTH = 16;
+
+    private static final int FORCE_THREAD_POOL = 0x1;
+    private static final int POLL_BATCH = 16;
+    private static final int POLL_TIMEOUT_MS = 200;
+
+    /**
+     * The native mechanism performing the writes.
+     */
+    public enum Backend {
+        /** Linked io_uring submissions driven by a single writer thread. */
+        IO_URING,
+        /** Plain blocking syscalls on a small native thread pool. */
+        THREAD_POOL
+    }
+
+    /**
+     * Per-write options.
+     */
+    public enum Option {
+        /** Create missing parent directories. */
+        CREATE_DIRECTORIES(0x1),
+        /** Write to a temporary name and rename it into place once complete. */
+        ATOMIC(0x2),
+        /** fsync the file before closing it. */
+        SYNC(0x4);
+
+        private final int value;
+
+        Option(int value) {
+            this.value = value;
+        }
+
+        /**
+         * Returns the native flag for this option.
+         *
+         * @return the native value
+         */
+        public int value() {
+            return value;
+        }
+    }
+
+    /**
+     * Outcome of a completed write.
+     *
+     * @param path the file that was written
+     * @param bytes number of bytes written
+     * @param latency time from submission to completion
+     */
+    public record Result(Path path, long bytes, Duration latency) {
+    }
+
+    private record Pending(Path path, CompletableFuture<Result> future) {
+    }
+
+    private final long handle;
+    private final Backend backend;
+    private final Map<Long, Pending> inFlight = new ConcurrentHashMap<>();
+    private final AtomicLong nextCookie = new AtomicLong(1);
+    private final Thread poller;
+    private volatile boolean closing;
+    private boolean closed;
+
+    private FrameWriter(int queueDepth, boolean forceThreadPool) {
+        this.handle = Native.writerCreate(queueDepth, forceThreadPool ? FORCE_THREAD_POOL : 0);
+        if (handle == 0) {
+            throw new LibCameraException("Failed to create frame writer");
+        }
+        this.backend = Native.writerBackend(handle) == 1 ? Backend.IO_URING : Backend.THREAD_POOL;
+        this.poller = Thread.ofPlatform().name("FrameWriter").daemon().start(this::pollCompletions);
+    }
+
+    /**
+     * Creates a writer with the default queue depth, preferring io_uring.
+     *
+     * @return a new writer
+     */
+    public static FrameWriter create() {
+        return create(DEFAULT_QUEUE_DEPTH);
+    }
+
+    /**
+     * Creates a writer, preferring io_uring.
+     *
+     * @param queueDepth maximum number of files in flight at once
+     * @return a new writer
+     */
+    public static FrameWriter create(int queueDepth) {
+        return new FrameWriter(queueDepth, false);
+    }
+
+    /**
+     * Creates a writer that always uses the thread-pool backend.
+     *
+     * @param queueDepth maximum number of files in flight at once
+     * @return a new writer
+     */
+    public static FrameWriter createThreadPool(int queueDepth) {
+        return new FrameWriter(queueDepth, true);
+    }
+
+    /**
+     * Returns the backend chosen when the writer was created.
+     *
+     * @return the backend
+     */
+    public Backend backend() {
+        return backend;
+    }
+
+    /**
+     * Returns the number of writes submitted but not yet completed.
+     *
+     * @return the number of pending writes
+     */
+    public int pending() {
+        return inFlight.size();
+    }
+
+    /**
+     * Queues the given bytes to be written to {@code path}.
+     *
+     * <p>The array is copied before this method returns and may be reused
+     * immediately. The future fails with error -11 ({@code EAGAIN}) if too
+     * many writes are already waiting for the disk.</p>
+     *
+     * @param path the destination file (replaced if it exists)
+     * @param data the file content
+     * @param options write options
+     * @return a future completed when the file has been written
+     */
+    public CompletableFuture<Result> write(Path path, byte[] data, Option... options) {
+        return write(path, MemorySegment.ofArray(data), options);
+    }
+
+    /**
+     * Queues the contents of a memory segment to be written to {@code path}.
+     *
+     * <p>The segment is copied before this method returns; it may be on- or
+     * off-heap.</p>
+     *
+     * @param path the destination file (replaced if it exists)
+     * @param data the file content
+     * @param options write options
+     * @return a future completed when the file has been written
+     */
+    public CompletableFuture<Result> write(Path path, MemorySegment data, Option... options) {
+        int flags = 0;
+        for (Option option : options) {
+            flags |= option.value();
+        }
+        CompletableFuture<Result> future = new CompletableFuture<>();
+        // Native code cannot read heap arrays outside critical calls, so heap
+        // data is staged off-heap; the writer copies it again before returning
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment pathSegment = arena.allocateFrom(path.toString());
+            MemorySegment offHeap = data;
+            if (!data.isNative()) {
+                offHeap = arena.allocate(Math.max(1, data.byteSize()));
+                MemorySegment.copy(data, 0, offHeap, 0, data.byteSize());
+                offHeap = offHeap.asSlice(0, data.byteSize());
+            }
+            synchronized (this) {
+                if (closing) {
+                    return CompletableFuture.failedFuture(new IllegalStateException("FrameWriter is closed"));
+                }
+                long cookie = nextCookie.getAndIncrement();
+                inFlight.put(cookie, new Pending(path, future));
+                int result = Native.writerSubmit(handle, pathSegment, offHeap, cookie, flags);
+                if (result != 0) {
+                    inFlight.remove(cookie);
+                    future.completeExceptionally(LibCameraException.forOperation("Submit write of " + path, result));
+                }
+            }
+        }
+        return future;
+    }
+
+    private void pollCompletions() {
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment batch = arena.allocate(Native.WRITE_COMPLETION_SIZE * POLL_BATCH, 8);
+            while (!(closing && inFlight.isEmpty())) {
+                int n = Native.writerPoll(handle, batch, POLL_BATCH, POLL_TIMEOUT_MS);
+                if (n < 0) {
+                    break;
+                }
+                for (int i = 0; i < n; i++) {
+                    long base = i * Native.WRITE_COMPLETION_SIZE;
+                    long cookie = batch.get(JAVA_LONG, base);
+                    long bytes = batch.get(JAVA_LONG, base + 8);
+                    long latencyNs = batch.get(JAVA_LONG, base + 16);
+                    int status = batch.get(JAVA_INT, base + 24);
+                    Pending pending = inFlight.remove(cookie);
+                    if (pending == null) {
+                        continue;
+                    }
+                    if (status == 0) {
+                        pending.future().complete(new Result(pending.path(), bytes, Duration.ofNanos(latencyNs)));
+                    } else {
+                        pending.future().completeExceptionally(
+                                LibCameraException.forOperation("Write of " + pending.path(), status));
+                    }
+                }
+            }
+        } catch (RuntimeException e) {
+            failAll(e);
+            return;
+        }
+        failAll(new LibCameraException("Frame writer stopped"));
+    }
+
+    private void failAll(Throwable cause) {
+        inFlight.values().forEach(p -> p.future().completeExceptionally(cause));
+        inFlight.clear();
+    }
+
+    /**
+     * Waits for all pending writes to finish and releases the native writer.
+     */
+    @Override
+    public void close() {
+        synchronized (this) {
+            if (closed) {
+                return;
+            }
+            closed = true;
+            closing = true;
+        }
+        try {
+            poller.join();
+        } catch (InterruptedException e) {
+            Thread.currentThread().interrupt();
+        }
+        Native.writerDestroy(handle);
+    }
+}
@@ -6,7 +6,12 @@ import java.time.Duration;
  * Contains EXIF-like metadata for a captured image.
  *
  * <p>This record holds various camera settings and sensor data that was used
- * or measured during image capture, similar to EXIF data in standard image files.</p>
+ * or measured during image capture, similar to EXIF data in standard image files.
+ * Captures that measure the frame itself also carry its luma {@link FrameStats}
+ * ({@code stats} is null otherwise). {@code frames} is the number of frames
+ * merged into the image, 1 unless it was captured as a burst or an exposure
+ * bracket. {@code waterline} is the {@link Waterline} found in captures that
+ * look for one, null otherwise.</p>
  */
 public record ImageMetadata(
     long timestamp,
@@ -20,7 +25,10 @@ public record ImageMetadata(
     double lux,
     int width,
     int height,
-    String pixelFormat
+    String pixelFormat,
+    FrameStats stats,
+    int frames,
+    Waterline waterline
 ) {
     /**
      * Returns the total gain (analogue × digital).
@@ -69,7 +77,18 @@ public record ImageMetadata(
      * @return metadata with default values
      */
     public static ImageMetadata unknown() {
-        return new ImageMetadata(0, 0, Duration.ZERO, 1.0, 1.0, 1.0, 1.0, 0, 0.0, 0, 0, "unknown");
+        return new ImageMetadata(0, 0, Duration.ZERO, 1.0, 1.0, 1.0, 1.0, 0, 0.0, 0, 0, "unknown", null, 1, null);
+    }
+
+    /**
+     * Returns a copy of this metadata with the given frame statistics.
+     *
+     * @param stats the statistics of the frame, or null
+     * @return metadata with {@code stats}
+     */
+    public ImageMetadata withStats(FrameStats stats) {
+        return new ImageMetadata(timestamp, sequence, exposureTime, analogueGain, digitalGain,
+            redGain, blueGain, colourTemperature, lux, width, height, pixelFormat, stats, frames, waterline);
     }
 
     /**
@@ -88,6 +107,9 @@ public record ImageMetadata(
         private int width;
         private int height;
         private String pixelFormat = "unknown";
+        private FrameStats stats;
+        private int frames = 1;
+        private Waterline waterline;
 
         public Builder timestamp(long timestamp) {
             this.timestamp = timestamp;
@@ -150,10 +172,25 @@ public record ImageMetadata(
             return this;
         }
 
+        public Builder stats(FrameStats stats) {
+            this.stats = stats;
+            return this;
+        }
+
+        public Builder frames(int frames) {
+            this.frames = frames;
+            return this;
+        }
+
+        public Builder waterline(Waterline waterline) {
+            this.waterline = waterline;
+            return this;
+        }
+
         public ImageMetadata build() {
             return new ImageMetadata(
                 timestamp, sequence, exposureTime, analogueGain, digitalGain,
-                redGain, blueGain, colourTemperature, lux, width, height, pixelFormat
+                redGain, blueGain, colourTemperature, lux, width, height, pixelFormat, stats, frames, waterline
             );
         }
     }
@@ -0,0 +1,157 @@
+package in.virit.libcamera4j;
+
+import java.lang.foreign.Arena;
+import java.lang.foreign.MemorySegment;
+import java.nio.file.Path;
+import java.time.Instant;
+import java.time.LocalDateTime;
+import java.time.ZoneId;
+import java.time.format.DateTimeFormatter;
+
+import static java.lang.foreign.ValueLayout.JAVA_INT;
+import static java.lang.foreign.ValueLayout.JAVA_LONG;
+
+/**
+ * The images of a {@code root/yyyy/MM/dd/yyyyMMdd_HHmmss.jpg} directory tree,
+ * as saved before {@link FrameStore} existed.
+ *
+ * <p>The tree is read natively: day directories are listed in parallel with
+ * {@code openat}/{@code getdents64} and file names are parsed without creating
+ * a {@link Path} or {@code String} per file. The result is a few packed arrays,
+ * sorted by timestamp; {@link #path(int)} builds a file's path on demand.</p>
+ *
+ * <pre>{@code
+ * ImageScan scan = ImageScan.scan(Path.of("timelapse"));
+ * for (int i = 0; i < scan.size(); i++) {
+ *     store.append(scan.timestampMs(i), Files.readAllBytes(scan.path(i)));
+ * }
+ * }</pre>
+ *
+ * <p>Timestamps are the local time of the file name as milliseconds since the
+ * epoch. Entries that do not match the layout are ignored.</p>
+ */
+public final class ImageScan {
+
+    static {
+        NativeLoader.load();
+    }
+
+    // Layout of lc4j_scan_entry
+    private static final long ENTRY_SIZE_OFFSET = 8;
+    private static final long ENTRY_DIR_OFFSET = 16;
+
+    private static final DateTimeFormatter FILE_FORMAT = DateTimeFormatter.ofPattern("yyyyMMdd_HHmmss");
+
+    private final Path root;
+    private final long[] timestamps;
+    private final long[] sizes;
+    private final int[] dirIds;
+    private final String[] dirs;
+
+    private ImageScan(Path root, long[] timestamps, long[] sizes, int[] dirIds, String[] dirs) {
+        this.root = root;
+        this.timestamps = timestamps;
+        this.sizes = sizes;
+        this.dirIds = dirIds;
+        this.dirs = dirs;
+    }
+
+    /**
+     * Scans {@code root} using one thread per CPU.
+     *
+     * @param root the tree's root directory
+     * @return the images found
+     * @throws LibCameraException if the root directory cannot be read
+     */
+    public static ImageScan scan(Path root) {
+        return scan(root, 0);
+    }
+
+    /**
+     * Scans {@code root}.
+     *
+     * @param root the tree's root directory
+     * @param threads number of threads reading day directories, or 0 for one per CPU
+     * @return the images found
+     * @throws LibCameraException if the root directory cannot be read
+     */
+    public static ImageScan scan(Path root, int threads) {
+        long handle = Native.scanOpen(root.toString(), threads);
+        if (handle == 0) {
+            throw new LibCameraException("Failed to scan " + root);
+        }
+        try (Arena arena = Arena.ofConfined()) {
+            int count = Native.scanCount(handle);
+            MemorySegment packed = arena.allocate(Math.max(1, count * Native.SCAN_ENTRY_SIZE), 8);
+            count = Native.scanEntries(handle, packed, count);
+            if (count < 0) {
+                throw LibCameraException.forOperation("Image scan", count);
+            }
+            long[] timestamps = new long[count];
+            long[] sizes = new long[count];
+            int[] dirIds = new int[count];
+            for (int i = 0; i < count; i++) {
+                long base = i * Native.SCAN_ENTRY_SIZE;
+                timestamps[i] = packed.get(JAVA_LONG, base);
+                sizes[i] = packed.get(JAVA_LONG, base + ENTRY_SIZE_OFFSET);
+                dirIds[i] = packed.get(JAVA_INT, base + ENTRY_DIR_OFFSET);
+            }
+            String[] dirs = new String[Native.scanDirCount(handle)];
+            for (int i = 0; i < dirs.length; i++) {
+                dirs[i] = Native.scanDir(handle, i);
+            }
+            return new ImageScan(root, timestamps, sizes, dirIds, dirs);
+        } finally {
+            Native.scanClose(handle);
+        }
+    }
+
+    /**
+     * Returns the number of images found.
+     *
+     * @return the image count
+     */
+    public int size() {
+        return timestamps.length;
+    }
+
+    /**
+     * Returns an image's timestamp.
+     *
+     * @param i image number, in timestamp order
+     * @return the timestamp in milliseconds
+     */
+    public long timestampMs(int i) {
+        return timestamps[i];
+    }
+
+    /**
+     * Returns an image's file size.
+     *
+     * @param i image number, in timestamp order
+     * @return the size in bytes
+     */
+    public long fileSize(int i) {
+        return sizes[i];
+    }
+
+    /**
+     * Returns an image's path.
+     *
+     * @param i image number, in timestamp order
+     * @return the file's path under the scanned root
+     */
+    public Path path(int i) {
+        LocalDateTime time = LocalDateTime.ofInstant(Instant.ofEpochMilli(timestamps[i]), ZoneId.systemDefault());
+        return root.resolve(dirs[dirIds[i]]).resolve(time.format(FILE_FORMAT) + ".jpg");
+    }
+
+    /**
+     * Returns the day directories found, relative to the root.
+     *
+     * @return the directories, e.g. {@code 2026/01/01}
+     */
+    public String[] directories() {
+        return dirs.clone();
+    }
+}
@@ -0,0 +1,116 @@
+package in.virit.libcamera4j;
+
+import java.lang.foreign.MemorySegment;
+import java.time.Duration;
+import java.util.LinkedHashMap;
+import java.util.Map;
+
+import static java.lang.foreign.ValueLayout.JAVA_LONG;
+
+/**
+ * The distribution of one latency of a {@link CaptureSession}'s captures,
+ * for the tail that sums and means hide.
+ *
+ * <p>Kept natively in log-linear buckets of microseconds, 16 per doubling,
+ * so any {@linkplain #percentile(double) percentile} is known to within a
+ * sixteenth. Read with {@link CaptureSession#latencyHistogram(Kind, boolean)};
+ * histograms of several reads or sessions add up with
+ * {@link #plus(LatencyHistogram)}.</p>
+ *
+ * @param count the latencies recorded
+ * @param maxNs the longest of them, in nanoseconds
+ * @param buckets the count in each bucket
+ */
+public record LatencyHistogram(long count, long maxNs, long[] buckets) {
+
+    /** Number of buckets, the last of which also holds everything beyond. */
+    public static final int BUCKETS = 480;
+
+    /** Percentiles of {@link #percentiles()}. */
+    private static final double[] TABLE = {50, 90, 99, 99.9};
+
+    /**
+     * The latencies kept as histograms.
+     */
+    public enum Kind {
+        /** From queueing a request to its completion. */
+        QUEUE_TO_COMPLETE,
+        /** From a request completing to the capture picking it up. */
+        COMPLETE_TO_CONSUMER,
+        /** Whole captures, failed ones included, so that request timeouts show. */
+        CAPTURE
+    }
+
+    /** No latencies recorded. */
+    public static LatencyHistogram empty() {
+        return new LatencyHistogram(0, 0, new long[BUCKETS]);
+    }
+
+    /** Both histograms added up. */
+    public LatencyHistogram plus(LatencyHistogram other) {
+        long[] sum = new long[BUCKETS];
+        for (int i = 0; i < BUCKETS; i++) {
+            sum[i] = buckets[i] + other.buckets[i];
+        }
+        return new LatencyHistogram(count + other.count, Math.max(maxNs, other.maxNs), sum);
+    }
+
+    /**
+     * The latency that {@code percent} of those recorded did not exceed: the
+     * upper end of its bucket, or the longest recorded if that is shorter.
+     *
+     * @param percent 0-100
+     * @return the latency, zero if none were recorded
+     */
+    public Duration percentile(double percent) {
+        long total = 0;
+        for (long bucket : buckets) {
+            total += bucket;
+        }
+        if (total == 0) {
+            return Duration.ZERO;
+        }
+        long rank = Math.max(1, (long) Math.ceil(total * Math.clamp(percent, 0, 100) / 100));
+        long seen = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                long upperNs = i + 1 < BUCKETS ? bucketStartUs(i + 1) * 1000 - 1 : maxNs;
+                return Duration.ofNanos(Math.min(upperNs, maxNs));
+            }
+        }
+        return Duration.ofNanos(maxNs);
+    }
+
+    /**
+     * The median, 90th, 99th and 99.9th percentiles and the maximum, keyed by
+     * name ("p50" … "max") in that order.
+     */
+    public Map<String, Duration> percentiles() {
+        Map<String, Duration> table = new LinkedHashMap<>();
+        for (double percent : TABLE) {
+            String name = percent == Math.rint(percent) ? String.valueOf((int) percent) : String.valueOf(percent);
+            table.put("p" + name, percentile(percent));
+        }
+        table.put("max", Duration.ofNanos(maxNs));
+        return table;
+    }
+
+    /**
+     * The smallest latency, in microseconds, counted in bucket {@code index}.
+     */
+    static long bucketStartUs(int index) {
+        return index < 32 ? index : (16L + index % 16) << (index / 16 - 1);
+    }
+
+    /**
+     * Reads an {@code lc4j_latency_histogram}.
+     */
+    static LatencyHistogram read(MemorySegment histogram) {
+        long[] buckets = new long[BUCKETS];
+        for (int i = 0; i < BUCKETS; i++) {
+            buckets[i] = histogram.get(JAVA_LONG, 16 + 8L * i);
+        }
+        return new LatencyHistogram(histogram.get(JAVA_LONG, 0), histogram.get(JAVA_LONG, 8), buckets);
+    }
+}
@@ -64,9 +64,14 @@ public class LibCameraException extends RuntimeException {
             case -12 -> operation + " failed: Out of memory";
             case -13 -> operation + " failed: Permission denied";
             case -16 -> operation + " failed: Device or resource busy";
+            case -17 -> operation + " failed: File exists";
             case -19 -> operation + " failed: No such device";
+            case -20 -> operation + " failed: Not a directory";
             case -22 -> operation + " failed: Invalid argument";
             case -28 -> operation + " failed: No space left on device";
+            case -30 -> operation + " failed: Read-only file system";
+            case -95 -> operation + " failed: Operation not supported";
+            case -110 -> operation + " failed: Timed out";
             default -> operation + " failed with error code " + errorCode;
         };
         return new LibCameraException(message, errorCode);
@@ -28,7 +28,10 @@ import java.lang.foreign.MemorySegment;
  */
 public final class MappedFrame implements AutoCloseable {
 
+    private static final int ENOTSUP = -95;
+
     private final long mapHandle;
+    private final StreamConfiguration stream;
     private final Arena arena;
     private final MemorySegment[] planes;
     private final long totalSize;
@@ -41,6 +44,7 @@ public final class MappedFrame implements AutoCloseable {
         if (mapHandle == 0) {
             throw new LibCameraException("Failed to map buffer");
         }
+        this.stream = configuration.get(streamIndex);
 
         // A shared arena: the segments may be read from any thread (libcamera
         // completes requests on its own thread). The arena scope governs segment
@@ -116,6 +120,38 @@ public final class MappedFrame implements AutoCloseable {
         return totalSize;
     }
 
+    /**
+     * Computes the luma histogram and exposure statistics of the frame
+     * natively, straight from the mapping.
+     *
+     * @param zonesX number of zone columns, 1 to {@link FrameStats#MAX_ZONES}
+     * @param zonesY number of zone rows, 1 to {@link FrameStats#MAX_ZONES}
+     * @return the statistics, or null if the pixel format has no luma or green
+     *         plane to measure (such as raw Bayer)
+     * @throws LibCameraException if the arguments are invalid
+     */
+    public FrameStats statistics(int zonesX, int zonesY) {
+        if (closed) {
+            throw new IllegalStateException("MappedFrame is closed");
+        }
+        try (Arena confined = Arena.ofConfined()) {
+            MemorySegment out = confined.allocate(Native.FRAME_STATS_SIZE, 8);
+            int result = Native.frameComputeStats(planes[0], stream.pixelFormat().fourcc(),
+                    stream.size().width(), stream.size().height(), stream.stride(), zonesX, zonesY, out);
+            if (result == ENOTSUP) {
+                return null;
+            }
+            if (result != 0) {
+                throw LibCameraException.forOperation("Frame statistics", result);
+            }
+            return FrameStats.read(out);
+        }
+    }
+
+    StreamConfiguration stream() {
+        return stream;
+    }
+
     @Override
     public void close() {
         if (closed) {
@@ -0,0 +1,297 @@
+package in.virit.libcamera4j;
+
+import java.lang.foreign.Arena;
+import java.lang.foreign.MemorySegment;
+import java.time.Duration;
+import java.util.ArrayList;
+import java.util.List;
+
+import static java.lang.foreign.ValueLayout.JAVA_BYTE;
+import static java.lang.foreign.ValueLayout.JAVA_FLOAT;
+import static java.lang.foreign.ValueLayout.JAVA_INT;
+import static java.lang.foreign.ValueLayout.JAVA_LONG;
+
+/**
+ * Detects motion in a stream of small frames, natively.
+ *
+ * <p>Each frame's luma is averaged down to a grid of at most 160x160 cells and
+ * compared with a slowly learning background. Changed cells are cleaned up
+ * with a 3x3 morphological opening and grouped into blobs; blobs large enough
+ * in a few consecutive frames raise a {@link MotionEvent}, after which the
+ * detector stays quiet for a while. A sudden change of most of the frame, such
+ * as the exposure jumping, resets the background instead of raising an event.
+ * Regions that always move, such as a water surface, can be left out with an
+ * {@linkplain #setIgnoreMask(byte[], int, int) ignore mask}.</p>
+ *
+ * <p>With a {@linkplain #setSchedule(Schedule) schedule} the detector also
+ * says when to capture next, following the scene rather than the clock: it
+ * raises an event when the frame's perceptual hash, the one a
+ * {@link FrameStore} tags frames with, has drifted far enough from that of the
+ * last scheduled event, or when none has been raised for too long.</p>
+ *
+ * <p>Frames come either from a {@link CaptureSession} monitoring a
+ * low-resolution stream between its captures, entirely natively, or from
+ * {@link #process(MappedFrame, long, long)}:</p>
+ *
+ * <pre>{@code
+ * try (MotionDetector detector = MotionDetector.create(MotionDetector.Params.defaults())) {
+ *     session.startMonitor(detector, 320, 240);
+ *     for (MotionEvent event : detector.poll(Duration.ofSeconds(1))) {
+ *         session.captureToStore(store, System.currentTimeMillis(), 90);
+ *     }
+ * }
+ * }</pre>
+ */
+public final class MotionDetector implements AutoCloseable {
+
+    static {
+        NativeLoader.load();
+    }
+
+    /** Largest number of boxes reported per event. */
+    public static final int MAX_BOXES = 8;
+
+    private static final int POLL_BATCH = 16;
+
+    // Layout of lc4j_motion_event
+    private static final long EVENT_TIMESTAMP = 8;
+    private static final long EVENT_CHANGED = 16;
+    private static final long EVENT_BOX_COUNT = 20;
+    private static final long EVENT_BOXES = 24;
+    private static final long BOX_SIZE = 16;
+    private static final long EVENT_TRIGGER = 152;
+    private static final long EVENT_HASH_DISTANCE = 156;
+
+    /**
+     * Detection parameters.
+     *
+     * @param threshold luma difference from the background, 0-255, that counts as a change
+     * @param learnShift the background moves 1/2^learnShift of the way to each frame, 1-8
+     * @param minAreaPermille smallest blob that counts, in thousandths of the frame area
+     * @param triggerFrames consecutive frames with motion that raise an event
+     * @param holdoffFrames frames after an event during which no other is raised
+     */
+    public record Params(int threshold, int learnShift, int minAreaPermille, int triggerFrames, int holdoffFrames) {
+
+        /**
+         * Returns the defaults: threshold 20, learnShift 4, 2 permille, 2
+         * trigger frames and 25 holdoff frames.
+         *
+         * @return the default parameters
+         */
+        public static Params defaults() {
+            return new Params(20, 4, 2, 2, 25);
+        }
+
+        /**
+         * Returns a copy with another change threshold.
+         *
+         * @param threshold luma difference that counts as a change
+         * @return the new parameters
+         */
+        public Params withThreshold(int threshold) {
+            return new Params(threshold, learnShift, minAreaPermille, triggerFrames, holdoffFrames);
+        }
+
+        /**
+         * Returns a copy with another smallest blob size.
+         *
+         * @param minAreaPermille smallest blob, in thousandths of the frame area
+         * @return the new parameters
+         */
+        public Params withMinAreaPermille(int minAreaPermille) {
+            return new Params(threshold, learnShift, minAreaPermille, triggerFrames, holdoffFrames);
+        }
+    }
+
+    /**
+     * When scheduled events are raised.
+     *
+     * @param hashDistance bits of the 64-bit perceptual hash that must change
+     *                     for a scene change, 0-63
+     * @param minInterval shortest time between scene changes
+     * @param maxInterval longest time between scheduled events, at least
+     *                    {@code minInterval}
+     */
+    public record Schedule(int hashDistance, Duration minInterval, Duration maxInterval) {
+    }
+
+    private final long handle;
+    private volatile boolean closed;
+
+    private MotionDetector(long handle) {
+        this.handle = handle;
+    }
+
+    /**
+     * Creates a detector.
+     *
+     * @param params the detection parameters
+     * @return the new detector
+     */
+    public static MotionDetector create(Params params) {
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment p = arena.allocate(Native.MOTION_PARAMS_SIZE, 4);
+            p.set(JAVA_INT, 0, params.threshold());
+            p.set(JAVA_INT, 4, params.learnShift());
+            p.set(JAVA_INT, 8, params.minAreaPermille());
+            p.set(JAVA_INT, 12, params.triggerFrames());
+            p.set(JAVA_INT, 16, params.holdoffFrames());
+            long handle = Native.motionCreate(p);
+            if (handle == 0) {
+                throw new LibCameraException("Failed to create motion detector");
+            }
+            return new MotionDetector(handle);
+        }
+    }
+
+    /**
+     * Sets the regions to ignore. The mask is stretched over the frame, so any
+     * grid works, from a few cells to one byte per pixel.
+     *
+     * @param mask one byte per cell, row-major; non-zero cells are ignored
+     * @param width mask columns
+     * @param height mask rows
+     * @throws LibCameraException if the mask size is invalid
+     */
+    public void setIgnoreMask(byte[] mask, int width, int height) {
+        ensureOpen();
+        if (mask.length < width * height) {
+            throw new IllegalArgumentException("Mask has " + mask.length + " cells, needs " + width * height);
+        }
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment m = arena.allocate(mask.length);
+            MemorySegment.copy(mask, 0, m, JAVA_BYTE, 0, mask.length);
+            int result = Native.motionSetMask(handle, m, width, height);
+            if (result != 0) {
+                throw LibCameraException.forOperation("Set ignore mask", result);
+            }
+        }
+    }
+
+    /**
+     * Removes the ignore mask.
+     */
+    public void clearIgnoreMask() {
+        ensureOpen();
+        Native.motionSetMask(handle, MemorySegment.NULL, 0, 0);
+    }
+
+    /**
+     * Sets when to raise scheduled events. The first frame after this is
+     * always due.
+     *
+     * @param schedule the schedule, or null (the default) for motion events only
+     * @throws LibCameraException if the schedule is out of range
+     */
+    public void setSchedule(Schedule schedule) {
+        ensureOpen();
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment s = MemorySegment.NULL;
+            if (schedule != null) {
+                s = arena.allocate(Native.SCENE_SCHEDULE_SIZE, 4);
+                s.set(JAVA_INT, 0, schedule.hashDistance());
+                s.set(JAVA_INT, 4, (int) Math.min(Integer.MAX_VALUE, schedule.minInterval().toMillis()));
+                s.set(JAVA_INT, 8, (int) Math.min(Integer.MAX_VALUE, schedule.maxInterval().toMillis()));
+            }
+            int result = Native.motionSetSchedule(handle, s);
+            if (result != 0) {
+                throw LibCameraException.forOperation("Set scene schedule", result);
+            }
+        }
+    }
+
+    /**
+     * Feeds a frame to the detector, straight from its mapping.
+     *
+     * @param frame a YUV or RGB frame
+     * @param sequence the frame's sequence number, reported in events
+     * @param timestampNs the frame's timestamp, reported in events
+     * @return whether the frame raised an event, of motion or of the schedule
+     * @throws LibCameraException if the pixel format has no luma or green plane
+     */
+    public boolean process(MappedFrame frame, long sequence, long timestampNs) {
+        ensureOpen();
+        StreamConfiguration stream = frame.stream();
+        int result = Native.motionProcess(handle, frame.plane(0), stream.pixelFormat().fourcc(),
+                stream.size().width(), stream.size().height(), stream.stride(), sequence, timestampNs);
+        if (result < 0) {
+            throw LibCameraException.forOperation("Motion detection", result);
+        }
+        return result == 1;
+    }
+
+    /**
+     * Waits for motion events.
+     *
+     * @param timeout how long to wait if none is queued; zero returns at once
+     * @return the queued events, oldest first; empty on timeout or once the
+     *         detector has been closed
+     */
+    public List<MotionEvent> poll(Duration timeout) {
+        ensureOpen();
+        List<MotionEvent> events = new ArrayList<>();
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment out = arena.allocate(POLL_BATCH * Native.MOTION_EVENT_SIZE, 8);
+            int timeoutMs = (int) Math.min(Integer.MAX_VALUE, timeout.toMillis());
+            int count = Native.motionPoll(handle, out, POLL_BATCH, timeoutMs);
+            for (int i = 0; i < count; i++) {
+                events.add(readEvent(out.asSlice(i * Native.MOTION_EVENT_SIZE, Native.MOTION_EVENT_SIZE)));
+            }
+        }
+        return events;
+    }
+
+    /**
+     * Returns an eventfd that is readable while events are queued, for
+     * integration into an existing poll loop; {@link #poll(Duration)} resets
+     * it once the queue is empty. Owned by the detector.
+     *
+     * @return the file descriptor
+     */
+    public int eventFd() {
+        ensureOpen();
+        return Native.motionEventFd(handle);
+    }
+
+    long handle() {
+        ensureOpen();
+        return handle;
+    }
+
+    private static MotionEvent readEvent(MemorySegment event) {
+        int count = Math.min(MAX_BOXES, event.get(JAVA_INT, EVENT_BOX_COUNT));
+        List<Rectangle> boxes = new ArrayList<>(count);
+        for (int i = 0; i < count; i++) {
+            long base = EVENT_BOXES + i * BOX_SIZE;
+            boxes.add(new Rectangle(event.get(JAVA_INT, base), event.get(JAVA_INT, base + 4),
+                    event.get(JAVA_INT, base + 8), event.get(JAVA_INT, base + 12)));
+        }
+        MotionEvent.Trigger trigger = switch (event.get(JAVA_INT, EVENT_TRIGGER)) {
+            case 1 -> MotionEvent.Trigger.SCENE_CHANGE;
+            case 2 -> MotionEvent.Trigger.INTERVAL;
+            default -> MotionEvent.Trigger.MOTION;
+        };
+        return new MotionEvent(event.get(JAVA_LONG, 0), event.get(JAVA_LONG, EVENT_TIMESTAMP),
+                event.get(JAVA_FLOAT, EVENT_CHANGED), List.copyOf(boxes), trigger,
+                event.get(JAVA_INT, EVENT_HASH_DISTANCE));
+    }
+
+    private void ensureOpen() {
+        if (closed) {
+            throw new IllegalStateException("MotionDetector is closed");
+        }
+    }
+
+    /**
+     * Closes the detector. A session monitoring for it stops, and a pending
+     * {@link #poll(Duration)} returns.
+     */
+    @Override
+    public synchronized void close() {
+        if (!closed) {
+            closed = true;
+            Native.motionClose(handle);
+        }
+    }
+}
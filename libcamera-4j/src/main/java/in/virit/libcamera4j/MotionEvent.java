@@ -0,0 +1,44 @@
+package in.virit.libcamera4j;
+
+import java.util.List;
+
+/**
+ * Motion seen by a {@link MotionDetector}, or a capture its
+ * {@linkplain MotionDetector#setSchedule(MotionDetector.Schedule) schedule}
+ * says is due.
+ *
+ * @param sequence sequence number of the frame that raised the event
+ * @param timestampNs sensor timestamp of that frame in nanoseconds
+ * @param changedPercent percentage of the frame area covered by moving blobs,
+ *                       0 for scheduled events
+ * @param boxes bounding boxes of the largest blobs in frame pixels, largest
+ *              first, at most {@link MotionDetector#MAX_BOXES}; none for
+ *              scheduled events
+ * @param trigger what raised the event
+ * @param hashDistance bits of the frame's perceptual hash that differ from
+ *                     the frame of the previous scheduled event, -1 for motion
+ */
+public record MotionEvent(long sequence, long timestampNs, double changedPercent, List<Rectangle> boxes,
+                          Trigger trigger, int hashDistance) {
+
+    /**
+     * What raised a {@link MotionEvent}.
+     */
+    public enum Trigger {
+        /** Moving blobs. */
+        MOTION,
+        /** The scene changed since the last scheduled event. */
+        SCENE_CHANGE,
+        /** The schedule's longest interval passed, or it just started. */
+        INTERVAL
+    }
+
+    /**
+     * Returns whether the schedule raised the event, rather than motion.
+     *
+     * @return true for scene changes and intervals
+     */
+    public boolean scheduled() {
+        return trigger != Trigger.MOTION;
+    }
+}
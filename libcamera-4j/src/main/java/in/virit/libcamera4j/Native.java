@@ -33,10 +33,10 @@ final class Native {
     private Native() {
     }
 
-    private static MethodHandle h(String name, FunctionDescriptor descriptor) {
+    private static MethodHandle h(String name, FunctionDescriptor descriptor, Linker.Option... options) {
         MemorySegment symbol = LOOKUP.find(name)
                 .orElseThrow(() -> new UnsatisfiedLinkError("Missing native symbol: " + name));
-        return LINKER.downcallHandle(symbol, descriptor);
+        return LINKER.downcallHandle(symbol, descriptor, options);
     }
 
     private static RuntimeException wrap(Throwable t) {
@@ -138,6 +138,11 @@ final class Native {
     private static final MethodHandle CAM_START = h("lc4j_cam_start", FunctionDescriptor.of(JAVA_INT, JAVA_LONG));
     private static final MethodHandle CAM_STOP = h("lc4j_cam_stop", FunctionDescriptor.ofVoid(JAVA_LONG));
     private static final MethodHandle CAM_POLL = h("lc4j_cam_poll_completed_request", FunctionDescriptor.of(JAVA_LONG, JAVA_LONG));
+    private static final MethodHandle CAM_SEQUENCE_STATS = h("lc4j_cam_sequence_stats",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, JAVA_LONG, JAVA_INT, ADDRESS, JAVA_INT));
+
+    /** Size in bytes of an {@code lc4j_sequence_stats}. */
+    static final long SEQUENCE_STATS_SIZE = 88;
 
     static int camAcquire(long handle) {
         try {
@@ -217,6 +222,14 @@ final class Native {
         }
     }
 
+    static int camSequenceStats(long handle, long configHandle, int streamIndex, MemorySegment out, boolean reset) {
+        try {
+            return (int) CAM_SEQUENCE_STATS.invokeExact(handle, configHandle, streamIndex, out, reset ? 1 : 0);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
     // ---- CameraConfiguration ----
     private static final MethodHandle CFG_DESTROY = h("lc4j_config_destroy", FunctionDescriptor.ofVoid(JAVA_LONG));
     private static final MethodHandle CFG_SIZE = h("lc4j_config_size", FunctionDescriptor.of(JAVA_INT, JAVA_LONG));
@@ -578,4 +591,760 @@ final class Native {
             throw wrap(t);
         }
     }
+
+    // ---- FrameWriter ----
+    // Submit copies the data into a native allocation and takes the writer's
+    // locks, so it is not a critical call; the data is passed off-heap.
+    private static final MethodHandle WRITER_CREATE = h("lc4j_writer_create", FunctionDescriptor.of(JAVA_LONG, JAVA_INT, JAVA_INT));
+    private static final MethodHandle WRITER_DESTROY = h("lc4j_writer_destroy", FunctionDescriptor.ofVoid(JAVA_LONG));
+    private static final MethodHandle WRITER_BACKEND = h("lc4j_writer_backend", FunctionDescriptor.of(JAVA_INT, JAVA_LONG));
+    private static final MethodHandle WRITER_SUBMIT = h("lc4j_writer_submit",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, ADDRESS, ADDRESS, JAVA_LONG, JAVA_LONG, JAVA_INT));
+    private static final MethodHandle WRITER_POLL = h("lc4j_writer_poll", FunctionDescriptor.of(JAVA_INT, JAVA_LONG, ADDRESS, JAVA_INT, JAVA_INT));
+    private static final MethodHandle WRITER_PENDING = h("lc4j_writer_pending", FunctionDescriptor.of(JAVA_INT, JAVA_LONG));
+
+    /** Size in bytes of one {@code lc4j_write_completion}. */
+    static final long WRITE_COMPLETION_SIZE = 32;
+
+    static long writerCreate(int queueDepth, int flags) {
+        try {
+            return (long) WRITER_CREATE.invokeExact(queueDepth, flags);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static void writerDestroy(long handle) {
+        try {
+            WRITER_DESTROY.invokeExact(handle);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int writerBackend(long handle) {
+        try {
+            return (int) WRITER_BACKEND.invokeExact(handle);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int writerSubmit(long handle, MemorySegment path, MemorySegment data, long cookie, int flags) {
+        try {
+            return (int) WRITER_SUBMIT.invokeExact(handle, path, data, data.byteSize(), cookie, flags);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int writerPoll(long handle, MemorySegment out, int max, int timeoutMs) {
+        try {
+            return (int) WRITER_POLL.invokeExact(handle, out, max, timeoutMs);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int writerPending(long handle) {
+        try {
+            return (int) WRITER_PENDING.invokeExact(handle);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    // ---- CaptureSession ----
+    private static final MethodHandle SESSION_OPEN = h("lc4j_session_open", FunctionDescriptor.of(JAVA_LONG, JAVA_INT, JAVA_INT, JAVA_INT));
+    private static final MethodHandle SESSION_CLOSE = h("lc4j_session_close", FunctionDescriptor.ofVoid(JAVA_LONG));
+    private static final MethodHandle SESSION_SET_TRANSFORM = h("lc4j_session_set_transform", FunctionDescriptor.ofVoid(JAVA_LONG, JAVA_INT));
+    private static final MethodHandle SESSION_SET_CONTROLS = h("lc4j_session_set_controls",
+            FunctionDescriptor.ofVoid(JAVA_LONG, JAVA_INT, JAVA_FLOAT, JAVA_INT, JAVA_INT, JAVA_FLOAT));
+    private static final MethodHandle SESSION_SET_STATS_GRID = h("lc4j_session_set_stats_grid",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, JAVA_INT, JAVA_INT));
+    private static final MethodHandle SESSION_SET_BURST = h("lc4j_session_set_burst",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, JAVA_INT, JAVA_INT));
+    private static final MethodHandle SESSION_SET_BRACKET = h("lc4j_session_set_bracket",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, ADDRESS, JAVA_INT));
+    private static final MethodHandle SESSION_SET_DENOISE = h("lc4j_session_set_denoise",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, JAVA_FLOAT, JAVA_FLOAT));
+    private static final MethodHandle SESSION_SET_WATERLINE = h("lc4j_session_set_waterline",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, ADDRESS));
+    private static final MethodHandle SESSION_FOCUS_SWEEP = h("lc4j_session_focus_sweep",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, ADDRESS, ADDRESS));
+    private static final MethodHandle SESSION_MONITOR_START = h("lc4j_session_monitor_start",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, JAVA_LONG, JAVA_INT, JAVA_INT));
+    private static final MethodHandle SESSION_MONITOR_STOP = h("lc4j_session_monitor_stop", FunctionDescriptor.ofVoid(JAVA_LONG));
+    private static final MethodHandle CAPTURE_TO_FILE = h("lc4j_capture_to_file",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, ADDRESS, JAVA_INT, JAVA_INT, ADDRESS));
+    private static final MethodHandle CAPTURE_TO_STORE = h("lc4j_capture_to_store",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, JAVA_LONG, JAVA_LONG, JAVA_INT, ADDRESS));
+    private static final MethodHandle CAPTURE_TO_STORE_TIERS = h("lc4j_capture_to_store_tiers",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, JAVA_LONG, JAVA_LONG, JAVA_INT, ADDRESS, JAVA_INT, ADDRESS));
+    private static final MethodHandle CAPTURE_TO_DNG_STREAM = h("lc4j_capture_to_dng_stream",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, ADDRESS, ADDRESS));
+    private static final MethodHandle STATS_SNAPSHOT = h("lc4j_stats_snapshot",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, ADDRESS, JAVA_INT));
+    private static final MethodHandle HISTOGRAM_SNAPSHOT = h("lc4j_histogram_snapshot",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, JAVA_INT, ADDRESS, JAVA_INT));
+    private static final MethodHandle SESSION_SEQUENCE_STATS = h("lc4j_session_sequence_stats",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, JAVA_INT, ADDRESS, JAVA_INT));
+
+    /** Size in bytes of one {@code lc4j_capture_result}. */
+    static final long CAPTURE_RESULT_SIZE = 2200;
+
+    /** Offset of the {@code lc4j_frame_stats} in an {@code lc4j_capture_result}. */
+    static final long CAPTURE_RESULT_STATS = 96;
+
+    /** Offset and size of the waterline fields of an {@code lc4j_capture_result}. */
+    static final long CAPTURE_RESULT_WATERLINE = 2184;
+    static final long CAPTURE_RESULT_WATERLINE_SIZE = 12;
+
+    /** Size in bytes of one {@code lc4j_waterline_params}. */
+    static final long WATERLINE_PARAMS_SIZE = 32;
+
+    /** Size in bytes of an {@code lc4j_focus_params}. */
+    static final long FOCUS_PARAMS_SIZE = 32;
+
+    /** Size in bytes of an {@code lc4j_focus_result}, and the offsets of its arrays. */
+    static final long FOCUS_RESULT_SIZE = 536;
+    static final long FOCUS_RESULT_POSITIONS = 24;
+    static final long FOCUS_RESULT_SHARPNESS = 280;
+
+    /** Size in bytes of one {@code lc4j_thumbnail_tier}. */
+    static final long THUMBNAIL_TIER_SIZE = 16;
+
+    /** Size in bytes of one {@code lc4j_stage_counter}, and of the {@code lc4j_stats} of all stages. */
+    static final long STAGE_COUNTER_SIZE = 32;
+    static final long STATS_SIZE = 320;
+
+    /** Size in bytes of an {@code lc4j_latency_histogram}. */
+    static final long LATENCY_HISTOGRAM_SIZE = 16 + 8L * LatencyHistogram.BUCKETS;
+
+    static long sessionOpen(int width, int height, int warmupFrames) {
+        try {
+            return (long) SESSION_OPEN.invokeExact(width, height, warmupFrames);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static void sessionClose(long handle) {
+        try {
+            SESSION_CLOSE.invokeExact(handle);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static void sessionSetTransform(long handle, int transform) {
+        try {
+            SESSION_SET_TRANSFORM.invokeExact(handle, transform);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static void sessionSetControls(long handle, int afMode, float lensPosition, boolean aeEnable,
+                                   int exposureUs, float analogueGain) {
+        try {
+            SESSION_SET_CONTROLS.invokeExact(handle, afMode, lensPosition, aeEnable ? 1 : 0, exposureUs, analogueGain);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int sessionSetStatsGrid(long handle, int zonesX, int zonesY) {
+        try {
+            return (int) SESSION_SET_STATS_GRID.invokeExact(handle, zonesX, zonesY);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int sessionSetBurst(long handle, int frames, int flags) {
+        try {
+            return (int) SESSION_SET_BURST.invokeExact(handle, frames, flags);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int sessionSetBracket(long handle, MemorySegment evStops, int count) {
+        try {
+            return (int) SESSION_SET_BRACKET.invokeExact(handle, evStops, count);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int sessionSetDenoise(long handle, float minGain, float strength) {
+        try {
+            return (int) SESSION_SET_DENOISE.invokeExact(handle, minGain, strength);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int sessionSetWaterline(long handle, MemorySegment params) {
+        try {
+            return (int) SESSION_SET_WATERLINE.invokeExact(handle, params);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int sessionFocusSweep(long handle, MemorySegment params, MemorySegment out) {
+        try {
+            return (int) SESSION_FOCUS_SWEEP.invokeExact(handle, params, out);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int statsSnapshot(long handle, MemorySegment out, boolean reset) {
+        try {
+            return (int) STATS_SNAPSHOT.invokeExact(handle, out, reset ? 1 : 0);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int histogramSnapshot(long handle, int histogram, MemorySegment out, boolean reset) {
+        try {
+            return (int) HISTOGRAM_SNAPSHOT.invokeExact(handle, histogram, out, reset ? 1 : 0);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int sessionSequenceStats(long handle, int stream, MemorySegment out, boolean reset) {
+        try {
+            return (int) SESSION_SEQUENCE_STATS.invokeExact(handle, stream, out, reset ? 1 : 0);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int sessionMonitorStart(long handle, long motionHandle, int width, int height) {
+        try {
+            return (int) SESSION_MONITOR_START.invokeExact(handle, motionHandle, width, height);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static void sessionMonitorStop(long handle) {
+        try {
+            SESSION_MONITOR_STOP.invokeExact(handle);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int captureToFile(long handle, String path, int format, int quality, MemorySegment result) {
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment p = arena.allocateFrom(path);
+            return (int) CAPTURE_TO_FILE.invokeExact(handle, p, format, quality, result);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int captureToStore(long handle, long storeHandle, long timestampMs, int quality, MemorySegment result) {
+        try {
+            return (int) CAPTURE_TO_STORE.invokeExact(handle, storeHandle, timestampMs, quality, result);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int captureToStoreTiers(long handle, long storeHandle, long timestampMs, int quality,
+                                   MemorySegment tiers, int tierCount, MemorySegment result) {
+        try {
+            return (int) CAPTURE_TO_STORE_TIERS.invokeExact(handle, storeHandle, timestampMs, quality,
+                    tiers, tierCount, result);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int captureToDngStream(long handle, MemorySegment streamOut, MemorySegment result) {
+        try {
+            return (int) CAPTURE_TO_DNG_STREAM.invokeExact(handle, streamOut, result);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    // ---- FrameStore ----
+    // Appends and reads do blocking file I/O, so they are not critical calls;
+    // frame data goes through a confined arena.
+    private static final MethodHandle STORE_OPEN = h("lc4j_store_open", FunctionDescriptor.of(JAVA_LONG, ADDRESS));
+    private static final MethodHandle STORE_CLOSE = h("lc4j_store_close", FunctionDescriptor.ofVoid(JAVA_LONG));
+    private static final MethodHandle STORE_APPEND = h("lc4j_store_append",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, JAVA_LONG, ADDRESS, JAVA_LONG));
+    private static final MethodHandle STORE_READ = h("lc4j_store_read",
+            FunctionDescriptor.of(JAVA_LONG, JAVA_LONG, JAVA_LONG, ADDRESS, JAVA_LONG));
+    private static final MethodHandle STORE_EXPORT = h("lc4j_store_export",
+            FunctionDescriptor.of(JAVA_LONG, JAVA_LONG, JAVA_LONG, ADDRESS));
+    private static final MethodHandle STORE_DELETE = h("lc4j_store_delete", FunctionDescriptor.of(JAVA_INT, JAVA_LONG, ADDRESS, JAVA_INT));
+    private static final MethodHandle STORE_COMPACT = h("lc4j_store_compact", FunctionDescriptor.of(JAVA_LONG, JAVA_LONG, JAVA_DOUBLE));
+    private static final MethodHandle STORE_INDEX_MAP = h("lc4j_store_index_map", FunctionDescriptor.of(JAVA_INT, JAVA_LONG, ADDRESS));
+    private static final MethodHandle STORE_SET_GROUP_COMMIT = h("lc4j_store_set_group_commit",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, JAVA_INT, JAVA_LONG));
+    private static final MethodHandle STORE_SYNC = h("lc4j_store_sync", FunctionDescriptor.of(JAVA_INT, JAVA_LONG));
+    private static final MethodHandle STORE_GET_DURABILITY = h("lc4j_store_get_durability", FunctionDescriptor.of(JAVA_INT, JAVA_LONG, ADDRESS));
+    private static final MethodHandle STORE_RECOMPRESS = h("lc4j_store_recompress",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, JAVA_LONG, JAVA_LONG, JAVA_INT, JAVA_INT, ADDRESS));
+    private static final MethodHandle STORE_SET_TAGS = h("lc4j_store_set_tags",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, ADDRESS, ADDRESS, JAVA_INT));
+    private static final MethodHandle STORE_LIST_TAGS = h("lc4j_store_list_tags",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, JAVA_LONG, JAVA_LONG, ADDRESS, JAVA_INT));
+    private static final MethodHandle STORE_HASH_FRAMES = h("lc4j_store_hash_frames",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, JAVA_LONG, JAVA_LONG));
+
+    /** Size in bytes of one {@code lc4j_store_record}. */
+    static final long STORE_RECORD_SIZE = 32;
+
+    /** Size in bytes of one {@code lc4j_store_durability}. */
+    static final long STORE_DURABILITY_SIZE = 64;
+
+    /** Size in bytes of one {@code lc4j_recompress_result}. */
+    static final long RECOMPRESS_RESULT_SIZE = 32;
+
+    static long storeOpen(String directory) {
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment dir = arena.allocateFrom(directory);
+            return (long) STORE_OPEN.invokeExact(dir);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static void storeClose(long handle) {
+        try {
+            STORE_CLOSE.invokeExact(handle);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int storeAppend(long handle, long timestampMs, MemorySegment data) {
+        try {
+            return (int) STORE_APPEND.invokeExact(handle, timestampMs, data, data.byteSize());
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static long storeRead(long handle, long timestampMs, MemorySegment buf) {
+        try {
+            return (long) STORE_READ.invokeExact(handle, timestampMs, buf, buf.byteSize());
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static long storeExport(long handle, long timestampMs, MemorySegment path) {
+        try {
+            return (long) STORE_EXPORT.invokeExact(handle, timestampMs, path);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int storeDelete(long handle, MemorySegment timestamps, int count) {
+        try {
+            return (int) STORE_DELETE.invokeExact(handle, timestamps, count);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static long storeCompact(long handle, double minDeadRatio) {
+        try {
+            return (long) STORE_COMPACT.invokeExact(handle, minDeadRatio);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int storeIndexMap(long handle, MemorySegment out2) {
+        try {
+            return (int) STORE_INDEX_MAP.invokeExact(handle, out2);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int storeSetGroupCommit(long handle, int intervalMs, long maxBytes) {
+        try {
+            return (int) STORE_SET_GROUP_COMMIT.invokeExact(handle, intervalMs, maxBytes);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int storeSync(long handle) {
+        try {
+            return (int) STORE_SYNC.invokeExact(handle);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int storeGetDurability(long handle, MemorySegment out) {
+        try {
+            return (int) STORE_GET_DURABILITY.invokeExact(handle, out);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int storeRecompress(long handle, long fromMs, long toMs, int maxWidth, int quality, MemorySegment out) {
+        try {
+            return (int) STORE_RECOMPRESS.invokeExact(handle, fromMs, toMs, maxWidth, quality, out);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int storeSetTags(long handle, MemorySegment timestamps, MemorySegment tags, int count) {
+        try {
+            return (int) STORE_SET_TAGS.invokeExact(handle, timestamps, tags, count);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int storeListTags(long handle, long fromMs, long toMs, MemorySegment out, int max) {
+        try {
+            return (int) STORE_LIST_TAGS.invokeExact(handle, fromMs, toMs, out, max);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int storeHashFrames(long handle, long fromMs, long toMs) {
+        try {
+            return (int) STORE_HASH_FRAMES.invokeExact(handle, fromMs, toMs);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    // ---- DirScanner ----
+    private static final MethodHandle SCAN_OPEN = h("lc4j_scan_open", FunctionDescriptor.of(JAVA_LONG, ADDRESS, JAVA_INT));
+    private static final MethodHandle SCAN_CLOSE = h("lc4j_scan_close", FunctionDescriptor.ofVoid(JAVA_LONG));
+    private static final MethodHandle SCAN_COUNT = h("lc4j_scan_count", FunctionDescriptor.of(JAVA_INT, JAVA_LONG));
+    private static final MethodHandle SCAN_ENTRIES = h("lc4j_scan_entries", FunctionDescriptor.of(JAVA_INT, JAVA_LONG, ADDRESS, JAVA_INT));
+    private static final MethodHandle SCAN_DIR_COUNT = h("lc4j_scan_dir_count", FunctionDescriptor.of(JAVA_INT, JAVA_LONG));
+    private static final MethodHandle SCAN_DIR = h("lc4j_scan_dir", FunctionDescriptor.of(JAVA_INT, JAVA_LONG, JAVA_INT, ADDRESS, JAVA_INT));
+
+    /** Size in bytes of one {@code lc4j_scan_entry}. */
+    static final long SCAN_ENTRY_SIZE = 24;
+
+    static long scanOpen(String root, int threads) {
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment dir = arena.allocateFrom(root);
+            return (long) SCAN_OPEN.invokeExact(dir, threads);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static void scanClose(long handle) {
+        try {
+            SCAN_CLOSE.invokeExact(handle);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int scanCount(long handle) {
+        try {
+            return (int) SCAN_COUNT.invokeExact(handle);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int scanEntries(long handle, MemorySegment out, int max) {
+        try {
+            return (int) SCAN_ENTRIES.invokeExact(handle, out, max);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int scanDirCount(long handle) {
+        try {
+            return (int) SCAN_DIR_COUNT.invokeExact(handle);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static String scanDir(long handle, int dirId) {
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment buf = arena.allocate(4096);
+            int n = (int) SCAN_DIR.invokeExact(handle, dirId, buf, 4096);
+            return n < 0 ? null : buf.getString(0);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    // ---- FrameExport ----
+    private static final MethodHandle EXPORT_OPEN = h("lc4j_export_open",
+            FunctionDescriptor.of(JAVA_LONG, ADDRESS, JAVA_INT, JAVA_LONG, JAVA_INT));
+    private static final MethodHandle EXPORT_ATTACH = h("lc4j_export_attach", FunctionDescriptor.of(JAVA_LONG, ADDRESS));
+    private static final MethodHandle EXPORT_CLOSE = h("lc4j_export_close", FunctionDescriptor.ofVoid(JAVA_LONG));
+    private static final MethodHandle EXPORT_MAP = h("lc4j_export_map", FunctionDescriptor.of(JAVA_INT, JAVA_LONG, ADDRESS));
+    private static final MethodHandle EXPORT_PUBLISH = h("lc4j_export_publish",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, JAVA_LONG, JAVA_INT, JAVA_INT, ADDRESS, JAVA_LONG));
+
+    static long exportOpen(String name, int slotCount, long slotSize, int flags) {
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment n = arena.allocateFrom(name);
+            return (long) EXPORT_OPEN.invokeExact(n, slotCount, slotSize, flags);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static long exportAttach(String name) {
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment n = arena.allocateFrom(name);
+            return (long) EXPORT_ATTACH.invokeExact(n);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static void exportClose(long handle) {
+        try {
+            EXPORT_CLOSE.invokeExact(handle);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int exportMap(long handle, MemorySegment out2) {
+        try {
+            return (int) EXPORT_MAP.invokeExact(handle, out2);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int exportPublish(long handle, long timestampNs, int width, int height, MemorySegment jpeg) {
+        try {
+            return (int) EXPORT_PUBLISH.invokeExact(handle, timestampNs, width, height, jpeg, jpeg.byteSize());
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    // ---- FrameServer ----
+    private static final MethodHandle SERVER_OPEN = h("lc4j_server_open", FunctionDescriptor.of(JAVA_LONG, ADDRESS, JAVA_INT));
+    private static final MethodHandle SERVER_CLOSE = h("lc4j_server_close", FunctionDescriptor.ofVoid(JAVA_LONG));
+    private static final MethodHandle SERVER_SUBSCRIBERS = h("lc4j_server_subscribers", FunctionDescriptor.of(JAVA_INT, JAVA_LONG));
+
+    static long serverOpen(String path, int maxOutstanding) {
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment p = arena.allocateFrom(path);
+            return (long) SERVER_OPEN.invokeExact(p, maxOutstanding);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static void serverClose(long handle) {
+        try {
+            SERVER_CLOSE.invokeExact(handle);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int serverSubscribers(long handle) {
+        try {
+            return (int) SERVER_SUBSCRIBERS.invokeExact(handle);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    // ---- DngStream ----
+    private static final MethodHandle DNG_STREAM_SIZE = h("lc4j_dng_stream_size", FunctionDescriptor.of(JAVA_LONG, JAVA_LONG));
+    private static final MethodHandle DNG_STREAM_READ = h("lc4j_dng_stream_read",
+            FunctionDescriptor.of(JAVA_LONG, JAVA_LONG, ADDRESS, JAVA_LONG));
+    private static final MethodHandle DNG_STREAM_CLOSE = h("lc4j_dng_stream_close", FunctionDescriptor.ofVoid(JAVA_LONG));
+
+    static long dngStreamSize(long handle) {
+        try {
+            return (long) DNG_STREAM_SIZE.invokeExact(handle);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static long dngStreamRead(long handle, MemorySegment buffer) {
+        try {
+            return (long) DNG_STREAM_READ.invokeExact(handle, buffer, buffer.byteSize());
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static void dngStreamClose(long handle) {
+        try {
+            DNG_STREAM_CLOSE.invokeExact(handle);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    // ---- FrameStats ----
+    private static final MethodHandle FRAME_COMPUTE_STATS = h("lc4j_frame_compute_stats",
+            FunctionDescriptor.of(JAVA_INT, ADDRESS, JAVA_LONG, JAVA_INT, JAVA_INT, JAVA_INT, JAVA_INT, JAVA_INT, JAVA_INT, ADDRESS));
+
+    /** Size in bytes of one {@code lc4j_frame_stats}. */
+    static final long FRAME_STATS_SIZE = 2088;
+
+    static int frameComputeStats(MemorySegment plane, int fourcc, int width, int height, int stride,
+                                 int zonesX, int zonesY, MemorySegment out) {
+        try {
+            return (int) FRAME_COMPUTE_STATS.invokeExact(plane, plane.byteSize(), fourcc, width, height, stride,
+                    zonesX, zonesY, out);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    // ---- MotionDetector ----
+    private static final MethodHandle MOTION_CREATE = h("lc4j_motion_create", FunctionDescriptor.of(JAVA_LONG, ADDRESS));
+    private static final MethodHandle MOTION_CLOSE = h("lc4j_motion_close", FunctionDescriptor.ofVoid(JAVA_LONG));
+    private static final MethodHandle MOTION_SET_MASK = h("lc4j_motion_set_mask",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, ADDRESS, JAVA_INT, JAVA_INT));
+    private static final MethodHandle MOTION_SET_SCHEDULE = h("lc4j_motion_set_schedule",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, ADDRESS));
+    private static final MethodHandle MOTION_PROCESS = h("lc4j_motion_process",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, ADDRESS, JAVA_LONG, JAVA_INT, JAVA_INT, JAVA_INT, JAVA_INT,
+                    JAVA_LONG, JAVA_LONG));
+    private static final MethodHandle MOTION_POLL = h("lc4j_motion_poll",
+            FunctionDescriptor.of(JAVA_INT, JAVA_LONG, ADDRESS, JAVA_INT, JAVA_INT));
+    private static final MethodHandle MOTION_EVENTFD = h("lc4j_motion_eventfd", FunctionDescriptor.of(JAVA_INT, JAVA_LONG));
+
+    /** Size in bytes of one {@code lc4j_motion_params}. */
+    static final long MOTION_PARAMS_SIZE = 24;
+
+    /** Size in bytes of one {@code lc4j_motion_event}. */
+    static final long MOTION_EVENT_SIZE = 160;
+
+    /** Size in bytes of an {@code lc4j_scene_schedule}. */
+    static final long SCENE_SCHEDULE_SIZE = 16;
+
+    static long motionCreate(MemorySegment params) {
+        try {
+            return (long) MOTION_CREATE.invokeExact(params);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static void motionClose(long handle) {
+        try {
+            MOTION_CLOSE.invokeExact(handle);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int motionSetMask(long handle, MemorySegment mask, int width, int height) {
+        try {
+            return (int) MOTION_SET_MASK.invokeExact(handle, mask, width, height);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int motionSetSchedule(long handle, MemorySegment schedule) {
+        try {
+            return (int) MOTION_SET_SCHEDULE.invokeExact(handle, schedule);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int motionProcess(long handle, MemorySegment plane, int fourcc, int width, int height, int stride,
+                             long sequence, long timestampNs) {
+        try {
+            return (int) MOTION_PROCESS.invokeExact(handle, plane, plane.byteSize(), fourcc, width, height, stride,
+                    sequence, timestampNs);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int motionPoll(long handle, MemorySegment out, int max, int timeoutMs) {
+        try {
+            return (int) MOTION_POLL.invokeExact(handle, out, max, timeoutMs);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static int motionEventFd(long handle) {
+        try {
+            return (int) MOTION_EVENTFD.invokeExact(handle);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    // ---- TimelapseFrames ----
+    private static final MethodHandle TIMELAPSE_OPEN = h("lc4j_timelapse_open",
+            FunctionDescriptor.of(JAVA_LONG, JAVA_LONG, ADDRESS, JAVA_INT, ADDRESS));
+    private static final MethodHandle TIMELAPSE_NEXT = h("lc4j_timelapse_next", FunctionDescriptor.of(JAVA_LONG, JAVA_LONG));
+    private static final MethodHandle TIMELAPSE_READ = h("lc4j_timelapse_read",
+            FunctionDescriptor.of(JAVA_LONG, JAVA_LONG, ADDRESS, JAVA_LONG));
+    private static final MethodHandle TIMELAPSE_CLOSE = h("lc4j_timelapse_close", FunctionDescriptor.ofVoid(JAVA_LONG));
+
+    /** Size in bytes of one {@code lc4j_timelapse_params}. */
+    static final long TIMELAPSE_PARAMS_SIZE = 16;
+
+    static long timelapseOpen(long storeHandle, MemorySegment timestamps, int count, MemorySegment params) {
+        try {
+            return (long) TIMELAPSE_OPEN.invokeExact(storeHandle, timestamps, count, params);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static long timelapseNext(long handle) {
+        try {
+            return (long) TIMELAPSE_NEXT.invokeExact(handle);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static long timelapseRead(long handle, MemorySegment buffer) {
+        try {
+            return (long) TIMELAPSE_READ.invokeExact(handle, buffer, buffer.byteSize());
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
+
+    static void timelapseClose(long handle) {
+        try {
+            TIMELAPSE_CLOSE.invokeExact(handle);
+        } catch (Throwable t) {
+            throw wrap(t);
+        }
+    }
 }
@@ -0,0 +1,145 @@
+package in.virit.libcamera4j;
+
+import java.lang.foreign.Arena;
+import java.lang.foreign.MemorySegment;
+
+import static java.lang.foreign.ValueLayout.JAVA_BYTE;
+import static java.lang.foreign.ValueLayout.JAVA_INT;
+import static java.lang.foreign.ValueLayout.JAVA_LONG;
+
+/**
+ * The frames of a timelapse read from a {@link FrameStore} in order, corrected
+ * natively on their way to the video encoder.
+ *
+ * <p>Auto-exposure settles a little differently for every capture, so a
+ * timelapse of an unchanging scene flickers. With a deflicker window, every
+ * frame's brightness is evened out against the frames around it: their mean
+ * luma is measured on 1/8 scale decodes, and the frame's luma is pulled
+ * towards the geometric mean of the window by a tone curve as it is
+ * re-encoded.</p>
+ *
+ * <p>Wind shaking the camera makes a timelapse wobble. With a stabilize
+ * window, the rotation and shift from each frame to the next are registered
+ * on downscaled luma, and every frame is warped to the mean path of the view
+ * over the frames around it; the border the warp uncovers repeats the edge.</p>
+ *
+ * <p>Changes slower than the windows, such as dusk or turning the camera,
+ * pass through. Frames that need no correction are returned as stored.</p>
+ *
+ * <pre>{@code
+ * try (TimelapseFrames frames = TimelapseFrames.open(store, timestamps, new TimelapseFrames.Params(9, 15, 92))) {
+ *     for (byte[] jpeg = frames.next(); jpeg != null; jpeg = frames.next()) {
+ *         encoder.write(jpeg);
+ *     }
+ * }
+ * }</pre>
+ *
+ * <p>Only the levels of the window are held, however long the range. Frames
+ * deleted from the store in between are skipped. Not thread safe.</p>
+ */
+public final class TimelapseFrames implements AutoCloseable {
+
+    static {
+        NativeLoader.load();
+    }
+
+    /** Largest deflicker or stabilize window, in frames. */
+    public static final int MAX_WINDOW = 61;
+
+    private static final int DEFLICKER = 0x1;
+    private static final int STABILIZE = 0x2;
+
+    /**
+     * Correction parameters.
+     *
+     * @param deflickerWindow frames around each frame its brightness is evened out against,
+     *                        odd, 3 to {@link #MAX_WINDOW}, or 0 for no deflicker
+     * @param stabilizeWindow frames around each frame whose mean view it is warped to,
+     *                        odd, 3 to {@link #MAX_WINDOW}, or 0 for no stabilization
+     * @param quality JPEG quality of corrected frames, 1-100
+     */
+    public record Params(int deflickerWindow, int stabilizeWindow, int quality) {
+    }
+
+    private final long handle;
+    private final Arena arena;
+    private MemorySegment buffer;
+    private boolean closed;
+
+    private TimelapseFrames(long handle) {
+        this.handle = handle;
+        this.arena = Arena.ofConfined();
+        this.buffer = arena.allocate(1);
+    }
+
+    /**
+     * Opens the frames with the given timestamps, in the given order. The
+     * store must stay open until the frames are closed.
+     *
+     * @param store the store holding the frames
+     * @param timestampsMs the frames' timestamps
+     * @param params the corrections to apply
+     * @return the frames
+     * @throws IllegalArgumentException if the parameters are invalid
+     */
+    public static TimelapseFrames open(FrameStore store, long[] timestampsMs, Params params) {
+        try (Arena arena = Arena.ofConfined()) {
+            MemorySegment timestamps = arena.allocateFrom(JAVA_LONG, timestampsMs);
+            MemorySegment p = arena.allocate(Native.TIMELAPSE_PARAMS_SIZE, 4);
+            p.set(JAVA_INT, 0, (params.deflickerWindow() > 0 ? DEFLICKER : 0)
+                    | (params.stabilizeWindow() > 0 ? STABILIZE : 0));
+            p.set(JAVA_INT, 4, params.quality());
+            p.set(JAVA_INT, 8, params.deflickerWindow());
+            p.set(JAVA_INT, 12, params.stabilizeWindow());
+            long handle = Native.timelapseOpen(store.handle(), timestamps, timestampsMs.length, p);
+            if (handle == 0) {
+                throw new IllegalArgumentException("Invalid timelapse parameters: " + params);
+            }
+            return new TimelapseFrames(handle);
+        }
+    }
+
+    /**
+     * Returns the next frame.
+     *
+     * @return the encoded frame, or null after the last one
+     * @throws LibCameraException if reading or correcting the frame fails
+     */
+    public byte[] next() {
+        ensureOpen();
+        long size = Native.timelapseNext(handle);
+        if (size == 0) {
+            return null;
+        }
+        if (size < 0) {
+            throw LibCameraException.forOperation("Timelapse frame", (int) size);
+        }
+        if (buffer.byteSize() < size) {
+            // With some headroom, as frames differ a little in size; the arena frees the old one on close
+            buffer = arena.allocate(size + size / 4);
+        }
+        long length = Native.timelapseRead(handle, buffer);
+        if (length < 0) {
+            throw LibCameraException.forOperation("Timelapse frame read", (int) length);
+        }
+        return buffer.asSlice(0, length).toArray(JAVA_BYTE);
+    }
+
+    private void ensureOpen() {
+        if (closed) {
+            throw new IllegalStateException("TimelapseFrames is closed");
+        }
+    }
+
+    /**
+     * Releases the native reader and its buffers.
+     */
+    @Override
+    public void close() {
+        if (!closed) {
+            closed = true;
+            arena.close();
+            Native.timelapseClose(handle);
+        }
+    }
+}
@@ -0,0 +1,55 @@
+package in.virit.libcamera4j;
+
+import java.lang.foreign.MemorySegment;
+
+import static java.lang.foreign.ValueLayout.JAVA_FLOAT;
+
+/**
+ * The waterline found in a capture, where the water meets something standing
+ * in it, such as the posts of a jetty.
+ *
+ * <p>Looked for natively in a region of every capture set with
+ * {@link CaptureSession#setWaterline(Params)}: the luma of each row is
+ * averaged over a few vertical strips of the region, and the waterline is the
+ * row where most strips step in brightness, between the post above and the
+ * water below. Ripples and reflections step too, but not in the same row
+ * across the strips. A linear calibration, the levels at two rows of the
+ * waterline, turns the row into a water level.</p>
+ *
+ * @param row the waterline as a fraction of the image height from the top
+ * @param level the level the calibration gives for {@code row}
+ * @param confidence the share of the region's strips agreeing on the row, 0-1
+ */
+public record Waterline(double row, double level, double confidence) {
+
+    /**
+     * Where to look for the waterline and how to calibrate it. All positions
+     * are fractions, 0-1, of the image as captured, after the session's
+     * {@link Transform}, 90 degree turns included.
+     *
+     * @param left left edge of the region
+     * @param top top edge of the region
+     * @param right right edge of the region
+     * @param bottom bottom edge of the region
+     * @param row0 a row of the waterline, from the top
+     * @param level0 the level when the waterline is at {@code row0}
+     * @param row1 another row of the waterline
+     * @param level1 the level when the waterline is at {@code row1}
+     */
+    public record Params(double left, double top, double right, double bottom,
+                         double row0, double level0, double row1, double level1) {
+    }
+
+    /**
+     * Reads the waterline fields of an {@code lc4j_capture_result}.
+     *
+     * @return the waterline, or null if none was found
+     */
+    static Waterline read(MemorySegment fields) {
+        float row = fields.get(JAVA_FLOAT, 0);
+        if (row < 0) {
+            return null;
+        }
+        return new Waterline(row, fields.get(JAVA_FLOAT, 4), fields.get(JAVA_FLOAT, 8));
+    }
+}
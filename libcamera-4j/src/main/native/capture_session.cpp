@@ -0,0 +1,1498 @@
+/*
+ * libcamera4j - capture sessions that write straight to a file.
+ *
+ * The handle-based API in libcamera4j.cpp hands every frame to Java, which then
+ * converts, encodes and writes it. For the common "take a picture and store it"
+ * case this session does the whole pipeline natively: configure, warm up, map
+ * the completed buffer, encode it (image_codec.cpp) directly from the mapping
+ * and write the result with writeFileSync, or append it to a frame store
+ * (frame_store.cpp) tagged with its perceptual hash, optionally together with
+ * downscaled thumbnail tiers in their own stores. A raw capture can also be
+ * kept as a DNG stream (dng_stream.cpp) that Java reads out in pieces. A
+ * capture can average a burst of frames (frame_stack.cpp) instead of taking a
+ * single one, summing each frame while the camera exposes the next, or fuse an
+ * exposure bracket (exposure_fusion.cpp), switching the exposure from request
+ * to request in the same stream. JPEGs taken at high gain are denoised
+ * (denoise.cpp) before they are encoded, and the waterline can be looked for
+ * in every capture (waterline.cpp). JPEG captures are also published to any
+ * open frame export (frame_export.cpp), and their dmabufs are handed to the
+ * subscribers of any frame server (frame_server.cpp). Only the
+ * lc4j_capture_result, which includes the luma statistics of the frame
+ * (frame_stats.cpp), crosses back into Java.
+ *
+ * Between captures a session can monitor a low-resolution stream for motion
+ * (motion_detector.cpp) on a thread of its own. Captures and settings changes
+ * pause it: they take the camera over, and the monitor reconfigures and
+ * restarts it once they are done. A focus sweep takes the camera over the
+ * same way, stepping the lens across its range on a preview stream and
+ * measuring each position (focus_measure.cpp) to find the sharpest one.
+ *
+ * Every stage of a capture is timed (stage_latency.cpp), from configuring the
+ * camera to writing the result, and read with lc4j_stats_snapshot; the
+ * latencies with tails worth seeing are also kept as histograms. The sequence
+ * numbers of the completed buffers tell whether the streams keep up with the
+ * sensor (frame_sequence.cpp).
+ *
+ * libcamera allows a single CameraManager per process, so a session must not be
+ * open while the handle-based API is in use, and vice versa.
+ */
+
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <libcamera/libcamera.h>
+#include <libcamera/control_ids.h>
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+using namespace libcamera;
+
+namespace {
+
+static_assert(sizeof(lc4j_capture_result) == 2200, "lc4j_capture_result layout");
+static_assert(sizeof(lc4j_focus_result) == 536, "lc4j_focus_result layout");
+
+constexpr int32_t DEFAULT_WARMUP_FRAMES = 10;
+constexpr int32_t DEFAULT_STATS_ZONES = 8;
+constexpr int32_t MAX_STATS_ZONES = 16;
+constexpr unsigned int BUFFER_COUNT = 2;
+constexpr auto REQUEST_TIMEOUT = std::chrono::milliseconds(5000);
+constexpr unsigned int MONITOR_BUFFER_COUNT = 4;
+// How often the monitor looks up from its frames for a waiting capture or stop
+constexpr auto MONITOR_POLL = std::chrono::milliseconds(100);
+constexpr auto MONITOR_RETRY = std::chrono::milliseconds(1000);
+// How far off its exposure a bracket frame may be, the sensor working in lines
+// and gain steps, and how many frames it gets to arrive at it before it is
+// taken as it comes
+constexpr double BRACKET_TOLERANCE = 0.1;
+constexpr int32_t BRACKET_SETTLE_FRAMES = 8;
+constexpr int32_t DEFAULT_FOCUS_WIDTH = 640;
+constexpr int32_t DEFAULT_FOCUS_HEIGHT = 480;
+constexpr int32_t DEFAULT_FOCUS_STEPS = 12;
+constexpr int32_t DEFAULT_FOCUS_SETTLE_FRAMES = 2;
+
+// Receives the captured frame (still mapped) and its encoding.
+using EncodedSink = std::function<int32_t(const lc4j::FrameView&, const std::vector<uint8_t>&)>;
+
+// Receives a raw frame (still mapped) in place of its DNG encoding, and returns
+// the size of the DNG it is going to produce or a negative errno.
+using RawSink = std::function<int64_t(const lc4j::FrameView&, const lc4j::RawInfo&, const lc4j::DngMetadata&)>;
+
+// Controls applied to every request, mirroring CameraCapture.applyCameraSettings.
+struct SessionControls {
+    bool set = false;
+    int32_t afMode = 0;
+    float lensPosition = 0.0f;
+    bool aeEnable = true;
+    int32_t exposureUs = 0;
+    float analogueGain = 1.0f;
+};
+
+// Manual exposure of one frame of a bracket.
+struct BracketExposure {
+    int32_t exposureUs = 0;
+    float analogueGain = 1.0f;
+};
+
+// `count` lens positions evenly from `from` to `to`, both included.
+std::vector<float> spread(float from, float to, int32_t count) {
+    std::vector<float> positions(count);
+    for (int32_t i = 0; i < count; ++i) {
+        positions[i] = from + (to - from) * static_cast<float>(i) / static_cast<float>(count - 1);
+    }
+    return positions;
+}
+
+// Whether a frame was exposed as its bracket asked, within the steps the
+// sensor can do.
+bool exposedAs(const ControlList& metadata, const BracketExposure& exposure) {
+    const double actual = metadata.get(controls::ExposureTime).value_or(0)
+                        * static_cast<double>(metadata.get(controls::AnalogueGain).value_or(1.0f));
+    const double wanted = exposure.exposureUs * static_cast<double>(exposure.analogueGain);
+    return wanted > 0 && std::abs(actual / wanted - 1.0) <= BRACKET_TOLERANCE;
+}
+
+// mmap()s every distinct dmabuf of a frame buffer once; planes of the same
+// buffer usually share an fd at different offsets.
+class MappedFrame {
+public:
+    ~MappedFrame() {
+        for (auto& [fd, mapping] : mappings_) {
+            munmap(mapping.first, mapping.second);
+        }
+    }
+
+    bool map(const FrameBuffer* buffer) {
+        std::map<int, size_t> lengths;
+        for (const auto& plane : buffer->planes()) {
+            size_t end = static_cast<size_t>(plane.offset) + plane.length;
+            size_t& length = lengths[plane.fd.get()];
+            length = std::max(length, end);
+        }
+        for (const auto& [fd, length] : lengths) {
+            if (fd < 0 || length == 0) {
+                return false;
+            }
+            void* data = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+            if (data == MAP_FAILED) {
+                return false;
+            }
+            mappings_[fd] = {data, length};
+        }
+        for (const auto& plane : buffer->planes()) {
+            auto& mapping = mappings_[plane.fd.get()];
+            planes_.push_back({static_cast<const uint8_t*>(mapping.first) + plane.offset, plane.length});
+        }
+        return true;
+    }
+
+    size_t planeCount() const { return planes_.size(); }
+    const uint8_t* plane(size_t i) const { return planes_[i].first; }
+    size_t planeLength(size_t i) const { return planes_[i].second; }
+
+    // Finds the dmabuf and offset that a mapped address belongs to.
+    bool locate(const uint8_t* address, int& fd, size_t& offset) const {
+        for (const auto& [mappedFd, mapping] : mappings_) {
+            const auto* start = static_cast<const uint8_t*>(mapping.first);
+            if (address >= start && address < start + mapping.second) {
+                fd = mappedFd;
+                offset = static_cast<size_t>(address - start);
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::map<int, std::pair<void*, size_t>> mappings_;
+    std::vector<std::pair<const uint8_t*, size_t>> planes_;
+};
+
+// Fills the plane pointers of a YUV frame. libcamera may describe a planar
+// format either as separate planes or as one contiguous plane.
+bool describeYuv(const MappedFrame& mapped, int32_t stride, lc4j::FrameView& frame) {
+    const uint32_t fourcc = frame.fourcc;
+    const bool planar = fourcc == lc4j::fourcc('Y', 'U', '1', '2') || fourcc == lc4j::fourcc('Y', 'V', '1', '2');
+    const bool semiPlanar = fourcc == lc4j::fourcc('N', 'V', '1', '2') || fourcc == lc4j::fourcc('N', 'V', '2', '1');
+    const size_t lumaSize = static_cast<size_t>(stride) * frame.height;
+    const size_t chromaRows = (frame.height + 1) / 2;
+
+    frame.planes[0] = mapped.plane(0);
+    frame.strides[0] = stride;
+    if (planar) {
+        int32_t chromaStride = stride / 2;
+        size_t chromaSize = static_cast<size_t>(chromaStride) * chromaRows;
+        if (mapped.planeCount() >= 3) {
+            frame.planes[1] = mapped.plane(1);
+            frame.planes[2] = mapped.plane(2);
+        } else if (mapped.planeLength(0) >= lumaSize + 2 * chromaSize) {
+            frame.planes[1] = mapped.plane(0) + lumaSize;
+            frame.planes[2] = mapped.plane(0) + lumaSize + chromaSize;
+        } else {
+            return false;
+        }
+        frame.strides[1] = chromaStride;
+        frame.strides[2] = chromaStride;
+    } else if (semiPlanar) {
+        if (mapped.planeCount() >= 2) {
+            frame.planes[1] = mapped.plane(1);
+        } else if (mapped.planeLength(0) >= lumaSize + static_cast<size_t>(stride) * chromaRows) {
+            frame.planes[1] = mapped.plane(0) + lumaSize;
+        } else {
+            return false;
+        }
+        frame.strides[1] = stride;
+    } else if (mapped.planeLength(0) < lumaSize) {
+        return false;
+    }
+    return true;
+}
+
+// Describes the planes of a mapped YUV frame by dmabuf fd and offset, for
+// lc4j::serveFrame.
+int32_t describeDmabufs(const MappedFrame& mapped, const lc4j::FrameView& frame, lc4j::DmabufPlane* planes) {
+    int32_t count = 0;
+    for (int i = 0; i < 3 && frame.planes[i] != nullptr; ++i) {
+        size_t offset = 0;
+        if (!mapped.locate(frame.planes[i], planes[i].fd, offset)) {
+            return 0;
+        }
+        const int32_t rows = i == 0 ? frame.height : (frame.height + 1) / 2;
+        planes[i].offset = static_cast<uint32_t>(offset);
+        planes[i].length = static_cast<uint32_t>(static_cast<size_t>(frame.strides[i]) * rows);
+        planes[i].stride = frame.strides[i];
+        ++count;
+    }
+    return count;
+}
+
+// Fills the plane pointers of a mapped frame: a raw frame's single plane, or
+// see describeYuv.
+bool describeFrame(const MappedFrame& mapped, bool raw, int32_t stride, lc4j::FrameView& frame) {
+    if (!raw) {
+        return describeYuv(mapped, stride, frame);
+    }
+    frame.planes[0] = mapped.plane(0);
+    frame.strides[0] = stride;
+    return mapped.planeLength(0) >= static_cast<size_t>(stride) * frame.height;
+}
+
+// Derives the Bayer layout from a libcamera format name such as
+// "SBGGR10_CSI2P" or "SRGGB16".
+bool describeRaw(const std::string& name, lc4j::RawInfo& raw) {
+    static const struct {
+        const char* order;
+        uint8_t pattern[4];
+    } orders[] = {
+        {"BGGR", {2, 1, 1, 0}},
+        {"GBRG", {1, 2, 0, 1}},
+        {"RGGB", {0, 1, 1, 2}},
+        {"GRBG", {1, 0, 2, 1}},
+    };
+    if (name.find("PISP_COMP") != std::string::npos) {
+        return false;   // compressed Pi 5 raw, not supported
+    }
+    for (const auto& o : orders) {
+        size_t pos = name.find(o.order);
+        if (pos == std::string::npos) {
+            continue;
+        }
+        std::memcpy(raw.cfaPattern, o.pattern, 4);
+        raw.bitDepth = std::atoi(name.c_str() + pos + 4);
+        if (name.find("_CSI2P") != std::string::npos) {
+            if (raw.bitDepth == 10) {
+                raw.packing = lc4j::RawPacking::Csi2p10;
+            } else if (raw.bitDepth == 12) {
+                raw.packing = lc4j::RawPacking::Csi2p12;
+            } else {
+                return false;
+            }
+        } else {
+            raw.packing = lc4j::RawPacking::Unpacked16;
+        }
+        return raw.bitDepth >= 8 && raw.bitDepth <= 16;
+    }
+    return false;
+}
+
+class Session {
+public:
+    std::shared_ptr<CameraManager> manager;
+    std::shared_ptr<Camera> camera;
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t warmupFrames = DEFAULT_WARMUP_FRAMES;
+    int32_t transform = 0;
+    int32_t statsZonesX = DEFAULT_STATS_ZONES;
+    int32_t statsZonesY = DEFAULT_STATS_ZONES;
+    int32_t burstFrames = 1;
+    bool burstAlign = false;
+    std::vector<float> bracketEv;
+    float denoiseMinGain = 0.0f;
+    float denoiseStrength = 0.0f;
+    bool waterline = false;
+    lc4j_waterline_params waterlineParams{};
+    SessionControls settings;
+    // Where the time of the captures goes, see lc4j_stats_snapshot and
+    // lc4j_histogram_snapshot
+    lc4j::StageLatency latency;
+    lc4j::LatencyHistogram histograms[LC4J_HISTOGRAM_COUNT];
+
+    // Serialises captures; a camera can only run one configuration at a time.
+    // Held by the monitor while it streams; take it through CameraLock.
+    std::mutex captureMutex;
+    // Number of threads waiting for or holding the camera through CameraLock
+    std::atomic<int32_t> capturePending{0};
+    std::condition_variable monitorCond;
+
+    ~Session() {
+        stopMonitor();
+        if (camera) {
+            camera->release();
+            camera.reset();
+        }
+        if (manager) {
+            manager->stop();
+        }
+    }
+
+    // Captures and encodes a frame, then hands the frame and the encoded bytes
+    // to `sink` (which writes them to a file or a frame store). DNG captures
+    // given a `rawSink` are not encoded; the raw frame goes there instead.
+    int32_t capture(int32_t format, int32_t quality, const EncodedSink& sink, lc4j_capture_result* out,
+                    const RawSink& rawSink = nullptr);
+
+    // Steps the lens across its range on a preview stream and measures how
+    // sharp each position is, see lc4j_session_focus_sweep.
+    int32_t focusSweep(const lc4j_focus_params& params, lc4j_focus_result& out);
+
+    // Starts feeding a monitorWidth x monitorHeight stream to a motion
+    // detector, replacing any monitor already running.
+    int32_t startMonitor(int64_t motionHandle, int32_t monitorWidth, int32_t monitorHeight);
+
+    void stopMonitor() {
+        std::lock_guard<std::mutex> lock(monitorControlMutex_);
+        if (!monitor_.joinable()) {
+            return;
+        }
+        monitorStop_ = true;
+        {
+            // Under captureMutex, so a monitor about to wait cannot miss it
+            std::lock_guard<std::mutex> cameraLock(captureMutex);
+            monitorCond.notify_all();
+        }
+        monitor_.join();
+    }
+
+    // Points `kind`, an LC4J_SESSION_STREAM_*, at the tracking of the stream
+    // just configured for it and restarts that, as new if its size or format
+    // changed since it last ran.
+    void startSequence(int32_t kind, const StreamConfiguration& streamConfig) {
+        std::lock_guard<std::mutex> lock(sequencesMutex_);
+        StreamSequence& tracked = sequences_[streamConfig.stream()];
+        const std::string configuration = streamConfig.toString();
+        tracked.sequence.restart(configuration != tracked.configuration);
+        tracked.configuration = configuration;
+        sequenceStreams_[kind] = streamConfig.stream();
+    }
+
+    // See lc4j_session_sequence_stats
+    void sequenceStats(int32_t kind, lc4j_sequence_stats& out, bool reset) {
+        std::lock_guard<std::mutex> lock(sequencesMutex_);
+        auto it = sequences_.find(sequenceStreams_[kind]);
+        if (it == sequences_.end()) {
+            out = lc4j_sequence_stats{};
+            return;
+        }
+        it->second.sequence.snapshot(out, reset);
+    }
+
+private:
+    std::mutex monitorControlMutex_;
+    std::thread monitor_;
+    std::atomic<bool> monitorStop_{false};
+    int64_t motionHandle_ = 0;
+    int32_t monitorWidth_ = 0;
+    int32_t monitorHeight_ = 0;
+
+    // Whether the streams keep up with the sensor, per stream and with the
+    // stream each LC4J_SESSION_STREAM_* last ran on
+    struct StreamSequence {
+        std::string configuration;
+        lc4j::FrameSequence sequence;
+    };
+    std::mutex sequencesMutex_;
+    std::map<const Stream*, StreamSequence> sequences_;
+    const Stream* sequenceStreams_[LC4J_SESSION_STREAM_COUNT] = {};
+
+    std::mutex completedMutex_;
+    std::condition_variable completedCond_;
+    // With the time each completed, for the latency counters
+    std::deque<std::pair<Request*, int64_t>> completed_;
+
+    void onRequestCompleted(Request* request) {
+        const int64_t now = lc4j::monotonicNs();
+        if (request->status() != Request::RequestCancelled) {
+            std::lock_guard<std::mutex> lock(sequencesMutex_);
+            for (const auto& [stream, buffer] : request->buffers()) {
+                const FrameMetadata& metadata = buffer->metadata();
+                if (metadata.status != FrameMetadata::FrameCancelled) {
+                    sequences_[stream].sequence.record(metadata.sequence, static_cast<int64_t>(metadata.timestamp),
+                                                       now);
+                }
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(completedMutex_);
+            completed_.emplace_back(request, now);
+        }
+        completedCond_.notify_one();
+    }
+
+    Request* waitCompleted(std::chrono::milliseconds timeout = REQUEST_TIMEOUT, int64_t* completedNs = nullptr) {
+        std::unique_lock<std::mutex> lock(completedMutex_);
+        if (!completedCond_.wait_for(lock, timeout, [this] { return !completed_.empty(); })) {
+            return nullptr;
+        }
+        auto [request, completed] = completed_.front();
+        completed_.pop_front();
+        if (completedNs != nullptr) {
+            *completedNs = completed;
+        }
+        return request;
+    }
+
+    // Times a call into a latency stage.
+    template <typename F>
+    auto timed(int32_t stage, F&& f) {
+        const int64_t start = lc4j::monotonicNs();
+        auto result = f();
+        latency.record(stage, lc4j::monotonicNs() - start);
+        return result;
+    }
+
+    // Sets the session's controls on a request, with the exposure of a
+    // bracket frame in place of its own if one is given.
+    void applyControls(ControlList& list, const BracketExposure* bracket = nullptr) const {
+        if (settings.set && camera->controls().count(controls::AF_MODE)) {
+            list.set(controls::AfMode, settings.afMode);
+            if (settings.afMode == controls::AfModeManual) {
+                list.set(controls::LensPosition, settings.lensPosition);
+            }
+        }
+        if (bracket != nullptr) {
+            list.set(controls::AeEnable, false);
+            list.set(controls::ExposureTime, bracket->exposureUs);
+            list.set(controls::AnalogueGain, bracket->analogueGain);
+        } else if (settings.set) {
+            list.set(controls::AeEnable, settings.aeEnable);
+            if (!settings.aeEnable) {
+                list.set(controls::ExposureTime, settings.exposureUs);
+                list.set(controls::AnalogueGain, settings.analogueGain);
+            }
+        } else if (!bracketEv.empty()) {
+            // Back to auto-exposure after the manual exposures of a bracket
+            list.set(controls::AeEnable, true);
+        }
+    }
+
+    // The exposure of every stop of the bracket around a metered one: darker
+    // frames drop gain first and brighter ones add time first, as far as the
+    // sensor goes.
+    std::vector<BracketExposure> bracketExposures(int32_t exposureUs, float analogueGain) const {
+        double minTime = 1;
+        double maxTime = INT32_MAX;
+        double minGain = 1;
+        double maxGain = analogueGain;
+        const ControlInfoMap& info = camera->controls();
+        if (auto it = info.find(&controls::ExposureTime); it != info.end()) {
+            minTime = std::max(1, it->second.min().get<int32_t>());
+            maxTime = std::max(minTime, static_cast<double>(it->second.max().get<int32_t>()));
+        }
+        if (auto it = info.find(&controls::AnalogueGain); it != info.end()) {
+            minGain = std::max(1.0f, it->second.min().get<float>());
+            maxGain = std::max(minGain, static_cast<double>(it->second.max().get<float>()));
+        }
+        const double metered = std::max(exposureUs, 1);
+        const double gain = std::clamp(static_cast<double>(analogueGain), minGain, maxGain);
+        std::vector<BracketExposure> exposures;
+        for (float ev : bracketEv) {
+            const double total = metered * gain * std::exp2(ev);
+            double stopGain = ev < 0 ? std::max(minGain, gain * std::exp2(ev)) : gain;
+            double time = std::clamp(total / stopGain, minTime, maxTime);
+            stopGain = std::clamp(total / time, minGain, maxGain);
+            exposures.push_back({static_cast<int32_t>(std::lround(time)), static_cast<float>(stopGain)});
+        }
+        return exposures;
+    }
+
+    int32_t captureFrame(int32_t format, int32_t quality, const EncodedSink& sink, lc4j_capture_result* out,
+                         const RawSink& rawSink);
+    void monitorLoop();
+    int32_t monitor();
+};
+
+// Takes the camera for a capture or a settings change, pausing the monitor of
+// the session if one is running.
+class CameraLock {
+public:
+    explicit CameraLock(Session& session) : session_(session) {
+        session_.capturePending++;
+        lock_ = std::unique_lock<std::mutex>(session_.captureMutex);
+    }
+
+    ~CameraLock() {
+        // Still under captureMutex, so the monitor cannot miss the wakeup
+        if (--session_.capturePending == 0) {
+            session_.monitorCond.notify_all();
+        }
+    }
+
+    CameraLock(const CameraLock&) = delete;
+    CameraLock& operator=(const CameraLock&) = delete;
+
+private:
+    Session& session_;
+    std::unique_lock<std::mutex> lock_;
+};
+
+int32_t Session::capture(int32_t format, int32_t quality, const EncodedSink& sink, lc4j_capture_result* out,
+                         const RawSink& rawSink) {
+    const int64_t start = lc4j::monotonicNs();
+    const int32_t ret = captureFrame(format, quality, sink, out, rawSink);
+    const int64_t elapsed = lc4j::monotonicNs() - start;
+    // Failures too: a capture that timed out is the tail worth seeing
+    histograms[LC4J_HISTOGRAM_CAPTURE].record(elapsed);
+    if (ret == 0) {
+        latency.record(LC4J_STAGE_TOTAL, elapsed);
+    }
+    return ret;
+}
+
+int32_t Session::captureFrame(int32_t format, int32_t quality, const EncodedSink& sink, lc4j_capture_result* out,
+                              const RawSink& rawSink) {
+    const bool dng = format == LC4J_CAPTURE_DNG;
+    const int64_t captureStart = lc4j::monotonicNs();
+
+    std::vector<StreamRole> roles{dng ? StreamRole::Raw : StreamRole::StillCapture};
+    std::unique_ptr<CameraConfiguration> config = camera->generateConfiguration(roles);
+    if (!dng && (!config || config->empty())) {
+        roles[0] = StreamRole::Viewfinder;
+        config = camera->generateConfiguration(roles);
+    }
+    if (!config || config->empty()) {
+        return -ENOTSUP;
+    }
+
+    StreamConfiguration& streamConfig = config->at(0);
+    if (!dng) {
+        if (width > 0 && height > 0) {
+            streamConfig.size = Size(width, height);
+        }
+        // Planar 4:2:0 feeds the JPEG encoder without any conversion
+        const auto supported = streamConfig.formats().pixelformats();
+        if (std::find(supported.begin(), supported.end(), formats::YUV420) != supported.end()) {
+            streamConfig.pixelFormat = formats::YUV420;
+        }
+    }
+    streamConfig.bufferCount = BUFFER_COUNT;
+    if (config->validate() == CameraConfiguration::Invalid) {
+        return -EINVAL;
+    }
+    int ret = camera->configure(config.get());
+    if (ret < 0) {
+        return ret;
+    }
+    latency.record(LC4J_STAGE_CONFIGURE, lc4j::monotonicNs() - captureStart);
+
+    lc4j::RawInfo raw;
+    if (dng && !describeRaw(streamConfig.pixelFormat.toString(), raw)) {
+        return -ENOTSUP;
+    }
+
+    Stream* stream = streamConfig.stream();
+    FrameBufferAllocator allocator(camera);
+    if (allocator.allocate(stream) <= 0) {
+        return -ENOMEM;
+    }
+
+    std::vector<std::unique_ptr<Request>> requests;
+    for (const auto& buffer : allocator.buffers(stream)) {
+        auto request = camera->createRequest();
+        if (!request || request->addBuffer(stream, buffer.get()) < 0) {
+            return -ENOMEM;
+        }
+        applyControls(request->controls());
+        requests.push_back(std::move(request));
+    }
+
+    lc4j::FrameView frame;
+    frame.fourcc = streamConfig.pixelFormat.fourcc();
+    frame.width = static_cast<int32_t>(streamConfig.size.width);
+    frame.height = static_cast<int32_t>(streamConfig.size.height);
+    const auto stride = static_cast<int32_t>(streamConfig.stride);
+
+    // A burst sums, and a bracket copies, every frame after the warm-up while
+    // the next is exposed; the buffers are mapped once, on first use.
+    const bool bracket = !dng && bracketEv.size() > 1;
+    const bool burst = !bracket && burstFrames > 1;
+    lc4j::FrameStack stack;
+    lc4j::ExposureFusion fusion;
+    std::map<const FrameBuffer*, std::unique_ptr<MappedFrame>> frameMappings;
+    auto viewFrame = [&](const Request* request, lc4j::FrameView& view) {
+        const FrameBuffer* buffer = request->buffers().begin()->second;
+        if (buffer->metadata().status != FrameMetadata::FrameSuccess) {
+            return false;
+        }
+        auto& mapping = frameMappings[buffer];
+        if (!mapping) {
+            mapping = std::make_unique<MappedFrame>();
+            if (!timed(LC4J_STAGE_MAP, [&] { return mapping->map(buffer); })) {
+                return false;
+            }
+        }
+        view = frame;
+        return describeFrame(*mapping, dng, stride, view);
+    };
+    auto stackFrame = [&](const Request* request) {
+        lc4j::FrameView view;
+        if (!viewFrame(request, view)) {
+            return -EIO;
+        }
+        return stack.count() == 0 ? stack.begin(view, dng ? &raw : nullptr, burstFrames, burstAlign)
+                                  : stack.add(view);
+    };
+    // The bracket is set around the exposure metered at the end of the warm-up;
+    // each stop takes the first frame that comes back exposed as asked.
+    std::vector<BracketExposure> exposures;
+    size_t bracketIndex = 0;
+    int32_t settleFrames = 0;
+    int32_t meteredExposureUs = 0;
+    float meteredGain = 1.0f;
+    auto bracketFrame = [&](const Request* request) {
+        if (exposures.empty()) {
+            meteredExposureUs = request->metadata().get(controls::ExposureTime).value_or(0);
+            meteredGain = request->metadata().get(controls::AnalogueGain).value_or(1.0f);
+            exposures = bracketExposures(meteredExposureUs, meteredGain);
+            return 0;
+        }
+        if (!exposedAs(request->metadata(), exposures[bracketIndex]) && ++settleFrames < BRACKET_SETTLE_FRAMES) {
+            return 0;
+        }
+        lc4j::FrameView view;
+        if (!viewFrame(request, view)) {
+            return -EIO;
+        }
+        int32_t result = fusion.add(view);
+        bracketIndex++;
+        settleFrames = 0;
+        return result;
+    };
+
+    std::map<const Request*, int64_t> queuedAt;
+    auto queue = [&](Request* request) {
+        queuedAt[request] = lc4j::monotonicNs();
+        return timed(LC4J_STAGE_QUEUE, [&] { return camera->queueRequest(request); });
+    };
+
+    camera->requestCompleted.connect(this, &Session::onRequestCompleted);
+    startSequence(LC4J_SESSION_STREAM_CAPTURE, streamConfig);
+    ret = timed(LC4J_STAGE_START, [&] { return camera->start(); });
+    Request* last = nullptr;
+    if (ret == 0) {
+        for (auto& request : requests) {
+            queue(request.get());
+        }
+        // Cycle the requests until auto-exposure has had warmupFrames to settle
+        for (int32_t frameCount = 1; ; ++frameCount) {
+            int64_t completedNs = 0;
+            Request* request = waitCompleted(REQUEST_TIMEOUT, &completedNs);
+            if (request == nullptr) {
+                ret = -ETIMEDOUT;
+                break;
+            }
+            const int64_t waitedNs = lc4j::monotonicNs() - completedNs;
+            latency.record(LC4J_STAGE_WAIT, waitedNs);
+            histograms[LC4J_HISTOGRAM_COMPLETE_TO_CONSUMER].record(waitedNs);
+            histograms[LC4J_HISTOGRAM_QUEUE_TO_COMPLETE].record(completedNs - queuedAt[request]);
+            const auto sensorNs = static_cast<int64_t>(request->buffers().begin()->second->metadata().timestamp);
+            if (sensorNs > 0) {
+                latency.record(LC4J_STAGE_COMPLETE, completedNs - sensorNs);
+            }
+            if (request->status() != Request::RequestComplete) {
+                ret = -EIO;
+                break;
+            }
+            if (frameCount >= warmupFrames) {
+                if (burst || bracket) {
+                    ret = burst ? stackFrame(request) : bracketFrame(request);
+                    if (ret < 0) {
+                        break;
+                    }
+                }
+                if (burst ? stack.count() == burstFrames : !bracket || bracketIndex == exposures.size()) {
+                    last = request;
+                    break;
+                }
+            }
+            request->reuse(Request::ReuseBuffers);
+            applyControls(request->controls(), exposures.empty() ? nullptr : &exposures[bracketIndex]);
+            queue(request);
+        }
+        camera->stop();
+    }
+    camera->requestCompleted.disconnect(this);
+    {
+        std::lock_guard<std::mutex> lock(completedMutex_);
+        completed_.clear();
+    }
+    if (last == nullptr) {
+        return ret < 0 ? ret : -EIO;
+    }
+
+    const FrameBuffer* buffer = last->buffers().begin()->second;
+    if (buffer->metadata().status != FrameMetadata::FrameSuccess) {
+        return -EIO;
+    }
+    // The average of a burst or the fusion of a bracket replaces the last
+    // frame; it is in no dmabuf
+    MappedFrame mapped;
+    lc4j::OwnedFrame merged;
+    lc4j::OwnedFrame denoised;
+    bool denoisedFrame = false;
+    if (burst || bracket) {
+        ret = timed(LC4J_STAGE_CONVERT, [&] {
+            return burst ? stack.average(merged, dng ? &raw : nullptr) : fusion.fuse(merged);
+        });
+        if (ret < 0) {
+            return ret;
+        }
+        frame = merged.view;
+    } else if (!timed(LC4J_STAGE_MAP, [&] { return mapped.map(buffer); }) ||
+               !describeFrame(mapped, dng, stride, frame)) {
+        return -EIO;
+    }
+
+    const ControlList& metadata = last->metadata();
+    std::vector<uint8_t> encoded;
+    int64_t bytes = 0;
+    if (dng) {
+        lc4j::DngMetadata dngMeta;
+        if (auto ccm = metadata.get(controls::ColourCorrectionMatrix)) {
+            for (int i = 0; i < 9; ++i) {
+                dngMeta.colorMatrix[i] = (*ccm)[i];
+            }
+        }
+        if (auto gains = metadata.get(controls::ColourGains)) {
+            double red = (*gains)[0] > 0 ? (*gains)[0] : 1.0;
+            double blue = (*gains)[1] > 0 ? (*gains)[1] : 1.0;
+            dngMeta.asShotNeutral[0] = 1.0 / red;
+            dngMeta.asShotNeutral[2] = 1.0 / blue;
+        }
+        if (auto black = metadata.get(controls::SensorBlackLevels)) {
+            for (int i = 0; i < 4; ++i) {
+                dngMeta.blackLevel[i] = (*black)[i];
+            }
+        }
+        if (rawSink) {
+            // Encodes and writes in one go; counted as encoding
+            bytes = timed(LC4J_STAGE_ENCODE, [&] { return rawSink(frame, raw, dngMeta); });
+            ret = bytes < 0 ? static_cast<int32_t>(bytes) : 0;
+        } else {
+            ret = timed(LC4J_STAGE_ENCODE, [&] { return lc4j::encodeDng(frame, raw, dngMeta, encoded); });
+        }
+    } else {
+        // High-gain frames are denoised first (denoise.cpp); a burst has
+        // already averaged its noise down by the square root of its frames
+        const float gain = metadata.get(controls::AnalogueGain).value_or(1.0f);
+        if (!bracket && denoiseStrength > 0.0f && gain >= denoiseMinGain) {
+            const float frames = burst ? static_cast<float>(stack.count()) : 1.0f;
+            ret = timed(LC4J_STAGE_CONVERT, [&] {
+                return lc4j::denoiseFrame(frame, denoiseStrength * std::sqrt(gain / frames), denoised);
+            });
+            if (ret == 0) {
+                frame = denoised.view;
+                denoisedFrame = true;
+            } else if (ret != -ENOTSUP) {
+                return ret;
+            }
+        }
+        ret = timed(LC4J_STAGE_ENCODE, [&] { return lc4j::encodeJpeg(frame, transform, quality, encoded); });
+    }
+    if (ret < 0) {
+        return ret;
+    }
+
+    if (!dng || !rawSink) {
+        bytes = static_cast<int64_t>(encoded.size());
+        ret = timed(LC4J_STAGE_WRITE, [&] { return sink(frame, encoded); });
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    if (!dng) {
+        const auto timestampNs = static_cast<int64_t>(buffer->metadata().timestamp);
+        lc4j::exportFrame(frame, transform, encoded, timestampNs, buffer->metadata().sequence);
+        lc4j::DmabufPlane planes[3];
+        // The dmabufs hold the frame as captured, not a merged or denoised one
+        int32_t planeCount = !burst && !bracket && !denoisedFrame && lc4j::frameServerWanted()
+                             ? describeDmabufs(mapped, frame, planes) : 0;
+        if (planeCount > 0) {
+            lc4j::serveFrame(frame.fourcc, frame.width, frame.height, planes, planeCount, timestampNs,
+                             buffer->metadata().sequence);
+        }
+    }
+
+    if (out != nullptr) {
+        std::memset(out, 0, sizeof(*out));
+        // Left empty (zonesX 0) for formats it cannot read
+        lc4j::frameStats(frame, dng ? &raw : nullptr, statsZonesX, statsZonesY, out->stats);
+        out->waterlineRow = -1.0f;
+        if (waterline && !dng) {
+            lc4j::estimateWaterline(frame, transform, waterlineParams, out->waterlineRow, out->waterlineLevel,
+                                    out->waterlineConfidence);
+        }
+        out->bytes = bytes;
+        out->timestampNs = static_cast<int64_t>(buffer->metadata().timestamp);
+        out->sequence = buffer->metadata().sequence;
+        // A bracket is reported at the exposure it was metered at
+        out->exposureTimeUs = bracket ? meteredExposureUs : metadata.get(controls::ExposureTime).value_or(0);
+        out->analogueGain = bracket ? meteredGain : metadata.get(controls::AnalogueGain).value_or(1.0f);
+        out->digitalGain = metadata.get(controls::DigitalGain).value_or(1.0f);
+        out->redGain = 1.0;
+        out->blueGain = 1.0;
+        if (auto gains = metadata.get(controls::ColourGains)) {
+            out->redGain = (*gains)[0];
+            out->blueGain = (*gains)[1];
+        }
+        out->lux = metadata.get(controls::Lux).value_or(0.0f);
+        out->colourTemperature = metadata.get(controls::ColourTemperature).value_or(0);
+        bool transpose = !dng && (transform & 4) != 0;
+        out->width = transpose ? frame.height : frame.width;
+        out->height = transpose ? frame.width : frame.height;
+        out->pixelFormat = static_cast<int32_t>(frame.fourcc);
+        out->frames = burst ? stack.count() : bracket ? fusion.count() : 1;
+    }
+    return 0;
+}
+
+int32_t Session::focusSweep(const lc4j_focus_params& params, lc4j_focus_result& out) {
+    const ControlInfoMap& info = camera->controls();
+    const auto lens = info.find(&controls::LensPosition);
+    if (lens == info.end()) {
+        return -ENOTSUP;
+    }
+    const float minPosition = lens->second.min().get<float>();
+    const float maxPosition = lens->second.max().get<float>();
+    if (!(maxPosition > minPosition)) {
+        return -ENOTSUP;
+    }
+
+    std::unique_ptr<CameraConfiguration> config = camera->generateConfiguration({StreamRole::Viewfinder});
+    if (!config || config->empty()) {
+        return -ENOTSUP;
+    }
+    StreamConfiguration& streamConfig = config->at(0);
+    streamConfig.size = Size(params.width, params.height);
+    const auto supported = streamConfig.formats().pixelformats();
+    if (std::find(supported.begin(), supported.end(), formats::YUV420) != supported.end()) {
+        streamConfig.pixelFormat = formats::YUV420;
+    }
+    streamConfig.bufferCount = MONITOR_BUFFER_COUNT;
+    if (config->validate() == CameraConfiguration::Invalid) {
+        return -EINVAL;
+    }
+    int ret = camera->configure(config.get());
+    if (ret < 0) {
+        return ret;
+    }
+
+    // The coarse pass spreads over the whole range; the fine one over the
+    // positions either side of the best of it
+    std::vector<float> targets = spread(minPosition, maxPosition, params.steps);
+    size_t target = 0;
+    bool fine = false;
+    // Half a step: a lens reporting a position that close has arrived
+    float tolerance = 0.5f * (maxPosition - minPosition) / static_cast<float>(params.steps - 1);
+    auto aim = [&](ControlList& list) {
+        applyControls(list);
+        if (info.count(controls::AF_MODE)) {
+            list.set(controls::AfMode, controls::AfModeManual);
+        }
+        list.set(controls::LensPosition, targets[target]);
+    };
+
+    Stream* stream = streamConfig.stream();
+    FrameBufferAllocator allocator(camera);
+    if (allocator.allocate(stream) <= 0) {
+        return -ENOMEM;
+    }
+    std::vector<std::unique_ptr<Request>> requests;
+    std::map<const FrameBuffer*, std::unique_ptr<MappedFrame>> mapped;
+    for (const auto& buffer : allocator.buffers(stream)) {
+        auto request = camera->createRequest();
+        auto mapping = std::make_unique<MappedFrame>();
+        if (!request || request->addBuffer(stream, buffer.get()) < 0 || !mapping->map(buffer.get())) {
+            return -ENOMEM;
+        }
+        aim(request->controls());
+        mapped[buffer.get()] = std::move(mapping);
+        requests.push_back(std::move(request));
+    }
+
+    lc4j::FrameView frame;
+    frame.fourcc = streamConfig.pixelFormat.fourcc();
+    frame.width = static_cast<int32_t>(streamConfig.size.width);
+    frame.height = static_cast<int32_t>(streamConfig.size.height);
+    const auto stride = static_cast<int32_t>(streamConfig.stride);
+
+    std::memset(&out, 0, sizeof(out));
+    out.bestSharpness = -1.0f;
+    out.afState = -1;
+    out.focusFoM = -1;
+    camera->requestCompleted.connect(this, &Session::onRequestCompleted);
+    startSequence(LC4J_SESSION_STREAM_FOCUS, streamConfig);
+    ret = camera->start();
+    bool done = false;
+    if (ret == 0) {
+        for (auto& request : requests) {
+            camera->queueRequest(request.get());
+        }
+        // Requests already queued still ask for the previous position, so a
+        // lens that does not report where it is gets that many frames more;
+        // one that never gets close enough is measured where it stopped.
+        const auto inFlight = static_cast<int32_t>(requests.size());
+        int32_t sinceMove = -warmupFrames;
+        while (!done) {
+            Request* request = waitCompleted();
+            if (request == nullptr) {
+                ret = -ETIMEDOUT;
+                break;
+            }
+            if (request->status() != Request::RequestComplete) {
+                ret = -EIO;
+                break;
+            }
+            ++sinceMove;
+            const ControlList& metadata = request->metadata();
+            const auto reported = metadata.get(controls::LensPosition);
+            const bool arrived = reported ? std::abs(*reported - targets[target]) <= tolerance
+                                            && sinceMove >= params.settleFrames
+                                          : sinceMove >= params.settleFrames + inFlight;
+            const FrameBuffer* buffer = request->buffers().begin()->second;
+            if ((arrived || sinceMove >= params.settleFrames + 2 * inFlight)
+                    && buffer->metadata().status == FrameMetadata::FrameSuccess
+                    && describeYuv(*mapped[buffer], stride, frame)) {
+                const double sharpness = lc4j::focusMeasure(frame, params.left, params.top, params.right,
+                                                            params.bottom);
+                if (sharpness < 0) {
+                    ret = -ENOTSUP;
+                    break;
+                }
+                const float position = reported.value_or(targets[target]);
+                out.positions[out.count] = position;
+                out.sharpness[out.count] = static_cast<float>(sharpness);
+                out.count++;
+                if (sharpness > out.bestSharpness) {
+                    out.bestPosition = position;
+                    out.bestSharpness = static_cast<float>(sharpness);
+                    out.afState = metadata.get(controls::AfState).value_or(-1);
+                    out.focusFoM = metadata.get(controls::FocusFoM).value_or(-1);
+                }
+                if (++target == targets.size()) {
+                    if (fine) {
+                        done = true;
+                        break;
+                    }
+                    const auto best = static_cast<size_t>(
+                            std::max_element(out.sharpness, out.sharpness + out.count) - out.sharpness);
+                    const std::vector<float> coarse = targets;
+                    const float from = coarse[best > 0 ? best - 1 : 0];
+                    const float to = coarse[std::min(best + 1, coarse.size() - 1)];
+                    targets = spread(from, to, params.steps);
+                    tolerance = 0.5f * (to - from) / static_cast<float>(params.steps - 1);
+                    target = 0;
+                    fine = true;
+                }
+                sinceMove = 0;
+            }
+            request->reuse(Request::ReuseBuffers);
+            aim(request->controls());
+            camera->queueRequest(request);
+        }
+        camera->stop();
+    }
+    camera->requestCompleted.disconnect(this);
+    {
+        std::lock_guard<std::mutex> lock(completedMutex_);
+        completed_.clear();
+    }
+    if (!done) {
+        return ret < 0 ? ret : -EIO;
+    }
+    return 0;
+}
+
+int32_t Session::startMonitor(int64_t motionHandle, int32_t monitorWidth, int32_t monitorHeight) {
+    stopMonitor();
+    std::lock_guard<std::mutex> lock(monitorControlMutex_);
+    motionHandle_ = motionHandle;
+    monitorWidth_ = monitorWidth;
+    monitorHeight_ = monitorHeight;
+    monitorStop_ = false;
+    monitor_ = std::thread(&Session::monitorLoop, this);
+    return 0;
+}
+
+void Session::monitorLoop() {
+    std::unique_lock<std::mutex> lock(captureMutex);
+    while (!monitorStop_) {
+        monitorCond.wait(lock, [this] { return monitorStop_ || capturePending == 0; });
+        if (monitorStop_) {
+            break;
+        }
+        int32_t ret = monitor();
+        if (ret == -1) {
+            break;      // the detector was closed
+        }
+        if (ret < 0) {
+            // Give the camera a moment rather than spinning on a failure
+            monitorCond.wait_for(lock, MONITOR_RETRY, [this] { return monitorStop_.load(); });
+        }
+    }
+}
+
+// Streams to the detector, with captureMutex held, until a capture is waiting
+// or the monitor is stopped.
+int32_t Session::monitor() {
+    std::unique_ptr<CameraConfiguration> config = camera->generateConfiguration({StreamRole::Viewfinder});
+    if (!config || config->empty()) {
+        return -ENOTSUP;
+    }
+    StreamConfiguration& streamConfig = config->at(0);
+    streamConfig.size = Size(monitorWidth_, monitorHeight_);
+    const auto supported = streamConfig.formats().pixelformats();
+    if (std::find(supported.begin(), supported.end(), formats::YUV420) != supported.end()) {
+        streamConfig.pixelFormat = formats::YUV420;
+    }
+    streamConfig.bufferCount = MONITOR_BUFFER_COUNT;
+    if (config->validate() == CameraConfiguration::Invalid) {
+        return -EINVAL;
+    }
+    int ret = camera->configure(config.get());
+    if (ret < 0) {
+        return ret;
+    }
+
+    Stream* stream = streamConfig.stream();
+    FrameBufferAllocator allocator(camera);
+    if (allocator.allocate(stream) <= 0) {
+        return -ENOMEM;
+    }
+    // Buffers are mapped once for the whole run, not per frame
+    std::vector<std::unique_ptr<Request>> requests;
+    std::map<const FrameBuffer*, std::unique_ptr<MappedFrame>> mapped;
+    for (const auto& buffer : allocator.buffers(stream)) {
+        auto request = camera->createRequest();
+        auto mapping = std::make_unique<MappedFrame>();
+        if (!request || request->addBuffer(stream, buffer.get()) < 0 || !mapping->map(buffer.get())) {
+            return -ENOMEM;
+        }
+        applyControls(request->controls());
+        mapped[buffer.get()] = std::move(mapping);
+        requests.push_back(std::move(request));
+    }
+
+    lc4j::FrameView frame;
+    frame.fourcc = streamConfig.pixelFormat.fourcc();
+    frame.width = static_cast<int32_t>(streamConfig.size.width);
+    frame.height = static_cast<int32_t>(streamConfig.size.height);
+    const auto stride = static_cast<int32_t>(streamConfig.stride);
+
+    camera->requestCompleted.connect(this, &Session::onRequestCompleted);
+    startSequence(LC4J_SESSION_STREAM_MONITOR, streamConfig);
+    ret = camera->start();
+    if (ret == 0) {
+        for (auto& request : requests) {
+            camera->queueRequest(request.get());
+        }
+        auto lastFrame = std::chrono::steady_clock::now();
+        while (!monitorStop_ && capturePending == 0) {
+            Request* request = waitCompleted(MONITOR_POLL);
+            if (request == nullptr) {
+                if (std::chrono::steady_clock::now() - lastFrame > REQUEST_TIMEOUT) {
+                    ret = -ETIMEDOUT;
+                    break;
+                }
+                continue;
+            }
+            lastFrame = std::chrono::steady_clock::now();
+            if (request->status() != Request::RequestComplete) {
+                ret = -EIO;
+                break;
+            }
+            const FrameBuffer* buffer = request->buffers().begin()->second;
+            if (buffer->metadata().status == FrameMetadata::FrameSuccess
+                    && describeYuv(*mapped[buffer], stride, frame)) {
+                ret = lc4j::motionProcess(motionHandle_, frame, buffer->metadata().sequence,
+                                          static_cast<int64_t>(buffer->metadata().timestamp));
+                if (ret == -1) {
+                    break;
+                }
+                ret = 0;
+            }
+            request->reuse(Request::ReuseBuffers);
+            applyControls(request->controls());
+            camera->queueRequest(request);
+        }
+        camera->stop();
+    }
+    camera->requestCompleted.disconnect(this);
+    {
+        std::lock_guard<std::mutex> lock(completedMutex_);
+        completed_.clear();
+    }
+    return ret;
+}
+
+std::mutex g_sessionsMutex;
+std::map<int64_t, std::shared_ptr<Session>> g_sessions;
+
+std::shared_ptr<Session> findSession(int64_t handle) {
+    std::lock_guard<std::mutex> lock(g_sessionsMutex);
+    auto it = g_sessions.find(handle);
+    return it == g_sessions.end() ? nullptr : it->second;
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// CaptureSession
+// -----------------------------------------------------------------------------
+
+extern "C" {
+
+int64_t lc4j_session_open(int32_t width, int32_t height, int32_t warmupFrames) {
+    try {
+        auto session = std::make_shared<Session>();
+        session->width = width;
+        session->height = height;
+        session->warmupFrames = warmupFrames > 0 ? warmupFrames : DEFAULT_WARMUP_FRAMES;
+
+        auto manager = std::make_shared<CameraManager>();
+        if (manager->start() < 0) {
+            return 0;
+        }
+        session->manager = manager;
+        auto cameras = manager->cameras();
+        if (cameras.empty() || cameras[0]->acquire() < 0) {
+            return 0;
+        }
+        session->camera = cameras[0];
+
+        int64_t handle = lc4j::allocHandle();
+        std::lock_guard<std::mutex> lock(g_sessionsMutex);
+        g_sessions[handle] = std::move(session);
+        return handle;
+    } catch (const std::exception&) {
+        return 0;
+    }
+}
+
+void lc4j_session_close(int64_t handle) {
+    std::shared_ptr<Session> session;
+    {
+        std::lock_guard<std::mutex> lock(g_sessionsMutex);
+        auto it = g_sessions.find(handle);
+        if (it == g_sessions.end()) {
+            return;
+        }
+        session = std::move(it->second);
+        g_sessions.erase(it);
+    }
+    // Wait for the monitor and a capture in progress; the camera is released
+    // when the last reference goes away.
+    session->stopMonitor();
+    std::lock_guard<std::mutex> lock(session->captureMutex);
+}
+
+void lc4j_session_set_transform(int64_t handle, int32_t transform) {
+    auto session = findSession(handle);
+    if (session) {
+        CameraLock lock(*session);
+        session->transform = transform & 7;
+    }
+}
+
+void lc4j_session_set_controls(int64_t handle, int32_t afMode, float lensPosition, int32_t aeEnable,
+                               int32_t exposureUs, float analogueGain) {
+    auto session = findSession(handle);
+    if (session) {
+        CameraLock lock(*session);
+        session->settings.set = true;
+        session->settings.afMode = afMode;
+        session->settings.lensPosition = lensPosition;
+        session->settings.aeEnable = aeEnable != 0;
+        session->settings.exposureUs = exposureUs;
+        session->settings.analogueGain = analogueGain;
+    }
+}
+
+int32_t lc4j_session_set_stats_grid(int64_t handle, int32_t zonesX, int32_t zonesY) {
+    if (zonesX < 1 || zonesY < 1 || zonesX > MAX_STATS_ZONES || zonesY > MAX_STATS_ZONES) {
+        return -EINVAL;
+    }
+    auto session = findSession(handle);
+    if (!session) {
+        return -1;
+    }
+    CameraLock lock(*session);
+    session->statsZonesX = zonesX;
+    session->statsZonesY = zonesY;
+    return 0;
+}
+
+int32_t lc4j_session_set_burst(int64_t handle, int32_t frames, int32_t flags) {
+    if (frames < 1 || frames > LC4J_BURST_MAX_FRAMES || (flags & ~LC4J_BURST_ALIGN) != 0) {
+        return -EINVAL;
+    }
+    auto session = findSession(handle);
+    if (!session) {
+        return -1;
+    }
+    CameraLock lock(*session);
+    session->burstFrames = frames;
+    session->burstAlign = (flags & LC4J_BURST_ALIGN) != 0;
+    return 0;
+}
+
+int32_t lc4j_session_set_bracket(int64_t handle, const float* evStops, int32_t count) {
+    if (count < 0 || count == 1 || count > LC4J_BRACKET_MAX_FRAMES || (count > 0 && evStops == nullptr)) {
+        return -EINVAL;
+    }
+    for (int32_t i = 0; i < count; ++i) {
+        if (!(std::abs(evStops[i]) <= LC4J_BRACKET_MAX_EV)) {
+            return -EINVAL;
+        }
+    }
+    auto session = findSession(handle);
+    if (!session) {
+        return -1;
+    }
+    CameraLock lock(*session);
+    session->bracketEv.assign(evStops, evStops + count);
+    return 0;
+}
+
+int32_t lc4j_session_set_denoise(int64_t handle, float minGain, float strength) {
+    if (!(minGain >= 0.0f && minGain <= LC4J_DENOISE_MAX_GAIN)
+        || !(strength >= 0.0f && strength <= LC4J_DENOISE_MAX_STRENGTH)) {
+        return -EINVAL;
+    }
+    auto session = findSession(handle);
+    if (!session) {
+        return -1;
+    }
+    CameraLock lock(*session);
+    session->denoiseMinGain = minGain;
+    session->denoiseStrength = strength;
+    return 0;
+}
+
+int32_t lc4j_session_set_waterline(int64_t handle, const lc4j_waterline_params* params) {
+    if (params != nullptr) {
+        const lc4j_waterline_params& p = *params;
+        if (!(p.left >= 0.0f && p.left < p.right && p.right <= 1.0f)
+            || !(p.top >= 0.0f && p.top < p.bottom && p.bottom <= 1.0f)
+            || !std::isfinite(p.row0) || !std::isfinite(p.row1) || p.row0 == p.row1
+            || !std::isfinite(p.level0) || !std::isfinite(p.level1)) {
+            return -EINVAL;
+        }
+    }
+    auto session = findSession(handle);
+    if (!session) {
+        return -1;
+    }
+    CameraLock lock(*session);
+    session->waterline = params != nullptr;
+    if (params != nullptr) {
+        session->waterlineParams = *params;
+    }
+    return 0;
+}
+
+int32_t lc4j_session_focus_sweep(int64_t handle, const lc4j_focus_params* params, lc4j_focus_result* out) {
+    if (params == nullptr || out == nullptr) {
+        return -EINVAL;
+    }
+    lc4j_focus_params p = *params;
+    if (p.width == 0 && p.height == 0) {
+        p.width = DEFAULT_FOCUS_WIDTH;
+        p.height = DEFAULT_FOCUS_HEIGHT;
+    }
+    p.steps = p.steps == 0 ? DEFAULT_FOCUS_STEPS : p.steps;
+    p.settleFrames = p.settleFrames == 0 ? DEFAULT_FOCUS_SETTLE_FRAMES : p.settleFrames;
+    if (p.left == 0.0f && p.top == 0.0f && p.right == 0.0f && p.bottom == 0.0f) {
+        p.left = 0.25f;
+        p.top = 0.25f;
+        p.right = 0.75f;
+        p.bottom = 0.75f;
+    }
+    if (p.width <= 0 || p.height <= 0 || p.steps < 3 || p.steps > LC4J_FOCUS_MAX_STEPS || p.settleFrames < 0
+        || !(p.left >= 0.0f && p.left < p.right && p.right <= 1.0f)
+        || !(p.top >= 0.0f && p.top < p.bottom && p.bottom <= 1.0f)) {
+        return -EINVAL;
+    }
+    auto session = findSession(handle);
+    if (!session) {
+        return -1;
+    }
+    CameraLock lock(*session);
+    try {
+        return session->focusSweep(p, *out);
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+}
+
+int32_t lc4j_session_monitor_start(int64_t handle, int64_t motionHandle, int32_t width, int32_t height) {
+    if (width <= 0 || height <= 0) {
+        return -EINVAL;
+    }
+    auto session = findSession(handle);
+    if (!session) {
+        return -1;
+    }
+    try {
+        return session->startMonitor(motionHandle, width, height);
+    } catch (const std::system_error&) {
+        return -EAGAIN;
+    }
+}
+
+void lc4j_session_monitor_stop(int64_t handle) {
+    auto session = findSession(handle);
+    if (session) {
+        session->stopMonitor();
+    }
+}
+
+int32_t lc4j_capture_to_file(int64_t handle, const char* path, int32_t format, int32_t quality,
+                             lc4j_capture_result* out) {
+    if (path == nullptr || (format != LC4J_CAPTURE_JPEG && format != LC4J_CAPTURE_DNG)) {
+        return -EINVAL;
+    }
+    auto session = findSession(handle);
+    if (!session) {
+        return -1;
+    }
+    CameraLock lock(*session);
+    try {
+        const std::string destination(path);
+        return session->capture(format, quality, [&destination](const lc4j::FrameView&,
+                                                                const std::vector<uint8_t>& encoded) {
+            return lc4j::writeFileSync(destination, encoded.data(), encoded.size(),
+                                       LC4J_WRITE_MKDIRS | LC4J_WRITE_ATOMIC);
+        }, out);
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+}
+
+int32_t lc4j_capture_to_store(int64_t handle, int64_t storeHandle, int64_t timestampMs, int32_t quality,
+                              lc4j_capture_result* out) {
+    return lc4j_capture_to_store_tiers(handle, storeHandle, timestampMs, quality, nullptr, 0, out);
+}
+
+int32_t lc4j_capture_to_store_tiers(int64_t handle, int64_t storeHandle, int64_t timestampMs, int32_t quality,
+                                    const lc4j_thumbnail_tier* tiers, int32_t tierCount,
+                                    lc4j_capture_result* out) {
+    if (tierCount < 0 || (tierCount > 0 && tiers == nullptr)) {
+        return -EINVAL;
+    }
+    auto session = findSession(handle);
+    if (!session) {
+        return -1;
+    }
+    // Largest tier first, so that each one is averaged down from the previous
+    // one rather than from the full frame.
+    std::vector<lc4j_thumbnail_tier> order(tiers, tiers + tierCount);
+    std::sort(order.begin(), order.end(), [](const lc4j_thumbnail_tier& a, const lc4j_thumbnail_tier& b) {
+        return a.maxSize > b.maxSize;
+    });
+    CameraLock lock(*session);
+    try {
+        return session->capture(LC4J_CAPTURE_JPEG, quality, [&](const lc4j::FrameView& frame,
+                                                                const std::vector<uint8_t>& encoded) {
+            // Encode every tier while the buffer is mapped, then store the frame
+            // and its thumbnails; a tier is never stored without its frame.
+            std::vector<std::vector<uint8_t>> thumbnails(order.size());
+            lc4j::OwnedFrame scaled[2];
+            const lc4j::FrameView* source = &frame;
+            for (size_t i = 0; i < order.size(); ++i) {
+                lc4j::OwnedFrame& target = scaled[i % 2];
+                int32_t ret = lc4j::downscaleFrame(*source, order[i].maxSize, target);
+                if (ret == 0) {
+                    ret = lc4j::encodeJpeg(target.view, session->transform, order[i].quality, thumbnails[i]);
+                }
+                if (ret < 0) {
+                    return ret;
+                }
+                source = &target.view;
+            }
+            // Hashed from the mapped luma rather than by decoding the JPEG again
+            uint64_t hash = 0;
+            const bool hashed = lc4j::perceptualHash(frame, session->transform, hash) == 0;
+            const int64_t tag = static_cast<int64_t>(hash);
+            int32_t ret = lc4j::storeAppend(storeHandle, timestampMs, encoded.data(), encoded.size(),
+                                            hashed ? &tag : nullptr);
+            for (size_t i = 0; i < order.size() && ret == 0; ++i) {
+                ret = lc4j::storeAppend(order[i].storeHandle, timestampMs, thumbnails[i].data(), thumbnails[i].size());
+            }
+            return ret;
+        }, out);
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+}
+
+int32_t lc4j_stats_snapshot(int64_t handle, lc4j_stats* out, int32_t reset) {
+    if (out == nullptr) {
+        return -EINVAL;
+    }
+    auto session = findSession(handle);
+    if (!session) {
+        return -1;
+    }
+    // The counters have a lock of their own; no need to wait for a capture
+    session->latency.snapshot(*out, reset != 0);
+    return 0;
+}
+
+int32_t lc4j_histogram_snapshot(int64_t handle, int32_t histogram, lc4j_latency_histogram* out, int32_t reset) {
+    if (out == nullptr || histogram < 0 || histogram >= LC4J_HISTOGRAM_COUNT) {
+        return -EINVAL;
+    }
+    auto session = findSession(handle);
+    if (!session) {
+        return -1;
+    }
+    session->histograms[histogram].snapshot(*out, reset != 0);
+    return 0;
+}
+
+int32_t lc4j_session_sequence_stats(int64_t handle, int32_t stream, lc4j_sequence_stats* out, int32_t reset) {
+    if (out == nullptr || stream < 0 || stream >= LC4J_SESSION_STREAM_COUNT) {
+        return -EINVAL;
+    }
+    auto session = findSession(handle);
+    if (!session) {
+        return -1;
+    }
+    session->sequenceStats(stream, *out, reset != 0);
+    return 0;
+}
+
+int32_t lc4j_capture_to_dng_stream(int64_t handle, int64_t* streamOut, lc4j_capture_result* out) {
+    if (streamOut == nullptr) {
+        return -EINVAL;
+    }
+    *streamOut = 0;
+    auto session = findSession(handle);
+    if (!session) {
+        return -1;
+    }
+    CameraLock lock(*session);
+    try {
+        return session->capture(LC4J_CAPTURE_DNG, 0, nullptr, out, [streamOut](const lc4j::FrameView& frame,
+                                                                             const lc4j::RawInfo& raw,
+                                                                             const lc4j::DngMetadata& meta) {
+            int64_t size = 0;
+            int32_t ret = lc4j::openDngStream(frame, raw, meta, *streamOut, size);
+            return ret < 0 ? static_cast<int64_t>(ret) : size;
+        });
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+}
+
+} // extern "C"
@@ -0,0 +1,215 @@
+/*
+ * libcamera4j - edge-preserving denoise of high-gain frames.
+ *
+ * At night the sensor runs at high analogue gain and its noise, speckle in
+ * luma and blotches in chroma, is both ugly and expensive: JPEG spends most of
+ * its bits on it. Each plane is smoothed by a self-guided filter (He, Sun and
+ * Tang), which fits every 5x5 window with a linear function of the plane
+ * itself: where the window varies much more than the noise, as across an
+ * edge, the fit is the plane and it passes through; where it is flat, the fit
+ * is the window mean. Averaging the fits of the windows covering a pixel makes
+ * the output. Chroma planes are half the size, so the same windows smooth
+ * twice as far there, where the eye minds blur least.
+ *
+ * A plane is worked through in bands of rows, on a few threads, each band
+ * padded by the rows its windows reach into, so the scratch is a few rows of
+ * floats however large the frame. The window sums are plain float loops over
+ * contiguous rows, which the compiler vectorises (NEON on the Pi). Frames keep
+ * their layout, planar or semi-planar YUV 4:2:0, with tight strides.
+ */
+
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <new>
+#include <vector>
+
+namespace {
+
+// Window radius, 5x5 windows
+constexpr int32_t kRadius = 2;
+constexpr int32_t kWindow = 2 * kRadius + 1;
+// Regularisation as a multiple of the noise variance
+constexpr float kEpsScale = 4.0f;
+// Output rows per band
+constexpr int32_t kBandRows = 32;
+
+bool isPlanar420(uint32_t fourcc) {
+    return fourcc == lc4j::fourcc('Y', 'U', '1', '2') || fourcc == lc4j::fourcc('Y', 'V', '1', '2');
+}
+
+bool isSemiPlanar420(uint32_t fourcc) {
+    return fourcc == lc4j::fourcc('N', 'V', '1', '2') || fourcc == lc4j::fourcc('N', 'V', '2', '1');
+}
+
+// One channel of a plane, its samples `step` bytes apart.
+struct Channel {
+    const uint8_t* src;
+    int32_t srcStride;
+    uint8_t* dst;
+    int32_t dstStride;
+    int32_t step;
+    int32_t width;
+    int32_t height;
+};
+
+struct Scratch {
+    std::vector<float> in;      // band rows padded by 2 radii, columns too
+    std::vector<float> a, b;    // window fits, padded by a radius
+    std::vector<float> sums, squares;
+};
+
+// Sums of kWindow consecutive rows of `rows` (each `stride` wide) into `out`,
+// for `count` starting rows.
+void verticalSums(const float* rows, int32_t stride, int32_t width, int32_t count, bool squares, float* out) {
+    for (int32_t j = 0; j < count; ++j) {
+        float* o = out + static_cast<size_t>(j) * stride;
+        std::fill(o, o + width, 0.0f);
+        for (int32_t t = 0; t < kWindow; ++t) {
+            const float* r = rows + static_cast<size_t>(j + t) * stride;
+            if (squares) {
+                for (int32_t x = 0; x < width; ++x) {
+                    o[x] += r[x] * r[x];
+                }
+            } else {
+                for (int32_t x = 0; x < width; ++x) {
+                    o[x] += r[x];
+                }
+            }
+        }
+    }
+}
+
+// Sums of kWindow consecutive columns, in place: out[x] = in[x] + ... + in[x + 2r].
+void horizontalSums(float* row, int32_t width) {
+    for (int32_t x = 0; x + kWindow <= width; ++x) {
+        float s = row[x];
+        for (int32_t t = 1; t < kWindow; ++t) {
+            s += row[x + t];
+        }
+        row[x] = s;
+    }
+}
+
+void filterBand(const Channel& c, int32_t y0, int32_t y1, float eps, Scratch& s) {
+    const int32_t pad = 2 * kRadius;
+    const int32_t stride = c.width + 2 * pad;
+    const int32_t inRows = y1 - y0 + 2 * pad;
+    s.in.resize(static_cast<size_t>(stride) * inRows);
+    for (int32_t j = 0; j < inRows; ++j) {
+        const int32_t y = std::clamp(y0 - pad + j, 0, c.height - 1);
+        const uint8_t* src = c.src + static_cast<size_t>(y) * c.srcStride;
+        float* row = s.in.data() + static_cast<size_t>(j) * stride;
+        for (int32_t x = 0; x < stride; ++x) {
+            row[x] = src[std::clamp(x - pad, 0, c.width - 1) * c.step];
+        }
+    }
+
+    // Fits of the windows centred on rows [y0 - r, y1 + r) and columns [-r, width + r)
+    const int32_t fitRows = y1 - y0 + 2 * kRadius;
+    const int32_t fitWidth = c.width + 2 * kRadius;
+    const size_t fitSize = static_cast<size_t>(stride) * fitRows;
+    s.sums.resize(fitSize);
+    s.squares.resize(fitSize);
+    s.a.resize(fitSize);
+    s.b.resize(fitSize);
+    verticalSums(s.in.data(), stride, stride, fitRows, false, s.sums.data());
+    verticalSums(s.in.data(), stride, stride, fitRows, true, s.squares.data());
+    const float norm = 1.0f / (kWindow * kWindow);
+    for (int32_t j = 0; j < fitRows; ++j) {
+        float* sum = s.sums.data() + static_cast<size_t>(j) * stride;
+        float* square = s.squares.data() + static_cast<size_t>(j) * stride;
+        horizontalSums(sum, stride);
+        horizontalSums(square, stride);
+        float* a = s.a.data() + static_cast<size_t>(j) * stride;
+        float* b = s.b.data() + static_cast<size_t>(j) * stride;
+        for (int32_t x = 0; x < fitWidth; ++x) {
+            const float mean = sum[x] * norm;
+            const float variance = std::max(0.0f, square[x] * norm - mean * mean);
+            a[x] = variance / (variance + eps);
+            b[x] = mean - a[x] * mean;
+        }
+    }
+
+    // Each pixel takes the mean of the fits of the windows covering it
+    verticalSums(s.a.data(), stride, fitWidth, y1 - y0, false, s.sums.data());
+    verticalSums(s.b.data(), stride, fitWidth, y1 - y0, false, s.squares.data());
+    for (int32_t j = 0; j < y1 - y0; ++j) {
+        float* meanA = s.sums.data() + static_cast<size_t>(j) * stride;
+        float* meanB = s.squares.data() + static_cast<size_t>(j) * stride;
+        horizontalSums(meanA, fitWidth);
+        horizontalSums(meanB, fitWidth);
+        const float* in = s.in.data() + static_cast<size_t>(j + pad) * stride + pad;
+        uint8_t* dst = c.dst + static_cast<size_t>(y0 + j) * c.dstStride;
+        for (int32_t x = 0; x < c.width; ++x) {
+            const float v = (meanA[x] * in[x] + meanB[x]) * norm;
+            dst[x * c.step] = static_cast<uint8_t>(std::clamp(v + 0.5f, 0.0f, 255.0f));
+        }
+    }
+}
+
+// False if a thread ran out of memory for its scratch.
+bool filterChannel(const Channel& c, float eps) {
+    const int32_t bands = (c.height + kBandRows - 1) / kBandRows;
+    std::atomic<bool> failed{false};
+    lc4j::forRows(bands, 1, [&](int32_t begin, int32_t end) {
+        try {
+            Scratch scratch;
+            for (int32_t band = begin; band < end; ++band) {
+                filterBand(c, band * kBandRows, std::min(c.height, (band + 1) * kBandRows), eps, scratch);
+            }
+        } catch (const std::bad_alloc&) {
+            failed = true;
+        }
+    });
+    return !failed;
+}
+
+} // namespace
+
+int32_t lc4j::denoiseFrame(const FrameView& frame, float sigma, OwnedFrame& out) {
+    const bool planar = isPlanar420(frame.fourcc);
+    if (!planar && !isSemiPlanar420(frame.fourcc)) {
+        return -ENOTSUP;
+    }
+    if (frame.width < kWindow || frame.height < kWindow || !(sigma > 0.0f)) {
+        return -EINVAL;
+    }
+    const int32_t chromaW = (frame.width + 1) / 2;
+    const int32_t chromaH = (frame.height + 1) / 2;
+    try {
+        out.view = frame;
+        out.planes[0].resize(static_cast<size_t>(frame.width) * frame.height);
+        out.view.planes[0] = out.planes[0].data();
+        out.view.strides[0] = frame.width;
+        const int32_t chromaPlanes = planar ? 2 : 1;
+        const int32_t chromaStride = planar ? chromaW : chromaW * 2;
+        for (int32_t p = 1; p <= chromaPlanes; ++p) {
+            out.planes[p].resize(static_cast<size_t>(chromaStride) * chromaH);
+            out.view.planes[p] = out.planes[p].data();
+            out.view.strides[p] = chromaStride;
+        }
+        if (!planar) {
+            out.view.planes[2] = nullptr;
+            out.view.strides[2] = 0;
+        }
+
+        // The window variance of pure noise is about sigma^2, which this eps
+        // smooths to a fifth; windows varying well beyond (2 sigma)^2 are kept
+        const float eps = kEpsScale * sigma * sigma;
+        bool ok = filterChannel({frame.planes[0], frame.strides[0], out.planes[0].data(), frame.width, 1,
+                                 frame.width, frame.height}, eps);
+        for (int32_t c = 0; c < 2 && ok; ++c) {
+            const int32_t p = planar ? 1 + c : 1;
+            const int32_t offset = planar ? 0 : c;
+            ok = filterChannel({frame.planes[p] + offset, frame.strides[p], out.planes[p].data() + offset,
+                                chromaStride, planar ? 1 : 2, chromaW, chromaH}, eps);
+        }
+        return ok ? 0 : -ENOMEM;
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+}
@@ -0,0 +1,323 @@
+/*
+ * libcamera4j - parallel scanner for one-file-per-image directory trees.
+ *
+ * Before the frame store, timelapse images were saved as
+ *
+ *     <root>/<yyyy>/<mm>/<dd>/<yyyyMMdd_HHmmss>.jpg
+ *
+ * and listing them through java.nio meant a Path, a BasicFileAttributes and a
+ * handful of Strings per file. This scanner collects the (few hundred) day
+ * directories on the calling thread and then reads them from a small pool of
+ * threads with openat/getdents64 into a fixed buffer. Names are parsed in place
+ * and only matching files are stat'ed, relative to their directory fd, for the
+ * size. The result is one packed, timestamp-sorted lc4j_scan_entry array plus
+ * the list of day directories it refers to.
+ */
+
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t kDirentBufferSize = 32 * 1024;
+constexpr int32_t kMaxThreads = 8;
+constexpr size_t kNameLength = 19;   // yyyyMMdd_HHmmss.jpg
+
+// Layout of the records returned by getdents64 (glibc only exposes it as
+// struct dirent64 from 2.30 on).
+struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+// Calls fn(name, type) for every entry of an open directory.
+template <typename Fn>
+int32_t readDirectory(int fd, char* buffer, size_t size, Fn&& fn) {
+    for (;;) {
+        long n = syscall(SYS_getdents64, fd, buffer, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        if (n == 0) {
+            return 0;
+        }
+        for (long pos = 0; pos < n;) {
+            auto* entry = reinterpret_cast<LinuxDirent64*>(buffer + pos);
+            pos += entry->d_reclen;
+            fn(entry->d_name, entry->d_type);
+        }
+    }
+}
+
+bool parseDigits(const char* s, int count, int& value) {
+    value = 0;
+    for (int i = 0; i < count; i++) {
+        if (s[i] < '0' || s[i] > '9') {
+            return false;
+        }
+        value = value * 10 + (s[i] - '0');
+    }
+    return true;
+}
+
+bool isNumber(const char* name, size_t length) {
+    int ignored;
+    return std::strlen(name) == length && parseDigits(name, static_cast<int>(length), ignored);
+}
+
+// Parses yyyyMMdd_HHmmss.jpg, a local wall-clock time, into milliseconds since
+// the epoch, the same keys the Java side uses for the frame store. In the hour
+// repeated when daylight saving time ends the names are ambiguous; mktime picks
+// one of the two offsets.
+bool parseImageName(const char* name, int64_t& timestampMs) {
+    if (std::strlen(name) != kNameLength || name[8] != '_' || std::memcmp(name + 15, ".jpg", 4) != 0) {
+        return false;
+    }
+    int year, month, day, hour, minute, second;
+    if (!parseDigits(name, 4, year) || !parseDigits(name + 4, 2, month) || !parseDigits(name + 6, 2, day)
+        || !parseDigits(name + 9, 2, hour) || !parseDigits(name + 11, 2, minute)
+        || !parseDigits(name + 13, 2, second)) {
+        return false;
+    }
+    if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 59) {
+        return false;
+    }
+    struct tm tm;
+    std::memset(&tm, 0, sizeof(tm));
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = day;
+    tm.tm_hour = hour;
+    tm.tm_min = minute;
+    tm.tm_sec = second;
+    tm.tm_isdst = -1;
+    const time_t seconds = mktime(&tm);
+    if (seconds == static_cast<time_t>(-1)) {
+        return false;
+    }
+    timestampMs = static_cast<int64_t>(seconds) * 1000;
+    return true;
+}
+
+// d_type is DT_UNKNOWN on some file systems; fall back to a stat then.
+bool isDirectory(int dirFd, const char* name, unsigned char type) {
+    if (type != DT_UNKNOWN) {
+        return type == DT_DIR;
+    }
+    struct stat st;
+    return fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+}
+
+class Scan {
+public:
+    int32_t run(const char* root, int32_t threads);
+
+    const std::vector<lc4j_scan_entry>& entries() const { return entries_; }
+    const std::vector<std::string>& dirs() const { return dirs_; }
+
+private:
+    // Appends the subdirectories of rootFd/parent whose names are `digits` long.
+    int32_t listNumbered(int rootFd, const std::string& parent, size_t digits,
+                         std::vector<std::string>& out, char* buffer);
+    void scanDays(int rootFd, std::atomic<size_t>& next, std::vector<lc4j_scan_entry>& out);
+
+    std::vector<lc4j_scan_entry> entries_;
+    std::vector<std::string> dirs_;
+};
+
+int32_t Scan::listNumbered(int rootFd, const std::string& parent, size_t digits,
+                           std::vector<std::string>& out, char* buffer) {
+    int fd = openat(rootFd, parent.empty() ? "." : parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return -errno;
+    }
+    int32_t ret = readDirectory(fd, buffer, kDirentBufferSize, [&](const char* name, unsigned char type) {
+        if (isNumber(name, digits) && isDirectory(fd, name, type)) {
+            out.push_back(parent.empty() ? std::string(name) : parent + '/' + name);
+        }
+    });
+    close(fd);
+    return ret;
+}
+
+void Scan::scanDays(int rootFd, std::atomic<size_t>& next, std::vector<lc4j_scan_entry>& out) {
+    std::unique_ptr<char[]> buffer(new char[kDirentBufferSize]);
+    for (size_t i = next++; i < dirs_.size(); i = next++) {
+        int fd = openat(rootFd, dirs_[i].c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            continue;   // removed while scanning
+        }
+        readDirectory(fd, buffer.get(), kDirentBufferSize, [&](const char* name, unsigned char type) {
+            int64_t timestampMs;
+            if ((type != DT_REG && type != DT_UNKNOWN) || !parseImageName(name, timestampMs)) {
+                return;
+            }
+            struct stat st;
+            if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISREG(st.st_mode)) {
+                return;
+            }
+            lc4j_scan_entry entry{};
+            entry.timestampMs = timestampMs;
+            entry.size = st.st_size;
+            entry.dirId = static_cast<int32_t>(i);
+            out.push_back(entry);
+        });
+        close(fd);
+    }
+}
+
+int32_t Scan::run(const char* root, int32_t threads) {
+    tzset();    // once, before the workers call mktime
+    int rootFd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootFd < 0) {
+        return -errno;
+    }
+    std::unique_ptr<char[]> buffer(new char[kDirentBufferSize]);
+    std::vector<std::string> years, months;
+    int32_t ret = listNumbered(rootFd, "", 4, years, buffer.get());
+    for (const auto& year : years) {
+        if (ret == 0) {
+            ret = listNumbered(rootFd, year, 2, months, buffer.get());
+        }
+    }
+    for (const auto& month : months) {
+        if (ret == 0) {
+            ret = listNumbered(rootFd, month, 2, dirs_, buffer.get());
+        }
+    }
+    if (ret < 0) {
+        close(rootFd);
+        return ret;
+    }
+
+    if (threads <= 0) {
+        threads = static_cast<int32_t>(std::thread::hardware_concurrency());
+    }
+    threads = std::max(1, std::min({threads, kMaxThreads, static_cast<int32_t>(dirs_.size())}));
+    std::atomic<size_t> next{0};
+    std::vector<std::vector<lc4j_scan_entry>> results(threads);
+    std::vector<std::thread> workers;
+    for (int32_t t = 1; t < threads; t++) {
+        workers.emplace_back([&, t] { scanDays(rootFd, next, results[t]); });
+    }
+    scanDays(rootFd, next, results[0]);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    close(rootFd);
+
+    size_t total = 0;
+    for (const auto& result : results) {
+        total += result.size();
+    }
+    entries_.reserve(total);
+    for (const auto& result : results) {
+        entries_.insert(entries_.end(), result.begin(), result.end());
+    }
+    std::sort(entries_.begin(), entries_.end(), [](const lc4j_scan_entry& a, const lc4j_scan_entry& b) {
+        return a.timestampMs != b.timestampMs ? a.timestampMs < b.timestampMs : a.dirId < b.dirId;
+    });
+    return 0;
+}
+
+std::mutex g_scansMutex;
+std::map<int64_t, std::shared_ptr<Scan>> g_scans;
+
+std::shared_ptr<Scan> findScan(int64_t handle) {
+    std::lock_guard<std::mutex> lock(g_scansMutex);
+    auto it = g_scans.find(handle);
+    return it == g_scans.end() ? nullptr : it->second;
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// DirScanner
+// -----------------------------------------------------------------------------
+
+extern "C" {
+
+int64_t lc4j_scan_open(const char* root, int32_t threads) {
+    if (root == nullptr) {
+        return 0;
+    }
+    try {
+        auto scan = std::make_shared<Scan>();
+        if (scan->run(root, threads) < 0) {
+            return 0;
+        }
+        int64_t handle = lc4j::allocHandle();
+        std::lock_guard<std::mutex> lock(g_scansMutex);
+        g_scans[handle] = std::move(scan);
+        return handle;
+    } catch (const std::exception&) {
+        return 0;
+    }
+}
+
+void lc4j_scan_close(int64_t handle) {
+    std::lock_guard<std::mutex> lock(g_scansMutex);
+    g_scans.erase(handle);
+}
+
+int32_t lc4j_scan_count(int64_t handle) {
+    auto scan = findScan(handle);
+    return scan ? static_cast<int32_t>(scan->entries().size()) : -1;
+}
+
+int32_t lc4j_scan_entries(int64_t handle, lc4j_scan_entry* out, int32_t max) {
+    auto scan = findScan(handle);
+    if (!scan) {
+        return -1;
+    }
+    if (out == nullptr || max < 0) {
+        return -EINVAL;
+    }
+    size_t n = std::min(scan->entries().size(), static_cast<size_t>(max));
+    std::memcpy(out, scan->entries().data(), n * sizeof(lc4j_scan_entry));
+    return static_cast<int32_t>(n);
+}
+
+int32_t lc4j_scan_dir_count(int64_t handle) {
+    auto scan = findScan(handle);
+    return scan ? static_cast<int32_t>(scan->dirs().size()) : -1;
+}
+
+int32_t lc4j_scan_dir(int64_t handle, int32_t dirId, char* buf, int32_t buflen) {
+    auto scan = findScan(handle);
+    if (!scan || dirId < 0 || static_cast<size_t>(dirId) >= scan->dirs().size() || buf == nullptr || buflen <= 0) {
+        return -1;
+    }
+    const std::string& dir = scan->dirs()[dirId];
+    if (dir.size() >= static_cast<size_t>(buflen)) {
+        return -1;
+    }
+    std::memcpy(buf, dir.c_str(), dir.size() + 1);
+    return static_cast<int32_t>(dir.size());
+}
+
+} // extern "C"
@@ -0,0 +1,163 @@
+/*
+ * libcamera4j - DNG files produced piece by piece.
+ *
+ * A 16-bit DNG of a 12 MP sensor is ~24 MB, and building it in one buffer
+ * before sending it anywhere means holding that on top of the raw frame. A DNG
+ * stream keeps only the DNG header and the frame's packed rows (10 or 12 bits
+ * per pixel, a third less than the DNG itself) and unpacks a row at a time as
+ * the reader asks for more. Readers pass their own buffer, so a download of
+ * any size costs one chunk of memory on their side.
+ */
+
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+class DngStream {
+public:
+    int32_t open(const lc4j::FrameView& frame, const lc4j::RawInfo& raw, const lc4j::DngMetadata& meta) {
+        if (frame.planes[0] == nullptr) {
+            return -EINVAL;
+        }
+        int32_t ret = lc4j::encodeDngHeader(frame.width, frame.height, raw, meta, header_);
+        if (ret < 0) {
+            return ret;
+        }
+        width_ = frame.width;
+        height_ = frame.height;
+        packing_ = raw.packing;
+        packedRowBytes_ = lc4j::rawRowBytes(frame.width, raw.packing);
+        rowBytes_ = static_cast<size_t>(frame.width) * 2;
+        // Dropping the stride padding while copying
+        packed_.resize(packedRowBytes_ * frame.height);
+        for (int32_t y = 0; y < frame.height; ++y) {
+            std::memcpy(packed_.data() + packedRowBytes_ * y,
+                        frame.planes[0] + static_cast<size_t>(y) * frame.strides[0], packedRowBytes_);
+        }
+        scratch_.resize(static_cast<size_t>(frame.width));
+        row_.resize(rowBytes_);
+        return 0;
+    }
+
+    int64_t size() const {
+        return static_cast<int64_t>(header_.size() + rowBytes_ * height_);
+    }
+
+    int64_t read(uint8_t* buffer, size_t capacity) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t written = 0;
+        if (position_ < header_.size()) {
+            size_t n = std::min(capacity, header_.size() - position_);
+            std::memcpy(buffer, header_.data() + position_, n);
+            position_ += n;
+            written += n;
+        }
+        while (written < capacity && position_ < static_cast<size_t>(size())) {
+            const size_t pixels = position_ - header_.size();
+            const int32_t y = static_cast<int32_t>(pixels / rowBytes_);
+            const size_t offset = pixels % rowBytes_;
+            const size_t n = std::min(capacity - written, rowBytes_ - offset);
+            if (offset == 0 && n == rowBytes_) {
+                // A whole row fits: unpack it straight into the caller's buffer
+                unpack(y, buffer + written);
+            } else {
+                if (y != cachedRow_) {
+                    unpack(y, row_.data());
+                    cachedRow_ = y;
+                }
+                std::memcpy(buffer + written, row_.data() + offset, n);
+            }
+            position_ += n;
+            written += n;
+        }
+        return static_cast<int64_t>(written);
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<uint8_t> header_;
+    std::vector<uint8_t> packed_;
+    std::vector<uint16_t> scratch_;
+    std::vector<uint8_t> row_;          // the row a read ended in the middle of
+    int32_t cachedRow_ = -1;
+    int32_t width_ = 0;
+    int32_t height_ = 0;
+    lc4j::RawPacking packing_ = lc4j::RawPacking::Csi2p10;
+    size_t packedRowBytes_ = 0;
+    size_t rowBytes_ = 0;
+    size_t position_ = 0;
+
+    void unpack(int32_t y, uint8_t* dst) {
+        lc4j::encodeDngRow(packed_.data() + packedRowBytes_ * y, width_, packing_, scratch_.data(), dst);
+    }
+};
+
+std::mutex g_streamsMutex;
+std::map<int64_t, std::shared_ptr<DngStream>> g_streams;
+
+std::shared_ptr<DngStream> findStream(int64_t handle) {
+    std::lock_guard<std::mutex> lock(g_streamsMutex);
+    auto it = g_streams.find(handle);
+    return it == g_streams.end() ? nullptr : it->second;
+}
+
+} // namespace
+
+int32_t lc4j::openDngStream(const FrameView& frame, const RawInfo& raw, const DngMetadata& meta,
+                            int64_t& handle, int64_t& size) {
+    try {
+        auto stream = std::make_shared<DngStream>();
+        int32_t ret = stream->open(frame, raw, meta);
+        if (ret < 0) {
+            return ret;
+        }
+        size = stream->size();
+        handle = allocHandle();
+        std::lock_guard<std::mutex> lock(g_streamsMutex);
+        g_streams[handle] = std::move(stream);
+        return 0;
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// DngStream
+// -----------------------------------------------------------------------------
+
+extern "C" {
+
+int64_t lc4j_dng_stream_size(int64_t handle) {
+    auto stream = findStream(handle);
+    if (!stream) {
+        return -1;
+    }
+    return stream->size();
+}
+
+int64_t lc4j_dng_stream_read(int64_t handle, void* buffer, int64_t capacity) {
+    if (buffer == nullptr || capacity < 0) {
+        return -EINVAL;
+    }
+    auto stream = findStream(handle);
+    if (!stream) {
+        return -1;
+    }
+    return stream->read(static_cast<uint8_t*>(buffer), static_cast<size_t>(capacity));
+}
+
+void lc4j_dng_stream_close(int64_t handle) {
+    std::lock_guard<std::mutex> lock(g_streamsMutex);
+    g_streams.erase(handle);
+}
+
+} // extern "C"
@@ -0,0 +1,442 @@
+/*
+ * libcamera4j - fusing an exposure bracket into one frame.
+ *
+ * The jetty has a bright sky and glare off the sea next to deep shadow under
+ * the pier, a wider range than any single exposure holds. A bracket captures
+ * the scene a few stops apart, and this merges the frames the way the exposure
+ * fusion of Mertens, Kautz and Van Reeth does: each frame is weighted per
+ * pixel by how well exposed, how saturated and how detailed it is there, and
+ * the frames are blended band by band on Laplacian pyramids so that the
+ * weights do not show as seams or halos. The result is already tone mapped,
+ * an ordinary 8-bit frame for the JPEG encoder.
+ *
+ * Float pyramids of every full resolution frame would take hundreds of MB on
+ * a Pi, so the weights and the pyramid blend run on a grid of cells of
+ * kGridFactor x kGridFactor pixels. The detail within a cell, the finest bands,
+ * is blended per pixel with the bilinearly interpolated cell weights. A frame
+ * is copied and its cells worked out as it is added, while the camera exposes
+ * the next one.
+ */
+
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+namespace {
+
+using lc4j::FloatPlane;
+
+constexpr int32_t kMaxFrames = LC4J_BRACKET_MAX_FRAMES;
+// Luma pixels per side of a grid cell; chroma cells are half as wide
+constexpr int32_t kGridFactor = 8;
+// The grid pyramids stop at a level this small on either side
+constexpr int32_t kTopLevelSize = 8;
+constexpr float kExposureSigma = 0.2f;
+// Keep flat or grey regions from zeroing the weight of a frame there
+constexpr float kContrastFloor = 1.0f / 64;
+constexpr float kSaturationFloor = 1.0f / 32;
+constexpr float kMinWeight = 1e-6f;
+
+bool isPlanar420(uint32_t fourcc) {
+    return fourcc == lc4j::fourcc('Y', 'U', '1', '2') || fourcc == lc4j::fourcc('Y', 'V', '1', '2');
+}
+
+bool isSemiPlanar420(uint32_t fourcc) {
+    return fourcc == lc4j::fourcc('N', 'V', '1', '2') || fourcc == lc4j::fourcc('N', 'V', '2', '1');
+}
+
+FloatPlane makePlane(int32_t width, int32_t height) {
+    FloatPlane plane;
+    plane.width = width;
+    plane.height = height;
+    plane.values.assign(static_cast<size_t>(width) * height, 0.0f);
+    return plane;
+}
+
+// Well-exposedness of each luma value, a Gaussian around mid-grey.
+const float* exposednessTable() {
+    static const std::vector<float> table = [] {
+        std::vector<float> values(256);
+        for (int v = 0; v < 256; ++v) {
+            const float d = static_cast<float>(v) / 255.0f - 0.5f;
+            values[v] = std::exp(-d * d / (2 * kExposureSigma * kExposureSigma));
+        }
+        return values;
+    }();
+    return table.data();
+}
+
+// Blurs by [1 2 1] / 4 both ways and keeps every other sample.
+FloatPlane reduce(const FloatPlane& in) {
+    FloatPlane out = makePlane((in.width + 1) / 2, (in.height + 1) / 2);
+    std::vector<float> rows(static_cast<size_t>(out.width) * in.height);
+    for (int32_t y = 0; y < in.height; ++y) {
+        const float* src = &in.values[static_cast<size_t>(y) * in.width];
+        float* dst = &rows[static_cast<size_t>(y) * out.width];
+        for (int32_t x = 0; x < out.width; ++x) {
+            const int32_t c = 2 * x;
+            dst[x] = (src[std::max(c - 1, 0)] + 2 * src[c] + src[std::min(c + 1, in.width - 1)]) * 0.25f;
+        }
+    }
+    for (int32_t y = 0; y < out.height; ++y) {
+        const int32_t c = 2 * y;
+        const float* above = &rows[static_cast<size_t>(std::max(c - 1, 0)) * out.width];
+        const float* centre = &rows[static_cast<size_t>(c) * out.width];
+        const float* below = &rows[static_cast<size_t>(std::min(c + 1, in.height - 1)) * out.width];
+        float* dst = &out.values[static_cast<size_t>(y) * out.width];
+        for (int32_t x = 0; x < out.width; ++x) {
+            dst[x] = (above[x] + 2 * centre[x] + below[x]) * 0.25f;
+        }
+    }
+    return out;
+}
+
+// Interpolates a reduced plane back up to width x height; sample i of `in`
+// lands on sample 2i.
+FloatPlane expand(const FloatPlane& in, int32_t width, int32_t height) {
+    FloatPlane out = makePlane(width, height);
+    std::vector<float> row(in.width);
+    for (int32_t y = 0; y < height; ++y) {
+        const int32_t y0 = std::min(y / 2, in.height - 1);
+        const int32_t y1 = std::min(y0 + (y & 1), in.height - 1);
+        const float* a = &in.values[static_cast<size_t>(y0) * in.width];
+        const float* b = &in.values[static_cast<size_t>(y1) * in.width];
+        for (int32_t x = 0; x < in.width; ++x) {
+            row[x] = (a[x] + b[x]) * 0.5f;
+        }
+        float* dst = &out.values[static_cast<size_t>(y) * width];
+        for (int32_t x = 0; x < width; ++x) {
+            const int32_t x0 = std::min(x / 2, in.width - 1);
+            const int32_t x1 = std::min(x0 + (x & 1), in.width - 1);
+            dst[x] = (row[x0] + row[x1]) * 0.5f;
+        }
+    }
+    return out;
+}
+
+std::vector<FloatPlane> gaussianPyramid(const FloatPlane& base) {
+    std::vector<FloatPlane> levels{base};
+    while (std::min(levels.back().width, levels.back().height) > kTopLevelSize) {
+        FloatPlane next = reduce(levels.back());
+        levels.push_back(std::move(next));
+    }
+    return levels;
+}
+
+// Turns a Gaussian pyramid into a Laplacian one, in place.
+void toLaplacian(std::vector<FloatPlane>& levels) {
+    for (size_t l = 0; l + 1 < levels.size(); ++l) {
+        const FloatPlane up = expand(levels[l + 1], levels[l].width, levels[l].height);
+        for (size_t i = 0; i < up.values.size(); ++i) {
+            levels[l].values[i] -= up.values[i];
+        }
+    }
+}
+
+// Sums a Laplacian pyramid back into its finest level.
+void collapse(std::vector<FloatPlane>& levels) {
+    for (size_t l = levels.size() - 1; l-- > 0;) {
+        const FloatPlane up = expand(levels[l + 1], levels[l].width, levels[l].height);
+        for (size_t i = 0; i < up.values.size(); ++i) {
+            levels[l].values[i] += up.values[i];
+        }
+    }
+}
+
+// Blends the cell means of every frame band by band, each band weighted by
+// the matching level of the frame's weight pyramid.
+FloatPlane blend(const std::vector<const FloatPlane*>& means, const std::vector<std::vector<FloatPlane>>& weights) {
+    std::vector<FloatPlane> blended;
+    for (size_t k = 0; k < means.size(); ++k) {
+        std::vector<FloatPlane> bands = gaussianPyramid(*means[k]);
+        toLaplacian(bands);
+        if (blended.empty()) {
+            for (const auto& band : bands) {
+                blended.push_back(makePlane(band.width, band.height));
+            }
+        }
+        for (size_t l = 0; l < bands.size(); ++l) {
+            const std::vector<float>& w = weights[k][l].values;
+            std::vector<float>& dst = blended[l].values;
+            for (size_t i = 0; i < dst.size(); ++i) {
+                dst[i] += w[i] * bands[l].values[i];
+            }
+        }
+    }
+    collapse(blended);
+    return std::move(blended[0]);
+}
+
+// The two cells, and the weight of the second, that bilinear interpolation
+// reads for each sample of a plane whose cells are `factor` samples wide.
+struct CellTaps {
+    std::vector<int32_t> first;
+    std::vector<int32_t> second;
+    std::vector<float> weight;
+};
+
+CellTaps cellTaps(int32_t samples, int32_t factor, int32_t cells) {
+    CellTaps taps;
+    taps.first.resize(samples);
+    taps.second.resize(samples);
+    taps.weight.resize(samples);
+    for (int32_t s = 0; s < samples; ++s) {
+        const float position = (static_cast<float>(s) + 0.5f) / static_cast<float>(factor) - 0.5f;
+        const auto cell = static_cast<int32_t>(std::floor(position));
+        if (position <= 0.0f) {
+            taps.first[s] = taps.second[s] = 0;
+            taps.weight[s] = 0.0f;
+        } else if (cell >= cells - 1) {
+            taps.first[s] = taps.second[s] = cells - 1;
+            taps.weight[s] = 0.0f;
+        } else {
+            taps.first[s] = cell;
+            taps.second[s] = cell + 1;
+            taps.weight[s] = position - static_cast<float>(cell);
+        }
+    }
+    return taps;
+}
+
+// Writes sum_k w_k * source_k + residual for every sample of a plane, the
+// weights and residual interpolated from their cells.
+void composePlane(const std::vector<const uint8_t*>& sources, const std::vector<const FloatPlane*>& weights,
+                  const FloatPlane& residual, int32_t width, int32_t height, int32_t factor, uint8_t* out) {
+    const CellTaps xs = cellTaps(width, factor, residual.width);
+    const CellTaps ys = cellTaps(height, factor, residual.height);
+    const size_t frames = sources.size();
+    const auto cells = static_cast<size_t>(residual.width);
+    lc4j::forRows(height, [&](int32_t begin, int32_t end) {
+        // Cell rows interpolated to the current row: one per frame, then the residual
+        std::vector<float> rows((frames + 1) * cells);
+        auto interpolateRow = [&](const FloatPlane& plane, int32_t y, float* dst) {
+            const float* a = &plane.values[static_cast<size_t>(ys.first[y]) * cells];
+            const float* b = &plane.values[static_cast<size_t>(ys.second[y]) * cells];
+            const float t = ys.weight[y];
+            for (size_t x = 0; x < cells; ++x) {
+                dst[x] = a[x] + t * (b[x] - a[x]);
+            }
+        };
+        for (int32_t y = begin; y < end; ++y) {
+            for (size_t k = 0; k < frames; ++k) {
+                interpolateRow(*weights[k], y, &rows[k * cells]);
+            }
+            interpolateRow(residual, y, &rows[frames * cells]);
+            const size_t offset = static_cast<size_t>(y) * width;
+            uint8_t* dst = out + offset;
+            for (int32_t x = 0; x < width; ++x) {
+                const int32_t c0 = xs.first[x];
+                const int32_t c1 = xs.second[x];
+                const float t = xs.weight[x];
+                const float* r = &rows[frames * cells];
+                float value = r[c0] + t * (r[c1] - r[c0]);
+                for (size_t k = 0; k < frames; ++k) {
+                    const float* w = &rows[k * cells];
+                    value += (w[c0] + t * (w[c1] - w[c0])) * static_cast<float>(sources[k][offset + x]);
+                }
+                dst[x] = static_cast<uint8_t>(std::clamp(value + 0.5f, 0.0f, 255.0f));
+            }
+        }
+    });
+}
+
+// Works out the weight and the plane means of every grid cell of a frame.
+// Weights multiply the well-exposedness of luma, its contrast (the magnitude
+// of a Laplacian) and the saturation of chroma, pixel by pixel.
+void analyse(const uint8_t* const planes[3], int32_t width, int32_t height, FloatPlane& weights, FloatPlane means[3]) {
+    const int32_t cells = (width + kGridFactor - 1) / kGridFactor;
+    const int32_t cellRows = (height + kGridFactor - 1) / kGridFactor;
+    const int32_t chromaWidth = (width + 1) / 2;
+    const int32_t chromaHeight = (height + 1) / 2;
+    constexpr int32_t chromaFactor = kGridFactor / 2;
+    weights = makePlane(cells, cellRows);
+    for (int p = 0; p < 3; ++p) {
+        means[p] = makePlane(cells, cellRows);
+    }
+    const float* exposedness = exposednessTable();
+
+    lc4j::forRows(cellRows, [&](int32_t begin, int32_t end) {
+        std::vector<float> saturation(chromaWidth);
+        std::vector<float> sums[4];
+        for (auto& sum : sums) {
+            sum.resize(cells);
+        }
+        for (int32_t cy = begin; cy < end; ++cy) {
+            for (auto& sum : sums) {
+                std::fill(sum.begin(), sum.end(), 0.0f);
+            }
+            const int32_t y0 = cy * kGridFactor;
+            const int32_t y1 = std::min(height, y0 + kGridFactor);
+            for (int32_t y = y0; y < y1; ++y) {
+                if ((y & 1) == 0) {
+                    const uint8_t* u = planes[1] + static_cast<size_t>(y / 2) * chromaWidth;
+                    const uint8_t* v = planes[2] + static_cast<size_t>(y / 2) * chromaWidth;
+                    for (int32_t x = 0; x < chromaWidth; ++x) {
+                        const float du = static_cast<float>(u[x]) - 128.0f;
+                        const float dv = static_cast<float>(v[x]) - 128.0f;
+                        saturation[x] = std::sqrt(du * du + dv * dv) * (1.0f / 128.0f) + kSaturationFloor;
+                    }
+                }
+                const uint8_t* above = planes[0] + static_cast<size_t>(std::max(y - 1, 0)) * width;
+                const uint8_t* row = planes[0] + static_cast<size_t>(y) * width;
+                const uint8_t* below = planes[0] + static_cast<size_t>(std::min(y + 1, height - 1)) * width;
+                for (int32_t x = 0; x < width; ++x) {
+                    const int32_t left = row[std::max(x - 1, 0)];
+                    const int32_t right = row[std::min(x + 1, width - 1)];
+                    const int32_t luma = row[x];
+                    const int32_t laplacian = std::abs(4 * luma - left - right - above[x] - below[x]);
+                    const float contrast = static_cast<float>(laplacian) * (1.0f / 255.0f) + kContrastFloor;
+                    sums[0][x / kGridFactor] += contrast * saturation[x / 2] * exposedness[luma];
+                    sums[1][x / kGridFactor] += static_cast<float>(luma);
+                }
+            }
+            const int32_t c0 = y0 / 2;
+            const int32_t c1 = std::min(chromaHeight, c0 + chromaFactor);
+            for (int32_t y = c0; y < c1; ++y) {
+                const uint8_t* u = planes[1] + static_cast<size_t>(y) * chromaWidth;
+                const uint8_t* v = planes[2] + static_cast<size_t>(y) * chromaWidth;
+                for (int32_t x = 0; x < chromaWidth; ++x) {
+                    sums[2][x / chromaFactor] += static_cast<float>(u[x]);
+                    sums[3][x / chromaFactor] += static_cast<float>(v[x]);
+                }
+            }
+            const size_t base = static_cast<size_t>(cy) * cells;
+            for (int32_t cx = 0; cx < cells; ++cx) {
+                const int32_t cellWidth = std::min(kGridFactor, width - cx * kGridFactor);
+                const int32_t chromaCellWidth = std::min(chromaFactor, chromaWidth - cx * chromaFactor);
+                const auto area = static_cast<float>(cellWidth * (y1 - y0));
+                const auto chromaArea = static_cast<float>(chromaCellWidth * (c1 - c0));
+                weights.values[base + cx] = sums[0][cx] / area + kMinWeight;
+                means[0].values[base + cx] = sums[1][cx] / area;
+                means[1].values[base + cx] = sums[2][cx] / chromaArea;
+                means[2].values[base + cx] = sums[3][cx] / chromaArea;
+            }
+        }
+    });
+}
+
+} // namespace
+
+int32_t lc4j::ExposureFusion::add(const FrameView& frame) {
+    const bool planar = isPlanar420(frame.fourcc);
+    const bool semiPlanar = isSemiPlanar420(frame.fourcc);
+    if (!planar && !semiPlanar) {
+        return -ENOTSUP;
+    }
+    if (frame.planes[0] == nullptr || frame.planes[1] == nullptr || (planar && frame.planes[2] == nullptr)
+        || frame.width < 2 || frame.height < 2) {
+        return -EINVAL;
+    }
+    if (!frames_.empty() && (frame.width != width_ || frame.height != height_)) {
+        return -EINVAL;
+    }
+    if (count() >= kMaxFrames) {
+        return -ENOSPC;
+    }
+
+    const int32_t chromaWidth = (frame.width + 1) / 2;
+    const int32_t chromaHeight = (frame.height + 1) / 2;
+    try {
+        Frame copy;
+        copy.planes[0].resize(static_cast<size_t>(frame.width) * frame.height);
+        copy.planes[1].resize(static_cast<size_t>(chromaWidth) * chromaHeight);
+        copy.planes[2].resize(copy.planes[1].size());
+        for (int32_t y = 0; y < frame.height; ++y) {
+            std::memcpy(&copy.planes[0][static_cast<size_t>(y) * frame.width],
+                        frame.planes[0] + static_cast<size_t>(y) * frame.strides[0], frame.width);
+        }
+        // Copied as U then V whatever order the format keeps them in
+        const bool swapped = frame.fourcc == lc4j::fourcc('Y', 'V', '1', '2')
+                             || frame.fourcc == lc4j::fourcc('N', 'V', '2', '1');
+        uint8_t* u = copy.planes[swapped ? 2 : 1].data();
+        uint8_t* v = copy.planes[swapped ? 1 : 2].data();
+        for (int32_t y = 0; y < chromaHeight; ++y) {
+            const size_t offset = static_cast<size_t>(y) * chromaWidth;
+            if (planar) {
+                std::memcpy(u + offset, frame.planes[1] + static_cast<size_t>(y) * frame.strides[1], chromaWidth);
+                std::memcpy(v + offset, frame.planes[2] + static_cast<size_t>(y) * frame.strides[2], chromaWidth);
+            } else {
+                const uint8_t* src = frame.planes[1] + static_cast<size_t>(y) * frame.strides[1];
+                for (int32_t x = 0; x < chromaWidth; ++x) {
+                    u[offset + x] = src[2 * x];
+                    v[offset + x] = src[2 * x + 1];
+                }
+            }
+        }
+        const uint8_t* planes[3] = {copy.planes[0].data(), copy.planes[1].data(), copy.planes[2].data()};
+        analyse(planes, frame.width, frame.height, copy.weights, copy.means);
+        frames_.push_back(std::move(copy));
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+    width_ = frame.width;
+    height_ = frame.height;
+    return 0;
+}
+
+int32_t lc4j::ExposureFusion::fuse(OwnedFrame& out) const {
+    if (frames_.empty()) {
+        return -EINVAL;
+    }
+    try {
+        // Weights normalised to sum to 1 in every cell, then their pyramids
+        const size_t frameCount = frames_.size();
+        const FloatPlane& first = frames_[0].weights;
+        std::vector<FloatPlane> weights(frameCount, makePlane(first.width, first.height));
+        for (size_t i = 0; i < first.values.size(); ++i) {
+            float total = 0.0f;
+            for (const Frame& frame : frames_) {
+                total += frame.weights.values[i];
+            }
+            for (size_t k = 0; k < frameCount; ++k) {
+                weights[k].values[i] = frames_[k].weights.values[i] / total;
+            }
+        }
+        std::vector<std::vector<FloatPlane>> weightPyramids;
+        std::vector<const FloatPlane*> weightPlanes;
+        for (const auto& w : weights) {
+            weightPyramids.push_back(gaussianPyramid(w));
+            weightPlanes.push_back(&w);
+        }
+
+        const int32_t chromaWidth = (width_ + 1) / 2;
+        const int32_t chromaHeight = (height_ + 1) / 2;
+        out.view = FrameView();
+        out.view.fourcc = lc4j::fourcc('Y', 'U', '1', '2');
+        out.view.width = width_;
+        out.view.height = height_;
+        for (int p = 0; p < 3; ++p) {
+            const int32_t planeWidth = p == 0 ? width_ : chromaWidth;
+            const int32_t planeHeight = p == 0 ? height_ : chromaHeight;
+            std::vector<const FloatPlane*> means;
+            std::vector<const uint8_t*> sources;
+            for (const Frame& frame : frames_) {
+                means.push_back(&frame.means[p]);
+                sources.push_back(frame.planes[p].data());
+            }
+            // What the pyramid blend adds to a plain per-cell weighted average,
+            // which the per-pixel blend below already gives
+            FloatPlane residual = blend(means, weightPyramids);
+            for (size_t i = 0; i < residual.values.size(); ++i) {
+                for (size_t k = 0; k < frameCount; ++k) {
+                    residual.values[i] -= weights[k].values[i] * means[k]->values[i];
+                }
+            }
+            out.planes[p].resize(static_cast<size_t>(planeWidth) * planeHeight);
+            composePlane(sources, weightPlanes, residual, planeWidth, planeHeight,
+                         p == 0 ? kGridFactor : kGridFactor / 2, out.planes[p].data());
+            out.view.planes[p] = out.planes[p].data();
+            out.view.strides[p] = planeWidth;
+        }
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+    return 0;
+}
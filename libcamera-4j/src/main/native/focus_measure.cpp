@@ -0,0 +1,64 @@
+/*
+ * libcamera4j - how sharp a frame is.
+ *
+ * A focus sweep (capture_session.cpp) steps the lens across its range and
+ * keeps the position whose frames measure sharpest. The measure is the
+ * Tenengrad of a region of the luma: the mean squared Sobel gradient, which
+ * peaks when edges are crispest. Gradients scale with brightness, so it is
+ * divided by the squared mean luma of the region; auto-exposure still moving
+ * during a sweep then does not pass for a change of focus. Noise raises the
+ * measure evenly at every lens position, so it does not move the peak.
+ */
+
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace {
+
+// Below this mean luma the measure is of the noise, not the scene
+constexpr double kMinMean = 8.0;
+constexpr int32_t kMinSize = 8;
+
+} // namespace
+
+double lc4j::focusMeasure(const FrameView& frame, float left, float top, float right, float bottom) {
+    int32_t offset;
+    int32_t step;
+    if (frame.planes[0] == nullptr || !lumaSampling(frame.fourcc, offset, step)) {
+        return -1.0;
+    }
+    // The Sobel kernel reaches one pixel beyond the region
+    const int32_t x0 = std::clamp(static_cast<int32_t>(std::floor(left * frame.width)), 1, frame.width - 1);
+    const int32_t x1 = std::clamp(static_cast<int32_t>(std::ceil(right * frame.width)), 1, frame.width - 1);
+    const int32_t y0 = std::clamp(static_cast<int32_t>(std::floor(top * frame.height)), 1, frame.height - 1);
+    const int32_t y1 = std::clamp(static_cast<int32_t>(std::ceil(bottom * frame.height)), 1, frame.height - 1);
+    if (x1 - x0 < kMinSize || y1 - y0 < kMinSize) {
+        return -1.0;
+    }
+
+    const auto pitch = static_cast<ptrdiff_t>(frame.strides[0]);
+    double energy = 0.0;
+    uint64_t luma = 0;
+    for (int32_t y = y0; y < y1; ++y) {
+        const uint8_t* row = frame.planes[0] + static_cast<size_t>(y) * frame.strides[0] + offset;
+        // Summed per row in integers, which cannot overflow for any width
+        uint64_t rowEnergy = 0;
+        for (int32_t x = x0; x < x1; ++x) {
+            const uint8_t* p = row + static_cast<size_t>(x) * step;
+            const uint8_t* up = p - pitch;
+            const uint8_t* down = p + pitch;
+            const int32_t gx = (up[step] + 2 * p[step] + down[step]) - (up[-step] + 2 * p[-step] + down[-step]);
+            const int32_t gy = (down[-step] + 2 * down[0] + down[step]) - (up[-step] + 2 * up[0] + up[step]);
+            rowEnergy += static_cast<uint64_t>(gx * gx + gy * gy);
+            luma += p[0];
+        }
+        energy += static_cast<double>(rowEnergy);
+    }
+    const double pixels = static_cast<double>(x1 - x0) * (y1 - y0);
+    const double mean = std::max(static_cast<double>(luma) / pixels, kMinMean);
+    return energy / pixels / (mean * mean);
+}
@@ -0,0 +1,347 @@
+/*
+ * libcamera4j - latest-frame export through POSIX shared memory.
+ *
+ * Local consumers (an analysis script, a second JVM) used to pick up the newest
+ * picture from latest.jpg on disk or over HTTP. An export instead keeps the last
+ * few captured frames - planes as captured and the JPEG - in a shared-memory
+ * ring that any number of readers map read-only and read in place. Slots are
+ * guarded by a seqlock in the same way as the frame store's timeline, so the
+ * writer never waits for a reader; a reader that was overtaken simply retries.
+ * The layout is lc4j_export_header / lc4j_export_slot in libcamera4j.h.
+ */
+
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr char kExportMagic[8] = {'L', 'C', '4', 'J', 'E', 'X', 'P', '1'};
+constexpr uint32_t kExportVersion = 1;
+constexpr int32_t kMaxSlots = 64;
+
+static_assert(sizeof(lc4j_export_header) == 64, "lc4j_export_header layout");
+static_assert(sizeof(lc4j_export_slot) == 128, "lc4j_export_slot layout");
+
+// Rows of each plane of a captured frame; every multi-planar format the
+// capture session produces is 4:2:0.
+int32_t planeRows(const lc4j::FrameView& frame, int plane) {
+    return plane == 0 ? frame.height : (frame.height + 1) / 2;
+}
+
+class FrameExport {
+public:
+    ~FrameExport() {
+        if (map_ != MAP_FAILED) {
+            munmap(map_, size_);
+        }
+        // Unless another process has replaced the object meanwhile
+        if (owner_ && ours()) {
+            shm_unlink(name_.c_str());
+        }
+    }
+
+    // Creates the shared-memory object, replacing any left under that name,
+    // and lays out its slots.
+    int32_t create(const std::string& name, int32_t slotCount, int64_t slotSize, int32_t flags) {
+        name_ = name;
+        size_ = sizeof(lc4j_export_header) + static_cast<size_t>(slotCount) * static_cast<size_t>(slotSize);
+        // Never truncate an object readers may still have mapped, which would
+        // fault them with SIGBUS: unlink it, so they keep the old pages until
+        // they attach again, and create a fresh one
+        if (shm_unlink(name.c_str()) != 0 && errno != ENOENT) {
+            return -errno;
+        }
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0) {
+            return -errno;
+        }
+        owner_ = true;
+        struct stat st;
+        int ret = fstat(fd, &st) == 0 && ftruncate(fd, static_cast<off_t>(size_)) == 0 ? 0 : -errno;
+        inode_ = ret == 0 ? st.st_ino : 0;
+        if (ret == 0) {
+            map_ = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ret = map_ == MAP_FAILED ? -errno : 0;
+        }
+        close(fd);
+        if (ret < 0) {
+            return ret;
+        }
+        header_ = static_cast<lc4j_export_header*>(map_);
+        header_->version = kExportVersion;
+        header_->slotCount = static_cast<uint32_t>(slotCount);
+        header_->slotSize = static_cast<uint64_t>(slotSize);
+        header_->flags = static_cast<uint32_t>(flags);
+        // Magic last: a reader attaching meanwhile sees either nothing or a valid header
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(header_->magic, kExportMagic, sizeof(kExportMagic));
+        return 0;
+    }
+
+    // Maps an existing export read-only.
+    int32_t attach(const std::string& name) {
+        name_ = name;
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            return -errno;
+        }
+        struct stat st;
+        int ret = fstat(fd, &st) == 0 ? 0 : -errno;
+        if (ret == 0 && static_cast<size_t>(st.st_size) < sizeof(lc4j_export_header)) {
+            ret = -EINVAL;
+        }
+        if (ret == 0) {
+            size_ = static_cast<size_t>(st.st_size);
+            map_ = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+            ret = map_ == MAP_FAILED ? -errno : 0;
+        }
+        close(fd);
+        if (ret < 0) {
+            return ret;
+        }
+        header_ = static_cast<lc4j_export_header*>(map_);
+        const bool valid = std::memcmp(header_->magic, kExportMagic, sizeof(kExportMagic)) == 0
+                && header_->version == kExportVersion && header_->slotCount > 0
+                && sizeof(lc4j_export_header) + header_->slotCount * header_->slotSize <= size_;
+        return valid ? 0 : -EINVAL;
+    }
+
+    bool owner() const { return owner_; }
+
+    void map(int64_t* out2) const {
+        out2[0] = static_cast<int64_t>(reinterpret_cast<uintptr_t>(map_));
+        out2[1] = static_cast<int64_t>(size_);
+    }
+
+    // Writes a frame into the next slot. `frame` may have no planes and `jpeg`
+    // may be empty; whatever is wanted by the export's flags and fits is written.
+    int32_t publish(const lc4j::FrameView& frame, const uint8_t* jpeg, size_t jpegLength,
+                    int32_t jpegWidth, int32_t jpegHeight, int64_t timestampNs, int64_t frameSequence) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const size_t capacity = header_->slotSize - sizeof(lc4j_export_slot);
+
+        // Decide what goes in before touching the slot
+        size_t planeBytes[3] = {0, 0, 0};
+        size_t rawBytes = 0;
+        if ((header_->flags & LC4J_EXPORT_RAW) && frame.planes[0] != nullptr) {
+            for (int i = 0; i < 3 && frame.planes[i] != nullptr; ++i) {
+                planeBytes[i] = static_cast<size_t>(frame.strides[i]) * planeRows(frame, i);
+                rawBytes += planeBytes[i];
+            }
+            if (rawBytes > capacity) {
+                rawBytes = 0;
+            }
+        }
+        if (!(header_->flags & LC4J_EXPORT_JPEG) || rawBytes + jpegLength > capacity) {
+            jpegLength = 0;
+        }
+        if (rawBytes == 0 && jpegLength == 0) {
+            return -ENOSPC;
+        }
+
+        const uint64_t number = header_->published + 1;
+        auto* slot = reinterpret_cast<lc4j_export_slot*>(static_cast<uint8_t*>(map_) + sizeof(lc4j_export_header)
+                + ((number - 1) % header_->slotCount) * header_->slotSize);
+        uint8_t* data = reinterpret_cast<uint8_t*>(slot + 1);
+
+        __atomic_store_n(&slot->sequence, slot->sequence + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+
+        slot->number = number;
+        slot->timestampNs = timestampNs;
+        slot->frameSequence = frameSequence;
+        slot->fourcc = rawBytes > 0 ? frame.fourcc : 0;
+        slot->width = rawBytes > 0 ? frame.width : 0;
+        slot->height = rawBytes > 0 ? frame.height : 0;
+        size_t offset = 0;
+        for (int i = 0; i < 3; ++i) {
+            const bool present = rawBytes > 0 && planeBytes[i] > 0;
+            slot->strides[i] = present ? frame.strides[i] : 0;
+            slot->planeOffsets[i] = present ? static_cast<int64_t>(offset) : -1;
+            if (present) {
+                std::memcpy(data + offset, frame.planes[i], planeBytes[i]);
+                offset += planeBytes[i];
+            }
+        }
+        slot->rawBytes = static_cast<int64_t>(rawBytes);
+        slot->jpegWidth = jpegLength > 0 ? jpegWidth : 0;
+        slot->jpegHeight = jpegLength > 0 ? jpegHeight : 0;
+        slot->jpegOffset = static_cast<int64_t>(offset);
+        slot->jpegBytes = static_cast<int64_t>(jpegLength);
+        if (jpegLength > 0) {
+            std::memcpy(data + offset, jpeg, jpegLength);
+        }
+        slot->publishedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+
+        __atomic_store_n(&slot->sequence, slot->sequence + 1, __ATOMIC_RELEASE);
+        __atomic_store_n(&header_->published, number, __ATOMIC_RELEASE);
+        return 0;
+    }
+
+private:
+    // Whether the object under name_ is still the one created here.
+    bool ours() const {
+        int fd = shm_open(name_.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        const bool same = fstat(fd, &st) == 0 && st.st_ino == inode_;
+        close(fd);
+        return same;
+    }
+
+    std::string name_;
+    bool owner_ = false;
+    ino_t inode_ = 0;
+    void* map_ = MAP_FAILED;
+    size_t size_ = 0;
+    lc4j_export_header* header_ = nullptr;
+    std::mutex mutex_;
+};
+
+std::mutex g_exportsMutex;
+std::map<int64_t, std::shared_ptr<FrameExport>> g_exports;
+// Number of open exports that publish; lets exportFrame skip the lock
+std::atomic<int32_t> g_publishers{0};
+
+std::shared_ptr<FrameExport> findExport(int64_t handle) {
+    std::lock_guard<std::mutex> lock(g_exportsMutex);
+    auto it = g_exports.find(handle);
+    return it == g_exports.end() ? nullptr : it->second;
+}
+
+int64_t registerExport(std::shared_ptr<FrameExport> frameExport) {
+    int64_t handle = lc4j::allocHandle();
+    std::lock_guard<std::mutex> lock(g_exportsMutex);
+    if (frameExport->owner()) {
+        g_publishers++;
+    }
+    g_exports[handle] = std::move(frameExport);
+    return handle;
+}
+
+} // namespace
+
+void lc4j::exportFrame(const FrameView& frame, int32_t transform, const std::vector<uint8_t>& jpeg,
+                       int64_t timestampNs, int64_t frameSequence) {
+    if (g_publishers.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    std::vector<std::shared_ptr<FrameExport>> publishers;
+    {
+        std::lock_guard<std::mutex> lock(g_exportsMutex);
+        for (const auto& [handle, frameExport] : g_exports) {
+            if (frameExport->owner()) {
+                publishers.push_back(frameExport);
+            }
+        }
+    }
+    const bool transpose = (transform & 4) != 0;
+    for (const auto& frameExport : publishers) {
+        // Best effort: a frame too large for the slots is not worth failing a capture for
+        frameExport->publish(frame, jpeg.data(), jpeg.size(), transpose ? frame.height : frame.width,
+                             transpose ? frame.width : frame.height, timestampNs, frameSequence);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// FrameExport
+// -----------------------------------------------------------------------------
+
+extern "C" {
+
+int64_t lc4j_export_open(const char* name, int32_t slotCount, int64_t slotSize, int32_t flags) {
+    if (name == nullptr || name[0] != '/' || slotCount < 2 || slotCount > kMaxSlots
+            || slotSize <= static_cast<int64_t>(sizeof(lc4j_export_slot)) || slotSize % 64 != 0
+            || (flags & (LC4J_EXPORT_RAW | LC4J_EXPORT_JPEG)) == 0) {
+        return 0;
+    }
+    try {
+        auto frameExport = std::make_shared<FrameExport>();
+        if (frameExport->create(name, slotCount, slotSize, flags) < 0) {
+            return 0;
+        }
+        return registerExport(std::move(frameExport));
+    } catch (const std::exception&) {
+        return 0;
+    }
+}
+
+int64_t lc4j_export_attach(const char* name) {
+    if (name == nullptr) {
+        return 0;
+    }
+    try {
+        auto frameExport = std::make_shared<FrameExport>();
+        if (frameExport->attach(name) < 0) {
+            return 0;
+        }
+        return registerExport(std::move(frameExport));
+    } catch (const std::exception&) {
+        return 0;
+    }
+}
+
+void lc4j_export_close(int64_t handle) {
+    std::shared_ptr<FrameExport> frameExport;
+    {
+        std::lock_guard<std::mutex> lock(g_exportsMutex);
+        auto it = g_exports.find(handle);
+        if (it == g_exports.end()) {
+            return;
+        }
+        frameExport = std::move(it->second);
+        g_exports.erase(it);
+        if (frameExport->owner()) {
+            g_publishers--;
+        }
+    }
+    // Unmapped once a publish in progress has let go of it
+}
+
+int32_t lc4j_export_map(int64_t handle, int64_t* out2) {
+    auto frameExport = findExport(handle);
+    if (!frameExport) {
+        return -1;
+    }
+    if (out2 == nullptr) {
+        return -EINVAL;
+    }
+    frameExport->map(out2);
+    return 0;
+}
+
+int32_t lc4j_export_publish(int64_t handle, int64_t timestampNs, int32_t width, int32_t height,
+                            const void* jpeg, int64_t length) {
+    auto frameExport = findExport(handle);
+    if (!frameExport) {
+        return -1;
+    }
+    if (!frameExport->owner()) {
+        return -EPERM;
+    }
+    if (jpeg == nullptr || length <= 0) {
+        return -EINVAL;
+    }
+    return frameExport->publish(lc4j::FrameView(), static_cast<const uint8_t*>(jpeg), static_cast<size_t>(length),
+                                width, height, timestampNs, 0);
+}
+
+} // extern "C"
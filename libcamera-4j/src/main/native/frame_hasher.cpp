@@ -0,0 +1,86 @@
+/*
+ * libcamera4j - perceptual hashes for frames already in a frame store.
+ *
+ * Frames captured through capture_session.cpp are tagged with the difference
+ * hash of their luma as they are stored. Frames stored any other way - by Java,
+ * by the legacy migration or before hashing existed - are hashed here: each
+ * untagged frame is decoded at 1/8 scale, where libjpeg only has to read the DC
+ * coefficients, and the hashes are written back as tags in batches.
+ */
+
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <cerrno>
+#include <new>
+#include <vector>
+
+namespace {
+
+constexpr int32_t kListBatch = 512;
+
+int32_t hashRange(int64_t storeHandle, int64_t fromMs, int64_t toMs) {
+    std::vector<lc4j_store_record> records(kListBatch);
+    std::vector<uint8_t> frame;
+    std::vector<int64_t> timestamps;
+    std::vector<int64_t> tags;
+    int32_t hashed = 0;
+    int64_t next = fromMs;
+    while (next <= toMs) {
+        int32_t n = lc4j_store_list_tags(storeHandle, next, toMs, records.data(), kListBatch);
+        if (n < 0) {
+            return hashed > 0 ? hashed : n;
+        }
+        if (n == 0) {
+            break;
+        }
+        timestamps.clear();
+        tags.clear();
+        for (int32_t i = 0; i < n; ++i) {
+            const lc4j_store_record& record = records[i];
+            if (record.flags & LC4J_STORE_TAGGED) {
+                continue;
+            }
+            frame.resize(static_cast<size_t>(record.length));
+            if (lc4j_store_read(storeHandle, record.timestampMs, frame.data(), record.length) != record.length) {
+                continue;   // replaced or deleted since it was listed
+            }
+            uint64_t hash;
+            if (lc4j::perceptualHashJpeg(frame.data(), frame.size(), hash) == 0) {
+                timestamps.push_back(record.timestampMs);
+                tags.push_back(static_cast<int64_t>(hash));
+            }
+        }
+        if (!timestamps.empty()) {
+            int32_t ret = lc4j_store_set_tags(storeHandle, timestamps.data(), tags.data(),
+                                              static_cast<int32_t>(timestamps.size()));
+            if (ret < 0) {
+                return hashed > 0 ? hashed : ret;
+            }
+            hashed += ret;
+        }
+        if (records[n - 1].timestampMs == INT64_MAX) {
+            break;
+        }
+        next = records[n - 1].timestampMs + 1;
+    }
+    return hashed;
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// FrameHasher
+// -----------------------------------------------------------------------------
+
+extern "C" {
+
+int32_t lc4j_store_hash_frames(int64_t handle, int64_t fromMs, int64_t toMs) {
+    try {
+        return hashRange(handle, fromMs, toMs);
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+}
+
+} // extern "C"
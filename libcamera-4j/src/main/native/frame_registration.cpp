@@ -0,0 +1,284 @@
+/*
+ * libcamera4j - registering consecutive frames of a shaking camera.
+ *
+ * The camera is mounted on the jetty, and wind shakes it: between two frames
+ * of a timelapse the view moves by a few pixels and turns by a fraction of a
+ * degree. The motion is measured on downscaled luma by phase correlation,
+ * which finds a shift as the peak of the inverse transform of the normalised
+ * cross-power spectrum and is unaffected by the brightness of the frames
+ * changing in between. A few tiles spread over the frame are correlated
+ * separately, and a rotation and shift are fitted to their shifts, leaving out
+ * tiles that disagree, such as one over a passing boat. Tiles of flat sky and
+ * of water, whose ripples change from frame to frame, give no clear peak and
+ * do not count.
+ */
+
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <vector>
+
+namespace {
+
+using Complex = std::complex<float>;
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Tile side, a power of two; shifts up to about a third of it are found
+constexpr int32_t kTileSize = 128;
+constexpr int32_t kTileBits = 7;
+constexpr int32_t kTilesX = 3;
+constexpr int32_t kTilesY = 2;
+// Tiles flatter than this standard deviation in luma are not correlated
+constexpr double kMinContrast = 2.0;
+// The cross-power spectrum is weighted down towards high frequencies, where
+// JPEG blocks and sensor noise are, by a Gaussian of this many bins
+constexpr double kSpectrumSigma = kTileSize / 8.0;
+// Height of the correlation peak, 1 for a clean shift, below which it is noise
+constexpr float kMinPeak = 0.3f;
+// Tiles off the fitted motion by more than this many pixels are left out
+constexpr double kMaxResidual = 1.0;
+// Anything larger is not the camera shaking
+constexpr double kMaxShift = 0.1;       // of the width
+constexpr double kMaxAngle = 0.05;      // radians
+
+static_assert(1 << kTileBits == kTileSize, "kTileBits must match kTileSize");
+
+// In-place radix-2 FFT of n = 1 << bits values, `step` apart.
+void fft(Complex* data, int32_t bits, int32_t step, bool inverse) {
+    const int32_t n = 1 << bits;
+    for (int32_t i = 1, j = 0; i < n; ++i) {
+        int32_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            std::swap(data[i * step], data[j * step]);
+        }
+    }
+    for (int32_t len = 2; len <= n; len <<= 1) {
+        const double angle = (inverse ? 2.0 : -2.0) * kPi / len;
+        const Complex unit(static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle)));
+        for (int32_t i = 0; i < n; i += len) {
+            Complex w(1.0f, 0.0f);
+            for (int32_t k = 0; k < len / 2; ++k) {
+                Complex& a = data[(i + k) * step];
+                Complex& b = data[(i + k + len / 2) * step];
+                const Complex t = b * w;
+                b = a - t;
+                a += t;
+                w *= unit;
+            }
+        }
+    }
+}
+
+void fft2d(std::vector<Complex>& tile, bool inverse) {
+    for (int32_t y = 0; y < kTileSize; ++y) {
+        fft(tile.data() + y * kTileSize, kTileBits, 1, inverse);
+    }
+    for (int32_t x = 0; x < kTileSize; ++x) {
+        fft(tile.data() + x, kTileBits, kTileSize, inverse);
+    }
+}
+
+// The spectrum of a Hann-windowed tile with its mean removed; false if the
+// tile is too flat to correlate.
+bool tileSpectrum(const uint8_t* plane, int32_t width, int32_t x0, int32_t y0, const std::vector<float>& window,
+                  std::vector<Complex>& out) {
+    double sum = 0.0;
+    double squares = 0.0;
+    for (int32_t y = 0; y < kTileSize; ++y) {
+        const uint8_t* row = plane + static_cast<size_t>(y0 + y) * width + x0;
+        for (int32_t x = 0; x < kTileSize; ++x) {
+            sum += row[x];
+            squares += static_cast<double>(row[x]) * row[x];
+        }
+    }
+    const double n = kTileSize * kTileSize;
+    const double mean = sum / n;
+    if (squares / n - mean * mean < kMinContrast * kMinContrast) {
+        return false;
+    }
+    out.resize(kTileSize * kTileSize);
+    for (int32_t y = 0; y < kTileSize; ++y) {
+        const uint8_t* row = plane + static_cast<size_t>(y0 + y) * width + x0;
+        for (int32_t x = 0; x < kTileSize; ++x) {
+            const float v = static_cast<float>(row[x] - mean) * window[y] * window[x];
+            out[y * kTileSize + x] = Complex(v, 0.0f);
+        }
+    }
+    fft2d(out, false);
+    return true;
+}
+
+// Vertex offset (-0.5..0.5) of the Gaussian through three samples, which is
+// the shape of the peak with the weighted spectrum; a parabola if one is not
+// positive.
+double peakOffset(float before, float at, float after) {
+    double a = before, b = at, c = after;
+    if (a > 0.0f && c > 0.0f) {
+        a = std::log(a);
+        b = std::log(b);
+        c = std::log(c);
+    }
+    const double curvature = a - 2.0 * b + c;
+    return curvature < 0.0 ? std::clamp(0.5 * (a - c) / curvature, -0.5, 0.5) : 0.0;
+}
+
+// Shift of the content from the `previous` tile to the `current` one; false
+// if the correlation has no clear peak.
+bool correlate(const std::vector<Complex>& previous, std::vector<Complex>& current, const std::vector<float>& weights,
+               float weightSum, double& dx, double& dy) {
+    for (size_t i = 0; i < current.size(); ++i) {
+        const Complex cross = current[i] * std::conj(previous[i]);
+        const float magnitude = std::abs(cross);
+        current[i] = magnitude > 1e-6f ? cross * (weights[i] / magnitude) : Complex(0.0f, 0.0f);
+    }
+    fft2d(current, true);
+    int32_t best = 0;
+    for (int32_t i = 1; i < kTileSize * kTileSize; ++i) {
+        if (current[i].real() > current[best].real()) {
+            best = i;
+        }
+    }
+    const float peak = current[best].real() / weightSum;
+    if (peak < kMinPeak) {
+        return false;
+    }
+    const int32_t mask = kTileSize - 1;
+    const int32_t px = best & mask;
+    const int32_t py = best >> kTileBits;
+    auto at = [&](int32_t x, int32_t y) { return current[(y & mask) * kTileSize + (x & mask)].real(); };
+    dx = px + peakOffset(at(px - 1, py), at(px, py), at(px + 1, py));
+    dy = py + peakOffset(at(px, py - 1), at(px, py), at(px, py + 1));
+    // The transform wraps around: peaks past the middle are negative shifts
+    if (dx >= kTileSize / 2) {
+        dx -= kTileSize;
+    }
+    if (dy >= kTileSize / 2) {
+        dy -= kTileSize;
+    }
+    return true;
+}
+
+struct TileShift {
+    double x, y;        // tile centre relative to the frame centre
+    double dx, dy;
+};
+
+// Least squares fit of a small rotation about the frame centre and a shift:
+// d = t + angle * (-y, x). Returns the largest residual.
+double fitRigid(const std::vector<TileShift>& tiles, double& tx, double& ty, double& angle) {
+    double cx = 0.0, cy = 0.0, mx = 0.0, my = 0.0;
+    for (const auto& t : tiles) {
+        cx += t.x;
+        cy += t.y;
+        mx += t.dx;
+        my += t.dy;
+    }
+    const double n = static_cast<double>(tiles.size());
+    cx /= n;
+    cy /= n;
+    mx /= n;
+    my /= n;
+    double num = 0.0, den = 0.0;
+    for (const auto& t : tiles) {
+        const double x = t.x - cx;
+        const double y = t.y - cy;
+        num += x * (t.dy - my) - y * (t.dx - mx);
+        den += x * x + y * y;
+    }
+    angle = den > 0.0 ? num / den : 0.0;
+    tx = mx + angle * cy;
+    ty = my - angle * cx;
+    double worst = 0.0;
+    for (const auto& t : tiles) {
+        worst = std::max(worst, std::hypot(tx - angle * t.y - t.dx, ty + angle * t.x - t.dy));
+    }
+    return worst;
+}
+
+} // namespace
+
+bool lc4j::estimateMotion(const uint8_t* previous, const uint8_t* current, int32_t width, int32_t height,
+                          RigidMotion& motion) {
+    if (previous == nullptr || current == nullptr || width < 2 * kTileSize || height < 2 * kTileSize) {
+        return false;
+    }
+    std::vector<float> window(kTileSize);
+    for (int32_t i = 0; i < kTileSize; ++i) {
+        window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * kPi * (i + 0.5) / kTileSize));
+    }
+    std::vector<float> weights(kTileSize * kTileSize);
+    float weightSum = 0.0f;
+    for (int32_t v = 0; v < kTileSize; ++v) {
+        for (int32_t u = 0; u < kTileSize; ++u) {
+            const double fu = std::min(u, kTileSize - u);
+            const double fv = std::min(v, kTileSize - v);
+            const auto w = static_cast<float>(std::exp(-(fu * fu + fv * fv) / (2.0 * kSpectrumSigma * kSpectrumSigma)));
+            weights[v * kTileSize + u] = w;
+            weightSum += w;
+        }
+    }
+    std::vector<TileShift> tiles;
+    std::vector<Complex> a, b;
+    for (int32_t ty = 0; ty < kTilesY; ++ty) {
+        for (int32_t tx = 0; tx < kTilesX; ++tx) {
+            // Tile centres spread evenly, tiles overlapping on small frames
+            const int32_t x0 = (width - kTileSize) * (2 * tx + 1) / (2 * kTilesX);
+            const int32_t y0 = (height - kTileSize) * (2 * ty + 1) / (2 * kTilesY);
+            double dx, dy;
+            if (!tileSpectrum(previous, width, x0, y0, window, a) || !tileSpectrum(current, width, x0, y0, window, b)
+                || !correlate(a, b, weights, weightSum, dx, dy)) {
+                continue;
+            }
+            // The window pulls the estimate towards no shift; correlating again
+            // with the current tile moved along leaves only the fraction to find
+            const auto ix = static_cast<int32_t>(std::lround(dx));
+            const auto iy = static_cast<int32_t>(std::lround(dy));
+            double fx, fy;
+            if ((ix != 0 || iy != 0) && x0 + ix >= 0 && x0 + ix + kTileSize <= width && y0 + iy >= 0
+                && y0 + iy + kTileSize <= height && tileSpectrum(current, width, x0 + ix, y0 + iy, window, b)
+                && correlate(a, b, weights, weightSum, fx, fy) && std::abs(fx) < 1.0 && std::abs(fy) < 1.0) {
+                dx = ix + fx;
+                dy = iy + fy;
+            }
+            tiles.push_back({x0 + kTileSize * 0.5 - width * 0.5, y0 + kTileSize * 0.5 - height * 0.5, dx, dy});
+        }
+    }
+    double shiftX = 0.0, shiftY = 0.0, angle = 0.0;
+    // Any two tiles fit a rotation exactly, so it takes three to tell which is off
+    while (tiles.size() >= 3 && fitRigid(tiles, shiftX, shiftY, angle) > kMaxResidual) {
+        auto residual = [&](const TileShift& t) {
+            return std::hypot(shiftX - angle * t.y - t.dx, shiftY + angle * t.x - t.dy);
+        };
+        tiles.erase(std::max_element(tiles.begin(), tiles.end(), [&](const TileShift& p, const TileShift& q) {
+            return residual(p) < residual(q);
+        }));
+    }
+    if (tiles.size() == 2) {
+        // Shift only, if the two agree
+        if (std::hypot(tiles[0].dx - tiles[1].dx, tiles[0].dy - tiles[1].dy) > kMaxResidual) {
+            return false;
+        }
+        shiftX = (tiles[0].dx + tiles[1].dx) / 2.0;
+        shiftY = (tiles[0].dy + tiles[1].dy) / 2.0;
+        angle = 0.0;
+    } else if (tiles.size() < 2) {
+        return false;
+    }
+    shiftX /= width;
+    shiftY /= width;
+    if (std::hypot(shiftX, shiftY) > kMaxShift || std::abs(angle) > kMaxAngle) {
+        return false;
+    }
+    motion.shiftX = shiftX;
+    motion.shiftY = shiftY;
+    motion.angle = angle;
+    return true;
+}
@@ -0,0 +1,97 @@
+/*
+ * libcamera4j - whether the pipeline keeps up with the sensor.
+ *
+ * Every buffer libcamera completes carries the sensor's frame sequence number
+ * and the timestamp of its exposure. A stream that keeps up sees consecutive
+ * numbers at even intervals; a skipped number is a frame the sensor produced
+ * but no request was queued for, a repeated one a buffer handed back twice.
+ * The tracker counts both, and keeps the mean and standard deviation (the
+ * jitter) of the intervals between consecutive frames with Welford's method.
+ *
+ * A completion is late when it comes more than one frame interval after the
+ * usual delay from exposure to completion, that is after the next frame
+ * should already have completed. Measured against the running mean of that
+ * delay, it does not depend on the exposure time or on which clock the
+ * timestamps are on, as long as it is steady.
+ */
+
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <algorithm>
+#include <cmath>
+
+static_assert(sizeof(lc4j_sequence_stats) == 88, "lc4j_sequence_stats layout");
+
+namespace {
+
+// Intervals to learn the frame rate and completion delay from before any
+// completion counts as late
+constexpr int64_t kWarmupIntervals = 4;
+
+} // namespace
+
+void lc4j::FrameSequence::restart(bool reconfigured) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    started_ = false;
+    if (reconfigured) {
+        // Late is judged against these; another frame rate makes them wrong
+        delays_ = intervals_ = 0;
+        meanDelayNs_ = meanIntervalNs_ = m2_ = 0.0;
+        minIntervalNs_ = maxIntervalNs_ = 0;
+    }
+}
+
+void lc4j::FrameSequence::record(uint32_t sequence, int64_t timestampNs, int64_t completedNs) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (started_ && sequence <= lastSequence_) {
+        duplicates_++;
+        return;
+    }
+    frames_++;
+    if (timestampNs > 0) {
+        const int64_t delayNs = completedNs - timestampNs;
+        if (intervals_ >= kWarmupIntervals && delayNs > meanDelayNs_ + meanIntervalNs_) {
+            late_++;
+        }
+        delays_++;
+        meanDelayNs_ += (delayNs - meanDelayNs_) / static_cast<double>(delays_);
+    }
+
+    if (started_) {
+        dropped_ += sequence - lastSequence_ - 1;
+        const int64_t interval = timestampNs - lastTimestampNs_;
+        if (sequence == lastSequence_ + 1 && lastTimestampNs_ > 0 && interval > 0) {
+            intervals_++;
+            const double delta = interval - meanIntervalNs_;
+            meanIntervalNs_ += delta / static_cast<double>(intervals_);
+            m2_ += delta * (interval - meanIntervalNs_);
+            minIntervalNs_ = intervals_ == 1 ? interval : std::min(minIntervalNs_, interval);
+            maxIntervalNs_ = std::max(maxIntervalNs_, interval);
+        }
+    }
+    started_ = true;
+    lastSequence_ = sequence;
+    lastTimestampNs_ = timestampNs;
+}
+
+void lc4j::FrameSequence::snapshot(lc4j_sequence_stats& out, bool reset) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out.frames = frames_;
+    out.dropped = dropped_;
+    out.duplicates = duplicates_;
+    out.late = late_;
+    out.lastSequence = lastSequence_;
+    out.intervals = intervals_;
+    out.meanIntervalNs = meanIntervalNs_;
+    out.jitterNs = intervals_ > 0 ? std::sqrt(m2_ / static_cast<double>(intervals_)) : 0.0;
+    out.minIntervalNs = minIntervalNs_;
+    out.maxIntervalNs = maxIntervalNs_;
+    out.meanLatencyNs = meanDelayNs_;
+    if (reset) {
+        // The last frame is kept, so that a gap to the next one still counts
+        frames_ = dropped_ = duplicates_ = late_ = delays_ = intervals_ = 0;
+        meanDelayNs_ = meanIntervalNs_ = m2_ = 0.0;
+        minIntervalNs_ = maxIntervalNs_ = 0;
+    }
+}
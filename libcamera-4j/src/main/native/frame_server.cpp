@@ -0,0 +1,336 @@
+/*
+ * libcamera4j - zero-copy frame server for other local processes.
+ *
+ * Capture sessions map their dmabufs only to encode them. A frame server passes
+ * the same dmabuf fds, with the plane layout and metadata, to subscriber
+ * processes over a Unix socket (SCM_RIGHTS), so a local encoder or analysis
+ * process can read full-resolution frames without a single copy. The kernel
+ * keeps a buffer alive for as long as any subscriber holds its fd, even after
+ * the session has freed it, so release tokens are credits: a subscriber holding
+ * maxOutstanding frames is skipped until it returns one, and cannot pin more of
+ * the camera's memory than that. Sends never block the capture; a subscriber
+ * whose socket is full misses the frame. The protocol is described with
+ * lc4j_served_frame in libcamera4j.h.
+ */
+
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+static_assert(sizeof(lc4j_served_frame) == 96, "lc4j_served_frame layout");
+
+constexpr int32_t kMaxOutstandingLimit = 64;
+
+class FrameServer {
+public:
+    ~FrameServer() {
+        if (thread_.joinable()) {
+            uint64_t one = 1;
+            ssize_t ignored = ::write(wakeFd_, &one, sizeof(one));
+            (void)ignored;
+            thread_.join();
+        }
+        for (const Client& client : clients_) {
+            close(client.fd);
+        }
+        if (listenFd_ >= 0) {
+            close(listenFd_);
+            unlink(path_.c_str());
+        }
+        if (wakeFd_ >= 0) {
+            close(wakeFd_);
+        }
+    }
+
+    int32_t open(const std::string& path, int32_t maxOutstanding) {
+        sockaddr_un addr{};
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+            return -ENAMETOOLONG;
+        }
+        path_ = path;
+        maxOutstanding_ = static_cast<size_t>(maxOutstanding);
+        wakeFd_ = eventfd(0, EFD_CLOEXEC);
+        if (wakeFd_ < 0) {
+            return -errno;
+        }
+        listenFd_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+        if (listenFd_ < 0) {
+            return -errno;
+        }
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size());
+        // A socket file left by a crashed process would make bind fail
+        unlink(path.c_str());
+        if (bind(listenFd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+                || listen(listenFd_, 8) < 0) {
+            int ret = -errno;
+            close(listenFd_);
+            listenFd_ = -1;
+            return ret;
+        }
+        thread_ = std::thread([this] { run(); });
+        return 0;
+    }
+
+    int32_t subscribers() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return static_cast<int32_t>(clients_.size());
+    }
+
+    bool wanted() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return std::any_of(clients_.begin(), clients_.end(), [this](const Client& client) {
+            return client.outstanding.size() < maxOutstanding_;
+        });
+    }
+
+    void serve(lc4j_served_frame& frame, const int* fds) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (Client& client : clients_) {
+            if (client.outstanding.size() >= maxOutstanding_) {
+                continue;
+            }
+            frame.token = nextToken_++;
+            if (sendFrame(client.fd, frame, fds)) {
+                client.outstanding.insert(frame.token);
+            }
+        }
+    }
+
+private:
+    struct Client {
+        int fd;
+        std::set<uint64_t> outstanding;
+    };
+
+    std::string path_;
+    size_t maxOutstanding_ = 0;
+    int listenFd_ = -1;
+    int wakeFd_ = -1;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::vector<Client> clients_;
+    uint64_t nextToken_ = 1;
+
+    static bool sendFrame(int fd, const lc4j_served_frame& frame, const int* fds) {
+        iovec iov{const_cast<lc4j_served_frame*>(&frame), sizeof(frame)};
+        alignas(cmsghdr) char control[CMSG_SPACE(3 * sizeof(int))];
+        std::memset(control, 0, sizeof(control));
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(static_cast<size_t>(frame.fdCount) * sizeof(int));
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(static_cast<size_t>(frame.fdCount) * sizeof(int));
+        std::memcpy(CMSG_DATA(cmsg), fds, static_cast<size_t>(frame.fdCount) * sizeof(int));
+        // A full socket means a slow subscriber: it misses this frame. A
+        // disconnect is noticed by the server thread.
+        return sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(frame));
+    }
+
+    // Accepts subscribers and collects their releases until the wake fd fires.
+    void run() {
+        std::vector<pollfd> fds;
+        while (true) {
+            fds.clear();
+            fds.push_back({wakeFd_, POLLIN, 0});
+            fds.push_back({listenFd_, POLLIN, 0});
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (const Client& client : clients_) {
+                    fds.push_back({client.fd, POLLIN, 0});
+                }
+            }
+            if (poll(fds.data(), fds.size(), -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return;
+            }
+            if (fds[0].revents != 0) {
+                return;
+            }
+            if (fds[1].revents & POLLIN) {
+                int fd = accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+                if (fd >= 0) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    clients_.push_back({fd, {}});
+                }
+            }
+            for (size_t i = 2; i < fds.size(); ++i) {
+                if (fds[i].revents != 0) {
+                    readReleases(fds[i].fd);
+                }
+            }
+        }
+    }
+
+    void readReleases(int fd) {
+        lc4j_frame_release release;
+        bool closed = false;
+        std::vector<uint64_t> tokens;
+        while (true) {
+            ssize_t n = recv(fd, &release, sizeof(release), MSG_DONTWAIT);
+            if (n == static_cast<ssize_t>(sizeof(release))) {
+                tokens.push_back(release.token);
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n > 0) {
+                continue;   // malformed message, ignored
+            }
+            closed = true;   // orderly shutdown or error
+            break;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::find_if(clients_.begin(), clients_.end(), [fd](const Client& c) { return c.fd == fd; });
+        if (it == clients_.end()) {
+            return;
+        }
+        if (closed) {
+            close(it->fd);
+            clients_.erase(it);
+            return;
+        }
+        for (uint64_t token : tokens) {
+            it->outstanding.erase(token);
+        }
+    }
+};
+
+std::mutex g_serversMutex;
+std::map<int64_t, std::shared_ptr<FrameServer>> g_servers;
+
+std::shared_ptr<FrameServer> findServer(int64_t handle) {
+    std::lock_guard<std::mutex> lock(g_serversMutex);
+    auto it = g_servers.find(handle);
+    return it == g_servers.end() ? nullptr : it->second;
+}
+
+std::vector<std::shared_ptr<FrameServer>> allServers() {
+    std::lock_guard<std::mutex> lock(g_serversMutex);
+    std::vector<std::shared_ptr<FrameServer>> servers;
+    for (const auto& [handle, server] : g_servers) {
+        servers.push_back(server);
+    }
+    return servers;
+}
+
+} // namespace
+
+bool lc4j::frameServerWanted() {
+    for (const auto& server : allServers()) {
+        if (server->wanted()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void lc4j::serveFrame(uint32_t fourcc, int32_t width, int32_t height, const DmabufPlane* planes,
+                      int32_t planeCount, int64_t timestampNs, int64_t sequence) {
+    if (planeCount <= 0 || planeCount > 3) {
+        return;
+    }
+    lc4j_served_frame frame;
+    std::memset(&frame, 0, sizeof(frame));
+    frame.magic = LC4J_SERVED_FRAME_MAGIC;
+    frame.planeCount = static_cast<uint32_t>(planeCount);
+    frame.timestampNs = timestampNs;
+    frame.sequence = sequence;
+    frame.fourcc = fourcc;
+    frame.width = width;
+    frame.height = height;
+    // Planes of one buffer usually share an fd; send each distinct fd once
+    int fds[3];
+    for (int32_t i = 0; i < planeCount; ++i) {
+        int32_t index = 0;
+        while (index < frame.fdCount && fds[index] != planes[i].fd) {
+            ++index;
+        }
+        if (index == frame.fdCount) {
+            fds[frame.fdCount++] = planes[i].fd;
+        }
+        frame.planes[i].fdIndex = index;
+        frame.planes[i].stride = planes[i].stride;
+        frame.planes[i].offset = planes[i].offset;
+        frame.planes[i].length = planes[i].length;
+    }
+    for (const auto& server : allServers()) {
+        server->serve(frame, fds);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// FrameServer
+// -----------------------------------------------------------------------------
+
+extern "C" {
+
+int64_t lc4j_server_open(const char* path, int32_t maxOutstanding) {
+    if (path == nullptr || maxOutstanding < 1 || maxOutstanding > kMaxOutstandingLimit) {
+        return 0;
+    }
+    try {
+        auto server = std::make_shared<FrameServer>();
+        if (server->open(path, maxOutstanding) < 0) {
+            return 0;
+        }
+        int64_t handle = lc4j::allocHandle();
+        std::lock_guard<std::mutex> lock(g_serversMutex);
+        g_servers[handle] = std::move(server);
+        return handle;
+    } catch (const std::exception&) {
+        return 0;
+    }
+}
+
+void lc4j_server_close(int64_t handle) {
+    std::shared_ptr<FrameServer> server;
+    {
+        std::lock_guard<std::mutex> lock(g_serversMutex);
+        auto it = g_servers.find(handle);
+        if (it == g_servers.end()) {
+            return;
+        }
+        server = std::move(it->second);
+        g_servers.erase(it);
+    }
+    // Stopped and the socket removed once a serve in progress has let go of it
+}
+
+int32_t lc4j_server_subscribers(int64_t handle) {
+    auto server = findServer(handle);
+    if (!server) {
+        return -1;
+    }
+    return server->subscribers();
+}
+
+} // extern "C"
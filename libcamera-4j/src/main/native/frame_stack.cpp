@@ -0,0 +1,376 @@
+/*
+ * libcamera4j - averaging a burst of frames.
+ *
+ * At night the camera runs at high analogue gain and every single frame is
+ * noisy. Averaging N frames taken with the same controls cuts the noise by
+ * sqrt(N), like an N times longer exposure without its motion blur or
+ * saturation. Frames are summed into 16-bit accumulators as they arrive, so a
+ * burst costs one frame of memory however long it is, and the summing of a
+ * frame runs on a few threads while the camera fills the next buffer. The
+ * inner loops are plain widening adds over contiguous rows, which the
+ * compiler vectorises (NEON on the Pi).
+ *
+ * A camera on a jetty moves a little in the wind, so frames can be aligned to
+ * the first one by a global whole-pixel shift, searched coarse to fine on a
+ * luma pyramid. Raw frames are shifted by whole Bayer quads to keep the colour
+ * pattern, and their average gains up to log2(N) bits of precision in the DNG.
+ */
+
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int32_t kMaxFrames = LC4J_BURST_MAX_FRAMES;
+constexpr int32_t kMaxThreads = 4;
+// Rows per thread below which a split is not worth a thread
+constexpr int32_t kMinRowsPerThread = 64;
+constexpr int32_t kTopLevelWidth = 160;
+constexpr int32_t kTopLevelRadius = 4;
+constexpr int64_t kMaxSadSamples = 1 << 15;
+
+bool isPlanar420(uint32_t fourcc) {
+    return fourcc == lc4j::fourcc('Y', 'U', '1', '2') || fourcc == lc4j::fourcc('Y', 'V', '1', '2');
+}
+
+bool isSemiPlanar420(uint32_t fourcc) {
+    return fourcc == lc4j::fourcc('N', 'V', '1', '2') || fourcc == lc4j::fourcc('N', 'V', '2', '1');
+}
+
+int32_t log2Floor(int32_t value) {
+    int32_t bits = 0;
+    while ((value >>= 1) != 0) {
+        ++bits;
+    }
+    return bits;
+}
+
+// Clamps a sample index into [0, n), keeping its phase modulo `unit` so that
+// interleaved chroma and Bayer colours stay what they were.
+inline int32_t clampPhase(int32_t v, int32_t n, int32_t unit) {
+    if (v < 0) {
+        return ((v % unit) + unit) % unit;
+    }
+    if (v >= n) {
+        return n - unit + v % unit;
+    }
+    return v;
+}
+
+// acc[x] += src[x + shift], with the edges replicated in phase.
+template <typename T>
+void addShiftedRow(uint16_t* __restrict acc, const T* __restrict src, int32_t n, int32_t shift, int32_t unit) {
+    const int32_t lo = std::clamp(-shift, 0, n);
+    const int32_t hi = std::clamp(n - shift, lo, n);
+    for (int32_t x = 0; x < lo; ++x) {
+        acc[x] += src[clampPhase(x + shift, n, unit)];
+    }
+    const T* shifted = src + shift;
+    for (int32_t x = lo; x < hi; ++x) {
+        acc[x] += shifted[x];
+    }
+    for (int32_t x = hi; x < n; ++x) {
+        acc[x] += src[clampPhase(x + shift, n, unit)];
+    }
+}
+
+// Mean absolute difference of ref(x, y) and cur(x + dx, y + dy) over their
+// overlap, on a subsampled grid; INT64_MAX if they hardly overlap.
+template <typename L>
+int64_t meanDifference(const L& ref, const L& cur, int32_t dx, int32_t dy) {
+    const int32_t x0 = std::max(0, -dx);
+    const int32_t x1 = std::min(ref.width, ref.width - dx);
+    const int32_t y0 = std::max(0, -dy);
+    const int32_t y1 = std::min(ref.height, ref.height - dy);
+    if ((x1 - x0) * 2 < ref.width || (y1 - y0) * 2 < ref.height) {
+        return INT64_MAX;
+    }
+    int32_t every = 1;
+    while (static_cast<int64_t>((x1 - x0) / every) * ((y1 - y0) / every) > kMaxSadSamples) {
+        ++every;
+    }
+    int64_t sum = 0;
+    int64_t count = 0;
+    for (int32_t y = y0; y < y1; y += every) {
+        const uint8_t* r = ref.pixels.data() + static_cast<size_t>(y) * ref.width;
+        const uint8_t* c = cur.pixels.data() + static_cast<size_t>(y + dy) * cur.width + dx;
+        for (int32_t x = x0; x < x1; x += every) {
+            sum += std::abs(static_cast<int32_t>(r[x]) - c[x]);
+        }
+        count += (x1 - x0 + every - 1) / every;
+    }
+    // Scaled, so that candidates compare at sub-level precision
+    return sum * 256 / std::max<int64_t>(1, count);
+}
+
+} // namespace
+
+void lc4j::forRows(int32_t rows, const std::function<void(int32_t, int32_t)>& fn) {
+    forRows(rows, kMinRowsPerThread, fn);
+}
+
+void lc4j::forRows(int32_t rows, int32_t minRows, const std::function<void(int32_t, int32_t)>& fn) {
+    int32_t threads = static_cast<int32_t>(std::thread::hardware_concurrency());
+    threads = std::clamp(std::min(threads, rows / std::max(1, minRows)), 1, kMaxThreads);
+    if (threads == 1) {
+        fn(0, rows);
+        return;
+    }
+    std::vector<std::thread> workers;
+    const int32_t chunk = (rows + threads - 1) / threads;
+    for (int32_t t = 1; t < threads; ++t) {
+        const int32_t begin = t * chunk;
+        const int32_t end = std::min(rows, begin + chunk);
+        workers.emplace_back([&fn, begin, end] { fn(begin, end); });
+    }
+    fn(0, std::min(rows, chunk));
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+int32_t lc4j::FrameStack::begin(const FrameView& frame, const RawInfo* raw, int32_t maxFrames, bool align) {
+    if (frame.planes[0] == nullptr || frame.width < 2 || frame.height < 2 || maxFrames < 1 || maxFrames > kMaxFrames) {
+        return -EINVAL;
+    }
+    first_ = frame;
+    raw_ = raw != nullptr;
+    align_ = align;
+    maxFrames_ = maxFrames;
+    count_ = 0;
+    shiftX_ = shiftY_ = 0;
+    reference_.clear();
+    const int32_t chromaW = (frame.width + 1) / 2;
+    const int32_t chromaH = (frame.height + 1) / 2;
+    if (raw_) {
+        if ((frame.width & 1) || (frame.height & 1)) {
+            return -EINVAL;
+        }
+        rawInfo_ = *raw;
+        // Room for maxFrames samples in 16 bits
+        preShift_ = std::max(0, rawInfo_.bitDepth + log2Floor(2 * maxFrames - 1) - 16);
+        planeCount_ = 1;
+        planes_[0] = {frame.width, frame.height, 1, 2, {}};
+    } else if (isPlanar420(frame.fourcc)) {
+        planeCount_ = 3;
+        planes_[0] = {frame.width, frame.height, 1, 1, {}};
+        planes_[1] = {chromaW, chromaH, 2, 1, {}};
+        planes_[2] = {chromaW, chromaH, 2, 1, {}};
+    } else if (isSemiPlanar420(frame.fourcc)) {
+        planeCount_ = 2;
+        planes_[0] = {frame.width, frame.height, 1, 1, {}};
+        planes_[1] = {chromaW * 2, chromaH, 2, 2, {}};
+    } else {
+        return -ENOTSUP;
+    }
+    for (int32_t i = 0; i < planeCount_; ++i) {
+        if (frame.planes[i] == nullptr) {
+            return -EINVAL;
+        }
+        planes_[i].sums.assign(static_cast<size_t>(planes_[i].rowBytes) * planes_[i].rows, 0);
+    }
+    if (align_) {
+        pyramid(frame, reference_);
+    }
+    accumulate(frame, 0, 0);
+    count_ = 1;
+    return 0;
+}
+
+int32_t lc4j::FrameStack::add(const FrameView& frame) {
+    if (count_ == 0) {
+        return -EINVAL;
+    }
+    if (frame.fourcc != first_.fourcc || frame.width != first_.width || frame.height != first_.height) {
+        return -EINVAL;
+    }
+    // The sums only have room for maxFrames
+    if (count_ >= maxFrames_) {
+        return -ENOSPC;
+    }
+    int32_t dx = 0;
+    int32_t dy = 0;
+    if (align_) {
+        std::vector<Level> levels;
+        pyramid(frame, levels);
+        for (int32_t level = static_cast<int32_t>(levels.size()) - 1; level >= 0; --level) {
+            const int32_t radius = level == static_cast<int32_t>(levels.size()) - 1 ? kTopLevelRadius : 1;
+            if (level != static_cast<int32_t>(levels.size()) - 1) {
+                dx *= 2;
+                dy *= 2;
+            }
+            int64_t best = meanDifference(reference_[level], levels[level], dx, dy);
+            int32_t bestX = dx;
+            int32_t bestY = dy;
+            for (int32_t sy = dy - radius; sy <= dy + radius; ++sy) {
+                for (int32_t sx = dx - radius; sx <= dx + radius; ++sx) {
+                    const int64_t difference = meanDifference(reference_[level], levels[level], sx, sy);
+                    // Ties go to the smaller shift
+                    if (difference < best || (difference == best
+                            && std::abs(sx) + std::abs(sy) < std::abs(bestX) + std::abs(bestY))) {
+                        best = difference;
+                        bestX = sx;
+                        bestY = sy;
+                    }
+                }
+            }
+            dx = bestX;
+            dy = bestY;
+        }
+        if (raw_) {
+            // Levels of a raw frame are in Bayer quads
+            dx *= 2;
+            dy *= 2;
+        }
+    }
+    shiftX_ = dx;
+    shiftY_ = dy;
+    accumulate(frame, dx, dy);
+    ++count_;
+    return 0;
+}
+
+int32_t lc4j::FrameStack::average(OwnedFrame& out, RawInfo* rawOut) const {
+    if (count_ == 0 || (raw_ && rawOut == nullptr)) {
+        return -EINVAL;
+    }
+    out.view = FrameView();
+    out.view.fourcc = first_.fourcc;
+    out.view.width = first_.width;
+    out.view.height = first_.height;
+    const uint32_t n = static_cast<uint32_t>(count_);
+    // Division by n as a multiply, exact for the sums' range
+    const uint64_t reciprocal = ((uint64_t{1} << 32) + n - 1) / n;
+    if (raw_) {
+        const int32_t extra = std::min(16 - rawInfo_.bitDepth, log2Floor(count_));
+        const Plane& plane = planes_[0];
+        std::vector<uint8_t>& bytes = out.planes[0];
+        bytes.resize(plane.sums.size() * 2);
+        forRows(plane.rows, [&](int32_t begin, int32_t end) {
+            for (size_t i = static_cast<size_t>(begin) * plane.rowBytes; i < static_cast<size_t>(end) * plane.rowBytes;
+                 ++i) {
+                const uint64_t sum = (static_cast<uint64_t>(plane.sums[i]) << (preShift_ + extra)) + n / 2;
+                const auto value = static_cast<uint32_t>((sum * reciprocal) >> 32);
+                bytes[i * 2] = static_cast<uint8_t>(value);
+                bytes[i * 2 + 1] = static_cast<uint8_t>(value >> 8);
+            }
+        });
+        out.view.planes[0] = bytes.data();
+        out.view.strides[0] = plane.rowBytes * 2;
+        *rawOut = rawInfo_;
+        rawOut->packing = RawPacking::Unpacked16;
+        rawOut->bitDepth = rawInfo_.bitDepth + extra;
+        return 0;
+    }
+    for (int32_t p = 0; p < planeCount_; ++p) {
+        const Plane& plane = planes_[p];
+        std::vector<uint8_t>& bytes = out.planes[p];
+        bytes.resize(plane.sums.size());
+        forRows(plane.rows, [&](int32_t begin, int32_t end) {
+            for (size_t i = static_cast<size_t>(begin) * plane.rowBytes; i < static_cast<size_t>(end) * plane.rowBytes;
+                 ++i) {
+                bytes[i] = static_cast<uint8_t>(((plane.sums[i] + n / 2) * reciprocal) >> 32);
+            }
+        });
+        out.view.planes[p] = bytes.data();
+        out.view.strides[p] = plane.rowBytes;
+    }
+    return 0;
+}
+
+// Luma (or Bayer quad) pyramid of a frame, halved until at most
+// kTopLevelWidth wide.
+void lc4j::FrameStack::pyramid(const FrameView& frame, std::vector<Level>& levels) const {
+    Level base;
+    if (raw_) {
+        base.width = frame.width / 2;
+        base.height = frame.height / 2;
+        base.pixels.resize(static_cast<size_t>(base.width) * base.height);
+        const int32_t down = std::max(0, rawInfo_.bitDepth - 8);
+        forRows(base.height, [&](int32_t begin, int32_t end) {
+            std::vector<uint16_t> rows(static_cast<size_t>(frame.width) * 2);
+            for (int32_t y = begin; y < end; ++y) {
+                const uint8_t* src = frame.planes[0] + static_cast<size_t>(y) * 2 * frame.strides[0];
+                unpackRawRow(src, frame.width, rawInfo_.packing, rows.data());
+                unpackRawRow(src + frame.strides[0], frame.width, rawInfo_.packing, rows.data() + frame.width);
+                uint8_t* out = base.pixels.data() + static_cast<size_t>(y) * base.width;
+                for (int32_t x = 0; x < base.width; ++x) {
+                    const uint32_t sum = rows[x * 2] + rows[x * 2 + 1] + rows[frame.width + x * 2]
+                                       + rows[frame.width + x * 2 + 1];
+                    out[x] = static_cast<uint8_t>(std::min<uint32_t>(255, (sum / 4) >> down));
+                }
+            }
+        });
+    } else {
+        base.width = frame.width;
+        base.height = frame.height;
+        base.pixels.resize(static_cast<size_t>(base.width) * base.height);
+        for (int32_t y = 0; y < base.height; ++y) {
+            std::memcpy(base.pixels.data() + static_cast<size_t>(y) * base.width,
+                        frame.planes[0] + static_cast<size_t>(y) * frame.strides[0], base.width);
+        }
+    }
+    levels.clear();
+    levels.push_back(std::move(base));
+    while (levels.back().width > kTopLevelWidth && levels.back().height >= 8) {
+        const Level& fine = levels.back();
+        Level coarse;
+        coarse.width = fine.width / 2;
+        coarse.height = fine.height / 2;
+        coarse.pixels.resize(static_cast<size_t>(coarse.width) * coarse.height);
+        for (int32_t y = 0; y < coarse.height; ++y) {
+            const uint8_t* r0 = fine.pixels.data() + static_cast<size_t>(y) * 2 * fine.width;
+            const uint8_t* r1 = r0 + fine.width;
+            uint8_t* out = coarse.pixels.data() + static_cast<size_t>(y) * coarse.width;
+            for (int32_t x = 0; x < coarse.width; ++x) {
+                out[x] = static_cast<uint8_t>((r0[x * 2] + r0[x * 2 + 1] + r1[x * 2] + r1[x * 2 + 1] + 2) / 4);
+            }
+        }
+        levels.push_back(std::move(coarse));
+    }
+}
+
+void lc4j::FrameStack::accumulate(const FrameView& frame, int32_t dx, int32_t dy) {
+    if (raw_) {
+        Plane& plane = planes_[0];
+        forRows(plane.rows, [&](int32_t begin, int32_t end) {
+            std::vector<uint16_t> row(static_cast<size_t>(frame.width));
+            for (int32_t y = begin; y < end; ++y) {
+                const int32_t sy = clampPhase(y + dy, plane.rows, 2);
+                unpackRawRow(frame.planes[0] + static_cast<size_t>(sy) * frame.strides[0], frame.width,
+                             rawInfo_.packing, row.data());
+                if (preShift_ > 0) {
+                    for (auto& sample : row) {
+                        sample = static_cast<uint16_t>(sample >> preShift_);
+                    }
+                }
+                addShiftedRow(plane.sums.data() + static_cast<size_t>(y) * plane.rowBytes, row.data(),
+                              plane.rowBytes, dx, plane.unit);
+            }
+        });
+        return;
+    }
+    for (int32_t p = 0; p < planeCount_; ++p) {
+        Plane& plane = planes_[p];
+        const int32_t shiftX = dx / plane.subsampling * plane.unit;
+        const int32_t shiftY = dy / plane.subsampling;
+        forRows(plane.rows, [&](int32_t begin, int32_t end) {
+            for (int32_t y = begin; y < end; ++y) {
+                const int32_t sy = clampPhase(y + shiftY, plane.rows, 1);
+                addShiftedRow(plane.sums.data() + static_cast<size_t>(y) * plane.rowBytes,
+                              frame.planes[p] + static_cast<size_t>(sy) * frame.strides[p], plane.rowBytes,
+                              shiftX, plane.unit);
+            }
+        });
+    }
+}
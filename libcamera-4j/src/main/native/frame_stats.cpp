@@ -0,0 +1,167 @@
+/*
+ * libcamera4j - luma histogram and exposure statistics of a frame.
+ *
+ * Java only needs a few numbers to judge an exposure or draw a histogram, so
+ * they are computed here, straight from the mapped buffer, instead of copying
+ * the frame to the heap. The pass reads a regular subsampled grid of at most
+ * kMaxSamples luma values (one per 2x2 quad for raw frames), which keeps it to
+ * about a millisecond on a Pi at any resolution; the result is a 256-bin
+ * histogram with its mean, median and clipping, plus the mean of each zone of
+ * a coarse grid for spot or centre-weighted metering.
+ */
+
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <vector>
+
+namespace {
+
+static_assert(sizeof(lc4j_frame_stats) == 2088, "lc4j_frame_stats layout");
+
+constexpr int64_t kMaxSamples = 1 << 17;
+constexpr int32_t kMaxZonesPerSide = 16;
+
+// Top 8 bits of sample x of a packed raw row.
+inline uint32_t rawTop8(const uint8_t* row, int32_t x, const lc4j::RawInfo& raw) {
+    switch (raw.packing) {
+        case lc4j::RawPacking::Csi2p10:
+            return row[(x / 4) * 5 + (x & 3)];
+        case lc4j::RawPacking::Csi2p12:
+            return row[(x / 2) * 3 + (x & 1)];
+        case lc4j::RawPacking::Unpacked16:
+            break;
+    }
+    const uint32_t value = row[x * 2] | (row[x * 2 + 1] << 8);
+    return std::min<uint32_t>(255, value >> std::max(0, raw.bitDepth - 8));
+}
+
+} // namespace
+
+int32_t lc4j::frameStats(const FrameView& frame, const RawInfo* raw, int32_t zonesX, int32_t zonesY,
+                         lc4j_frame_stats& out) {
+    if (frame.planes[0] == nullptr || zonesX < 1 || zonesY < 1
+            || zonesX > kMaxZonesPerSide || zonesY > kMaxZonesPerSide) {
+        return -EINVAL;
+    }
+    int32_t offset = 0;
+    int32_t step = 1;
+    if (raw == nullptr && !lumaSampling(frame.fourcc, offset, step)) {
+        return -ENOTSUP;
+    }
+    // Sampling units: pixels, or 2x2 Bayer quads
+    const int32_t unitsW = raw != nullptr ? frame.width / 2 : frame.width;
+    const int32_t unitsH = raw != nullptr ? frame.height / 2 : frame.height;
+    if (unitsW < zonesX || unitsH < zonesY) {
+        return -EINVAL;
+    }
+    int32_t every = 1;
+    while (static_cast<int64_t>((unitsW + every - 1) / every) * ((unitsH + every - 1) / every) > kMaxSamples) {
+        ++every;
+    }
+
+    try {
+        const int32_t columns = (unitsW + every - 1) / every;
+        std::vector<int32_t> zoneColumn(columns);
+        for (int32_t i = 0; i < columns; ++i) {
+            zoneColumn[i] = static_cast<int32_t>(static_cast<int64_t>(i) * every * zonesX / unitsW);
+        }
+        uint64_t histogram[256] = {};
+        uint64_t zoneSums[LC4J_STATS_MAX_ZONES] = {};
+        uint64_t zoneCounts[LC4J_STATS_MAX_ZONES] = {};
+        uint64_t sum = 0;
+        for (int32_t uy = 0; uy < unitsH; uy += every) {
+            const int32_t zy = static_cast<int32_t>(static_cast<int64_t>(uy) * zonesY / unitsH);
+            uint64_t* sums = zoneSums + zy * zonesX;
+            uint64_t* counts = zoneCounts + zy * zonesX;
+            if (raw != nullptr) {
+                const uint8_t* row0 = frame.planes[0] + static_cast<size_t>(uy) * 2 * frame.strides[0];
+                const uint8_t* row1 = row0 + frame.strides[0];
+                for (int32_t i = 0; i < columns; ++i) {
+                    const int32_t x = i * every * 2;
+                    const uint32_t value = (rawTop8(row0, x, *raw) + rawTop8(row0, x + 1, *raw)
+                                          + rawTop8(row1, x, *raw) + rawTop8(row1, x + 1, *raw) + 2) / 4;
+                    histogram[value]++;
+                    sums[zoneColumn[i]] += value;
+                    counts[zoneColumn[i]]++;
+                    sum += value;
+                }
+            } else {
+                const uint8_t* row = frame.planes[0] + static_cast<size_t>(uy) * frame.strides[0] + offset;
+                for (int32_t i = 0; i < columns; ++i) {
+                    const uint32_t value = row[static_cast<size_t>(i) * every * step];
+                    histogram[value]++;
+                    sums[zoneColumn[i]] += value;
+                    counts[zoneColumn[i]]++;
+                    sum += value;
+                }
+            }
+        }
+
+        std::memset(&out, 0, sizeof(out));
+        uint64_t samples = 0;
+        for (int32_t level = 0; level < 256; ++level) {
+            out.histogram[level] = static_cast<uint32_t>(histogram[level]);
+            samples += histogram[level];
+        }
+        uint64_t below = 0;
+        out.median = 255;
+        for (int32_t level = 0; level < 256; ++level) {
+            below += histogram[level];
+            if (below * 2 >= samples) {
+                out.median = level;
+                break;
+            }
+        }
+        out.samples = samples;
+        out.mean = static_cast<double>(sum) / samples;
+        out.clippedLow = static_cast<float>(100.0 * histogram[0] / samples);
+        out.clippedHigh = static_cast<float>(100.0 * histogram[255] / samples);
+        out.zonesX = zonesX;
+        out.zonesY = zonesY;
+        for (int32_t zone = 0; zone < zonesX * zonesY; ++zone) {
+            out.zoneMeans[zone] = zoneCounts[zone] == 0
+                    ? 0.0f : static_cast<float>(static_cast<double>(zoneSums[zone]) / zoneCounts[zone]);
+        }
+        return 0;
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// FrameStats
+// -----------------------------------------------------------------------------
+
+extern "C" {
+
+int32_t lc4j_frame_compute_stats(const void* plane, int64_t length, int32_t fourcc, int32_t width, int32_t height,
+                                 int32_t stride, int32_t zonesX, int32_t zonesY, lc4j_frame_stats* out) {
+    if (plane == nullptr || out == nullptr || width <= 0 || height <= 0 || stride <= 0) {
+        return -EINVAL;
+    }
+    int32_t offset;
+    int32_t step;
+    if (!lc4j::lumaSampling(static_cast<uint32_t>(fourcc), offset, step)) {
+        return -ENOTSUP;
+    }
+    // The last luma sample must lie within the plane
+    const int64_t needed = static_cast<int64_t>(height - 1) * stride + offset
+                         + static_cast<int64_t>(width - 1) * step + 1;
+    if (length < needed) {
+        return -EINVAL;
+    }
+    lc4j::FrameView frame;
+    frame.fourcc = static_cast<uint32_t>(fourcc);
+    frame.width = width;
+    frame.height = height;
+    frame.planes[0] = static_cast<const uint8_t*>(plane);
+    frame.strides[0] = stride;
+    return lc4j::frameStats(frame, nullptr, zonesX, zonesY, *out);
+}
+
+} // extern "C"
@@ -0,0 +1,1634 @@
+/*
+ * libcamera4j - append-only segment store for encoded frames.
+ *
+ * A timelapse used to be one small JPEG file per capture, which means tens of
+ * thousands of inodes, a directory walk on every startup and an SD card that
+ * rewrites metadata blocks for each frame. The store instead keeps one pair of
+ * files per day:
+ *
+ *     <root>/<yyyymmdd>.<generation>.seg   encoded frames, back to back
+ *     <root>/<yyyymmdd>.idx                header + fixed 32-byte records
+ *
+ * Appends write the frame at the end of the segment and then its index record,
+ * so a record never points at data that was not written first; any record
+ * reaching past the end of its segment is ignored when the day is loaded.
+ * Deleting a frame only sets a flag in its index record, and a frame's tag (a
+ * caller-defined 64-bit value such as a perceptual hash) is kept in the
+ * otherwise unused end of its record. Compaction copies the
+ * live frames of a day into a segment of the next generation, writes a new
+ * index next to the old one and renames it into place - the rename is the
+ * commit point, after which the old segment is unlinked. Leftovers of an
+ * interrupted compaction are removed on open.
+ *
+ * All live frames of all days are additionally listed in one sorted, memory-
+ * mapped index (<root>/timeline.map, see lc4j_store_index_header) which is what
+ * lookups, range queries and the Java side search. It is kept current on every
+ * append, delete and compaction, so opening a store only reads the header of
+ * each day's index; a day's files are opened the first time it is used. The
+ * timeline is flagged clean when the store is closed and rebuilt from the day
+ * indexes if it was not.
+ *
+ * Appends are not synced individually. The day files touched since the last
+ * group commit are collected and made durable together - one fdatasync per
+ * file, plus a directory fsync after new days were created - by a background
+ * thread every commit interval or once the byte budget is exceeded. Appends are
+ * numbered as they complete, and a commit covers every append numbered before
+ * it started, which gives the durable watermark reported to callers. The
+ * timeline is never synced: after a crash it is rebuilt from the day indexes.
+ *
+ * Timestamps are opaque 64-bit milliseconds; the day a frame belongs to is
+ * derived from them as if they were UTC.
+ */
+
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr char kIndexMagic[8] = {'L', 'C', '4', 'J', 'I', 'D', 'X', '1'};
+constexpr uint32_t kIndexVersion = 1;
+constexpr char kTimelineMagic[8] = {'L', 'C', '4', 'J', 'T', 'M', 'L', '1'};
+constexpr uint32_t kTimelineVersion = 1;
+constexpr int64_t kMsPerDay = 86400000;
+// Days are keyed as yyyymmdd, so timestamps are limited to years 1..9999.
+constexpr int64_t kMinTimestampMs = -62135596800000LL;
+constexpr int64_t kMaxTimestampMs = 253402300799999LL;
+constexpr size_t kCopyChunk = 256 * 1024;
+// Address space reserved for the timeline so that it never has to move; the
+// file itself grows in steps. 16M entries (~400 MB of address space), halved
+// until the reservation succeeds on small address spaces.
+constexpr size_t kTimelineReserveEntries = size_t(1) << 24;
+constexpr size_t kTimelineMinReserveEntries = size_t(1) << 16;
+constexpr size_t kTimelineGrowEntries = 16384;
+
+using IndexEntry = lc4j_store_index_entry;
+using TimelineHeader = lc4j_store_index_header;
+
+struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t generation;
+    uint64_t reserved;
+};
+static_assert(sizeof(IndexHeader) == 32, "index header layout");
+static_assert(sizeof(lc4j_store_record) == 32, "index record layout");
+static_assert(sizeof(TimelineHeader) == 64, "timeline header layout");
+static_assert(sizeof(IndexEntry) == 24, "timeline entry layout");
+
+bool byTimestamp(const IndexEntry& a, const IndexEntry& b) {
+    return a.timestampMs < b.timestampMs;
+}
+
+int64_t dayStartMs(int64_t timestampMs) {
+    return (timestampMs / kMsPerDay - (timestampMs % kMsPerDay < 0 ? 1 : 0)) * kMsPerDay;
+}
+
+int32_t dayKey(int64_t timestampMs) {
+    time_t seconds = static_cast<time_t>(dayStartMs(timestampMs) / 1000);
+    struct tm tm;
+    gmtime_r(&seconds, &tm);
+    return (tm.tm_year + 1900) * 10000 + (tm.tm_mon + 1) * 100 + tm.tm_mday;
+}
+
+int64_t dayKeyStartMs(int32_t key) {
+    struct tm tm;
+    std::memset(&tm, 0, sizeof(tm));
+    tm.tm_year = key / 10000 - 1900;
+    tm.tm_mon = key / 100 % 100 - 1;
+    tm.tm_mday = key % 100;
+    return static_cast<int64_t>(timegm(&tm)) * 1000;
+}
+
+int32_t preadAll(int fd, void* buf, size_t length, int64_t offset) {
+    auto* p = static_cast<uint8_t*>(buf);
+    while (length > 0) {
+        ssize_t n = pread(fd, p, length, offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        if (n == 0) {
+            return -EIO;
+        }
+        p += n;
+        length -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+int32_t pwriteAll(int fd, const void* buf, size_t length, int64_t offset) {
+    auto* p = static_cast<const uint8_t*>(buf);
+    while (length > 0) {
+        ssize_t n = pwrite(fd, p, length, offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        p += n;
+        length -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+// Copies a byte range between files, in the kernel where the filesystem allows.
+int32_t copyRange(int in, int64_t inOffset, int out, int64_t outOffset, int64_t length) {
+    while (length > 0) {
+        loff_t src = inOffset;
+        loff_t dst = outOffset;
+        ssize_t n = copy_file_range(in, &src, out, &dst, static_cast<size_t>(length), 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        inOffset += n;
+        outOffset += n;
+        length -= n;
+    }
+    std::vector<uint8_t> buffer;
+    while (length > 0) {
+        size_t chunk = static_cast<size_t>(std::min<int64_t>(length, kCopyChunk));
+        buffer.resize(chunk);
+        int32_t ret = preadAll(in, buffer.data(), chunk, inOffset);
+        if (ret == 0) {
+            ret = pwriteAll(out, buffer.data(), chunk, outOffset);
+        }
+        if (ret < 0) {
+            return ret;
+        }
+        inOffset += chunk;
+        outOffset += chunk;
+        length -= chunk;
+    }
+    return 0;
+}
+
+lc4j_store_record toRecord(const IndexEntry& e, int32_t flags, int64_t tag = 0) {
+    lc4j_store_record r;
+    std::memset(&r, 0, sizeof(r));
+    r.timestampMs = e.timestampMs;
+    r.offset = e.offset;
+    r.length = e.length;
+    r.flags = flags;
+    r.tag = tag;
+    return r;
+}
+
+int64_t recordPosition(uint32_t slot) {
+    return sizeof(IndexHeader) + static_cast<int64_t>(slot) * sizeof(lc4j_store_record);
+}
+
+int32_t flagDeleted(int idxFd, uint32_t slot) {
+    int32_t flags = LC4J_STORE_DELETED;
+    return pwriteAll(idxFd, &flags, sizeof(flags), recordPosition(slot) + offsetof(lc4j_store_record, flags));
+}
+
+// Flags and tag are adjacent, so tagging is a single 12-byte write.
+static_assert(offsetof(lc4j_store_record, tag) == offsetof(lc4j_store_record, flags) + sizeof(int32_t),
+              "record tag layout");
+
+int32_t writeTag(int idxFd, uint32_t slot, int64_t tag) {
+    int32_t flags = LC4J_STORE_TAGGED;
+    uint8_t buf[sizeof(flags) + sizeof(tag)];
+    std::memcpy(buf, &flags, sizeof(flags));
+    std::memcpy(buf + sizeof(flags), &tag, sizeof(tag));
+    return pwriteAll(idxFd, buf, sizeof(buf), recordPosition(slot) + offsetof(lc4j_store_record, flags));
+}
+
+// ---- Timeline ----
+
+// The sorted, memory-mapped index of all live frames. Callers serialise
+// changes; readers in other threads or in Java follow the protocol described
+// at lc4j_store_index_header.
+class Timeline {
+public:
+    ~Timeline() {
+        if (map_ != MAP_FAILED) {
+            msync(map_, sizeof(TimelineHeader) + size() * sizeof(IndexEntry), MS_SYNC);
+            header_->clean = 1;
+            msync(map_, sizeof(TimelineHeader), MS_SYNC);
+            munmap(map_, reservedBytes_);
+        }
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    // Maps the timeline file; `valid` is false if it has to be rebuilt.
+    int32_t open(const std::string& path, bool& valid) {
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            return -errno;
+        }
+        struct stat st;
+        if (fstat(fd_, &st) != 0) {
+            return -errno;
+        }
+        for (size_t entries = kTimelineReserveEntries; entries >= kTimelineMinReserveEntries; entries /= 2) {
+            size_t bytes = sizeof(TimelineHeader) + entries * sizeof(IndexEntry);
+            map_ = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+            if (map_ != MAP_FAILED) {
+                reservedBytes_ = bytes;
+                capacity_ = entries;
+                break;
+            }
+        }
+        if (map_ == MAP_FAILED) {
+            return -ENOMEM;
+        }
+        header_ = static_cast<TimelineHeader*>(map_);
+        entries_ = reinterpret_cast<IndexEntry*>(header_ + 1);
+
+        const size_t fileSize = static_cast<size_t>(st.st_size);
+        fileEntries_ = fileSize < sizeof(TimelineHeader) ? 0 : (fileSize - sizeof(TimelineHeader)) / sizeof(IndexEntry);
+        valid = fileSize >= sizeof(TimelineHeader)
+                && std::memcmp(header_->magic, kTimelineMagic, sizeof(kTimelineMagic)) == 0
+                && header_->version == kTimelineVersion
+                && header_->entrySize == sizeof(IndexEntry)
+                && header_->clean == 1
+                && header_->count <= fileEntries_;
+        if (!valid) {
+            fileEntries_ = 0;
+            if (ftruncate(fd_, 0) != 0) {
+                return -errno;
+            }
+            int32_t ret = reserve(kTimelineGrowEntries);
+            if (ret < 0) {
+                return ret;
+            }
+            std::memset(header_, 0, sizeof(TimelineHeader));
+            std::memcpy(header_->magic, kTimelineMagic, sizeof(kTimelineMagic));
+            header_->version = kTimelineVersion;
+            header_->entrySize = sizeof(IndexEntry);
+        }
+        // Until closed cleanly the file may lag behind the day indexes
+        header_->clean = 0;
+        if (msync(map_, sizeof(TimelineHeader), MS_SYNC) != 0) {
+            return -errno;
+        }
+        return 0;
+    }
+
+    // The whole reservation; only the header and the first size() entries may be read.
+    void* address() const { return map_; }
+    size_t mappedBytes() const { return reservedBytes_; }
+
+    size_t size() const { return __atomic_load_n(&header_->count, __ATOMIC_ACQUIRE); }
+    IndexEntry& operator[](size_t i) { return entries_[i]; }
+    const IndexEntry& operator[](size_t i) const { return entries_[i]; }
+
+    // First entry with a timestamp >= timestampMs.
+    size_t lowerBound(int64_t timestampMs) const {
+        return std::lower_bound(entries_, entries_ + size(), IndexEntry{timestampMs, 0, 0, 0}, byTimestamp) - entries_;
+    }
+
+    // First entry with a timestamp > timestampMs.
+    size_t upperBound(int64_t timestampMs) const {
+        return std::upper_bound(entries_, entries_ + size(), IndexEntry{timestampMs, 0, 0, 0}, byTimestamp) - entries_;
+    }
+
+    // Makes room for `entries` entries in the file; the mapping never moves.
+    int32_t reserve(size_t entries) {
+        if (entries <= fileEntries_) {
+            return 0;
+        }
+        if (entries > capacity_) {
+            return -ENOSPC;
+        }
+        size_t grown = std::min(capacity_, std::max(entries, fileEntries_ + kTimelineGrowEntries));
+        // Allocate the blocks: a store into a hole on a full disk would be SIGBUS
+        int err = posix_fallocate(fd_, 0, sizeof(TimelineHeader) + grown * sizeof(IndexEntry));
+        if (err != 0) {
+            return -err;
+        }
+        fileEntries_ = grown;
+        return 0;
+    }
+
+    // Inserts an entry whose timestamp is not yet present. Space must have
+    // been reserved.
+    void insert(const IndexEntry& entry) {
+        const size_t count = size();
+        const size_t pos = lowerBound(entry.timestampMs);
+        if (pos == count) {
+            entries_[count] = entry;
+            setCount(count + 1);
+            return;
+        }
+        beginUpdate();
+        std::memmove(entries_ + pos + 1, entries_ + pos, (count - pos) * sizeof(IndexEntry));
+        entries_[pos] = entry;
+        setCount(count + 1);
+        endUpdate();
+    }
+
+    void setCount(size_t count) {
+        __atomic_store_n(&header_->count, static_cast<uint64_t>(count), __ATOMIC_RELEASE);
+    }
+
+    // Brackets in-place changes to existing entries.
+    void beginUpdate() {
+        __atomic_store_n(&header_->sequence, header_->sequence + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+    }
+
+    void endUpdate() {
+        __atomic_store_n(&header_->sequence, header_->sequence + 1, __ATOMIC_RELEASE);
+    }
+
+private:
+    int fd_ = -1;
+    void* map_ = MAP_FAILED;
+    size_t reservedBytes_ = 0;
+    size_t capacity_ = 0;
+    size_t fileEntries_ = 0;
+    TimelineHeader* header_ = nullptr;
+    IndexEntry* entries_ = nullptr;
+};
+
+// ---- Days ----
+
+struct Day {
+    int32_t key = 0;
+    int64_t startMs = 0;
+    uint64_t generation = 0;
+    bool loaded = false;        // files opened and statistics read
+    bool removed = false;
+    int segFd = -1;
+    int idxFd = -1;
+    int64_t segSize = 0;
+    uint32_t nextSlot = 0;
+    int64_t liveBytes = 0;
+    int64_t deadBytes = 0;
+
+    // Exclusive for appends, deletes and the compaction swap; shared for reads.
+    std::shared_mutex lock;
+    // Held for a whole compaction; deletes wait on it so they are not lost.
+    std::mutex compactMutex;
+    // Listed for the next group commit; guarded by FrameStore::syncMutex_.
+    bool dirty = false;
+
+    ~Day() {
+        if (segFd >= 0) {
+            close(segFd);
+        }
+        if (idxFd >= 0) {
+            close(idxFd);
+        }
+    }
+};
+
+class FrameStore {
+public:
+    explicit FrameStore(std::string root) : root_(std::move(root)) {}
+    ~FrameStore();
+
+    int32_t open();
+    int32_t append(int64_t timestampMs, const uint8_t* data, size_t length, const int64_t* tag = nullptr) {
+        return write(timestampMs, data, length, nullptr, tag);
+    }
+    // Replaces the frame `expected` (as returned by find or list) unless it has
+    // been replaced, deleted or moved by compaction since; -ESTALE then. The
+    // new data keeps the frame's tag.
+    int32_t replace(const lc4j_store_record& expected, const uint8_t* data, size_t length) {
+        return write(expected.timestampMs, data, length, &expected, nullptr);
+    }
+    int32_t find(int64_t timestampMs, lc4j_store_record* out);
+    int64_t read(int64_t timestampMs, void* buf, int64_t capacity);
+    int64_t exportFrame(int64_t timestampMs, const std::string& path);
+    int32_t list(int64_t fromMs, int64_t toMs, lc4j_store_record* out, int32_t max);
+    int32_t remove(const int64_t* timestamps, int32_t count);
+    int32_t setTags(const int64_t* timestamps, const int64_t* tags, int32_t count);
+    int32_t listTags(int64_t fromMs, int64_t toMs, lc4j_store_record* out, int32_t max);
+    int64_t compact(double minDeadRatio);
+    void setGroupCommit(int32_t intervalMs, int64_t maxBytes);
+    int32_t sync();
+    void durability(lc4j_store_durability* out);
+
+    void indexMap(int64_t* out2) const {
+        out2[0] = reinterpret_cast<int64_t>(timeline_.address());
+        out2[1] = static_cast<int64_t>(timeline_.mappedBytes());
+    }
+
+private:
+    std::string root_;
+    std::mutex mapMutex_;
+    std::map<int32_t, std::shared_ptr<Day>> days_;
+    // Lock order: mapMutex_, then a day's lock, then timelineLock_.
+    std::shared_mutex timelineLock_;
+    Timeline timeline_;
+
+    // Group commit state. syncMutex_ is taken after any other lock and never
+    // held across I/O; flushMutex_ serialises commits.
+    std::mutex syncMutex_;
+    std::mutex flushMutex_;
+    std::condition_variable syncCv_;
+    std::thread syncer_;
+    bool stopping_ = false;
+    int32_t intervalMs_ = 0;
+    int64_t maxBytes_ = 0;
+    std::vector<std::shared_ptr<Day>> dirtyDays_;
+    bool directoryDirty_ = false;
+    int64_t appended_ = 0;
+    int64_t appendedNewestMs_ = INT64_MIN;
+    int64_t pendingBytes_ = 0;
+    int64_t durable_ = 0;
+    int64_t durableNewestMs_ = INT64_MIN;
+    int64_t syncs_ = 0;
+    int64_t lastSyncMs_ = 0;
+    int64_t lastSyncNs_ = 0;
+    int32_t lastSyncError_ = 0;
+
+    std::string indexPath(int32_t key) const {
+        return root_ + "/" + std::to_string(key) + ".idx";
+    }
+    std::string segmentPath(int32_t key, uint64_t generation) const {
+        return root_ + "/" + std::to_string(key) + "." + std::to_string(generation) + ".seg";
+    }
+
+    // Timeline positions [first, second) of a day's frames; needs timelineLock_.
+    std::pair<size_t, size_t> dayRange(const Day& day) const {
+        return {timeline_.lowerBound(day.startMs), timeline_.lowerBound(day.startMs + kMsPerDay)};
+    }
+
+    int32_t write(int64_t timestampMs, const uint8_t* data, size_t length, const lc4j_store_record* expected,
+                  const int64_t* tag);
+    int32_t loadDay(Day& day, std::vector<IndexEntry>* live);
+    int32_t rebuildTimeline();
+    std::shared_ptr<Day> findDay(int32_t key);
+    int32_t dayForAppend(int32_t key, std::shared_ptr<Day>& out);
+    int32_t compactDay(const std::shared_ptr<Day>& day, int64_t& reclaimed);
+    int64_t removeDay(const std::shared_ptr<Day>& day);
+    void syncDirectory() const;
+    void noteWrite(const std::shared_ptr<Day>& day, size_t bytes, int64_t timestampMs, bool append);
+    void syncLoop();
+};
+
+FrameStore::~FrameStore() {
+    {
+        std::lock_guard<std::mutex> lock(syncMutex_);
+        stopping_ = true;
+    }
+    syncCv_.notify_all();
+    if (syncer_.joinable()) {
+        syncer_.join();
+    }
+    sync();
+}
+
+int32_t FrameStore::open() {
+    if (mkdir(root_.c_str(), 0755) != 0 && errno != EEXIST) {
+        return -errno;
+    }
+    DIR* dir = opendir(root_.c_str());
+    if (dir == nullptr) {
+        return -errno;
+    }
+    std::vector<std::string> names;
+    while (dirent* d = readdir(dir)) {
+        names.emplace_back(d->d_name);
+    }
+    closedir(dir);
+
+    // Only the headers are read here; a day is loaded when first used
+    for (const auto& name : names) {
+        int key = 0;
+        char tail[8] = {0};
+        if (std::sscanf(name.c_str(), "%8d.%7s", &key, tail) != 2 || std::strcmp(tail, "idx") != 0) {
+            continue;
+        }
+        int fd = ::open(indexPath(key).c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        IndexHeader header;
+        if (preadAll(fd, &header, sizeof(header), 0) == 0
+                && std::memcmp(header.magic, kIndexMagic, sizeof(kIndexMagic)) == 0
+                && header.recordSize == sizeof(lc4j_store_record)) {
+            auto day = std::make_shared<Day>();
+            day->key = key;
+            day->startMs = dayKeyStartMs(key);
+            day->generation = header.generation;
+            days_[key] = std::move(day);
+        }
+        close(fd);
+    }
+    // Segments of other generations and unfinished indexes are crash leftovers
+    for (const auto& name : names) {
+        int key = 0;
+        unsigned long long generation = 0;
+        char tail[8] = {0};
+        bool stale = false;
+        if (std::sscanf(name.c_str(), "%8d.%llu.%7s", &key, &generation, tail) == 3 && std::strcmp(tail, "seg") == 0) {
+            auto it = days_.find(key);
+            stale = it == days_.end() || it->second->generation != generation;
+        } else if (name.size() > 8 && name.compare(name.size() - 8, 8, ".idx.tmp") == 0) {
+            stale = true;
+        }
+        if (stale) {
+            unlink((root_ + "/" + name).c_str());
+        }
+    }
+
+    bool valid = false;
+    int32_t ret = timeline_.open(root_ + "/timeline.map", valid);
+    if (ret == 0 && !valid) {
+        ret = rebuildTimeline();
+    }
+    return ret;
+}
+
+// Opens a day's files and reads its statistics, optionally collecting its live frames.
+int32_t FrameStore::loadDay(Day& day, std::vector<IndexEntry>* live) {
+    day.idxFd = ::open(indexPath(day.key).c_str(), O_RDWR | O_CLOEXEC);
+    if (day.idxFd < 0) {
+        return -errno;
+    }
+    day.segFd = ::open(segmentPath(day.key, day.generation).c_str(), O_RDWR | O_CLOEXEC);
+    if (day.segFd < 0) {
+        return -errno;
+    }
+    struct stat st;
+    struct stat segStat;
+    if (fstat(day.idxFd, &st) != 0 || fstat(day.segFd, &segStat) != 0) {
+        return -errno;
+    }
+    day.segSize = segStat.st_size;
+
+    // A partially written trailing record is cut off
+    size_t count = st.st_size < static_cast<off_t>(sizeof(IndexHeader))
+            ? 0 : (st.st_size - sizeof(IndexHeader)) / sizeof(lc4j_store_record);
+    std::vector<lc4j_store_record> records(count);
+    if (count > 0 && preadAll(day.idxFd, records.data(), count * sizeof(lc4j_store_record), sizeof(IndexHeader)) != 0) {
+        return -EIO;
+    }
+    if (static_cast<off_t>(sizeof(IndexHeader) + count * sizeof(lc4j_store_record)) != st.st_size) {
+        if (ftruncate(day.idxFd, sizeof(IndexHeader) + count * sizeof(lc4j_store_record)) != 0) {
+            return -errno;
+        }
+    }
+    day.nextSlot = static_cast<uint32_t>(count);
+    day.liveBytes = 0;
+    day.deadBytes = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const auto& r = records[i];
+        if (r.length <= 0 || r.offset < 0 || r.offset + r.length > day.segSize) {
+            continue;   // frame data never made it to disk
+        }
+        if (r.flags & LC4J_STORE_DELETED) {
+            day.deadBytes += r.length;
+            continue;
+        }
+        day.liveBytes += r.length;
+        if (live != nullptr) {
+            live->push_back({r.timestampMs, r.offset, r.length, static_cast<uint32_t>(i)});
+        }
+    }
+    day.loaded = true;
+    return 0;
+}
+
+int32_t FrameStore::rebuildTimeline() {
+    std::vector<IndexEntry> entries;
+    for (auto& [key, day] : days_) {
+        size_t first = entries.size();
+        if (loadDay(*day, &entries) < 0) {
+            entries.resize(first);
+        }
+    }
+    // A frame replaced just before a crash may still be live twice; the later
+    // record wins.
+    std::stable_sort(entries.begin(), entries.end(), byTimestamp);
+    std::vector<IndexEntry> unique;
+    unique.reserve(entries.size());
+    for (const auto& e : entries) {
+        if (!unique.empty() && unique.back().timestampMs == e.timestampMs) {
+            unique.back() = e;
+        } else {
+            unique.push_back(e);
+        }
+    }
+    int32_t ret = timeline_.reserve(unique.size());
+    if (ret < 0) {
+        return ret;
+    }
+    for (size_t i = 0; i < unique.size(); ++i) {
+        timeline_[i] = unique[i];
+    }
+    timeline_.setCount(unique.size());
+    return 0;
+}
+
+std::shared_ptr<Day> FrameStore::findDay(int32_t key) {
+    std::lock_guard<std::mutex> lock(mapMutex_);
+    auto it = days_.find(key);
+    if (it == days_.end()) {
+        return nullptr;
+    }
+    if (!it->second->loaded && loadDay(*it->second, nullptr) < 0) {
+        return nullptr;
+    }
+    return it->second;
+}
+
+int32_t FrameStore::dayForAppend(int32_t key, std::shared_ptr<Day>& out) {
+    std::lock_guard<std::mutex> lock(mapMutex_);
+    auto it = days_.find(key);
+    if (it != days_.end()) {
+        if (!it->second->loaded) {
+            int32_t ret = loadDay(*it->second, nullptr);
+            if (ret < 0) {
+                return ret;
+            }
+        }
+        out = it->second;
+        return 0;
+    }
+    auto day = std::make_shared<Day>();
+    day->key = key;
+    day->startMs = dayKeyStartMs(key);
+    day->loaded = true;
+    day->segFd = ::open(segmentPath(key, 0).c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (day->segFd < 0) {
+        return -errno;
+    }
+    IndexHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+    header.version = kIndexVersion;
+    header.recordSize = sizeof(lc4j_store_record);
+    day->idxFd = ::open(indexPath(key).c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (day->idxFd < 0 || pwriteAll(day->idxFd, &header, sizeof(header), 0) != 0) {
+        int32_t err = day->idxFd < 0 ? -errno : -EIO;
+        unlink(indexPath(key).c_str());
+        unlink(segmentPath(key, 0).c_str());
+        return err;
+    }
+    days_[key] = day;
+    out = std::move(day);
+    std::lock_guard<std::mutex> syncLock(syncMutex_);
+    directoryDirty_ = true;
+    return 0;
+}
+
+int32_t FrameStore::write(int64_t timestampMs, const uint8_t* data, size_t length,
+                          const lc4j_store_record* expected, const int64_t* tag) {
+    if (length == 0 || length > INT32_MAX || timestampMs < kMinTimestampMs || timestampMs > kMaxTimestampMs) {
+        return -EINVAL;
+    }
+    const int32_t key = dayKey(timestampMs);
+    for (;;) {
+        std::shared_ptr<Day> day;
+        int32_t ret = dayForAppend(key, day);
+        if (ret < 0) {
+            return ret;
+        }
+        std::unique_lock<std::shared_mutex> lock(day->lock);
+        if (day->removed) {
+            if (expected != nullptr) {
+                return -ESTALE;
+            }
+            continue;   // compacted away meanwhile; start a new one
+        }
+        uint32_t expectedSlot = 0;
+        {
+            std::unique_lock<std::shared_mutex> timelineLock(timelineLock_);
+            if (expected != nullptr) {
+                // Every change to this day's frames holds the day lock, so the
+                // frame cannot change between this check and the swap below
+                size_t pos = timeline_.lowerBound(timestampMs);
+                if (pos == timeline_.size() || timeline_[pos].timestampMs != timestampMs
+                    || timeline_[pos].offset != expected->offset || timeline_[pos].length != expected->length) {
+                    return -ESTALE;
+                }
+                expectedSlot = timeline_[pos].slot;
+            }
+            ret = timeline_.reserve(timeline_.size() + 1);
+        }
+        if (ret < 0) {
+            return ret;
+        }
+        int32_t flags = 0;
+        int64_t tagValue = 0;
+        if (tag != nullptr) {
+            flags = LC4J_STORE_TAGGED;
+            tagValue = *tag;
+        } else if (expected != nullptr) {
+            lc4j_store_record previous;
+            ret = preadAll(day->idxFd, &previous, sizeof(previous), recordPosition(expectedSlot));
+            if (ret < 0) {
+                return ret;
+            }
+            flags = previous.flags & LC4J_STORE_TAGGED;
+            tagValue = previous.tag;
+        }
+
+        // Data first, then the record that points at it
+        IndexEntry entry{timestampMs, day->segSize, static_cast<int32_t>(length), day->nextSlot};
+        ret = pwriteAll(day->segFd, data, length, entry.offset);
+        if (ret == 0) {
+            lc4j_store_record record = toRecord(entry, flags, tagValue);
+            ret = pwriteAll(day->idxFd, &record, sizeof(record), recordPosition(entry.slot));
+        }
+        if (ret < 0) {
+            if (ftruncate(day->segFd, day->segSize) != 0) {
+                // The orphaned bytes are unreferenced and go away on compaction
+                day->segSize += length;
+            }
+            return ret;
+        }
+        day->segSize += length;
+        day->nextSlot++;
+        day->liveBytes += length;
+
+        // A frame with the same timestamp is replaced
+        bool replaced = false;
+        IndexEntry previous{};
+        {
+            std::unique_lock<std::shared_mutex> timelineLock(timelineLock_);
+            size_t pos = timeline_.lowerBound(timestampMs);
+            if (pos < timeline_.size() && timeline_[pos].timestampMs == timestampMs) {
+                previous = timeline_[pos];
+                replaced = true;
+                timeline_.beginUpdate();
+                timeline_[pos] = entry;
+                timeline_.endUpdate();
+            } else {
+                ret = timeline_.reserve(timeline_.size() + 1);
+                if (ret == 0) {
+                    timeline_.insert(entry);
+                }
+            }
+        }
+        if (ret < 0) {
+            // Only reachable when the timeline is full; keep the day consistent with it
+            flagDeleted(day->idxFd, entry.slot);
+            day->liveBytes -= length;
+            day->deadBytes += length;
+            return ret;
+        }
+        if (replaced) {
+            flagDeleted(day->idxFd, previous.slot);
+            day->liveBytes -= previous.length;
+            day->deadBytes += previous.length;
+        }
+        noteWrite(day, length, timestampMs, true);
+        return 0;
+    }
+}
+
+int32_t FrameStore::find(int64_t timestampMs, lc4j_store_record* out) {
+    std::shared_lock<std::shared_mutex> lock(timelineLock_);
+    size_t pos = timeline_.lowerBound(timestampMs);
+    if (pos == timeline_.size() || timeline_[pos].timestampMs != timestampMs) {
+        return -ENOENT;
+    }
+    if (out != nullptr) {
+        *out = toRecord(timeline_[pos], 0);
+    }
+    return 0;
+}
+
+int64_t FrameStore::read(int64_t timestampMs, void* buf, int64_t capacity) {
+    if (timestampMs < kMinTimestampMs || timestampMs > kMaxTimestampMs) {
+        return -ENOENT;
+    }
+    auto day = findDay(dayKey(timestampMs));
+    if (!day) {
+        return -ENOENT;
+    }
+    std::shared_lock<std::shared_mutex> lock(day->lock);
+    IndexEntry entry;
+    {
+        std::shared_lock<std::shared_mutex> timelineLock(timelineLock_);
+        size_t pos = timeline_.lowerBound(timestampMs);
+        if (pos == timeline_.size() || timeline_[pos].timestampMs != timestampMs) {
+            return -ENOENT;
+        }
+        entry = timeline_[pos];
+    }
+    // The day lock keeps the entry's offset valid until the read is done
+    if (capacity < entry.length) {
+        return -ENOSPC;
+    }
+    int32_t ret = preadAll(day->segFd, buf, entry.length, entry.offset);
+    return ret < 0 ? ret : entry.length;
+}
+
+// Copies the frame to a temporary file next to `path` and renames it over
+// `path`, so readers of the file never see a partial frame.
+int64_t FrameStore::exportFrame(int64_t timestampMs, const std::string& path) {
+    if (timestampMs < kMinTimestampMs || timestampMs > kMaxTimestampMs) {
+        return -ENOENT;
+    }
+    auto day = findDay(dayKey(timestampMs));
+    if (!day) {
+        return -ENOENT;
+    }
+    // A temporary file of its own, so that concurrent exports to one path
+    // never write into each other's copy before it is renamed
+    static std::atomic<uint64_t> tmpSequence{0};
+    const std::string tmpPath = path + ".tmp-e" + std::to_string(tmpSequence.fetch_add(1));
+    int out = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (out < 0) {
+        return -errno;
+    }
+    int32_t ret = -ENOENT;
+    int64_t length = 0;
+    {
+        // The day lock keeps the entry's offset valid until the copy is done
+        std::shared_lock<std::shared_mutex> lock(day->lock);
+        std::shared_lock<std::shared_mutex> timelineLock(timelineLock_);
+        size_t pos = timeline_.lowerBound(timestampMs);
+        if (pos < timeline_.size() && timeline_[pos].timestampMs == timestampMs) {
+            const IndexEntry entry = timeline_[pos];
+            timelineLock.unlock();
+            length = entry.length;
+            ret = copyRange(day->segFd, entry.offset, out, 0, length);
+        }
+    }
+    if (close(out) != 0 && ret == 0) {
+        ret = -errno;
+    }
+    if (ret == 0 && rename(tmpPath.c_str(), path.c_str()) != 0) {
+        ret = -errno;
+    }
+    if (ret < 0) {
+        unlink(tmpPath.c_str());
+        return ret;
+    }
+    return length;
+}
+
+int32_t FrameStore::list(int64_t fromMs, int64_t toMs, lc4j_store_record* out, int32_t max) {
+    std::shared_lock<std::shared_mutex> lock(timelineLock_);
+    size_t first = timeline_.lowerBound(fromMs);
+    size_t last = std::max(first, timeline_.upperBound(toMs));
+    if (out == nullptr) {
+        return static_cast<int32_t>(std::min<size_t>(last - first, INT32_MAX));
+    }
+    int32_t n = 0;
+    for (size_t i = first; i < last && n < max; ++i) {
+        out[n++] = toRecord(timeline_[i], 0);
+    }
+    return n;
+}
+
+int32_t FrameStore::remove(const int64_t* timestamps, int32_t count) {
+    std::vector<int64_t> sorted(timestamps, timestamps + count);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    sorted.erase(std::remove_if(sorted.begin(), sorted.end(), [](int64_t ts) {
+        return ts < kMinTimestampMs || ts > kMaxTimestampMs;
+    }), sorted.end());
+
+    int32_t removed = 0;
+    for (auto groupBegin = sorted.begin(); groupBegin != sorted.end();) {
+        const int32_t key = dayKey(*groupBegin);
+        auto groupEnd = std::find_if(groupBegin, sorted.end(), [key](int64_t ts) { return dayKey(ts) != key; });
+        auto day = findDay(key);
+        if (!day) {
+            groupBegin = groupEnd;
+            continue;
+        }
+        std::lock_guard<std::mutex> compactLock(day->compactMutex);
+        std::unique_lock<std::shared_mutex> lock(day->lock);
+
+        std::vector<IndexEntry> victims;
+        {
+            std::shared_lock<std::shared_mutex> timelineLock(timelineLock_);
+            for (auto it = groupBegin; it != groupEnd; ++it) {
+                size_t pos = timeline_.lowerBound(*it);
+                if (pos < timeline_.size() && timeline_[pos].timestampMs == *it) {
+                    victims.push_back(timeline_[pos]);
+                }
+            }
+        }
+        // Flag the records first; a frame whose flag could not be written stays
+        size_t flagged = 0;
+        int32_t ret = 0;
+        for (; flagged < victims.size(); ++flagged) {
+            ret = flagDeleted(day->idxFd, victims[flagged].slot);
+            if (ret < 0) {
+                break;
+            }
+            day->liveBytes -= victims[flagged].length;
+            day->deadBytes += victims[flagged].length;
+        }
+        victims.resize(flagged);
+        if (flagged > 0) {
+            noteWrite(day, 0, 0, false);
+        }
+        if (!victims.empty()) {
+            std::unique_lock<std::shared_mutex> timelineLock(timelineLock_);
+            const size_t size = timeline_.size();
+            size_t write = timeline_.lowerBound(victims.front().timestampMs);
+            size_t next = 0;
+            timeline_.beginUpdate();
+            for (size_t read = write; read < size; ++read) {
+                if (next < victims.size() && timeline_[read].timestampMs == victims[next].timestampMs) {
+                    next++;
+                    continue;
+                }
+                timeline_[write++] = timeline_[read];
+            }
+            timeline_.setCount(write);
+            timeline_.endUpdate();
+        }
+        removed += static_cast<int32_t>(victims.size());
+        if (ret < 0) {
+            return removed > 0 ? removed : ret;
+        }
+        groupBegin = groupEnd;
+    }
+    return removed;
+}
+
+int32_t FrameStore::setTags(const int64_t* timestamps, const int64_t* tags, int32_t count) {
+    std::vector<std::pair<int64_t, int64_t>> sorted;
+    sorted.reserve(count);
+    for (int32_t i = 0; i < count; ++i) {
+        if (timestamps[i] >= kMinTimestampMs && timestamps[i] <= kMaxTimestampMs) {
+            sorted.emplace_back(timestamps[i], tags[i]);
+        }
+    }
+    std::sort(sorted.begin(), sorted.end());
+
+    int32_t tagged = 0;
+    for (auto groupBegin = sorted.begin(); groupBegin != sorted.end();) {
+        const int32_t key = dayKey(groupBegin->first);
+        auto groupEnd = std::find_if(groupBegin, sorted.end(), [key](const auto& t) {
+            return dayKey(t.first) != key;
+        });
+        auto day = findDay(key);
+        if (!day) {
+            groupBegin = groupEnd;
+            continue;
+        }
+        std::unique_lock<std::shared_mutex> lock(day->lock);
+        int32_t written = 0;
+        for (auto it = groupBegin; it != groupEnd; ++it) {
+            uint32_t slot;
+            {
+                std::shared_lock<std::shared_mutex> timelineLock(timelineLock_);
+                size_t pos = timeline_.lowerBound(it->first);
+                if (pos == timeline_.size() || timeline_[pos].timestampMs != it->first) {
+                    continue;
+                }
+                slot = timeline_[pos].slot;
+            }
+            int32_t ret = writeTag(day->idxFd, slot, it->second);
+            if (ret < 0) {
+                return tagged > 0 ? tagged : ret;
+            }
+            written++;
+            tagged++;
+        }
+        if (written > 0) {
+            noteWrite(day, 0, 0, false);
+        }
+        groupBegin = groupEnd;
+    }
+    return tagged;
+}
+
+int32_t FrameStore::listTags(int64_t fromMs, int64_t toMs, lc4j_store_record* out, int32_t max) {
+    int32_t n = 0;
+    int64_t next = std::max(fromMs, kMinTimestampMs);
+    toMs = std::min(toMs, kMaxTimestampMs);
+    std::vector<lc4j_store_record> records;
+    while (n < max && next <= toMs) {
+        // One day at a time, under its lock so that compaction cannot move the
+        // records between finding their slots and reading them
+        int64_t first;
+        {
+            std::shared_lock<std::shared_mutex> timelineLock(timelineLock_);
+            size_t pos = timeline_.lowerBound(next);
+            if (pos == timeline_.size() || timeline_[pos].timestampMs > toMs) {
+                break;
+            }
+            first = timeline_[pos].timestampMs;
+        }
+        const int32_t key = dayKey(first);
+        const int64_t dayEnd = std::min(toMs, dayKeyStartMs(key) + kMsPerDay - 1);
+        auto day = findDay(key);
+        if (day) {
+            std::shared_lock<std::shared_mutex> lock(day->lock);
+            std::vector<IndexEntry> entries;
+            {
+                std::shared_lock<std::shared_mutex> timelineLock(timelineLock_);
+                size_t begin = timeline_.lowerBound(first);
+                size_t end = std::min(timeline_.upperBound(dayEnd), begin + static_cast<size_t>(max - n));
+                for (size_t i = begin; i < end; ++i) {
+                    entries.push_back(timeline_[i]);
+                }
+            }
+            if (!entries.empty()) {
+                auto bySlot = [](const IndexEntry& a, const IndexEntry& b) { return a.slot < b.slot; };
+                auto slots = std::minmax_element(entries.begin(), entries.end(), bySlot);
+                const uint32_t lowSlot = slots.first->slot;
+                records.resize(slots.second->slot - lowSlot + 1);
+                int32_t ret = preadAll(day->idxFd, records.data(), records.size() * sizeof(lc4j_store_record),
+                                       recordPosition(lowSlot));
+                if (ret < 0) {
+                    return n > 0 ? n : ret;
+                }
+                for (const auto& e : entries) {
+                    const lc4j_store_record& r = records[e.slot - lowSlot];
+                    out[n++] = toRecord(e, r.flags & LC4J_STORE_TAGGED, (r.flags & LC4J_STORE_TAGGED) ? r.tag : 0);
+                }
+            }
+        }
+        if (dayEnd == kMaxTimestampMs) {
+            break;
+        }
+        next = dayEnd + 1;
+    }
+    return n;
+}
+
+// Lists a day for the next group commit; appends also take the next number.
+// Called with the day's lock held.
+void FrameStore::noteWrite(const std::shared_ptr<Day>& day, size_t bytes, int64_t timestampMs, bool append) {
+    std::lock_guard<std::mutex> lock(syncMutex_);
+    if (!day->dirty) {
+        day->dirty = true;
+        dirtyDays_.push_back(day);
+    }
+    if (append) {
+        appended_++;
+        appendedNewestMs_ = std::max(appendedNewestMs_, timestampMs);
+        pendingBytes_ += static_cast<int64_t>(bytes);
+        if (maxBytes_ > 0 && pendingBytes_ >= maxBytes_) {
+            syncCv_.notify_one();
+        }
+    }
+}
+
+int32_t FrameStore::sync() {
+    std::lock_guard<std::mutex> flushLock(flushMutex_);
+    std::vector<std::shared_ptr<Day>> days;
+    bool directory;
+    int64_t target, targetNewestMs, bytes;
+    {
+        std::lock_guard<std::mutex> lock(syncMutex_);
+        days.swap(dirtyDays_);
+        for (auto& day : days) {
+            day->dirty = false;
+        }
+        directory = directoryDirty_;
+        directoryDirty_ = false;
+        target = appended_;
+        targetNewestMs = appendedNewestMs_;
+        bytes = pendingBytes_;
+        pendingBytes_ = 0;
+    }
+    // Everything numbered up to target was written before it was numbered
+    const auto start = std::chrono::steady_clock::now();
+    int32_t ret = 0;
+    for (const auto& day : days) {
+        std::shared_lock<std::shared_mutex> lock(day->lock);
+        if (day->removed) {
+            continue;
+        }
+        if (fdatasync(day->segFd) != 0 || fdatasync(day->idxFd) != 0) {
+            ret = -errno;
+        }
+    }
+    if (directory) {
+        syncDirectory();
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    std::lock_guard<std::mutex> lock(syncMutex_);
+    if (ret < 0) {
+        // Retried by the next commit
+        for (auto& day : days) {
+            if (!day->dirty) {
+                day->dirty = true;
+                dirtyDays_.push_back(day);
+            }
+        }
+        directoryDirty_ = directoryDirty_ || directory;
+        pendingBytes_ += bytes;
+        lastSyncError_ = ret;
+        return ret;
+    }
+    durable_ = target;
+    durableNewestMs_ = std::max(durableNewestMs_, targetNewestMs);
+    syncs_++;
+    lastSyncMs_ = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    lastSyncNs_ = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    lastSyncError_ = 0;
+    return 0;
+}
+
+void FrameStore::syncLoop() {
+    std::unique_lock<std::mutex> lock(syncMutex_);
+    while (!stopping_) {
+        const int32_t interval = intervalMs_;
+        auto wake = [this, interval] {
+            return stopping_ || intervalMs_ != interval || (maxBytes_ > 0 && pendingBytes_ >= maxBytes_);
+        };
+        if (interval > 0) {
+            syncCv_.wait_for(lock, std::chrono::milliseconds(interval), wake);
+        } else {
+            syncCv_.wait(lock, wake);
+        }
+        if (stopping_ || (dirtyDays_.empty() && !directoryDirty_)) {
+            continue;
+        }
+        lock.unlock();
+        sync();
+        lock.lock();
+    }
+}
+
+void FrameStore::setGroupCommit(int32_t intervalMs, int64_t maxBytes) {
+    {
+        std::lock_guard<std::mutex> lock(syncMutex_);
+        intervalMs_ = std::max(0, intervalMs);
+        maxBytes_ = std::max<int64_t>(0, maxBytes);
+        if (!syncer_.joinable() && (intervalMs_ > 0 || maxBytes_ > 0)) {
+            syncer_ = std::thread(&FrameStore::syncLoop, this);
+        }
+    }
+    syncCv_.notify_all();
+}
+
+void FrameStore::durability(lc4j_store_durability* out) {
+    std::lock_guard<std::mutex> lock(syncMutex_);
+    std::memset(out, 0, sizeof(*out));
+    out->appended = appended_;
+    out->durable = durable_;
+    out->durableTimestampMs = durableNewestMs_;
+    out->pendingBytes = pendingBytes_;
+    out->syncs = syncs_;
+    out->lastSyncMs = lastSyncMs_;
+    out->lastSyncNs = lastSyncNs_;
+    out->lastError = lastSyncError_;
+}
+
+void FrameStore::syncDirectory() const {
+    int fd = ::open(root_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+// Removes a day without live frames; returns the size of its segment.
+int64_t FrameStore::removeDay(const std::shared_ptr<Day>& day) {
+    std::lock_guard<std::mutex> mapLock(mapMutex_);
+    std::unique_lock<std::shared_mutex> lock(day->lock);
+    {
+        std::shared_lock<std::shared_mutex> timelineLock(timelineLock_);
+        auto range = dayRange(*day);
+        if (range.first != range.second) {
+            return 0;   // an append got in first
+        }
+    }
+    const std::string segPath = segmentPath(day->key, day->generation);
+    struct stat st;
+    int64_t size = stat(segPath.c_str(), &st) == 0 ? st.st_size : 0;
+    // The index goes first: without it the segment is a leftover
+    unlink(indexPath(day->key).c_str());
+    unlink(segPath.c_str());
+    syncDirectory();
+    day->removed = true;
+    days_.erase(day->key);
+    return size;
+}
+
+int32_t FrameStore::compactDay(const std::shared_ptr<Day>& day, int64_t& reclaimed) {
+    std::lock_guard<std::mutex> compactLock(day->compactMutex);
+
+    std::vector<IndexEntry> snapshot;
+    uint32_t snapshotSlots;
+    {
+        std::shared_lock<std::shared_mutex> lock(day->lock);
+        if (day->removed) {
+            return 0;
+        }
+        std::shared_lock<std::shared_mutex> timelineLock(timelineLock_);
+        auto range = dayRange(*day);
+        for (size_t i = range.first; i < range.second; ++i) {
+            snapshot.push_back(timeline_[i]);
+        }
+        snapshotSlots = day->nextSlot;
+    }
+    if (snapshot.empty()) {
+        reclaimed += removeDay(day);
+        return 0;
+    }
+    if (!day->loaded) {
+        return 0;
+    }
+
+    // Copy the live frames in timestamp order without blocking readers or
+    // appends; segment data is immutable once written.
+    const uint64_t generation = day->generation + 1;
+    const std::string segPath = segmentPath(day->key, generation);
+    const std::string tmpIndexPath = indexPath(day->key) + ".tmp";
+    int segFd = ::open(segPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (segFd < 0) {
+        return -errno;
+    }
+    std::vector<int64_t> newOffsets(snapshotSlots, -1);
+    int64_t size = 0;
+    int32_t ret = 0;
+    for (const auto& e : snapshot) {
+        ret = copyRange(day->segFd, e.offset, segFd, size, e.length);
+        if (ret < 0) {
+            break;
+        }
+        newOffsets[e.slot] = size;
+        size += e.length;
+    }
+
+    int idxFd = -1;
+    std::unique_lock<std::shared_mutex> lock(day->lock, std::defer_lock);
+    std::vector<IndexEntry> entries;
+    std::vector<lc4j_store_record> oldRecords;
+    if (ret == 0) {
+        lock.lock();
+        {
+            std::shared_lock<std::shared_mutex> timelineLock(timelineLock_);
+            auto range = dayRange(*day);
+            for (size_t i = range.first; i < range.second; ++i) {
+                entries.push_back(timeline_[i]);
+            }
+        }
+        // For the tags, which only the day index has
+        oldRecords.resize(day->nextSlot);
+        ret = preadAll(day->idxFd, oldRecords.data(), oldRecords.size() * sizeof(lc4j_store_record),
+                       sizeof(IndexHeader));
+    }
+    std::vector<lc4j_store_record> records(entries.size());
+    if (ret == 0) {
+        // Frames appended while copying are carried over now
+        for (size_t i = 0; i < entries.size() && ret == 0; ++i) {
+            IndexEntry& e = entries[i];
+            const lc4j_store_record& old = oldRecords[e.slot];
+            records[i].flags = old.flags & LC4J_STORE_TAGGED;
+            records[i].tag = old.tag;
+            if (e.slot < snapshotSlots && newOffsets[e.slot] >= 0) {
+                e.offset = newOffsets[e.slot];
+            } else {
+                ret = copyRange(day->segFd, e.offset, segFd, size, e.length);
+                e.offset = size;
+                size += e.length;
+            }
+            e.slot = static_cast<uint32_t>(i);
+        }
+    }
+    if (ret == 0) {
+        std::vector<uint8_t> index(sizeof(IndexHeader) + entries.size() * sizeof(lc4j_store_record));
+        IndexHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+        header.version = kIndexVersion;
+        header.recordSize = sizeof(lc4j_store_record);
+        header.generation = generation;
+        std::memcpy(index.data(), &header, sizeof(header));
+        for (size_t i = 0; i < entries.size(); ++i) {
+            lc4j_store_record r = toRecord(entries[i], records[i].flags, records[i].tag);
+            std::memcpy(index.data() + sizeof(header) + i * sizeof(r), &r, sizeof(r));
+        }
+        idxFd = ::open(tmpIndexPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (idxFd < 0) {
+            ret = -errno;
+        } else {
+            ret = pwriteAll(idxFd, index.data(), index.size(), 0);
+        }
+        if (ret == 0 && (fsync(segFd) != 0 || fsync(idxFd) != 0)) {
+            ret = -errno;
+        }
+        if (ret == 0 && rename(tmpIndexPath.c_str(), indexPath(day->key).c_str()) != 0) {
+            ret = -errno;
+        }
+    }
+    if (ret < 0) {
+        if (idxFd >= 0) {
+            close(idxFd);
+        }
+        close(segFd);
+        unlink(tmpIndexPath.c_str());
+        unlink(segPath.c_str());
+        return ret;
+    }
+    syncDirectory();
+
+    // Committed: point the timeline at the new segment and drop the old one.
+    // The day lock keeps the day's entries from moving relative to each other.
+    {
+        std::unique_lock<std::shared_mutex> timelineLock(timelineLock_);
+        auto range = dayRange(*day);
+        timeline_.beginUpdate();
+        for (size_t i = 0; i < entries.size() && range.first + i < range.second; ++i) {
+            timeline_[range.first + i].offset = entries[i].offset;
+            timeline_[range.first + i].slot = entries[i].slot;
+        }
+        timeline_.endUpdate();
+    }
+    unlink(segmentPath(day->key, day->generation).c_str());
+    close(day->segFd);
+    close(day->idxFd);
+    day->segFd = segFd;
+    day->idxFd = idxFd;
+    day->generation = generation;
+    reclaimed += day->segSize - size;
+    day->segSize = size;
+    day->nextSlot = static_cast<uint32_t>(entries.size());
+    day->liveBytes = size;
+    day->deadBytes = 0;
+    return 0;
+}
+
+int64_t FrameStore::compact(double minDeadRatio) {
+    // Only loaded days have statistics; deletes load the days they touch.
+    // Days without frames are removed whether loaded or not.
+    std::vector<std::shared_ptr<Day>> candidates;
+    {
+        std::lock_guard<std::mutex> lock(mapMutex_);
+        for (const auto& [key, day] : days_) {
+            std::shared_lock<std::shared_mutex> dayLock(day->lock);
+            bool empty;
+            {
+                std::shared_lock<std::shared_mutex> timelineLock(timelineLock_);
+                auto range = dayRange(*day);
+                empty = range.first == range.second;
+            }
+            int64_t total = day->liveBytes + day->deadBytes;
+            if (empty || (day->loaded && day->deadBytes > 0
+                    && static_cast<double>(day->deadBytes) >= minDeadRatio * static_cast<double>(total))) {
+                candidates.push_back(day);
+            }
+        }
+    }
+    int64_t reclaimed = 0;
+    for (const auto& day : candidates) {
+        int32_t ret = compactDay(day, reclaimed);
+        if (ret < 0 && reclaimed == 0) {
+            return ret;
+        }
+    }
+    return reclaimed;
+}
+
+std::mutex g_storesMutex;
+std::map<int64_t, std::shared_ptr<FrameStore>> g_stores;
+
+std::shared_ptr<FrameStore> findStore(int64_t handle) {
+    std::lock_guard<std::mutex> lock(g_storesMutex);
+    auto it = g_stores.find(handle);
+    return it == g_stores.end() ? nullptr : it->second;
+}
+
+} // namespace
+
+int32_t lc4j::storeAppend(int64_t storeHandle, int64_t timestampMs, const uint8_t* data, size_t length,
+                          const int64_t* tag) {
+    auto store = findStore(storeHandle);
+    if (!store) {
+        return -1;
+    }
+    return store->append(timestampMs, data, length, tag);
+}
+
+int32_t lc4j::storeReplace(int64_t storeHandle, const lc4j_store_record& expected, const uint8_t* data,
+                           size_t length) {
+    auto store = findStore(storeHandle);
+    if (!store) {
+        return -1;
+    }
+    return store->replace(expected, data, length);
+}
+
+// -----------------------------------------------------------------------------
+// FrameStore
+// -----------------------------------------------------------------------------
+
+extern "C" {
+
+int64_t lc4j_store_open(const char* directory) {
+    if (directory == nullptr) {
+        return 0;
+    }
+    try {
+        auto store = std::make_shared<FrameStore>(directory);
+        if (store->open() < 0) {
+            return 0;
+        }
+        int64_t handle = lc4j::allocHandle();
+        std::lock_guard<std::mutex> lock(g_storesMutex);
+        g_stores[handle] = std::move(store);
+        return handle;
+    } catch (const std::exception&) {
+        return 0;
+    }
+}
+
+void lc4j_store_close(int64_t handle) {
+    std::lock_guard<std::mutex> lock(g_storesMutex);
+    g_stores.erase(handle);
+}
+
+int32_t lc4j_store_append(int64_t handle, int64_t timestampMs, const void* data, int64_t length) {
+    auto store = findStore(handle);
+    if (!store) {
+        return -1;
+    }
+    if (data == nullptr || length <= 0) {
+        return -EINVAL;
+    }
+    try {
+        return store->append(timestampMs, static_cast<const uint8_t*>(data), static_cast<size_t>(length));
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+}
+
+int32_t lc4j_store_find(int64_t handle, int64_t timestampMs, lc4j_store_record* out) {
+    auto store = findStore(handle);
+    return store ? store->find(timestampMs, out) : -1;
+}
+
+int64_t lc4j_store_read(int64_t handle, int64_t timestampMs, void* buf, int64_t capacity) {
+    auto store = findStore(handle);
+    if (!store) {
+        return -1;
+    }
+    return store->read(timestampMs, buf, capacity);
+}
+
+int64_t lc4j_store_export(int64_t handle, int64_t timestampMs, const char* path) {
+    auto store = findStore(handle);
+    if (!store) {
+        return -1;
+    }
+    if (path == nullptr) {
+        return -EINVAL;
+    }
+    try {
+        return store->exportFrame(timestampMs, path);
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+}
+
+int32_t lc4j_store_count(int64_t handle, int64_t fromMs, int64_t toMs) {
+    auto store = findStore(handle);
+    return store ? store->list(fromMs, toMs, nullptr, 0) : -1;
+}
+
+int32_t lc4j_store_list(int64_t handle, int64_t fromMs, int64_t toMs, lc4j_store_record* out, int32_t max) {
+    auto store = findStore(handle);
+    if (!store) {
+        return -1;
+    }
+    if (out == nullptr || max < 0) {
+        return -EINVAL;
+    }
+    return store->list(fromMs, toMs, out, max);
+}
+
+int32_t lc4j_store_delete(int64_t handle, const int64_t* timestamps, int32_t count) {
+    auto store = findStore(handle);
+    if (!store) {
+        return -1;
+    }
+    if (timestamps == nullptr || count < 0) {
+        return -EINVAL;
+    }
+    try {
+        return store->remove(timestamps, count);
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+}
+
+int32_t lc4j_store_set_tags(int64_t handle, const int64_t* timestamps, const int64_t* tags, int32_t count) {
+    auto store = findStore(handle);
+    if (!store) {
+        return -1;
+    }
+    if (timestamps == nullptr || tags == nullptr || count < 0) {
+        return -EINVAL;
+    }
+    try {
+        return store->setTags(timestamps, tags, count);
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+}
+
+int32_t lc4j_store_list_tags(int64_t handle, int64_t fromMs, int64_t toMs, lc4j_store_record* out, int32_t max) {
+    auto store = findStore(handle);
+    if (!store) {
+        return -1;
+    }
+    if (out == nullptr || max < 0) {
+        return -EINVAL;
+    }
+    try {
+        return store->listTags(fromMs, toMs, out, max);
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+}
+
+int64_t lc4j_store_compact(int64_t handle, double minDeadRatio) {
+    auto store = findStore(handle);
+    if (!store) {
+        return -1;
+    }
+    try {
+        return store->compact(minDeadRatio);
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+}
+
+int32_t lc4j_store_index_map(int64_t handle, int64_t* out2) {
+    auto store = findStore(handle);
+    if (!store) {
+        return -1;
+    }
+    if (out2 == nullptr) {
+        return -EINVAL;
+    }
+    store->indexMap(out2);
+    return 0;
+}
+
+int32_t lc4j_store_set_group_commit(int64_t handle, int32_t intervalMs, int64_t maxBytes) {
+    auto store = findStore(handle);
+    if (!store) {
+        return -1;
+    }
+    try {
+        store->setGroupCommit(intervalMs, maxBytes);
+        return 0;
+    } catch (const std::system_error& e) {
+        return -e.code().value();
+    }
+}
+
+int32_t lc4j_store_sync(int64_t handle) {
+    auto store = findStore(handle);
+    if (!store) {
+        return -1;
+    }
+    try {
+        return store->sync();
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+}
+
+int32_t lc4j_store_get_durability(int64_t handle, lc4j_store_durability* out) {
+    auto store = findStore(handle);
+    if (!store) {
+        return -1;
+    }
+    if (out == nullptr) {
+        return -EINVAL;
+    }
+    store->durability(out);
+    return 0;
+}
+
+} // extern "C"
@@ -0,0 +1,878 @@
+/*
+ * libcamera4j - asynchronous frame writer.
+ *
+ * Persisting a timelapse frame used to be a blocking createDirectories + write
+ * on whatever thread finished the capture. The writer takes an owned copy of the
+ * encoded bytes and turns the whole save into one linked io_uring chain:
+ *
+ *     mkdirat* (hard-linked) -> openat(direct fd) -> write -> [fsync] -> close
+ *                                                          -> [renameat]
+ *
+ * A single writer thread owns the ring; submitters only append to a queue and
+ * poke an eventfd, so a slow SD card can never hold up the next capture.
+ * Completions are reported through a queue drained by lc4j_writer_poll.
+ *
+ * io_uring is driven through raw syscalls (no liburing dependency). When the
+ * kernel lacks io_uring or one of the opcodes (it may also be disabled by
+ * seccomp or sysctl) the writer falls back to a small pool of threads doing the
+ * same sequence with plain syscalls.
+ */
+
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int32_t kDefaultQueueDepth = 16;
+constexpr int32_t kPoolThreads = 2;
+// Writes held in memory at once, submitted but not completed; beyond either
+// limit submit returns -EAGAIN rather than buffering without bound behind a
+// slow card.
+constexpr int32_t kMaxInFlight = 64;
+constexpr size_t kMaxInFlightBytes = 128u << 20;
+constexpr unsigned kRingEntries = 256;
+// io_uring read/write lengths are 32-bit; larger buffers become several linked writes.
+constexpr size_t kMaxWriteChunk = 1u << 30;
+
+int64_t nowNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// Every proper prefix of path that names a directory, shallowest first.
+std::vector<std::string> parentDirectories(const std::string& path) {
+    std::vector<std::string> dirs;
+    for (size_t i = 1; i < path.size(); ++i) {
+        if (path[i] == '/' && path[i - 1] != '/') {
+            dirs.push_back(path.substr(0, i));
+        }
+    }
+    return dirs;
+}
+
+// Blocking equivalent of one io_uring write chain.
+int32_t writeWhole(const std::string& path, const std::string& target,
+                   const std::vector<std::string>& mkdirs, const uint8_t* data, size_t length,
+                   int32_t flags, int64_t& bytes) {
+    for (const auto& dir : mkdirs) {
+        struct stat st;
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST
+                && !(stat(dir.c_str(), &st) == 0 && S_ISDIR(st.st_mode))) {
+            return -errno;
+        }
+    }
+    int fd = open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -errno;
+    }
+    int32_t status = 0;
+    const uint8_t* p = data;
+    size_t remaining = length;
+    while (remaining > 0) {
+        ssize_t n = ::write(fd, p, remaining);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            status = -errno;
+            break;
+        }
+        p += n;
+        remaining -= static_cast<size_t>(n);
+        bytes += n;
+    }
+    if (status == 0 && (flags & LC4J_WRITE_FSYNC) && fsync(fd) != 0) {
+        status = -errno;
+    }
+    if (close(fd) != 0 && status == 0) {
+        status = -errno;
+    }
+    if (target != path) {
+        if (status == 0 && rename(target.c_str(), path.c_str()) != 0) {
+            status = -errno;
+        }
+        if (status != 0) {
+            unlink(target.c_str());
+        }
+    }
+    return status;
+}
+
+struct WriteJob {
+    std::string path;
+    std::string tmpPath;               // only used with LC4J_WRITE_ATOMIC
+    std::vector<std::string> mkdirs;   // parents not yet known to exist
+    std::vector<uint8_t> data;
+    int64_t cookie = 0;
+    int32_t flags = 0;
+    int64_t submitNs = 0;
+
+    // io_uring bookkeeping
+    int32_t slot = -1;
+    int32_t pendingCqes = 0;
+    int32_t status = 0;
+    int64_t written = 0;
+    bool opened = false;
+    bool closed = false;
+
+    const std::string& target() const {
+        return (flags & LC4J_WRITE_ATOMIC) ? tmpPath : path;
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Common queueing, completion reporting and directory cache
+// -----------------------------------------------------------------------------
+
+class FrameWriter {
+public:
+    virtual ~FrameWriter() = default;
+
+    virtual int32_t backend() const = 0;
+
+    int32_t submit(std::unique_ptr<WriteJob> job) {
+        job->submitNs = nowNs();
+        if (job->flags & LC4J_WRITE_ATOMIC) {
+            job->tmpPath = job->path + ".tmp-" + std::to_string(tmpSequence_.fetch_add(1));
+        }
+        if (job->flags & LC4J_WRITE_MKDIRS) {
+            job->mkdirs = missingDirectories(job->path);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) {
+                return -1;
+            }
+            // One write always fits, however large
+            if (inFlight_ >= kMaxInFlight ||
+                (inFlight_ > 0 && inFlightBytes_ + job->data.size() > kMaxInFlightBytes)) {
+                return -EAGAIN;
+            }
+            inFlightBytes_ += job->data.size();
+            jobs_.push_back(std::move(job));
+            inFlight_++;
+        }
+        wake();
+        return 0;
+    }
+
+    int32_t poll(lc4j_write_completion* out, int32_t max, int32_t timeoutMs) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto ready = [this] { return !done_.empty() || closed_; };
+        if (timeoutMs < 0) {
+            doneCv_.wait(lock, ready);
+        } else if (timeoutMs > 0) {
+            doneCv_.wait_for(lock, std::chrono::milliseconds(timeoutMs), ready);
+        }
+        if (done_.empty()) {
+            return closed_ ? -1 : 0;
+        }
+        int32_t n = 0;
+        while (n < max && !done_.empty()) {
+            out[n++] = done_.front();
+            done_.pop_front();
+        }
+        return n;
+    }
+
+    int32_t pending() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return inFlight_;
+    }
+
+    // Stops accepting work, lets everything already submitted finish and joins
+    // the worker threads. Completions stay pollable until drained.
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) {
+                return;
+            }
+            stopping_ = true;
+        }
+        wake();
+        for (auto& t : threads_) {
+            t.join();
+        }
+        threads_.clear();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        doneCv_.notify_all();
+    }
+
+protected:
+    virtual void wake() = 0;
+
+    void complete(const WriteJob& job, int32_t status, int64_t bytes) {
+        if (status == 0) {
+            rememberDirectories(job.mkdirs);
+        } else if (status == -ENOENT && (job.flags & LC4J_WRITE_MKDIRS)) {
+            // A directory known to exist has been removed since; look again
+            // on the next write there
+            forgetDirectories(job.path);
+        }
+        lc4j_write_completion c{};
+        c.cookie = job.cookie;
+        c.bytes = bytes;
+        c.latencyNs = nowNs() - job.submitNs;
+        c.status = status;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_.push_back(c);
+            inFlight_--;
+            inFlightBytes_ -= job.data.size();
+        }
+        doneCv_.notify_all();
+    }
+
+    void rememberDirectories(const std::vector<std::string>& dirs) {
+        if (dirs.empty()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(dirMutex_);
+        knownDirs_.insert(dirs.begin(), dirs.end());
+    }
+
+    void forgetDirectories(const std::string& path) {
+        std::lock_guard<std::mutex> lock(dirMutex_);
+        for (const auto& dir : parentDirectories(path)) {
+            knownDirs_.erase(dir);
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable jobsCv_;
+    std::deque<std::unique_ptr<WriteJob>> jobs_;
+    bool stopping_ = false;
+    std::vector<std::thread> threads_;
+
+private:
+    // Timelapse frames land in a handful of day directories, so after the first
+    // frame of the day this is a single set lookup and no mkdir at all.
+    std::vector<std::string> missingDirectories(const std::string& path) {
+        std::vector<std::string> dirs = parentDirectories(path);
+        std::lock_guard<std::mutex> lock(dirMutex_);
+        size_t known = dirs.size();
+        while (known > 0 && knownDirs_.count(dirs[known - 1]) == 0) {
+            known--;
+        }
+        dirs.erase(dirs.begin(), dirs.begin() + known);
+        return dirs;
+    }
+
+    std::condition_variable doneCv_;
+    std::deque<lc4j_write_completion> done_;
+    int32_t inFlight_ = 0;
+    size_t inFlightBytes_ = 0;
+    bool closed_ = false;
+    std::atomic<uint64_t> tmpSequence_{0};
+
+    std::mutex dirMutex_;
+    std::set<std::string> knownDirs_;
+};
+
+// -----------------------------------------------------------------------------
+// Thread-pool backend
+// -----------------------------------------------------------------------------
+
+class PoolWriter : public FrameWriter {
+public:
+    explicit PoolWriter(int32_t threads) {
+        for (int32_t i = 0; i < threads; ++i) {
+            threads_.emplace_back([this] { run(); });
+        }
+    }
+
+    ~PoolWriter() override {
+        shutdown();
+    }
+
+    int32_t backend() const override {
+        return LC4J_WRITER_BACKEND_THREAD_POOL;
+    }
+
+protected:
+    void wake() override {
+        jobsCv_.notify_all();
+    }
+
+private:
+    void run() {
+        for (;;) {
+            std::unique_ptr<WriteJob> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                jobsCv_.wait(lock, [this] { return !jobs_.empty() || stopping_; });
+                if (jobs_.empty()) {
+                    return;
+                }
+                job = std::move(jobs_.front());
+                jobs_.pop_front();
+            }
+            int64_t bytes = 0;
+            int32_t status = write(*job, bytes);
+            complete(*job, status, bytes);
+        }
+    }
+
+    static int32_t write(const WriteJob& job, int64_t& bytes) {
+        return writeWhole(job.path, job.target(), job.mkdirs, job.data.data(), job.data.size(),
+                          job.flags, bytes);
+    }
+};
+
+// -----------------------------------------------------------------------------
+// io_uring backend
+// -----------------------------------------------------------------------------
+
+int uringSetup(unsigned entries, io_uring_params* p) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+}
+
+int uringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+int uringRegister(int fd, unsigned opcode, const void* arg, unsigned nrArgs) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs));
+}
+
+enum : uint64_t {
+    OP_WAKE = 0,
+    OP_MKDIR,
+    OP_OPEN,
+    OP_WRITE,
+    OP_FSYNC,
+    OP_CLOSE,
+    OP_RENAME,
+};
+constexpr uint64_t kOpMask = 0x7;
+
+class UringWriter : public FrameWriter {
+public:
+    // Returns nullptr if io_uring (or anything the chain needs) is unavailable.
+    static std::unique_ptr<UringWriter> create(int32_t slots) {
+        std::unique_ptr<UringWriter> w(new UringWriter(slots));
+        if (!w->init()) {
+            return nullptr;
+        }
+        w->threads_.emplace_back([p = w.get()] { p->run(); });
+        return w;
+    }
+
+    ~UringWriter() override {
+        shutdown();
+        if (sqes_ != nullptr) {
+            munmap(sqes_, sqesSize_);
+        }
+        if (cqPtr_ != nullptr && cqPtr_ != sqPtr_) {
+            munmap(cqPtr_, cqSize_);
+        }
+        if (sqPtr_ != nullptr) {
+            munmap(sqPtr_, sqSize_);
+        }
+        if (ringFd_ >= 0) {
+            close(ringFd_);
+        }
+        if (eventFd_ >= 0) {
+            close(eventFd_);
+        }
+    }
+
+    int32_t backend() const override {
+        return LC4J_WRITER_BACKEND_IO_URING;
+    }
+
+protected:
+    void wake() override {
+        uint64_t one = 1;
+        ssize_t ignored = ::write(eventFd_, &one, sizeof(one));
+        (void)ignored;
+    }
+
+private:
+    explicit UringWriter(int32_t slots) : slotCount_(slots) {}
+
+    bool init() {
+        eventFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (eventFd_ < 0) {
+            return false;
+        }
+
+        io_uring_params p{};
+        ringFd_ = uringSetup(kRingEntries, &p);
+        if (ringFd_ < 0) {
+            return false;
+        }
+
+        sqSize_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqSize_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool singleMmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMmap) {
+            sqSize_ = cqSize_ = std::max(sqSize_, cqSize_);
+        }
+        sqPtr_ = mmap(nullptr, sqSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ringFd_, IORING_OFF_SQ_RING);
+        if (sqPtr_ == MAP_FAILED) {
+            sqPtr_ = nullptr;
+            return false;
+        }
+        if (singleMmap) {
+            cqPtr_ = sqPtr_;
+        } else {
+            cqPtr_ = mmap(nullptr, cqSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ringFd_, IORING_OFF_CQ_RING);
+            if (cqPtr_ == MAP_FAILED) {
+                cqPtr_ = nullptr;
+                return false;
+            }
+        }
+        sqesSize_ = p.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ringFd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            return false;
+        }
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        auto* sq = static_cast<uint8_t*>(sqPtr_);
+        sqHead_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+        sqTail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        sqEntries_ = p.sq_entries;
+        auto* cq = static_cast<uint8_t*>(cqPtr_);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        localTail_ = *sqTail_;
+
+        return probeOpcodes() && registerSlots();
+    }
+
+    bool probeOpcodes() {
+        constexpr unsigned nOps = 256;
+        std::vector<uint8_t> buf(sizeof(io_uring_probe) + nOps * sizeof(io_uring_probe_op), 0);
+        auto* probe = reinterpret_cast<io_uring_probe*>(buf.data());
+        if (uringRegister(ringFd_, IORING_REGISTER_PROBE, probe, nOps) < 0) {
+            return false;
+        }
+        for (unsigned op : {IORING_OP_MKDIRAT, IORING_OP_OPENAT, IORING_OP_WRITE, IORING_OP_FSYNC,
+                            IORING_OP_CLOSE, IORING_OP_RENAMEAT, IORING_OP_POLL_ADD}) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Files are opened straight into a sparse registered table ("direct
+    // descriptors"), which is what lets openat/write/close be linked without
+    // the fd ever coming back to user space.
+    bool registerSlots() {
+        std::vector<int> fds(static_cast<size_t>(slotCount_), -1);
+        if (uringRegister(ringFd_, IORING_REGISTER_FILES, fds.data(), static_cast<unsigned>(fds.size())) < 0) {
+            return false;
+        }
+        for (int32_t i = slotCount_ - 1; i >= 0; --i) {
+            freeSlots_.push_back(i);
+        }
+        return true;
+    }
+
+    unsigned sqSpace() const {
+        unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        return sqEntries_ - (localTail_ - head);
+    }
+
+    io_uring_sqe* nextSqe(uint64_t userData, uint8_t flags) {
+        unsigned idx = localTail_ & sqMask_;
+        io_uring_sqe* sqe = &sqes_[idx];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->user_data = userData;
+        sqe->flags = flags;
+        sqArray_[idx] = idx;
+        localTail_++;
+        toSubmit_++;
+        return sqe;
+    }
+
+    static unsigned sqesFor(const WriteJob& job) {
+        size_t chunks = std::max<size_t>(1, (job.data.size() + kMaxWriteChunk - 1) / kMaxWriteChunk);
+        return static_cast<unsigned>(job.mkdirs.size() + chunks + 2
+                                     + ((job.flags & LC4J_WRITE_FSYNC) ? 1 : 0)
+                                     + ((job.flags & LC4J_WRITE_ATOMIC) ? 1 : 0));
+    }
+
+    void armWake() {
+        io_uring_sqe* sqe = nextSqe(OP_WAKE, 0);
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = eventFd_;
+        sqe->poll32_events = POLLIN;
+    }
+
+    void prepare(WriteJob* job) {
+        uint64_t tag = reinterpret_cast<uint64_t>(job);
+        job->slot = freeSlots_.back();
+        freeSlots_.pop_back();
+
+        // Hard links keep the chain going when a directory already exists.
+        for (const auto& dir : job->mkdirs) {
+            io_uring_sqe* sqe = nextSqe(tag | OP_MKDIR, IOSQE_IO_HARDLINK);
+            sqe->opcode = IORING_OP_MKDIRAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = reinterpret_cast<uint64_t>(dir.c_str());
+            sqe->len = 0755;
+            job->pendingCqes++;
+        }
+
+        io_uring_sqe* o = nextSqe(tag | OP_OPEN, IOSQE_IO_LINK);
+        o->opcode = IORING_OP_OPENAT;
+        o->fd = AT_FDCWD;
+        o->addr = reinterpret_cast<uint64_t>(job->target().c_str());
+        o->len = 0644;
+        o->open_flags = O_WRONLY | O_CREAT | O_TRUNC;   // O_CLOEXEC is invalid for direct descriptors
+        o->file_index = static_cast<uint32_t>(job->slot + 1);
+        job->pendingCqes++;
+
+        size_t offset = 0;
+        do {
+            size_t len = std::min(kMaxWriteChunk, job->data.size() - offset);
+            io_uring_sqe* w = nextSqe(tag | OP_WRITE, IOSQE_FIXED_FILE | IOSQE_IO_LINK);
+            w->opcode = IORING_OP_WRITE;
+            w->fd = job->slot;
+            w->addr = reinterpret_cast<uint64_t>(job->data.data() + offset);
+            w->len = static_cast<uint32_t>(len);
+            w->off = offset;
+            job->pendingCqes++;
+            offset += len;
+        } while (offset < job->data.size());
+
+        if (job->flags & LC4J_WRITE_FSYNC) {
+            io_uring_sqe* s = nextSqe(tag | OP_FSYNC, IOSQE_FIXED_FILE | IOSQE_IO_LINK);
+            s->opcode = IORING_OP_FSYNC;
+            s->fd = job->slot;
+            job->pendingCqes++;
+        }
+
+        bool atomic = (job->flags & LC4J_WRITE_ATOMIC) != 0;
+        io_uring_sqe* c = nextSqe(tag | OP_CLOSE, atomic ? IOSQE_IO_LINK : 0);
+        c->opcode = IORING_OP_CLOSE;
+        c->file_index = static_cast<uint32_t>(job->slot + 1);
+        job->pendingCqes++;
+
+        if (atomic) {
+            io_uring_sqe* r = nextSqe(tag | OP_RENAME, 0);
+            r->opcode = IORING_OP_RENAMEAT;
+            r->fd = AT_FDCWD;
+            r->addr = reinterpret_cast<uint64_t>(job->tmpPath.c_str());
+            r->len = static_cast<uint32_t>(AT_FDCWD);
+            r->addr2 = reinterpret_cast<uint64_t>(job->path.c_str());
+            job->pendingCqes++;
+        }
+    }
+
+    void handle(WriteJob* job, uint64_t op, int32_t res) {
+        auto fail = [job](int32_t err) {
+            if (job->status == 0 && err != -ECANCELED) {
+                job->status = err;
+            }
+        };
+        switch (op) {
+            case OP_MKDIR:
+                // Failures surface through the openat that follows.
+                break;
+            case OP_OPEN:
+                if (res < 0) {
+                    fail(res);
+                } else {
+                    job->opened = true;
+                }
+                break;
+            case OP_WRITE:
+                if (res < 0) {
+                    fail(res);
+                } else {
+                    job->written += res;
+                }
+                break;
+            case OP_CLOSE:
+                if (res == 0) {
+                    job->closed = true;
+                } else {
+                    fail(res);
+                }
+                break;
+            default:
+                if (res < 0) {
+                    fail(res);
+                }
+                break;
+        }
+    }
+
+    void finish(WriteJob* job) {
+        if (job->status == 0 && job->written != static_cast<int64_t>(job->data.size())) {
+            job->status = -EIO;   // a short write breaks the link chain
+        }
+        if (job->opened && !job->closed) {
+            // The linked close was cancelled; drop the direct descriptor here.
+            int fd = -1;
+            io_uring_files_update update{};
+            update.offset = static_cast<uint32_t>(job->slot);
+            update.fds = reinterpret_cast<uint64_t>(&fd);
+            uringRegister(ringFd_, IORING_REGISTER_FILES_UPDATE, &update, 1);
+        }
+        if (job->status != 0 && job->opened && (job->flags & LC4J_WRITE_ATOMIC)) {
+            unlink(job->tmpPath.c_str());
+        }
+        freeSlots_.push_back(job->slot);
+        complete(*job, job->status, job->written);
+        active_.erase(job);
+    }
+
+    void reap() {
+        unsigned head = *cqHead_;
+        unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            const io_uring_cqe& cqe = cqes_[head & cqMask_];
+            uint64_t op = cqe.user_data & kOpMask;
+            if (op == OP_WAKE) {
+                uint64_t count;
+                ssize_t ignored = read(eventFd_, &count, sizeof(count));
+                (void)ignored;
+                wakeArmed_ = false;
+            } else {
+                auto* job = reinterpret_cast<WriteJob*>(cqe.user_data & ~kOpMask);
+                handle(job, op, cqe.res);
+                if (--job->pendingCqes == 0) {
+                    finish(job);
+                }
+            }
+            head++;
+        }
+        __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+    }
+
+    void run() {
+        for (;;) {
+            bool exit = false;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!wakeArmed_) {
+                    armWake();
+                    wakeArmed_ = true;
+                }
+                while (!jobs_.empty() && !freeSlots_.empty() && sqSpace() >= sqesFor(*jobs_.front())) {
+                    WriteJob* job = jobs_.front().get();
+                    active_[job] = std::move(jobs_.front());
+                    jobs_.pop_front();
+                    prepare(job);
+                }
+                exit = stopping_ && jobs_.empty() && active_.empty();
+            }
+            if (exit) {
+                break;
+            }
+            __atomic_store_n(sqTail_, localTail_, __ATOMIC_RELEASE);
+            int ret = uringEnter(ringFd_, toSubmit_, 1, IORING_ENTER_GETEVENTS);
+            if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                failAll(-errno);
+                break;
+            }
+            if (ret > 0) {
+                toSubmit_ -= std::min<unsigned>(toSubmit_, static_cast<unsigned>(ret));
+            }
+            reap();
+        }
+    }
+
+    // The ring itself is broken; report every outstanding write as failed.
+    void failAll(int32_t err) {
+        std::deque<std::unique_ptr<WriteJob>> queued;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queued.swap(jobs_);
+            stopping_ = true;
+        }
+        for (auto& job : queued) {
+            complete(*job, err, 0);
+        }
+        for (auto& entry : active_) {
+            complete(*entry.first, err, entry.first->written);
+        }
+        active_.clear();
+    }
+
+    const int32_t slotCount_;
+    int ringFd_ = -1;
+    int eventFd_ = -1;
+    void* sqPtr_ = nullptr;
+    void* cqPtr_ = nullptr;
+    size_t sqSize_ = 0;
+    size_t cqSize_ = 0;
+    size_t sqesSize_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    unsigned* sqHead_ = nullptr;
+    unsigned* sqTail_ = nullptr;
+    unsigned* sqArray_ = nullptr;
+    unsigned sqMask_ = 0;
+    unsigned sqEntries_ = 0;
+    unsigned localTail_ = 0;
+    unsigned toSubmit_ = 0;
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    unsigned cqMask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+    bool wakeArmed_ = false;
+
+    // Owned by the writer thread.
+    std::vector<int32_t> freeSlots_;
+    std::map<WriteJob*, std::unique_ptr<WriteJob>> active_;
+};
+
+std::mutex g_writersMutex;
+std::map<int64_t, std::shared_ptr<FrameWriter>> g_writers;
+
+std::shared_ptr<FrameWriter> findWriter(int64_t handle) {
+    std::lock_guard<std::mutex> lock(g_writersMutex);
+    auto it = g_writers.find(handle);
+    return it == g_writers.end() ? nullptr : it->second;
+}
+
+} // namespace
+
+int32_t lc4j::writerSubmitOwned(int64_t writerHandle, const std::string& path,
+                                std::vector<uint8_t>&& data, int64_t cookie, int32_t flags) {
+    auto writer = findWriter(writerHandle);
+    if (!writer || path.empty()) {
+        return -1;
+    }
+    auto job = std::make_unique<WriteJob>();
+    job->path = path;
+    job->data = std::move(data);
+    job->cookie = cookie;
+    job->flags = flags;
+    return writer->submit(std::move(job));
+}
+
+int32_t lc4j::writeFileSync(const std::string& path, const uint8_t* data, size_t length, int32_t flags) {
+    static std::atomic<uint64_t> tmpSequence{0};
+    std::string target = path;
+    if (flags & LC4J_WRITE_ATOMIC) {
+        target = path + ".tmp-s" + std::to_string(tmpSequence.fetch_add(1));
+    }
+    std::vector<std::string> mkdirs;
+    if (flags & LC4J_WRITE_MKDIRS) {
+        mkdirs = parentDirectories(path);
+    }
+    int64_t bytes = 0;
+    return writeWhole(path, target, mkdirs, data, length, flags, bytes);
+}
+
+// -----------------------------------------------------------------------------
+// FrameWriter C ABI
+// -----------------------------------------------------------------------------
+
+extern "C" {
+
+int64_t lc4j_writer_create(int32_t queueDepth, int32_t flags) {
+    try {
+        int32_t depth = queueDepth > 0 ? queueDepth : kDefaultQueueDepth;
+        std::shared_ptr<FrameWriter> writer;
+        if (!(flags & LC4J_WRITER_FORCE_THREAD_POOL)) {
+            writer = UringWriter::create(depth);
+        }
+        if (!writer) {
+            writer = std::make_shared<PoolWriter>(std::min(depth, kPoolThreads));
+        }
+        int64_t handle = lc4j::allocHandle();
+        std::lock_guard<std::mutex> lock(g_writersMutex);
+        g_writers[handle] = writer;
+        return handle;
+    } catch (const std::exception&) {
+        return 0;
+    }
+}
+
+void lc4j_writer_destroy(int64_t handle) {
+    std::shared_ptr<FrameWriter> writer;
+    {
+        std::lock_guard<std::mutex> lock(g_writersMutex);
+        auto it = g_writers.find(handle);
+        if (it == g_writers.end()) {
+            return;
+        }
+        writer = it->second;
+        g_writers.erase(it);
+    }
+    // Drains outstanding writes; a concurrent poll keeps its own reference and
+    // returns -1 once the last completion has been handed out.
+    writer->shutdown();
+}
+
+int32_t lc4j_writer_backend(int64_t handle) {
+    auto writer = findWriter(handle);
+    return writer ? writer->backend() : -1;
+}
+
+int32_t lc4j_writer_submit(int64_t handle, const char* path, const void* data, int64_t length,
+                           int64_t cookie, int32_t flags) {
+    if (path == nullptr || length < 0 || (data == nullptr && length > 0)) {
+        return -1;
+    }
+    try {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        std::vector<uint8_t> copy(bytes, bytes + length);
+        return lc4j::writerSubmitOwned(handle, path, std::move(copy), cookie, flags);
+    } catch (const std::exception&) {
+        return -1;
+    }
+}
+
+int32_t lc4j_writer_poll(int64_t handle, lc4j_write_completion* out, int32_t max, int32_t timeoutMs) {
+    if (out == nullptr || max <= 0) {
+        return -1;
+    }
+    auto writer = findWriter(handle);
+    if (!writer) {
+        return -1;
+    }
+    return writer->poll(out, max, timeoutMs);
+}
+
+int32_t lc4j_writer_pending(int64_t handle) {
+    auto writer = findWriter(handle);
+    return writer ? writer->pending() : -1;
+}
+
+} // extern "C"
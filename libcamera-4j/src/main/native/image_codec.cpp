@@ -0,0 +1,1181 @@
+/*
+ * libcamera4j - native still image encoders.
+ *
+ * JPEG encoding goes straight from the mapped YUV planes into libjpeg(-turbo)
+ * via its raw-data interface, so 4:2:0 frames are neither colour converted nor
+ * re-subsampled on the way; packed RGB formats use libjpeg-turbo's extended
+ * input colour spaces. Thumbnails are made by area-averaging the planes in
+ * their native layout before encoding, and stored JPEGs can be re-encoded
+ * smaller, decoded at a reduced DCT scale straight to YCbCr. DNG output is a
+ * port of DngWriter.java with the same tag layout. Nothing in here depends on
+ * libcamera.
+ */
+
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <jpeglib.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+
+using lc4j::fourcc;
+using lc4j::FrameView;
+
+constexpr uint32_t FMT_YUV420 = fourcc('Y', 'U', '1', '2');
+constexpr uint32_t FMT_YVU420 = fourcc('Y', 'V', '1', '2');
+constexpr uint32_t FMT_NV12 = fourcc('N', 'V', '1', '2');
+constexpr uint32_t FMT_NV21 = fourcc('N', 'V', '2', '1');
+constexpr uint32_t FMT_YUYV = fourcc('Y', 'U', 'Y', 'V');
+// DRM formats name the little-endian word, so RGB888 is stored B,G,R in memory.
+constexpr uint32_t FMT_RGB888 = fourcc('R', 'G', '2', '4');
+constexpr uint32_t FMT_BGR888 = fourcc('B', 'G', '2', '4');
+constexpr uint32_t FMT_XRGB8888 = fourcc('X', 'R', '2', '4');
+constexpr uint32_t FMT_XBGR8888 = fourcc('X', 'B', '2', '4');
+// V4L2 names, as also accepted by PixelFormatConverter
+constexpr uint32_t FMT_V4L2_RGB24 = fourcc('R', 'G', 'B', '3');
+constexpr uint32_t FMT_V4L2_BGR24 = fourcc('B', 'G', 'R', '3');
+
+constexpr int32_t TRANSFORM_HFLIP = 1;
+constexpr int32_t TRANSFORM_VFLIP = 2;
+constexpr int32_t TRANSFORM_TRANSPOSE = 4;
+
+size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// An owned, tightly packed plane. Rows are padded to `stride`, which callers
+// choose as a multiple of the JPEG block size.
+struct Plane {
+    std::vector<uint8_t> data;
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t stride = 0;
+
+    void allocate(int32_t w, int32_t h, int32_t s) {
+        width = w;
+        height = h;
+        stride = s;
+        data.resize(static_cast<size_t>(s) * h);
+    }
+    uint8_t* row(int32_t y) {
+        return data.data() + static_cast<size_t>(y) * stride;
+    }
+};
+
+// Applies a Transform to a plane of elem-byte samples. Same orientation as
+// CameraCapture.applyTransform: flips first, then a 90 degree clockwise turn
+// when transposing. dst must hold the (possibly swapped) output dimensions.
+void transformPlane(const uint8_t* src, int32_t srcStride, int32_t w, int32_t h, int32_t elem,
+                    uint8_t* dst, int32_t dstStride, int32_t transform) {
+    bool hflip = (transform & TRANSFORM_HFLIP) != 0;
+    bool vflip = (transform & TRANSFORM_VFLIP) != 0;
+
+    if (!(transform & TRANSFORM_TRANSPOSE)) {
+        for (int32_t dy = 0; dy < h; ++dy) {
+            const uint8_t* s = src + static_cast<size_t>(vflip ? h - 1 - dy : dy) * srcStride;
+            uint8_t* d = dst + static_cast<size_t>(dy) * dstStride;
+            if (!hflip) {
+                std::memcpy(d, s, static_cast<size_t>(w) * elem);
+            } else {
+                for (int32_t dx = 0; dx < w; ++dx) {
+                    std::memcpy(d + dx * elem, s + (w - 1 - dx) * elem, elem);
+                }
+            }
+        }
+        return;
+    }
+
+    // Output is h wide and w high. Walk in tiles so both sides stay in cache.
+    constexpr int32_t tile = 32;
+    int32_t outW = h;
+    int32_t outH = w;
+    for (int32_t ty = 0; ty < outH; ty += tile) {
+        for (int32_t tx = 0; tx < outW; tx += tile) {
+            int32_t yEnd = std::min(ty + tile, outH);
+            int32_t xEnd = std::min(tx + tile, outW);
+            for (int32_t dy = ty; dy < yEnd; ++dy) {
+                int32_t sx = hflip ? w - 1 - dy : dy;
+                uint8_t* d = dst + static_cast<size_t>(dy) * dstStride;
+                for (int32_t dx = tx; dx < xEnd; ++dx) {
+                    int32_t sy = vflip ? dx : h - 1 - dx;
+                    std::memcpy(d + dx * elem, src + static_cast<size_t>(sy) * srcStride + sx * elem, elem);
+                }
+            }
+        }
+    }
+}
+
+// Replicates the last sample of each row into the stride padding, so the
+// partial blocks at the right edge do not pick up garbage.
+void padRows(Plane& plane) {
+    for (int32_t y = 0; y < plane.height; ++y) {
+        uint8_t* r = plane.row(y);
+        std::memset(r + plane.width, r[plane.width - 1], plane.stride - plane.width);
+    }
+}
+
+// ---- libjpeg plumbing ----
+
+struct JpegError {
+    jpeg_error_mgr pub;
+    jmp_buf jump;
+};
+
+void jpegErrorExit(j_common_ptr cinfo) {
+    longjmp(reinterpret_cast<JpegError*>(cinfo->err)->jump, 1);
+}
+
+void jpegOutputMessage(j_common_ptr) {
+    // libjpeg warnings are not interesting here
+}
+
+// Destination manager that encodes straight into a std::vector.
+struct VectorDestination {
+    jpeg_destination_mgr pub;
+    std::vector<uint8_t>* out;
+};
+
+void destInit(j_compress_ptr cinfo) {
+    auto* dest = reinterpret_cast<VectorDestination*>(cinfo->dest);
+    dest->pub.next_output_byte = dest->out->data();
+    dest->pub.free_in_buffer = dest->out->size();
+}
+
+boolean destEmpty(j_compress_ptr cinfo) {
+    auto* dest = reinterpret_cast<VectorDestination*>(cinfo->dest);
+    size_t used = dest->out->size();
+    dest->out->resize(used * 2);
+    dest->pub.next_output_byte = dest->out->data() + used;
+    dest->pub.free_in_buffer = dest->out->size() - used;
+    return TRUE;
+}
+
+void destTerm(j_compress_ptr cinfo) {
+    auto* dest = reinterpret_cast<VectorDestination*>(cinfo->dest);
+    dest->out->resize(dest->out->size() - dest->pub.free_in_buffer);
+}
+
+struct YuvPlanes {
+    const uint8_t* data[3];
+    int32_t strides[3];
+    int32_t width;
+    int32_t height;
+};
+
+struct PackedImage {
+    const uint8_t* data;
+    int32_t stride;
+    int32_t width;
+    int32_t height;
+    int32_t components;
+    J_COLOR_SPACE colorSpace;
+    const char* comment = nullptr;   // written as a COM marker if set
+};
+
+// Everything that can longjmp lives in these two functions, which hold no
+// objects with destructors.
+int32_t compressYuv(const YuvPlanes& in, int32_t quality, std::vector<uint8_t>& out) {
+    jpeg_compress_struct cinfo;
+    JpegError jerr;
+    VectorDestination dest;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpegErrorExit;
+    jerr.pub.output_message = jpegOutputMessage;
+    if (setjmp(jerr.jump)) {
+        jpeg_destroy_compress(&cinfo);
+        return -EIO;
+    }
+    jpeg_create_compress(&cinfo);
+    dest.pub.init_destination = destInit;
+    dest.pub.empty_output_buffer = destEmpty;
+    dest.pub.term_destination = destTerm;
+    dest.out = &out;
+    cinfo.dest = &dest.pub;
+
+    cinfo.image_width = static_cast<JDIMENSION>(in.width);
+    cinfo.image_height = static_cast<JDIMENSION>(in.height);
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_YCbCr;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_colorspace(&cinfo, JCS_YCbCr);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    cinfo.raw_data_in = TRUE;
+    cinfo.comp_info[0].h_samp_factor = 2;
+    cinfo.comp_info[0].v_samp_factor = 2;
+    cinfo.comp_info[1].h_samp_factor = 1;
+    cinfo.comp_info[1].v_samp_factor = 1;
+    cinfo.comp_info[2].h_samp_factor = 1;
+    cinfo.comp_info[2].v_samp_factor = 1;
+    jpeg_start_compress(&cinfo, TRUE);
+
+    int32_t chromaHeight = (in.height + 1) / 2;
+    JSAMPROW yRows[16];
+    JSAMPROW uRows[8];
+    JSAMPROW vRows[8];
+    JSAMPARRAY planes[3] = {yRows, uRows, vRows};
+    for (int32_t row = 0; row < in.height; row += 16) {
+        // Rows past the bottom edge repeat the last one
+        for (int32_t i = 0; i < 16; ++i) {
+            int32_t y = std::min(row + i, in.height - 1);
+            yRows[i] = const_cast<JSAMPROW>(in.data[0] + static_cast<size_t>(y) * in.strides[0]);
+        }
+        for (int32_t i = 0; i < 8; ++i) {
+            int32_t y = std::min(row / 2 + i, chromaHeight - 1);
+            uRows[i] = const_cast<JSAMPROW>(in.data[1] + static_cast<size_t>(y) * in.strides[1]);
+            vRows[i] = const_cast<JSAMPROW>(in.data[2] + static_cast<size_t>(y) * in.strides[2]);
+        }
+        jpeg_write_raw_data(&cinfo, planes, 16);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    return 0;
+}
+
+int32_t compressPacked(const PackedImage& in, int32_t quality, std::vector<uint8_t>& out) {
+    jpeg_compress_struct cinfo;
+    JpegError jerr;
+    VectorDestination dest;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpegErrorExit;
+    jerr.pub.output_message = jpegOutputMessage;
+    if (setjmp(jerr.jump)) {
+        jpeg_destroy_compress(&cinfo);
+        return -EIO;
+    }
+    jpeg_create_compress(&cinfo);
+    dest.pub.init_destination = destInit;
+    dest.pub.empty_output_buffer = destEmpty;
+    dest.pub.term_destination = destTerm;
+    dest.out = &out;
+    cinfo.dest = &dest.pub;
+
+    cinfo.image_width = static_cast<JDIMENSION>(in.width);
+    cinfo.image_height = static_cast<JDIMENSION>(in.height);
+    cinfo.input_components = in.components;
+    cinfo.in_color_space = in.colorSpace;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    if (in.comment != nullptr) {
+        jpeg_write_marker(&cinfo, JPEG_COM, reinterpret_cast<const JOCTET*>(in.comment),
+                          static_cast<unsigned int>(std::strlen(in.comment)));
+    }
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW row = const_cast<JSAMPROW>(in.data + static_cast<size_t>(cinfo.next_scanline) * in.stride);
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    return 0;
+}
+
+// Marks JPEGs written by recompressJpeg.
+constexpr char kRecompressedMarker[] = "lc4j-recompressed";
+
+// Source manager reading from memory (jpeg_mem_src needs a non-const buffer
+// on older libjpeg versions).
+void srcInit(j_decompress_ptr) {
+}
+
+boolean srcFill(j_decompress_ptr cinfo) {
+    // Premature end of data: feed an EOI so that libjpeg finishes with a warning
+    static const JOCTET eoi[2] = {0xFF, JPEG_EOI};
+    cinfo->src->next_input_byte = eoi;
+    cinfo->src->bytes_in_buffer = sizeof(eoi);
+    return TRUE;
+}
+
+void srcSkip(j_decompress_ptr cinfo, long count) {
+    if (count > 0) {
+        size_t skip = std::min(static_cast<size_t>(count), cinfo->src->bytes_in_buffer);
+        cinfo->src->next_input_byte += skip;
+        cinfo->src->bytes_in_buffer -= skip;
+    }
+}
+
+void srcTerm(j_decompress_ptr) {
+}
+
+// Decodes a JPEG at the smallest scale n/8 that keeps it at least maxWidth
+// wide into interleaved YCbCr (or, if grayscale or the image is, luma only)
+// rows of components bytes per pixel, without converting to RGB and back.
+// `marked` tells whether recompressJpeg wrote it.
+int32_t decompressScaled(const uint8_t* data, size_t length, int32_t maxWidth, bool grayscale,
+                         std::vector<uint8_t>& pixels, int32_t& width, int32_t& height, int32_t& components,
+                         bool& marked) {
+    jpeg_decompress_struct cinfo;
+    JpegError jerr;
+    jpeg_source_mgr src;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpegErrorExit;
+    jerr.pub.output_message = jpegOutputMessage;
+    if (setjmp(jerr.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        return -EIO;
+    }
+    jpeg_create_decompress(&cinfo);
+    src.init_source = srcInit;
+    src.fill_input_buffer = srcFill;
+    src.skip_input_data = srcSkip;
+    src.resync_to_restart = jpeg_resync_to_restart;
+    src.term_source = srcTerm;
+    src.next_input_byte = data;
+    src.bytes_in_buffer = length;
+    cinfo.src = &src;
+    jpeg_save_markers(&cinfo, JPEG_COM, sizeof(kRecompressedMarker));
+    jpeg_read_header(&cinfo, TRUE);
+
+    marked = false;
+    for (jpeg_saved_marker_ptr m = cinfo.marker_list; m != nullptr; m = m->next) {
+        if (m->data_length == sizeof(kRecompressedMarker) - 1
+            && std::memcmp(m->data, kRecompressedMarker, m->data_length) == 0) {
+            marked = true;
+        }
+    }
+    if (grayscale || cinfo.num_components == 1) {
+        cinfo.out_color_space = JCS_GRAYSCALE;
+    } else if (cinfo.jpeg_color_space == JCS_YCbCr) {
+        cinfo.out_color_space = JCS_YCbCr;
+    } else {
+        jpeg_destroy_decompress(&cinfo);
+        return -ENOTSUP;
+    }
+    // The IDCT does the downscaling; the encoder subsamples chroma again anyway
+    int32_t scaleNum = 8;
+    if (maxWidth > 0 && static_cast<int64_t>(maxWidth) < cinfo.image_width) {
+        scaleNum = static_cast<int32_t>((static_cast<int64_t>(maxWidth) * 8 + cinfo.image_width - 1)
+                                        / cinfo.image_width);
+        scaleNum = std::max(1, std::min(8, scaleNum));
+    }
+    cinfo.scale_num = static_cast<unsigned int>(scaleNum);
+    cinfo.scale_denom = 8;
+    cinfo.do_fancy_upsampling = FALSE;
+    jpeg_start_decompress(&cinfo);
+
+    width = static_cast<int32_t>(cinfo.output_width);
+    height = static_cast<int32_t>(cinfo.output_height);
+    components = cinfo.output_components;
+    const size_t stride = static_cast<size_t>(width) * components;
+    if (pixels.max_size() / stride < static_cast<size_t>(height)) {
+        jpeg_destroy_decompress(&cinfo);
+        return -ENOMEM;
+    }
+    try {
+        pixels.resize(stride * height);
+    } catch (const std::bad_alloc&) {
+        jpeg_destroy_decompress(&cinfo);
+        return -ENOMEM;
+    }
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = pixels.data() + stride * cinfo.output_scanline;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return 0;
+}
+
+// ---- JPEG front ends ----
+
+// Splits semi-planar or packed YUV into untransformed I420 planes.
+void toI420(const FrameView& f, Plane& y, Plane& u, Plane& v) {
+    int32_t cw = (f.width + 1) / 2;
+    int32_t ch = (f.height + 1) / 2;
+    y.allocate(f.width, f.height, f.width);
+    u.allocate(cw, ch, cw);
+    v.allocate(cw, ch, cw);
+
+    if (f.fourcc == FMT_YUYV) {
+        for (int32_t row = 0; row < f.height; ++row) {
+            const uint8_t* s = f.planes[0] + static_cast<size_t>(row) * f.strides[0];
+            uint8_t* yd = y.row(row);
+            for (int32_t x = 0; x < f.width; ++x) {
+                yd[x] = s[x * 2];
+            }
+            if (row % 2 == 0) {
+                uint8_t* ud = u.row(row / 2);
+                uint8_t* vd = v.row(row / 2);
+                for (int32_t x = 0; x < cw; ++x) {
+                    ud[x] = s[x * 4 + 1];
+                    vd[x] = s[x * 4 + 3];
+                }
+            }
+        }
+        return;
+    }
+
+    // NV12 / NV21
+    bool swap = f.fourcc == FMT_NV21;
+    for (int32_t row = 0; row < f.height; ++row) {
+        std::memcpy(y.row(row), f.planes[0] + static_cast<size_t>(row) * f.strides[0], f.width);
+    }
+    for (int32_t row = 0; row < ch; ++row) {
+        const uint8_t* s = f.planes[1] + static_cast<size_t>(row) * f.strides[1];
+        uint8_t* ud = u.row(row);
+        uint8_t* vd = v.row(row);
+        for (int32_t x = 0; x < cw; ++x) {
+            ud[x] = s[x * 2 + (swap ? 1 : 0)];
+            vd[x] = s[x * 2 + (swap ? 0 : 1)];
+        }
+    }
+}
+
+int32_t encodeYuv(const FrameView& f, int32_t transform, int32_t quality, std::vector<uint8_t>& out) {
+    const uint8_t* src[3];
+    int32_t srcStrides[3];
+    Plane y, u, v;
+
+    if (f.fourcc == FMT_YUV420 || f.fourcc == FMT_YVU420) {
+        int32_t uIndex = f.fourcc == FMT_YUV420 ? 1 : 2;
+        src[0] = f.planes[0];
+        src[1] = f.planes[uIndex];
+        src[2] = f.planes[3 - uIndex];
+        srcStrides[0] = f.strides[0];
+        srcStrides[1] = f.strides[uIndex];
+        srcStrides[2] = f.strides[3 - uIndex];
+    } else {
+        toI420(f, y, u, v);
+        src[0] = y.data.data();
+        src[1] = u.data.data();
+        src[2] = v.data.data();
+        srcStrides[0] = y.stride;
+        srcStrides[1] = u.stride;
+        srcStrides[2] = v.stride;
+    }
+
+    int32_t cw = (f.width + 1) / 2;
+    int32_t ch = (f.height + 1) / 2;
+    bool transpose = (transform & TRANSFORM_TRANSPOSE) != 0;
+    int32_t outW = transpose ? f.height : f.width;
+    int32_t outH = transpose ? f.width : f.height;
+
+    // libjpeg reads whole blocks, i.e. up to 16 luma / 8 chroma columns past the
+    // right edge. Use the source in place only when its stride covers that.
+    bool inPlace = transform == 0
+        && static_cast<size_t>(srcStrides[0]) >= alignUp(f.width, 16)
+        && static_cast<size_t>(srcStrides[1]) >= alignUp(cw, 8)
+        && static_cast<size_t>(srcStrides[2]) >= alignUp(cw, 8);
+
+    YuvPlanes in;
+    in.width = outW;
+    in.height = outH;
+    Plane ty, tu, tv;
+    if (inPlace) {
+        for (int i = 0; i < 3; ++i) {
+            in.data[i] = src[i];
+            in.strides[i] = srcStrides[i];
+        }
+    } else {
+        int32_t outCw = transpose ? ch : cw;
+        int32_t outCh = transpose ? cw : ch;
+        ty.allocate(outW, outH, static_cast<int32_t>(alignUp(outW, 16)));
+        tu.allocate(outCw, outCh, static_cast<int32_t>(alignUp(outCw, 8)));
+        tv.allocate(outCw, outCh, static_cast<int32_t>(alignUp(outCw, 8)));
+        transformPlane(src[0], srcStrides[0], f.width, f.height, 1, ty.data.data(), ty.stride, transform);
+        transformPlane(src[1], srcStrides[1], cw, ch, 1, tu.data.data(), tu.stride, transform);
+        transformPlane(src[2], srcStrides[2], cw, ch, 1, tv.data.data(), tv.stride, transform);
+        padRows(ty);
+        padRows(tu);
+        padRows(tv);
+        in.data[0] = ty.data.data();
+        in.data[1] = tu.data.data();
+        in.data[2] = tv.data.data();
+        in.strides[0] = ty.stride;
+        in.strides[1] = tu.stride;
+        in.strides[2] = tv.stride;
+        // The untransformed copies are no longer needed
+        std::vector<uint8_t>().swap(y.data);
+        std::vector<uint8_t>().swap(u.data);
+        std::vector<uint8_t>().swap(v.data);
+    }
+    return compressYuv(in, quality, out);
+}
+
+int32_t encodePacked(const FrameView& f, int32_t transform, int32_t quality, std::vector<uint8_t>& out) {
+    PackedImage in;
+    switch (f.fourcc) {
+        case FMT_RGB888:     in.components = 3; in.colorSpace = JCS_EXT_BGR; break;
+        case FMT_V4L2_BGR24: in.components = 3; in.colorSpace = JCS_EXT_BGR; break;
+        case FMT_BGR888:     in.components = 3; in.colorSpace = JCS_EXT_RGB; break;
+        case FMT_V4L2_RGB24: in.components = 3; in.colorSpace = JCS_EXT_RGB; break;
+        case FMT_XRGB8888:   in.components = 4; in.colorSpace = JCS_EXT_BGRX; break;
+        case FMT_XBGR8888:   in.components = 4; in.colorSpace = JCS_EXT_RGBX; break;
+        default: return -ENOTSUP;
+    }
+    Plane t;
+    if (transform == 0) {
+        in.data = f.planes[0];
+        in.stride = f.strides[0];
+        in.width = f.width;
+        in.height = f.height;
+    } else {
+        bool transpose = (transform & TRANSFORM_TRANSPOSE) != 0;
+        int32_t outW = transpose ? f.height : f.width;
+        int32_t outH = transpose ? f.width : f.height;
+        t.allocate(outW, outH, outW * in.components);
+        transformPlane(f.planes[0], f.strides[0], f.width, f.height, in.components,
+                       t.data.data(), t.stride, transform);
+        in.data = t.data.data();
+        in.stride = t.stride;
+        in.width = outW;
+        in.height = outH;
+    }
+    return compressPacked(in, quality, out);
+}
+
+// ---- Downscaling ----
+
+// Box-filters a plane of elem-byte samples (each byte averaged on its own) from
+// w x h down to dw x dh: every output sample is the mean of the source area it
+// covers, which for the large reductions of thumbnails is cheap and does not
+// alias.
+void downscalePlane(const uint8_t* src, int32_t srcStride, int32_t w, int32_t h, int32_t elem,
+                    uint8_t* dst, int32_t dstStride, int32_t dw, int32_t dh) {
+    std::vector<int32_t> xStart(dw + 1);
+    for (int32_t dx = 0; dx <= dw; ++dx) {
+        xStart[dx] = static_cast<int32_t>(static_cast<int64_t>(dx) * w / dw);
+    }
+    std::vector<uint32_t> sums(static_cast<size_t>(dw) * elem);
+    for (int32_t dy = 0; dy < dh; ++dy) {
+        int32_t y0 = static_cast<int32_t>(static_cast<int64_t>(dy) * h / dh);
+        int32_t y1 = std::max(y0 + 1, static_cast<int32_t>(static_cast<int64_t>(dy + 1) * h / dh));
+        std::fill(sums.begin(), sums.end(), 0);
+        for (int32_t y = y0; y < y1; ++y) {
+            const uint8_t* row = src + static_cast<size_t>(y) * srcStride;
+            for (int32_t dx = 0; dx < dw; ++dx) {
+                uint32_t* sum = sums.data() + static_cast<size_t>(dx) * elem;
+                int32_t x1 = std::max(xStart[dx] + 1, xStart[dx + 1]);
+                for (int32_t x = xStart[dx]; x < x1; ++x) {
+                    for (int32_t c = 0; c < elem; ++c) {
+                        sum[c] += row[x * elem + c];
+                    }
+                }
+            }
+        }
+        uint8_t* out = dst + static_cast<size_t>(dy) * dstStride;
+        for (int32_t dx = 0; dx < dw; ++dx) {
+            uint32_t count = static_cast<uint32_t>(std::max(1, xStart[dx + 1] - xStart[dx]) * (y1 - y0));
+            for (int32_t c = 0; c < elem; ++c) {
+                uint32_t sum = sums[static_cast<size_t>(dx) * elem + c];
+                out[dx * elem + c] = static_cast<uint8_t>((sum + count / 2) / count);
+            }
+        }
+    }
+}
+
+// ---- Perceptual hash ----
+
+// A difference hash compares neighbouring cells of a 9x8 grid of mean luma.
+constexpr int32_t kHashGridWidth = 9;
+constexpr int32_t kHashGridHeight = 8;
+
+// Cell of position i of n along an axis split into g cells. Box edges are
+// rounded from the far end of a reversed axis, so that a grid taken before a
+// flip has the same boxes as one taken from the flipped image.
+int32_t gridCell(int32_t i, int32_t n, int32_t g, bool reversed) {
+    return reversed ? g - 1 - static_cast<int32_t>(static_cast<int64_t>(n - 1 - i) * g / n)
+                    : static_cast<int32_t>(static_cast<int64_t>(i) * g / n);
+}
+
+// Mean of gw x gh equal boxes over a w x h plane whose samples are `step`
+// bytes apart, with box edges as for gridCell.
+void lumaGrid(const uint8_t* base, int32_t stride, int32_t w, int32_t h, int32_t step,
+              int32_t gw, int32_t gh, uint8_t* grid, bool reverseX = false, bool reverseY = false) {
+    std::vector<int32_t> column(w);
+    std::vector<uint64_t> columns(gw);
+    std::vector<uint64_t> rows(gh);
+    for (int32_t x = 0; x < w; ++x) {
+        column[x] = gridCell(x, w, gw, reverseX);
+        columns[column[x]]++;
+    }
+    std::vector<uint64_t> sums(static_cast<size_t>(gw) * gh);
+    for (int32_t y = 0; y < h; ++y) {
+        const uint8_t* row = base + static_cast<size_t>(y) * stride;
+        const int32_t gy = gridCell(y, h, gh, reverseY);
+        uint64_t* cells = sums.data() + static_cast<size_t>(gy) * gw;
+        rows[gy]++;
+        for (int32_t x = 0; x < w; ++x) {
+            cells[column[x]] += row[static_cast<size_t>(x) * step];
+        }
+    }
+    for (int32_t gy = 0; gy < gh; ++gy) {
+        for (int32_t gx = 0; gx < gw; ++gx) {
+            const uint64_t count = std::max<uint64_t>(1, rows[gy] * columns[gx]);
+            grid[gy * gw + gx] = static_cast<uint8_t>(sums[static_cast<size_t>(gy) * gw + gx] / count);
+        }
+    }
+}
+
+// Bit y*8+x (from the top) is set when cell (x, y) is brighter than (x+1, y).
+uint64_t differenceHash(const uint8_t* grid) {
+    uint64_t hash = 0;
+    for (int32_t y = 0; y < kHashGridHeight; ++y) {
+        for (int32_t x = 0; x < kHashGridWidth - 1; ++x) {
+            const uint8_t* cell = grid + y * kHashGridWidth + x;
+            hash = (hash << 1) | (cell[0] > cell[1] ? 1 : 0);
+        }
+    }
+    return hash;
+}
+
+// ---- Warping ----
+
+// Bilinearly resamples packed rows so that the content moves by `motion`:
+// out(q) = in(p) with q = R(angle) (p - c) + c + shift. Samples falling
+// outside the image take the nearest edge pixel. 16.16 fixed point.
+void warpPacked(const uint8_t* src, int32_t width, int32_t height, int32_t components,
+                const lc4j::RigidMotion& motion, uint8_t* dst) {
+    const double cosA = std::cos(motion.angle);
+    const double sinA = std::sin(motion.angle);
+    const double cx = (width - 1) * 0.5;
+    const double cy = (height - 1) * 0.5;
+    const double tx = motion.shiftX * width;
+    const double ty = motion.shiftY * width;
+    const size_t stride = static_cast<size_t>(width) * components;
+    const int32_t maxX = (width - 1) << 16;
+    const int32_t maxY = (height - 1) << 16;
+    for (int32_t y = 0; y < height; ++y) {
+        // p = R(-angle) (q - c - shift) + c, stepping along the row
+        const double qy = y - cy - ty;
+        const double qx = -cx - tx;
+        auto px = static_cast<int64_t>(std::lround((cosA * qx + sinA * qy + cx) * 65536.0));
+        auto py = static_cast<int64_t>(std::lround((-sinA * qx + cosA * qy + cy) * 65536.0));
+        const auto dx = static_cast<int64_t>(std::lround(cosA * 65536.0));
+        const auto dy = static_cast<int64_t>(std::lround(-sinA * 65536.0));
+        uint8_t* out = dst + stride * y;
+        for (int32_t x = 0; x < width; ++x, px += dx, py += dy, out += components) {
+            const auto fx = static_cast<int32_t>(std::clamp<int64_t>(px, 0, maxX));
+            const auto fy = static_cast<int32_t>(std::clamp<int64_t>(py, 0, maxY));
+            const int32_t x0 = fx >> 16;
+            const int32_t y0 = fy >> 16;
+            const int32_t x1 = std::min(x0 + 1, width - 1);
+            const int32_t y1 = std::min(y0 + 1, height - 1);
+            const uint32_t wx = static_cast<uint32_t>(fx & 0xFFFF) >> 8;
+            const uint32_t wy = static_cast<uint32_t>(fy & 0xFFFF) >> 8;
+            const uint8_t* r0 = src + stride * y0;
+            const uint8_t* r1 = src + stride * y1;
+            for (int32_t c = 0; c < components; ++c) {
+                const uint32_t top = r0[x0 * components + c] * (256 - wx) + r0[x1 * components + c] * wx;
+                const uint32_t bottom = r1[x0 * components + c] * (256 - wx) + r1[x1 * components + c] * wx;
+                out[c] = static_cast<uint8_t>((top * (256 - wy) + bottom * wy + 32768) >> 16);
+            }
+        }
+    }
+}
+
+// ---- DNG ----
+
+constexpr uint16_t TYPE_BYTE = 1;
+constexpr uint16_t TYPE_ASCII = 2;
+constexpr uint16_t TYPE_SHORT = 3;
+constexpr uint16_t TYPE_LONG = 4;
+constexpr uint16_t TYPE_RATIONAL = 5;
+constexpr uint16_t TYPE_SRATIONAL = 10;
+
+struct IfdEntry {
+    uint16_t tag;
+    uint16_t type;
+    uint32_t count;
+    uint32_t value;              // inline value, or offset of extra
+    std::vector<uint8_t> extra;  // values larger than 4 bytes
+};
+
+void put16(std::vector<uint8_t>& b, uint16_t v) {
+    b.push_back(static_cast<uint8_t>(v));
+    b.push_back(static_cast<uint8_t>(v >> 8));
+}
+
+void put32(std::vector<uint8_t>& b, uint32_t v) {
+    for (int i = 0; i < 4; ++i) {
+        b.push_back(static_cast<uint8_t>(v >> (i * 8)));
+    }
+}
+
+void addInline(std::vector<IfdEntry>& e, uint16_t tag, uint16_t type, uint32_t count, uint32_t value) {
+    e.push_back({tag, type, count, value, {}});
+}
+
+void addBytes(std::vector<IfdEntry>& e, uint16_t tag, uint16_t type, const uint8_t* data, size_t n) {
+    if (n <= 4) {
+        uint32_t value = 0;
+        for (size_t i = 0; i < n; ++i) {
+            value |= static_cast<uint32_t>(data[i]) << (i * 8);
+        }
+        addInline(e, tag, type, static_cast<uint32_t>(n), value);
+    } else {
+        e.push_back({tag, type, static_cast<uint32_t>(n), 0, std::vector<uint8_t>(data, data + n)});
+    }
+}
+
+void addString(std::vector<IfdEntry>& e, uint16_t tag, const std::string& s) {
+    addBytes(e, tag, TYPE_ASCII, reinterpret_cast<const uint8_t*>(s.c_str()), s.size() + 1);
+}
+
+void addRationals(std::vector<IfdEntry>& e, uint16_t tag, uint16_t type, const double* v, size_t n) {
+    std::vector<uint8_t> data;
+    for (size_t i = 0; i < n; ++i) {
+        put32(data, static_cast<uint32_t>(static_cast<int32_t>(std::lround(v[i] * 10000))));
+        put32(data, 10000);
+    }
+    e.push_back({tag, type, static_cast<uint32_t>(n), 0, std::move(data)});
+}
+
+// Unpacks one row of raw samples to 16-bit values.
+void unpackRow(const uint8_t* src, int32_t width, lc4j::RawPacking packing, uint16_t* dst) {
+    switch (packing) {
+        case lc4j::RawPacking::Csi2p10:
+            // 4 pixels in 5 bytes: high 8 bits each, then the 4x2 low bits
+            for (int32_t x = 0; x < width; x += 4) {
+                const uint8_t* s = src + (x / 4) * 5;
+                for (int32_t i = 0; i < 4 && x + i < width; ++i) {
+                    dst[x + i] = static_cast<uint16_t>((s[i] << 2) | ((s[4] >> (i * 2)) & 0x03));
+                }
+            }
+            break;
+        case lc4j::RawPacking::Csi2p12:
+            // 2 pixels in 3 bytes
+            for (int32_t x = 0; x < width; x += 2) {
+                const uint8_t* s = src + (x / 2) * 3;
+                dst[x] = static_cast<uint16_t>((s[0] << 4) | (s[2] & 0x0F));
+                if (x + 1 < width) {
+                    dst[x + 1] = static_cast<uint16_t>((s[1] << 4) | (s[2] >> 4));
+                }
+            }
+            break;
+        case lc4j::RawPacking::Unpacked16:
+            for (int32_t x = 0; x < width; ++x) {
+                dst[x] = static_cast<uint16_t>(src[x * 2] | (src[x * 2 + 1] << 8));
+            }
+            break;
+    }
+}
+
+} // namespace
+
+int32_t lc4j::encodeJpeg(const FrameView& frame, int32_t transform, int32_t quality,
+                         std::vector<uint8_t>& out) {
+    if (frame.width <= 0 || frame.height <= 0 || frame.planes[0] == nullptr) {
+        return -EINVAL;
+    }
+    int32_t q = quality > 0 ? std::min(quality, 100) : 75;
+    // Start with a generous guess; the destination grows if needed
+    out.resize(std::max<size_t>(static_cast<size_t>(frame.width) * frame.height / 4, 65536));
+    try {
+        switch (frame.fourcc) {
+            case FMT_YUV420:
+            case FMT_YVU420:
+            case FMT_NV12:
+            case FMT_NV21:
+            case FMT_YUYV:
+                return encodeYuv(frame, transform & 7, q, out);
+            default:
+                return encodePacked(frame, transform & 7, q, out);
+        }
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+}
+
+int32_t lc4j::recompressJpeg(const uint8_t* data, size_t length, int32_t maxWidth, int32_t quality,
+                             std::vector<uint8_t>& out) {
+    if (data == nullptr || length == 0) {
+        return -EINVAL;
+    }
+    const int32_t q = std::max(1, std::min(100, quality));
+    try {
+        std::vector<uint8_t> pixels;
+        PackedImage in;
+        bool marked;
+        int32_t ret = decompressScaled(data, length, maxWidth, false, pixels, in.width, in.height, in.components,
+                                       marked);
+        if (ret < 0) {
+            return ret;
+        }
+        if (marked) {
+            return -EALREADY;
+        }
+        in.data = pixels.data();
+        in.stride = in.width * in.components;
+        in.colorSpace = in.components == 1 ? JCS_GRAYSCALE : JCS_YCbCr;
+        in.comment = kRecompressedMarker;
+        // Start with a generous guess; the destination grows if needed
+        out.resize(std::max<size_t>(length / 2, 65536));
+        return compressPacked(in, q, out);
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+}
+
+bool lc4j::lumaSampling(uint32_t fourcc, int32_t& offset, int32_t& step) {
+    offset = 0;
+    step = 1;
+    switch (fourcc) {
+        case FMT_YUV420:
+        case FMT_YVU420:
+        case FMT_NV12:
+        case FMT_NV21:
+            return true;
+        case FMT_YUYV:
+            step = 2;
+            return true;
+        case FMT_RGB888:
+        case FMT_BGR888:
+        case FMT_V4L2_RGB24:
+        case FMT_V4L2_BGR24:
+            offset = 1;
+            step = 3;
+            return true;
+        case FMT_XRGB8888:
+        case FMT_XBGR8888:
+            offset = 1;
+            step = 4;
+            return true;
+        default:
+            return false;
+    }
+}
+
+int32_t lc4j::perceptualHash(const FrameView& frame, int32_t transform, uint64_t& hash) {
+    if (frame.width < kHashGridWidth || frame.height < kHashGridWidth || frame.planes[0] == nullptr) {
+        return -EINVAL;
+    }
+    int32_t offset;
+    int32_t step;
+    if (!lumaSampling(frame.fourcc, offset, step)) {
+        return -ENOTSUP;
+    }
+    // The grid is taken from the sensor image and then turned like the encoded
+    // one, so that hashes match those computed from stored JPEGs. Its boxes
+    // are those of the encoded image: a sensor axis the turn reverses is split
+    // from its far end.
+    transform &= 7;
+    const bool transpose = (transform & TRANSFORM_TRANSPOSE) != 0;
+    const bool reverseX = (transform & TRANSFORM_HFLIP) != 0;
+    const bool reverseY = ((transform & TRANSFORM_VFLIP) != 0) != transpose;
+    const int32_t gw = transpose ? kHashGridHeight : kHashGridWidth;
+    const int32_t gh = transpose ? kHashGridWidth : kHashGridHeight;
+    uint8_t raw[kHashGridWidth * kHashGridHeight];
+    uint8_t grid[kHashGridWidth * kHashGridHeight];
+    try {
+        lumaGrid(frame.planes[0] + offset, frame.strides[0], frame.width, frame.height, step, gw, gh, raw,
+                 reverseX, reverseY);
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+    transformPlane(raw, gw, gw, gh, 1, grid, kHashGridWidth, transform);
+    hash = differenceHash(grid);
+    return 0;
+}
+
+int32_t lc4j::perceptualHashJpeg(const uint8_t* data, size_t length, uint64_t& hash) {
+    if (data == nullptr || length == 0) {
+        return -EINVAL;
+    }
+    try {
+        // At 1/8 scale libjpeg only decodes the DC coefficients
+        std::vector<uint8_t> luma;
+        int32_t width, height, components;
+        bool marked;
+        int32_t ret = decompressScaled(data, length, 1, true, luma, width, height, components, marked);
+        if (ret < 0) {
+            return ret;
+        }
+        if (width < kHashGridWidth || height < kHashGridHeight) {
+            return -EINVAL;
+        }
+        uint8_t grid[kHashGridWidth * kHashGridHeight];
+        lumaGrid(luma.data(), width, width, height, 1, kHashGridWidth, kHashGridHeight, grid);
+        hash = differenceHash(grid);
+        return 0;
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+}
+
+int32_t lc4j::decodeJpegLuma(const uint8_t* data, size_t length, int32_t maxWidth, std::vector<uint8_t>& luma,
+                             int32_t& width, int32_t& height) {
+    if (data == nullptr || length == 0 || maxWidth < 1) {
+        return -EINVAL;
+    }
+    try {
+        int32_t components;
+        bool marked;
+        return decompressScaled(data, length, maxWidth, true, luma, width, height, components, marked);
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+}
+
+int32_t lc4j::correctJpeg(const uint8_t* data, size_t length, const JpegCorrection& correction, int32_t quality,
+                          std::vector<uint8_t>& out) {
+    if (data == nullptr || length == 0) {
+        return -EINVAL;
+    }
+    const int32_t q = std::max(1, std::min(100, quality));
+    try {
+        std::vector<uint8_t> pixels;
+        PackedImage in;
+        bool marked;
+        int32_t ret = decompressScaled(data, length, 0, false, pixels, in.width, in.height, in.components, marked);
+        if (ret < 0) {
+            return ret;
+        }
+        if (correction.lumaLut != nullptr) {
+            for (size_t i = 0; i < pixels.size(); i += static_cast<size_t>(in.components)) {
+                pixels[i] = correction.lumaLut[pixels[i]];
+            }
+        }
+        if (correction.warp != nullptr) {
+            std::vector<uint8_t> warped(pixels.size());
+            warpPacked(pixels.data(), in.width, in.height, in.components, *correction.warp, warped.data());
+            pixels.swap(warped);
+        }
+        in.data = pixels.data();
+        in.stride = in.width * in.components;
+        in.colorSpace = in.components == 1 ? JCS_GRAYSCALE : JCS_YCbCr;
+        out.resize(std::max<size_t>(length, 65536));
+        return compressPacked(in, q, out);
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+}
+
+int32_t lc4j::downscaleFrame(const FrameView& frame, int32_t maxSize, OwnedFrame& out) {
+    if (frame.width <= 0 || frame.height <= 0 || frame.planes[0] == nullptr || maxSize < 2) {
+        return -EINVAL;
+    }
+    // Even output dimensions keep the chroma planes simple
+    const int32_t longest = std::max(frame.width, frame.height);
+    const double scale = std::min(1.0, static_cast<double>(maxSize) / longest);
+    const int32_t dw = std::max(2, static_cast<int32_t>(frame.width * scale) & ~1);
+    const int32_t dh = std::max(2, static_cast<int32_t>(frame.height * scale) & ~1);
+    if (dw > frame.width || dh > frame.height) {
+        return -EINVAL;
+    }
+
+    // Per plane: source size, output size and bytes per sample
+    struct Layout {
+        int32_t w, h, dw, dh, elem;
+    };
+    const int32_t cw = (frame.width + 1) / 2;
+    const int32_t ch = (frame.height + 1) / 2;
+    std::array<Layout, 3> layouts{};
+    size_t planes;
+    switch (frame.fourcc) {
+        case FMT_YUV420:
+        case FMT_YVU420:
+            layouts[0] = {frame.width, frame.height, dw, dh, 1};
+            layouts[1] = {cw, ch, dw / 2, dh / 2, 1};
+            layouts[2] = {cw, ch, dw / 2, dh / 2, 1};
+            planes = 3;
+            break;
+        case FMT_NV12:
+        case FMT_NV21:
+            layouts[0] = {frame.width, frame.height, dw, dh, 1};
+            layouts[1] = {cw, ch, dw / 2, dh / 2, 2};
+            planes = 2;
+            break;
+        case FMT_YUYV:
+            // Y0 U Y1 V macropixels are averaged as 4-byte samples
+            layouts[0] = {frame.width / 2, frame.height, dw / 2, dh, 4};
+            planes = 1;
+            break;
+        case FMT_RGB888:
+        case FMT_BGR888:
+        case FMT_V4L2_RGB24:
+        case FMT_V4L2_BGR24:
+            layouts[0] = {frame.width, frame.height, dw, dh, 3};
+            planes = 1;
+            break;
+        case FMT_XRGB8888:
+        case FMT_XBGR8888:
+            layouts[0] = {frame.width, frame.height, dw, dh, 4};
+            planes = 1;
+            break;
+        default:
+            return -ENOTSUP;
+    }
+    try {
+        out.view = FrameView();
+        out.view.fourcc = frame.fourcc;
+        out.view.width = dw;
+        out.view.height = dh;
+        for (size_t i = 0; i < planes; ++i) {
+            const Layout& l = layouts[i];
+            if (frame.planes[i] == nullptr) {
+                return -EINVAL;
+            }
+            const int32_t stride = l.dw * l.elem;
+            out.planes[i].resize(static_cast<size_t>(stride) * l.dh);
+            downscalePlane(frame.planes[i], frame.strides[i], l.w, l.h, l.elem,
+                           out.planes[i].data(), stride, l.dw, l.dh);
+            out.view.planes[i] = out.planes[i].data();
+            out.view.strides[i] = stride;
+        }
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+int32_t lc4j::encodeDngHeader(int32_t width, int32_t height, const RawInfo& raw, const DngMetadata& meta,
+                              std::vector<uint8_t>& out) {
+    if (width <= 0 || height <= 0 || raw.bitDepth <= 0 || raw.bitDepth > 16) {
+        return -EINVAL;
+    }
+
+    char dateTime[20];
+    time_t now = time(nullptr);
+    struct tm local;
+    localtime_r(&now, &local);
+    strftime(dateTime, sizeof(dateTime), "%Y:%m:%d %H:%M:%S", &local);
+
+    std::vector<IfdEntry> e;
+    addInline(e, 254, TYPE_LONG, 1, 0);                   // NewSubFileType: full resolution
+    addInline(e, 256, TYPE_LONG, 1, width);               // ImageWidth
+    addInline(e, 257, TYPE_LONG, 1, height);              // ImageLength
+    addInline(e, 258, TYPE_SHORT, 1, 16);                 // BitsPerSample
+    addInline(e, 259, TYPE_SHORT, 1, 1);                  // Compression: none
+    addInline(e, 262, TYPE_SHORT, 1, 32803);              // Photometric: CFA
+    addInline(e, 274, TYPE_SHORT, 1, 1);                  // Orientation: top-left
+    addInline(e, 277, TYPE_SHORT, 1, 1);                  // SamplesPerPixel
+    addInline(e, 278, TYPE_LONG, 1, height);              // RowsPerStrip
+    addInline(e, 284, TYPE_SHORT, 1, 1);                  // PlanarConfig: chunky
+    addString(e, 271, meta.make);
+    addString(e, 272, meta.model);
+    addString(e, 305, meta.software);
+    addString(e, 306, dateTime);
+    addString(e, 50708, meta.make + " " + meta.model);    // UniqueCameraModel
+    const uint8_t dngVersion[4] = {1, 4, 0, 0};
+    const uint8_t dngBackward[4] = {1, 1, 0, 0};
+    addBytes(e, 50706, TYPE_BYTE, dngVersion, 4);
+    addBytes(e, 50707, TYPE_BYTE, dngBackward, 4);
+    addInline(e, 33421, TYPE_SHORT, 2, 2 | (2u << 16));   // CFARepeatPatternDim
+    addBytes(e, 33422, TYPE_BYTE, raw.cfaPattern, 4);     // CFAPattern
+    const uint8_t planeColor[3] = {0, 1, 2};
+    addBytes(e, 50710, TYPE_BYTE, planeColor, 3);         // CFAPlaneColor
+    addInline(e, 50711, TYPE_SHORT, 1, 1);                // CFALayout: rectangular
+    addRationals(e, 50721, TYPE_SRATIONAL, meta.colorMatrix, 9);
+    addRationals(e, 50728, TYPE_RATIONAL, meta.asShotNeutral, 3);
+    addInline(e, 50778, TYPE_SHORT, 1, 21);               // CalibrationIlluminant1: D65
+    // libcamera reports black levels on a 16-bit scale; the samples are not shifted.
+    double black[4];
+    for (int i = 0; i < 4; ++i) {
+        black[i] = static_cast<double>(meta.blackLevel[i]) / (1 << (16 - raw.bitDepth));
+    }
+    addRationals(e, 50714, TYPE_RATIONAL, black, 4);
+    addInline(e, 50717, TYPE_LONG, 1, (1u << raw.bitDepth) - 1);   // WhiteLevel
+    const uint32_t imageBytes = static_cast<uint32_t>(width) * height * 2;
+    addInline(e, 273, TYPE_LONG, 1, 0);                   // StripOffsets, patched below
+    addInline(e, 279, TYPE_LONG, 1, imageBytes);          // StripByteCounts
+
+    std::sort(e.begin(), e.end(), [](const IfdEntry& a, const IfdEntry& b) { return a.tag < b.tag; });
+
+    const uint32_t ifdOffset = 8;
+    const uint32_t extraOffset = ifdOffset + 2 + static_cast<uint32_t>(e.size()) * 12 + 4;
+    uint32_t offset = extraOffset;
+    for (auto& entry : e) {
+        if (!entry.extra.empty()) {
+            if (entry.type == TYPE_RATIONAL || entry.type == TYPE_SRATIONAL || entry.type == TYPE_LONG) {
+                offset = (offset + 3) & ~3u;
+            } else if (entry.type == TYPE_SHORT) {
+                offset = (offset + 1) & ~1u;
+            }
+            entry.value = offset;
+            offset += static_cast<uint32_t>(entry.extra.size());
+        }
+    }
+    const uint32_t stripOffset = (offset + 3) & ~3u;
+    for (auto& entry : e) {
+        if (entry.tag == 273) {
+            entry.value = stripOffset;
+        }
+    }
+
+    try {
+        out.clear();
+        out.reserve(stripOffset);
+        out.push_back('I');
+        out.push_back('I');
+        put16(out, 42);
+        put32(out, ifdOffset);
+        put16(out, static_cast<uint16_t>(e.size()));
+        for (const auto& entry : e) {
+            put16(out, entry.tag);
+            put16(out, entry.type);
+            put32(out, entry.count);
+            put32(out, entry.value);
+        }
+        put32(out, 0);   // no next IFD
+        for (const auto& entry : e) {
+            if (!entry.extra.empty()) {
+                out.resize(entry.value, 0);
+                out.insert(out.end(), entry.extra.begin(), entry.extra.end());
+            }
+        }
+        out.resize(stripOffset, 0);
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+size_t lc4j::rawRowBytes(int32_t width, RawPacking packing) {
+    switch (packing) {
+        case RawPacking::Csi2p10:
+            return static_cast<size_t>((width + 3) / 4) * 5;
+        case RawPacking::Csi2p12:
+            return static_cast<size_t>((width + 1) / 2) * 3;
+        case RawPacking::Unpacked16:
+            break;
+    }
+    return static_cast<size_t>(width) * 2;
+}
+
+void lc4j::unpackRawRow(const uint8_t* src, int32_t width, RawPacking packing, uint16_t* dst) {
+    unpackRow(src, width, packing, dst);
+}
+
+void lc4j::encodeDngRow(const uint8_t* src, int32_t width, RawPacking packing, uint16_t* scratch, uint8_t* dst) {
+    unpackRow(src, width, packing, scratch);
+    for (int32_t x = 0; x < width; ++x) {
+        *dst++ = static_cast<uint8_t>(scratch[x]);
+        *dst++ = static_cast<uint8_t>(scratch[x] >> 8);
+    }
+}
+
+int32_t lc4j::encodeDng(const FrameView& frame, const RawInfo& raw, const DngMetadata& meta,
+                        std::vector<uint8_t>& out) {
+    if (frame.planes[0] == nullptr) {
+        return -EINVAL;
+    }
+    int32_t ret = encodeDngHeader(frame.width, frame.height, raw, meta, out);
+    if (ret < 0) {
+        return ret;
+    }
+    const size_t rowBytes = static_cast<size_t>(frame.width) * 2;
+    try {
+        const size_t stripOffset = out.size();
+        out.resize(stripOffset + rowBytes * frame.height);
+        std::vector<uint16_t> row(static_cast<size_t>(frame.width));
+        for (int32_t y = 0; y < frame.height; ++y) {
+            encodeDngRow(frame.planes[0] + static_cast<size_t>(y) * frame.strides[0], frame.width, raw.packing,
+                         row.data(), out.data() + stripOffset + rowBytes * y);
+        }
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+    return 0;
+}
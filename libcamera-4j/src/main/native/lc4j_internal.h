@@ -0,0 +1,439 @@
+/*
+ * libcamera4j - internal helpers shared between the shim's translation units.
+ *
+ * Nothing in here is part of the C ABI; the Java layer only ever sees
+ * libcamera4j.h. These declarations let the individual native modules (camera
+ * shim, frame writer, ...) share handle allocation and hand data to each other
+ * without a round trip through Java.
+ */
+#ifndef LC4J_INTERNAL_H
+#define LC4J_INTERNAL_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct lc4j_store_record;
+struct lc4j_frame_stats;
+struct lc4j_stats;
+struct lc4j_latency_histogram;
+struct lc4j_sequence_stats;
+
+namespace lc4j {
+
+// Allocates a process-wide unique, non-zero handle. All modules draw from the
+// same sequence so a handle can never be mistaken for one of another type.
+int64_t allocHandle();
+
+// Queues an owned buffer on a frame writer (see lc4j_writer_submit). The data
+// is moved, not copied. Returns 0 on success, negative on error.
+int32_t writerSubmitOwned(int64_t writerHandle, const std::string& path,
+                          std::vector<uint8_t>&& data, int64_t cookie, int32_t flags);
+
+// Writes a whole file on the calling thread, honouring the LC4J_WRITE_* flags.
+// Returns 0 on success, negative errno on failure.
+int32_t writeFileSync(const std::string& path, const uint8_t* data, size_t length, int32_t flags);
+
+// Appends a frame to a frame store (see lc4j_store_append), tagged with *tag
+// if that is given (see lc4j_store_set_tags).
+int32_t storeAppend(int64_t storeHandle, int64_t timestampMs, const uint8_t* data, size_t length,
+                    const int64_t* tag = nullptr);
+
+// Replaces a stored frame, as listed by lc4j_store_list, with new data. Fails
+// with -ESTALE if the frame changed in between; there is nothing to replace
+// then, so callers skip it.
+int32_t storeReplace(int64_t storeHandle, const lc4j_store_record& expected, const uint8_t* data, size_t length);
+
+// ---- Image codecs (image_codec.cpp) ----
+
+constexpr uint32_t fourcc(char a, char b, char c, char d) {
+    return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8)
+         | (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24);
+}
+
+// A captured frame as laid out in memory by libcamera, planes already mapped.
+// Pixel formats use DRM fourccs (libcamera's PixelFormat::fourcc()).
+struct FrameView {
+    uint32_t fourcc = 0;
+    int32_t width = 0;
+    int32_t height = 0;
+    const uint8_t* planes[3] = {nullptr, nullptr, nullptr};
+    int32_t strides[3] = {0, 0, 0};
+};
+
+enum class RawPacking { Csi2p10, Csi2p12, Unpacked16 };
+
+// Bayer layout of a raw frame.
+struct RawInfo {
+    uint8_t cfaPattern[4] = {2, 1, 1, 0};   // 2x2 row-major, 0=R 1=G 2=B (default BGGR)
+    int32_t bitDepth = 10;
+    RawPacking packing = RawPacking::Csi2p10;
+};
+
+struct DngMetadata {
+    std::string make = "Raspberry Pi";
+    std::string model = "Camera Module";
+    std::string software = "libcamera4j";
+    double colorMatrix[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+    double asShotNeutral[3] = {1, 1, 1};
+    int32_t blackLevel[4] = {4096, 4096, 4096, 4096};   // 16-bit scale, as libcamera reports
+};
+
+// Encodes a YUV or RGB frame as JPEG, applying a Transform (bit 0 hflip,
+// bit 1 vflip, bit 2 transpose - same values as the Java Transform enum).
+// Returns 0 on success, negative errno on failure.
+int32_t encodeJpeg(const FrameView& frame, int32_t transform, int32_t quality, std::vector<uint8_t>& out);
+
+// A frame that owns its planes, such as a downscaled copy. Not copyable, as
+// the view points into the vectors.
+struct OwnedFrame {
+    FrameView view;
+    std::vector<uint8_t> planes[3];
+
+    OwnedFrame() = default;
+    OwnedFrame(const OwnedFrame&) = delete;
+    OwnedFrame& operator=(const OwnedFrame&) = delete;
+};
+
+// Downscales a YUV or RGB frame by area averaging so that its longer side is
+// at most maxSize (dimensions rounded to even), keeping its pixel format.
+// Returns 0 on success, -ENOTSUP for unknown formats.
+int32_t downscaleFrame(const FrameView& frame, int32_t maxSize, OwnedFrame& out);
+
+// Re-encodes a JPEG at `quality`, decoding it at the smallest libjpeg DCT
+// scale (n/8) that keeps it at least maxWidth pixels wide (0 keeps the size).
+// The output carries a comment marker, and input that has one is refused with
+// -EALREADY, so repeated passes do not keep degrading an image.
+int32_t recompressJpeg(const uint8_t* data, size_t length, int32_t maxWidth, int32_t quality,
+                       std::vector<uint8_t>& out);
+
+// Where the luma (green for packed RGB) samples of a YUV or RGB frame are in
+// plane 0: the first at `offset`, then every `step` bytes. False for other
+// formats.
+bool lumaSampling(uint32_t fourcc, int32_t& offset, int32_t& step);
+
+// 64-bit difference hash of a frame's luma (green for RGB formats): a 9x8 grid
+// of mean brightness, one bit per horizontal neighbour pair. The grid is
+// turned by `transform`, so the hash matches perceptualHashJpeg of the frame
+// as encoded by encodeJpeg with the same transform. Similar images differ in
+// few bits.
+int32_t perceptualHash(const FrameView& frame, int32_t transform, uint64_t& hash);
+
+// The same hash, from a JPEG decoded at 1/8 scale.
+int32_t perceptualHashJpeg(const uint8_t* data, size_t length, uint64_t& hash);
+
+// Luma of a JPEG decoded at the smallest n/8 scale that keeps it at least
+// maxWidth wide (1 for 1/8), rows of width bytes.
+int32_t decodeJpegLuma(const uint8_t* data, size_t length, int32_t maxWidth, std::vector<uint8_t>& luma,
+                       int32_t& width, int32_t& height);
+
+// A rotation of an image by `angle` radians about its centre followed by a
+// shift. Shifts are in widths of the image, so that a motion measured on a
+// downscaled copy applies to the full image as is.
+struct RigidMotion {
+    double shiftX = 0.0;
+    double shiftY = 0.0;
+    double angle = 0.0;
+};
+
+// What correctJpeg does to an image; null members are left out.
+struct JpegCorrection {
+    const uint8_t* lumaLut = nullptr;       // 256 entries luma is mapped through
+    const RigidMotion* warp = nullptr;      // motion of the content, edges repeated into the border
+};
+
+// Re-encodes a JPEG at `quality` with its luma mapped and its content warped,
+// decoding only to YCbCr so that colours are not converted back and forth.
+int32_t correctJpeg(const uint8_t* data, size_t length, const JpegCorrection& correction, int32_t quality,
+                    std::vector<uint8_t>& out);
+
+// Encodes a raw Bayer frame as an uncompressed 16-bit DNG.
+int32_t encodeDng(const FrameView& frame, const RawInfo& raw, const DngMetadata& meta,
+                  std::vector<uint8_t>& out);
+
+// The same DNG in pieces: everything up to the pixel data (a single strip of
+// width * 2 bytes per row that follows directly), and one row of that strip
+// from a packed raw row. `scratch` holds `width` samples.
+int32_t encodeDngHeader(int32_t width, int32_t height, const RawInfo& raw, const DngMetadata& meta,
+                        std::vector<uint8_t>& out);
+void encodeDngRow(const uint8_t* src, int32_t width, RawPacking packing, uint16_t* scratch, uint8_t* dst);
+
+// Bytes of one packed raw row of `width` pixels, without stride padding.
+size_t rawRowBytes(int32_t width, RawPacking packing);
+
+// Unpacks one packed raw row to `width` samples of bitDepth bits.
+void unpackRawRow(const uint8_t* src, int32_t width, RawPacking packing, uint16_t* dst);
+
+// ---- Frame export (frame_export.cpp) ----
+
+// Publishes a captured frame to every open frame export (see lc4j_export_open):
+// its planes as they are, and `jpeg` (its encoding with `transform` applied)
+// if not empty. Cheap when no export is open.
+void exportFrame(const FrameView& frame, int32_t transform, const std::vector<uint8_t>& jpeg,
+                 int64_t timestampNs, int64_t frameSequence);
+
+// ---- Frame server (frame_server.cpp) ----
+
+// Where a plane of a captured frame lives in its dmabuf.
+struct DmabufPlane {
+    int fd = -1;
+    uint32_t offset = 0;
+    uint32_t length = 0;
+    int32_t stride = 0;
+};
+
+// Whether any frame server has a subscriber that can take a frame; lets
+// capture sessions skip describing the buffer.
+bool frameServerWanted();
+
+// Sends a captured frame's dmabufs to the subscribers of every open frame
+// server (see lc4j_server_open). The fds are duplicated by the kernel; the
+// caller keeps its own.
+void serveFrame(uint32_t fourcc, int32_t width, int32_t height, const DmabufPlane* planes, int32_t planeCount,
+                int64_t timestampNs, int64_t sequence);
+
+// ---- DNG streams (dng_stream.cpp) ----
+
+// Copies a raw frame's rows and opens a DNG stream on them (see
+// lc4j_dng_stream_read), so the frame's buffer can be returned right away.
+// Returns the stream handle in `handle` and the DNG size in `size`.
+int32_t openDngStream(const FrameView& frame, const RawInfo& raw, const DngMetadata& meta,
+                      int64_t& handle, int64_t& size);
+
+// ---- Frame statistics (frame_stats.cpp) ----
+
+// Computes the exposure statistics of a YUV or RGB frame, or of a raw Bayer
+// frame if `raw` is given (see lc4j_frame_stats).
+int32_t frameStats(const FrameView& frame, const RawInfo* raw, int32_t zonesX, int32_t zonesY,
+                   lc4j_frame_stats& out);
+
+// ---- Motion detection (motion_detector.cpp) ----
+
+// Feeds a YUV or RGB frame to a motion detector (see lc4j_motion_process).
+// Returns 1 if it raised an event, 0 if not, -1 for an unknown handle.
+int32_t motionProcess(int64_t handle, const FrameView& frame, int64_t sequence, int64_t timestampNs);
+
+// ---- Frame stacking (frame_stack.cpp) ----
+
+// Runs fn(begin, end) over [0, rows), split across a few threads when there
+// are enough rows to be worth it.
+void forRows(int32_t rows, const std::function<void(int32_t, int32_t)>& fn);
+
+// The same with at least minRows rows per thread; 1 splits work such as
+// whole frames, every one of which is worth a thread.
+void forRows(int32_t rows, int32_t minRows, const std::function<void(int32_t, int32_t)>& fn);
+
+// Averages a burst of frames of one layout, YUV 4:2:0 (planar or semi-planar)
+// or raw Bayer, in 16-bit accumulators. With `align` every frame is shifted by
+// the whole pixels (whole Bayer quads for raw) that best line its luma up with
+// the first frame, found coarse to fine on a pyramid.
+class FrameStack {
+public:
+    // Starts a stack of at most maxFrames with its first frame; raw frames
+    // need `raw`. -ENOTSUP for other formats.
+    int32_t begin(const FrameView& frame, const RawInfo* raw, int32_t maxFrames, bool align);
+
+    // Adds a frame of the same layout as the first.
+    int32_t add(const FrameView& frame);
+
+    // The average so far: YUV in the same format with tight strides, or raw
+    // unpacked to 16 bits per sample, described by `rawOut`, whose bit depth
+    // is raised by up to log2(count) bits of the extra precision.
+    int32_t average(OwnedFrame& out, RawInfo* rawOut) const;
+
+    int32_t count() const { return count_; }
+
+    // Shift of the last added frame, in pixels.
+    int32_t shiftX() const { return shiftX_; }
+    int32_t shiftY() const { return shiftY_; }
+
+private:
+    struct Level {
+        int32_t width = 0;
+        int32_t height = 0;
+        std::vector<uint8_t> pixels;
+    };
+
+    struct Plane {
+        int32_t rowBytes = 0;       // accumulated samples per row
+        int32_t rows = 0;
+        int32_t subsampling = 1;    // pixels per sample
+        int32_t unit = 1;           // samples per shift step (2 for interleaved chroma)
+        std::vector<uint16_t> sums;
+    };
+
+    FrameView first_;
+    bool raw_ = false;
+    RawInfo rawInfo_;
+    int32_t preShift_ = 0;
+    bool align_ = false;
+    Plane planes_[3];
+    int32_t planeCount_ = 0;
+    int32_t maxFrames_ = 0;
+    int32_t count_ = 0;
+    int32_t shiftX_ = 0;
+    int32_t shiftY_ = 0;
+    std::vector<Level> reference_;
+
+    void pyramid(const FrameView& frame, std::vector<Level>& levels) const;
+    void accumulate(const FrameView& frame, int32_t dx, int32_t dy);
+};
+
+// ---- Exposure fusion (exposure_fusion.cpp) ----
+
+// A row-major plane of floats.
+struct FloatPlane {
+    int32_t width = 0;
+    int32_t height = 0;
+    std::vector<float> values;
+};
+
+// Merges an exposure bracket of YUV 4:2:0 frames (planar or semi-planar) into
+// one tone-mapped frame, weighting every frame by local exposedness, contrast
+// and saturation and blending on Laplacian pyramids (Mertens et al.).
+class ExposureFusion {
+public:
+    // Copies a frame of the same size as the first into the bracket and works
+    // out its weights. -ENOTSUP for other formats, -ENOSPC past
+    // LC4J_BRACKET_MAX_FRAMES.
+    int32_t add(const FrameView& frame);
+
+    // The fused frame, planar YUV 4:2:0 (YU12) with tight strides.
+    int32_t fuse(OwnedFrame& out) const;
+
+    int32_t count() const { return static_cast<int32_t>(frames_.size()); }
+
+private:
+    struct Frame {
+        std::vector<uint8_t> planes[3];     // Y, U, V with tight strides
+        FloatPlane weights;                 // per grid cell
+        FloatPlane means[3];                // of each plane per grid cell
+    };
+
+    int32_t width_ = 0;
+    int32_t height_ = 0;
+    std::vector<Frame> frames_;
+};
+
+// ---- Denoise (denoise.cpp) ----
+
+// Smooths the noise of a YUV 4:2:0 frame (planar or semi-planar) with an
+// edge-preserving guided filter into a copy of the same layout with tight
+// strides. sigma is the noise to take out, in 8-bit levels; detail well
+// above it is kept. -ENOTSUP for other formats.
+int32_t denoiseFrame(const FrameView& frame, float sigma, OwnedFrame& out);
+
+// ---- Waterline (waterline.cpp) ----
+
+// Finds the waterline in params' region of a YUV or RGB frame captured with
+// `transform`: its row, as a fraction of the height of the image as captured
+// from the top, the level the calibration gives for it, and the share of
+// strips of the region that agree on it. False if no row stands out.
+bool estimateWaterline(const FrameView& frame, int32_t transform, const lc4j_waterline_params& params,
+                       float& row, float& level, float& confidence);
+
+// ---- Focus measure (focus_measure.cpp) ----
+
+// How sharp a region (fractions of the frame, 0-1) of a YUV or RGB frame is:
+// its mean squared Sobel gradient over its squared mean luma. Only compares
+// between frames of the same scene. Negative for other formats or a region
+// too small to measure.
+double focusMeasure(const FrameView& frame, float left, float top, float right, float bottom);
+
+// ---- Stage latency (stage_latency.cpp) ----
+
+// Nanoseconds on CLOCK_MONOTONIC, the clock of the sensor timestamps.
+int64_t monotonicNs();
+
+// Count, sum, minimum and maximum of the time each LC4J_STAGE_* of a session's
+// captures takes. Thread-safe.
+class StageLatency {
+public:
+    static constexpr int32_t kStages = 10;     // LC4J_STAGE_COUNT
+
+    // Adds one pass through `stage`; negative times are dropped.
+    void record(int32_t stage, int64_t ns);
+    // Copies the counters out, and clears them if `reset`.
+    void snapshot(lc4j_stats& out, bool reset);
+
+private:
+    struct Counter {
+        int64_t count = 0;
+        int64_t sumNs = 0;
+        int64_t minNs = 0;
+        int64_t maxNs = 0;
+    };
+
+    std::mutex mutex_;
+    Counter counters_[kStages];
+};
+
+// Log-linear histogram of latencies, see lc4j_latency_histogram. Recording
+// takes no lock, so it can be done from libcamera's completion thread.
+class LatencyHistogram {
+public:
+    static constexpr int32_t kBuckets = 480;   // LC4J_HISTOGRAM_BUCKETS
+
+    // The bucket of a latency in microseconds.
+    static int32_t bucket(int64_t us);
+
+    void record(int64_t ns);
+    // Copies the histogram out, and clears it if `reset`. Not a consistent
+    // cut while values are being recorded: those land before or after it.
+    void snapshot(lc4j_latency_histogram& out, bool reset);
+
+private:
+    std::atomic<int64_t> count_{0};
+    std::atomic<int64_t> maxNs_{0};
+    std::atomic<uint64_t> buckets_[kBuckets] = {};
+};
+
+// ---- Frame sequence (frame_sequence.cpp) ----
+
+// Sequence numbers and timestamps of the buffers completed on a stream, see
+// lc4j_sequence_stats. Thread-safe.
+class FrameSequence {
+public:
+    // Forgets the last frame but keeps the counts, for when the camera is
+    // started again and its sequence numbers start over. If `reconfigured`,
+    // the stream's size or format changed, and the intervals and delays
+    // learned so far are forgotten as well.
+    void restart(bool reconfigured = false);
+    // Adds a completed buffer; `completedNs` on monotonicNs().
+    void record(uint32_t sequence, int64_t timestampNs, int64_t completedNs);
+    // Copies the counts out, and clears them if `reset`.
+    void snapshot(lc4j_sequence_stats& out, bool reset);
+
+private:
+    std::mutex mutex_;
+    bool started_ = false;
+    uint32_t lastSequence_ = 0;
+    int64_t lastTimestampNs_ = 0;
+    int64_t frames_ = 0;
+    int64_t dropped_ = 0;
+    int64_t duplicates_ = 0;
+    int64_t late_ = 0;
+    int64_t delays_ = 0;
+    double meanDelayNs_ = 0.0;
+    int64_t intervals_ = 0;
+    double meanIntervalNs_ = 0.0;
+    double m2_ = 0.0;           // sum of squared deviations of the intervals
+    int64_t minIntervalNs_ = 0;
+    int64_t maxIntervalNs_ = 0;
+};
+
+// ---- Frame registration (frame_registration.cpp) ----
+
+// Estimates the rigid motion of the content from `previous` to `current`,
+// two luma planes of the same size, by phase correlation of tiles. Returns
+// false if it cannot be told, such as in the dark, after a scene change or
+// when the frames are too small.
+bool estimateMotion(const uint8_t* previous, const uint8_t* current, int32_t width, int32_t height,
+                    RigidMotion& motion);
+
+} // namespace lc4j
+
+#endif /* LC4J_INTERNAL_H */
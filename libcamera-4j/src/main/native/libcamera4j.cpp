@@ -9,6 +9,7 @@
  */
 
 #include "libcamera4j.h"
+#include "lc4j_internal.h"
 
 #include <libcamera/libcamera.h>
 #include <libcamera/control_ids.h>
@@ -44,12 +45,16 @@ static int64_t g_nextHandle = 1;
 
 // Request completion queue per camera
 static std::map<int64_t, std::queue<Request*>> g_completedRequests;
+// Sequence numbers of the buffers completed per camera and stream
+static std::map<int64_t, std::map<const Stream*, lc4j::FrameSequence>> g_sequences;
 
-static int64_t allocHandle() {
+int64_t lc4j::allocHandle() {
     std::lock_guard<std::recursive_mutex> lock(g_mutex);
     return g_nextHandle++;
 }
 
+using lc4j::allocHandle;
+
 // Copy a std::string into a caller-provided buffer. Returns bytes written
 // (excluding NUL), or -1 if the buffer is too small / invalid.
 static int32_t copyString(const std::string& str, char* buf, int32_t buflen) {
@@ -169,6 +174,7 @@ void lc4j_cam_release(int64_t handle) {
         // Drop shared_ptr so CameraManager can clean up properly
         g_cameras.erase(it);
         g_completedRequests.erase(handle);
+        g_sequences.erase(handle);
     }
 }
 
@@ -204,11 +210,19 @@ int32_t lc4j_cam_configure(int64_t handle, int64_t configHandle) {
     if (confIt == g_configurations.end()) {
         return -1;
     }
-    return camIt->second->configure(confIt->second.get());
+    int ret = camIt->second->configure(confIt->second.get());
+    if (ret == 0) {
+        for (const StreamConfiguration& streamConfig : *confIt->second) {
+            g_sequences[handle][streamConfig.stream()].restart(true);
+        }
+    }
+    return ret;
 }
 
-// Request completed callback - stores completed requests in queue
+// Request completed callback - stores completed requests in queue, and
+// tracks the sequence numbers of their buffers
 static void requestCompleted(Request* request) {
+    const int64_t completedNs = lc4j::monotonicNs();
     Camera* cam = request->cookie() != 0 ?
         reinterpret_cast<Camera*>(request->cookie()) : nullptr;
 
@@ -217,6 +231,16 @@ static void requestCompleted(Request* request) {
         for (auto& [handle, camera] : g_cameras) {
             if (camera.get() == cam) {
                 g_completedRequests[handle].push(request);
+                // Requests cancelled by stop() were never exposed
+                if (request->status() != Request::RequestCancelled) {
+                    for (const auto& [stream, buffer] : request->buffers()) {
+                        const FrameMetadata& metadata = buffer->metadata();
+                        if (metadata.status != FrameMetadata::FrameCancelled) {
+                            g_sequences[handle][stream].record(metadata.sequence,
+                                                               static_cast<int64_t>(metadata.timestamp), completedNs);
+                        }
+                    }
+                }
                 break;
             }
         }
@@ -230,6 +254,10 @@ int32_t lc4j_cam_start(int64_t handle) {
         return -1;
     }
     it->second->requestCompleted.connect(requestCompleted);
+    // Sequence numbers start over with every start
+    for (auto& [stream, sequence] : g_sequences[handle]) {
+        sequence.restart();
+    }
     return it->second->start();
 }
 
@@ -275,6 +303,25 @@ int32_t lc4j_cam_queue_request(int64_t handle, int64_t requestHandle) {
     return camIt->second->queueRequest(reqIt->second.get());
 }
 
+int32_t lc4j_cam_sequence_stats(int64_t handle, int64_t configHandle, int32_t streamIndex,
+                                lc4j_sequence_stats* out, int32_t reset) {
+    if (out == nullptr) {
+        return -EINVAL;
+    }
+    std::lock_guard<std::recursive_mutex> lock(g_mutex);
+    auto confIt = g_configurations.find(configHandle);
+    if (g_cameras.find(handle) == g_cameras.end() || confIt == g_configurations.end()) {
+        return -1;
+    }
+    if (streamIndex < 0 || static_cast<size_t>(streamIndex) >= confIt->second->size()) {
+        return -EINVAL;
+    }
+    // Not configured or nothing completed yet: all zero
+    lc4j::FrameSequence& sequence = g_sequences[handle][confIt->second->at(streamIndex).stream()];
+    sequence.snapshot(*out, reset != 0);
+    return 0;
+}
+
 int64_t lc4j_cam_poll_completed_request(int64_t handle) {
     std::lock_guard<std::recursive_mutex> lock(g_mutex);
     auto it = g_completedRequests.find(handle);
@@ -91,6 +91,657 @@ int32_t lc4j_fb_plane_count(int64_t mapHandle);
 int64_t lc4j_fb_plane_address(int64_t mapHandle, int32_t planeIndex);
 int64_t lc4j_fb_plane_length(int64_t mapHandle, int32_t planeIndex);
 
+/* ---- Frame sequence ----
+ * Each camera tracks the sequence numbers and sensor timestamps of the
+ * buffers it completes, per stream (frame_sequence.cpp), to tell whether the
+ * pipeline keeps up with the sensor. Skipped sequence numbers count as
+ * dropped frames and repeated ones as duplicates. A completion is late when
+ * it comes more than one frame interval after the mean delay from exposure to
+ * completion. The intervals are between the timestamps of consecutive frames;
+ * jitter is their standard deviation. Starting the camera starts the numbers
+ * over, keeping the counts; configuring the stream again also starts the
+ * intervals and delays over. */
+typedef struct lc4j_sequence_stats {
+    int64_t frames;             /* buffers completed */
+    int64_t dropped;            /* sequence numbers skipped */
+    int64_t duplicates;         /* sequence numbers seen again, or going back */
+    int64_t late;
+    int64_t lastSequence;
+    int64_t intervals;          /* intervals between consecutive frames measured */
+    double meanIntervalNs;
+    double jitterNs;
+    int64_t minIntervalNs;
+    int64_t maxIntervalNs;
+    double meanLatencyNs;       /* from sensor timestamp to completion */
+} lc4j_sequence_stats;
+
+/* Copies the tracking of one stream of the camera's configuration into *out,
+ * and clears it if reset is non-zero. Returns -1 for an unknown handle and
+ * -EINVAL for a stream index out of range. */
+int32_t lc4j_cam_sequence_stats(int64_t handle, int64_t configHandle, int32_t streamIndex,
+                                lc4j_sequence_stats* out, int32_t reset);
+
+/* ---- FrameWriter ----
+ * Asynchronous whole-file writes. Each submission becomes a linked
+ * mkdirat/openat/write/fsync/close/renameat chain on an io_uring owned by a
+ * writer thread; if io_uring is unavailable the same work is done by a small
+ * thread pool. The data is copied on submit, so the caller's buffer may be
+ * reused as soon as lc4j_writer_submit returns. Submit returns -EAGAIN while
+ * 64 writes or 128 MiB are already waiting to complete. */
+#define LC4J_WRITER_BACKEND_IO_URING    1
+#define LC4J_WRITER_BACKEND_THREAD_POOL 2
+
+#define LC4J_WRITER_FORCE_THREAD_POOL 0x1   /* lc4j_writer_create flag */
+
+#define LC4J_WRITE_MKDIRS 0x1   /* create missing parent directories */
+#define LC4J_WRITE_ATOMIC 0x2   /* write to a temporary name, rename into place */
+#define LC4J_WRITE_FSYNC  0x4   /* fsync the file before closing it */
+
+typedef struct lc4j_write_completion {
+    int64_t cookie;     /* value passed to lc4j_writer_submit */
+    int64_t bytes;      /* bytes written */
+    int64_t latencyNs;  /* submit -> completion */
+    int32_t status;     /* 0 on success, negative errno on failure */
+    int32_t reserved;
+} lc4j_write_completion;
+
+int64_t lc4j_writer_create(int32_t queueDepth, int32_t flags);
+void    lc4j_writer_destroy(int64_t handle);
+int32_t lc4j_writer_backend(int64_t handle);
+int32_t lc4j_writer_submit(int64_t handle, const char* path, const void* data, int64_t length,
+                           int64_t cookie, int32_t flags);
+int32_t lc4j_writer_poll(int64_t handle, lc4j_write_completion* out, int32_t max, int32_t timeoutMs);
+int32_t lc4j_writer_pending(int64_t handle);
+
+/* ---- FrameStats ----
+ * Exposure statistics of a frame's luma, computed natively from the mapped
+ * buffer on a subsampled grid (at most ~128k samples, so it is cheap enough
+ * for every frame). YUV frames use the Y plane and RGB frames green; raw
+ * frames use the mean of each 2x2 Bayer quad, taken from the top 8 bits of
+ * the samples, so their levels are linear and include the black level.
+ * Clipped samples are those at level 0 or 255. Zone means cover a zonesX x
+ * zonesY grid (each 1..16) in sensor orientation, row-major.
+ * lc4j_frame_compute_stats computes them for a mapped YUV or RGB plane of
+ * `length` bytes; capture sessions fill lc4j_capture_result.stats themselves. */
+#define LC4J_STATS_MAX_ZONES 256
+
+typedef struct lc4j_frame_stats {
+    uint32_t histogram[256];    /* samples per luma level */
+    uint64_t samples;
+    double   mean;
+    int32_t  median;
+    int32_t  zonesX;            /* 0 if no statistics were computed */
+    int32_t  zonesY;
+    float    clippedLow;        /* percent of samples at 0 */
+    float    clippedHigh;       /* percent of samples at 255 */
+    float    zoneMeans[LC4J_STATS_MAX_ZONES];
+    int32_t  reserved;
+} lc4j_frame_stats;
+
+int32_t lc4j_frame_compute_stats(const void* plane, int64_t length, int32_t fourcc, int32_t width, int32_t height,
+                                 int32_t stride, int32_t zonesX, int32_t zonesY, lc4j_frame_stats* out);
+
+/* ---- MotionDetector ----
+ * Detects motion in a stream of small frames. Each frame's luma is averaged
+ * down to at most 160 columns and compared with a running-average background;
+ * cells that differ by more than `threshold` levels, outside the ignore mask,
+ * are cleaned up with a 3x3 opening and grouped into 8-connected blobs. When
+ * blobs of at least minAreaPermille of the frame are seen in triggerFrames
+ * consecutive frames, an lc4j_motion_event is queued (up to 64, oldest dropped)
+ * and the eventfd becomes readable; no further event is raised for
+ * holdoffFrames frames. A change of most of the frame at once, such as an
+ * exposure jump, resets the background instead. Parameters <= 0 take their
+ * defaults. The ignore mask is one byte per cell of any grid (non-zero:
+ * ignored), stretched over the frame, e.g. to leave out a water surface.
+ * lc4j_motion_process returns 1 if the frame raised an event, else 0;
+ * lc4j_motion_poll works like lc4j_writer_poll. lc4j_session_monitor_start runs
+ * the session's camera on a lores stream between captures and feeds every frame
+ * to the detector; captures on the session pause it.
+ *
+ * With a schedule set, the detector also says when the next capture is due, so
+ * that captures follow the scene rather than the clock: each frame's perceptual
+ * hash (the one a FrameStore tags frames with, ignoring the mask) is compared
+ * with that of the frame of the last scheduled event, and an event with
+ * trigger LC4J_MOTION_TRIGGER_SCENE is raised once they are more than
+ * hashDistance bits apart, at most every minIntervalMs. After maxIntervalMs
+ * without one, and on the first frame, LC4J_MOTION_TRIGGER_INTERVAL is raised
+ * instead. Scheduled events have no boxes and are not held off by motion. */
+#define LC4J_MOTION_MAX_BOXES 8
+
+#define LC4J_MOTION_TRIGGER_MOTION   0
+#define LC4J_MOTION_TRIGGER_SCENE    1
+#define LC4J_MOTION_TRIGGER_INTERVAL 2
+
+typedef struct lc4j_motion_params {
+    int32_t threshold;          /* luma difference counted as change, default 20 */
+    int32_t learnShift;         /* background learns 1/2^learnShift per frame, default 4 */
+    int32_t minAreaPermille;    /* smallest blob, default 2 */
+    int32_t triggerFrames;      /* consecutive frames with motion, default 2 */
+    int32_t holdoffFrames;      /* quiet period after an event, default 25 */
+    int32_t reserved;
+} lc4j_motion_params;
+
+typedef struct lc4j_motion_box {
+    int32_t x;                  /* in frame pixels */
+    int32_t y;
+    int32_t width;
+    int32_t height;
+} lc4j_motion_box;
+
+typedef struct lc4j_motion_event {
+    int64_t sequence;           /* of the frame that raised the event */
+    int64_t timestampNs;        /* sensor timestamp of that frame */
+    float   changedPercent;     /* of the frame area inside blobs */
+    int32_t boxCount;
+    lc4j_motion_box boxes[LC4J_MOTION_MAX_BOXES];   /* largest first */
+    int32_t trigger;            /* LC4J_MOTION_TRIGGER_* */
+    int32_t hashDistance;       /* of a scheduled event's frame from the last one's, -1 for motion */
+} lc4j_motion_event;
+
+typedef struct lc4j_scene_schedule {
+    int32_t hashDistance;       /* bits of the 64-bit hash that must change, 0-63 */
+    int32_t minIntervalMs;      /* between scene-change events at least */
+    int32_t maxIntervalMs;      /* between scheduled events at most, >= minIntervalMs */
+    int32_t reserved;
+} lc4j_scene_schedule;
+
+int64_t lc4j_motion_create(const lc4j_motion_params* params);
+void    lc4j_motion_close(int64_t handle);
+int32_t lc4j_motion_set_mask(int64_t handle, const uint8_t* mask, int32_t width, int32_t height);
+/* Sets the scene schedule, or with NULL (the default) turns it off. */
+int32_t lc4j_motion_set_schedule(int64_t handle, const lc4j_scene_schedule* schedule);
+int32_t lc4j_motion_process(int64_t handle, const void* plane, int64_t length, int32_t fourcc, int32_t width,
+                            int32_t height, int32_t stride, int64_t sequence, int64_t timestampNs);
+int32_t lc4j_motion_poll(int64_t handle, lc4j_motion_event* out, int32_t max, int32_t timeoutMs);
+int32_t lc4j_motion_eventfd(int64_t handle);
+
+/* ---- CaptureSession ----
+ * Captures a still and writes it to a file without the frame ever leaving
+ * native code: the completed buffer is encoded straight from its mapping and
+ * written atomically (parent directories are created). A session owns the
+ * process' CameraManager and the first camera until it is closed. */
+#define LC4J_CAPTURE_JPEG 1
+#define LC4J_CAPTURE_DNG  2
+
+#define LC4J_BURST_MAX_FRAMES 16
+#define LC4J_BURST_ALIGN      0x1
+
+#define LC4J_BRACKET_MAX_FRAMES 5
+#define LC4J_BRACKET_MAX_EV     4.0f
+
+#define LC4J_DENOISE_MAX_GAIN     64.0f
+#define LC4J_DENOISE_MAX_STRENGTH 16.0f
+
+typedef struct lc4j_capture_result {
+    int64_t bytes;              /* size of the written file */
+    int64_t timestampNs;        /* sensor timestamp */
+    int64_t sequence;           /* frame sequence number */
+    int64_t exposureTimeUs;
+    double  analogueGain;
+    double  digitalGain;
+    double  redGain;
+    double  blueGain;
+    double  lux;
+    int32_t colourTemperature;
+    int32_t width;              /* of the written image, after any transpose */
+    int32_t height;
+    int32_t pixelFormat;        /* fourcc of the captured stream */
+    int32_t frames;             /* merged into the image, see lc4j_session_set_burst/_bracket */
+    lc4j_frame_stats stats;     /* of the captured frame, see lc4j_session_set_stats_grid */
+    float   waterlineRow;       /* fraction of the height, -1 if not found, see lc4j_session_set_waterline */
+    float   waterlineLevel;     /* calibrated from waterlineRow */
+    float   waterlineConfidence;/* share of the region's strips agreeing on the row, 0-1 */
+    int32_t reserved;
+} lc4j_capture_result;
+
+int64_t lc4j_session_open(int32_t width, int32_t height, int32_t warmupFrames);
+void    lc4j_session_close(int64_t handle);
+void    lc4j_session_set_transform(int64_t handle, int32_t transform);
+void    lc4j_session_set_controls(int64_t handle, int32_t afMode, float lensPosition, int32_t aeEnable,
+                                  int32_t exposureUs, float analogueGain);
+/* Zone grid of the statistics of subsequent captures (default 8x8). */
+int32_t lc4j_session_set_stats_grid(int64_t handle, int32_t zonesX, int32_t zonesY);
+/* Averages `frames` consecutive frames (default 1) into each subsequent capture,
+ * lowering the noise like a longer exposure would (frame_stack.cpp). With
+ * LC4J_BURST_ALIGN each frame is first shifted to line up with the first one. */
+int32_t lc4j_session_set_burst(int64_t handle, int32_t frames, int32_t flags);
+/* Captures subsequent JPEGs as an exposure bracket: one frame per entry of
+ * evStops, exposed that many stops above (or below) the metered exposure, fused
+ * into one tone-mapped image (exposure_fusion.cpp). Takes precedence over a
+ * burst; DNG captures stay single exposures. count is 2 to LC4J_BRACKET_MAX_FRAMES,
+ * or 0 to turn it off. */
+int32_t lc4j_session_set_bracket(int64_t handle, const float* evStops, int32_t count);
+/* Denoises subsequent JPEG captures taken at an analogue gain of at least minGain
+ * with an edge-preserving filter (denoise.cpp) before they are encoded, taking out
+ * noise of strength * sqrt(gain) levels, less for bursts by the square root of
+ * their frames. Brackets and DNGs are left alone. strength 0 (the default) turns
+ * it off. */
+int32_t lc4j_session_set_denoise(int64_t handle, float minGain, float strength);
+/* Looks for the waterline in a region of subsequent YUV and RGB captures
+ * (waterline.cpp): the row where the luma of most vertical strips of the region
+ * steps, as where a post enters the water, reported in the capture result
+ * together with the level a linear calibration gives for it. Region and rows
+ * are fractions of the image as captured, after the session's transform,
+ * transposing ones included. NULL (the default) turns it off. */
+typedef struct lc4j_waterline_params {
+    float left, top, right, bottom;     /* region searched, 0-1 */
+    float row0, level0;                 /* the level at which the waterline is at row0 */
+    float row1, level1;                 /* and at row1, which differs from row0 */
+} lc4j_waterline_params;
+
+int32_t lc4j_session_set_waterline(int64_t handle, const lc4j_waterline_params* params);
+/* Finds the sharpest lens position: streams a width x height preview, steps
+ * LensPosition across the lens' range in `steps` positions and then as many
+ * again around the best of them, and measures the sharpness of a region of
+ * each (focus_measure.cpp) once the lens reports it is there, or settleFrames
+ * after asking if it does not say. The session's own settings are left as they
+ * are. -ENOTSUP if the camera has no lens control. */
+#define LC4J_FOCUS_MAX_STEPS 32
+
+typedef struct lc4j_focus_params {
+    int32_t width, height;              /* of the preview stream, 0 for 640x480 */
+    int32_t steps;                      /* per pass, 3 to LC4J_FOCUS_MAX_STEPS, 0 for 12 */
+    int32_t settleFrames;               /* 0 for 2 */
+    float left, top, right, bottom;     /* region measured in sensor orientation, 0-1, all 0 for the centre half */
+} lc4j_focus_params;
+
+typedef struct lc4j_focus_result {
+    float   bestPosition;       /* LensPosition, in dioptres */
+    float   bestSharpness;
+    int32_t afState;            /* AfState and FocusFoM reported with the sharpest frame, -1 if not */
+    int32_t focusFoM;
+    int32_t count;              /* positions measured, at most 2 * LC4J_FOCUS_MAX_STEPS */
+    int32_t reserved;
+    float   positions[2 * LC4J_FOCUS_MAX_STEPS];    /* in the order measured */
+    float   sharpness[2 * LC4J_FOCUS_MAX_STEPS];
+} lc4j_focus_result;
+
+int32_t lc4j_session_focus_sweep(int64_t handle, const lc4j_focus_params* params, lc4j_focus_result* out);
+/* Motion monitoring on a width x height stream, see MotionDetector. */
+int32_t lc4j_session_monitor_start(int64_t handle, int64_t motionHandle, int32_t width, int32_t height);
+void    lc4j_session_monitor_stop(int64_t handle);
+int32_t lc4j_capture_to_file(int64_t handle, const char* path, int32_t format, int32_t quality,
+                             lc4j_capture_result* out);
+/* Like lc4j_capture_to_file, but appends the JPEG to a FrameStore under timestampMs. */
+int32_t lc4j_capture_to_store(int64_t handle, int64_t storeHandle, int64_t timestampMs, int32_t quality,
+                              lc4j_capture_result* out);
+
+/* A thumbnail size stored alongside each captured frame. */
+typedef struct lc4j_thumbnail_tier {
+    int64_t storeHandle;        /* FrameStore receiving this tier */
+    int32_t maxSize;            /* longer side in pixels, rounded down to even */
+    int32_t quality;            /* JPEG quality */
+} lc4j_thumbnail_tier;
+
+/* Like lc4j_capture_to_store, and also appends a downscaled JPEG of the frame
+ * to each tier's store under the same timestamp. Tiers are area-averaged from
+ * the next larger one, in the frame's native pixel format. */
+int32_t lc4j_capture_to_store_tiers(int64_t handle, int64_t storeHandle, int64_t timestampMs, int32_t quality,
+                                    const lc4j_thumbnail_tier* tiers, int32_t tierCount,
+                                    lc4j_capture_result* out);
+
+/* Time spent in each stage of the session's captures (stage_latency.cpp), in
+ * nanoseconds, since it was opened or last reset. COMPLETE runs from a frame's
+ * sensor timestamp to its request completing, WAIT from there until the
+ * capture picks the request up; both count every frame, warm-up included.
+ * CONVERT is the merging of a burst or bracket and denoising, WRITE the sink
+ * of the encoded frame (file, store and thumbnails) and TOTAL the whole
+ * capture. Stages not passed through have a count of 0. */
+#define LC4J_STAGE_CONFIGURE 0
+#define LC4J_STAGE_START     1
+#define LC4J_STAGE_QUEUE     2
+#define LC4J_STAGE_COMPLETE  3
+#define LC4J_STAGE_WAIT      4
+#define LC4J_STAGE_MAP       5
+#define LC4J_STAGE_CONVERT   6
+#define LC4J_STAGE_ENCODE    7
+#define LC4J_STAGE_WRITE     8
+#define LC4J_STAGE_TOTAL     9
+#define LC4J_STAGE_COUNT     10
+
+typedef struct lc4j_stage_counter {
+    int64_t count;
+    int64_t sumNs;
+    int64_t minNs;
+    int64_t maxNs;
+} lc4j_stage_counter;
+
+typedef struct lc4j_stats {
+    lc4j_stage_counter stages[LC4J_STAGE_COUNT];
+} lc4j_stats;
+
+/* Copies the counters into *out, and clears them if reset is non-zero. */
+int32_t lc4j_stats_snapshot(int64_t handle, lc4j_stats* out, int32_t reset);
+
+/* Distributions of the latencies whose tails matter, kept next to the
+ * counters above: from queueing a request to its completion, from completion
+ * to the capture picking it up, and of whole captures, failed ones included so
+ * that request timeouts show. Log-linear buckets of microseconds: bucket i
+ * starts at i for i < 32 and at (16 + i % 16) << (i / 16 - 1) above, 16 per
+ * doubling, so a value is known to within 1/16; the last bucket also holds
+ * everything beyond. Counts add up bucket by bucket across snapshots and
+ * sessions. */
+#define LC4J_HISTOGRAM_QUEUE_TO_COMPLETE    0
+#define LC4J_HISTOGRAM_COMPLETE_TO_CONSUMER 1
+#define LC4J_HISTOGRAM_CAPTURE              2
+#define LC4J_HISTOGRAM_COUNT                3
+#define LC4J_HISTOGRAM_BUCKETS              480
+
+typedef struct lc4j_latency_histogram {
+    int64_t count;
+    int64_t maxNs;
+    uint64_t buckets[LC4J_HISTOGRAM_BUCKETS];
+} lc4j_latency_histogram;
+
+/* Copies one LC4J_HISTOGRAM_* into *out, and clears it if reset is non-zero.
+ * Returns -EINVAL for an unknown histogram. */
+int32_t lc4j_histogram_snapshot(int64_t handle, int32_t histogram, lc4j_latency_histogram* out, int32_t reset);
+
+/* Copies the frame sequence tracking (see lc4j_sequence_stats) of the stream a
+ * session last ran one LC4J_SESSION_STREAM_* on into *out, and clears it if
+ * reset is non-zero. All zero if it has not run yet. Tracking is per libcamera
+ * stream, so kinds the pipeline runs on the same stream share it; the learned
+ * intervals and delays start over when the stream's size or format changes.
+ * Returns -EINVAL for an unknown stream. */
+#define LC4J_SESSION_STREAM_CAPTURE 0
+#define LC4J_SESSION_STREAM_FOCUS   1
+#define LC4J_SESSION_STREAM_MONITOR 2
+#define LC4J_SESSION_STREAM_COUNT   3
+
+int32_t lc4j_session_sequence_stats(int64_t handle, int32_t stream, lc4j_sequence_stats* out, int32_t reset);
+
+/* ---- FrameStore ----
+ * Append-only storage for encoded frames keyed by millisecond timestamps. Each
+ * day is one segment file of concatenated frames plus an index of fixed 32-byte
+ * records; reading a frame is a single pread. Deletes only flag index records,
+ * lc4j_store_compact rewrites days whose deleted share reaches minDeadRatio
+ * (days without live frames are removed). lc4j_store_read returns the frame
+ * length, -ENOENT if there is no such frame or -ENOSPC if capacity is too small;
+ * lc4j_store_export copies a frame to a file, replacing it atomically, and
+ * returns the frame length;
+ * lc4j_store_delete returns the number of frames deleted; lc4j_store_compact the
+ * number of bytes reclaimed. */
+#define LC4J_STORE_DELETED 0x1
+#define LC4J_STORE_TAGGED  0x2
+
+typedef struct lc4j_store_record {
+    int64_t timestampMs;
+    int64_t offset;             /* in the day's segment */
+    int32_t length;
+    int32_t flags;              /* LC4J_STORE_* */
+    int64_t tag;                /* caller-defined, valid with LC4J_STORE_TAGGED */
+} lc4j_store_record;
+
+int64_t lc4j_store_open(const char* directory);
+void    lc4j_store_close(int64_t handle);
+int32_t lc4j_store_append(int64_t handle, int64_t timestampMs, const void* data, int64_t length);
+int32_t lc4j_store_find(int64_t handle, int64_t timestampMs, lc4j_store_record* out);
+int64_t lc4j_store_read(int64_t handle, int64_t timestampMs, void* buf, int64_t capacity);
+int64_t lc4j_store_export(int64_t handle, int64_t timestampMs, const char* path);
+int32_t lc4j_store_count(int64_t handle, int64_t fromMs, int64_t toMs);
+int32_t lc4j_store_list(int64_t handle, int64_t fromMs, int64_t toMs, lc4j_store_record* out, int32_t max);
+int32_t lc4j_store_delete(int64_t handle, const int64_t* timestamps, int32_t count);
+
+/* Tags. Every frame can carry one 64-bit value in its index record, such as a
+ * perceptual hash, which is kept when the frame is compacted or replaced by
+ * lc4j_store_recompress. lc4j_store_set_tags returns the number of frames
+ * tagged (unknown timestamps are ignored); lc4j_store_list_tags is
+ * lc4j_store_list with flags and tag read from the day indexes, so it costs a
+ * pread per day. lc4j_store_list and lc4j_store_find report neither. */
+int32_t lc4j_store_set_tags(int64_t handle, const int64_t* timestamps, const int64_t* tags, int32_t count);
+int32_t lc4j_store_list_tags(int64_t handle, int64_t fromMs, int64_t toMs, lc4j_store_record* out, int32_t max);
+int64_t lc4j_store_compact(int64_t handle, double minDeadRatio);
+
+/* The store keeps every live frame in one timestamp-sorted, memory-mapped
+ * index (<dir>/timeline.map). lc4j_store_index_map returns its address and
+ * mapped size in out2[0..1] so that callers can search it in place; the mapping
+ * stays at the same address until the store is closed. Appends past the last
+ * frame only publish a new count (store-release). Every other change to
+ * existing entries is bracketed by a sequence counter that is odd while the
+ * change is in progress: readers load it (acquire), read entries, fence and
+ * retry if it differs or is odd. */
+typedef struct lc4j_store_index_header {
+    char     magic[8];          /* "LC4JTML1" */
+    uint32_t version;
+    uint32_t entrySize;         /* sizeof(lc4j_store_index_entry) */
+    uint64_t count;             /* entries in use */
+    uint64_t sequence;          /* seqlock counter */
+    uint32_t clean;             /* 1 if closed cleanly, otherwise rebuilt on open */
+    uint32_t reserved0;
+    uint64_t reserved[3];
+} lc4j_store_index_header;      /* entries follow directly */
+
+typedef struct lc4j_store_index_entry {
+    int64_t  timestampMs;
+    int64_t  offset;            /* in the day's segment */
+    int32_t  length;
+    uint32_t slot;              /* record number in the day's index file */
+} lc4j_store_index_entry;
+
+int32_t lc4j_store_index_map(int64_t handle, int64_t* out2);
+
+/* Group commit. Appends return once written, without an fsync each; a
+ * background thread makes them durable together - one fdatasync per touched
+ * day file, plus a directory fsync after new days - every intervalMs, or
+ * earlier once maxBytes have been appended since the last commit (0 disables a
+ * trigger; both 0 leaves syncing to lc4j_store_sync and close). Appends are
+ * numbered as they complete, starting at 1 when the store is opened; the
+ * durable watermark is the number up to which all of them are on stable
+ * storage. The timeline is not synced, it is rebuilt after a crash. */
+typedef struct lc4j_store_durability {
+    int64_t appended;           /* appends since open */
+    int64_t durable;            /* appends 1..durable are on stable storage */
+    int64_t durableTimestampMs; /* newest timestamp among them, INT64_MIN if none */
+    int64_t pendingBytes;       /* appended, not yet committed */
+    int64_t syncs;              /* completed group commits */
+    int64_t lastSyncMs;         /* wall-clock time of the last commit, 0 if none */
+    int64_t lastSyncNs;         /* duration of the last commit */
+    int32_t lastError;          /* negative errno if the last commit failed, else 0 */
+    int32_t reserved;
+} lc4j_store_durability;
+
+int32_t lc4j_store_set_group_commit(int64_t handle, int32_t intervalMs, int64_t maxBytes);
+int32_t lc4j_store_sync(int64_t handle);
+int32_t lc4j_store_get_durability(int64_t handle, lc4j_store_durability* out);
+
+/* Recompression (recompressor.cpp). Re-encodes the JPEG frames with timestamps
+ * in [fromMs, toMs] at `quality`, decoded at the smallest libjpeg DCT scale n/8
+ * that keeps them at least maxWidth wide (0 keeps the size), and replaces each
+ * one in place if that made it smaller. Output is marked with a JPEG comment;
+ * marked frames, and frames replaced or deleted meanwhile, are skipped. The
+ * freed space is reclaimed by lc4j_store_compact. The work runs on a thread of
+ * its own at idle CPU and I/O priority; the call returns when it is done. */
+typedef struct lc4j_recompress_result {
+    int32_t recompressed;
+    int32_t skipped;            /* already recompressed, not smaller or changed */
+    int32_t failed;             /* not decodable */
+    int32_t reserved;
+    int64_t bytesBefore;        /* of the recompressed frames */
+    int64_t bytesAfter;
+} lc4j_recompress_result;
+
+int32_t lc4j_store_recompress(int64_t handle, int64_t fromMs, int64_t toMs, int32_t maxWidth, int32_t quality,
+                              lc4j_recompress_result* out);
+
+/* Perceptual hashes (frame_hasher.cpp). Frames stored by lc4j_capture_to_store
+ * are tagged with a 64-bit difference hash of their luma; the Hamming distance
+ * of two hashes says how different the images look (0-64, small is similar).
+ * lc4j_store_hash_frames tags the untagged JPEG frames in [fromMs, toMs] with
+ * the same hash, decoding them at 1/8 scale, and returns how many it tagged. */
+int32_t lc4j_store_hash_frames(int64_t handle, int64_t fromMs, int64_t toMs);
+
+/* ---- DirScanner ----
+ * Lists the images of a <root>/yyyy/MM/dd/yyyyMMdd_HHmmss.jpg tree, the layout
+ * used before the frame store. Day directories are read in parallel with
+ * openat/getdents64 (threads <= 0: one per CPU) and file names, local time,
+ * are parsed into milliseconds since the epoch; anything else in the tree is
+ * skipped. The scan handle holds the entries sorted by timestamp and the day
+ * directories (relative to root) they refer to. */
+typedef struct lc4j_scan_entry {
+    int64_t timestampMs;
+    int64_t size;               /* file size in bytes */
+    int32_t dirId;              /* see lc4j_scan_dir */
+    int32_t reserved;
+} lc4j_scan_entry;
+
+int64_t lc4j_scan_open(const char* root, int32_t threads);
+void    lc4j_scan_close(int64_t handle);
+int32_t lc4j_scan_count(int64_t handle);
+int32_t lc4j_scan_entries(int64_t handle, lc4j_scan_entry* out, int32_t max);
+int32_t lc4j_scan_dir_count(int64_t handle);
+int32_t lc4j_scan_dir(int64_t handle, int32_t dirId, char* buf, int32_t buflen);
+
+/* ---- FrameExport ----
+ * Publishes the latest captured frames in a POSIX shared-memory object
+ * (/dev/shm/<name>) that other processes map read-only. The object is a header
+ * followed by slotCount slots of slotSize bytes; each slot is an
+ * lc4j_export_slot followed by its data: the frame's planes as captured, copied
+ * row for row, and its JPEG encoding. Frames are written round-robin, frame n
+ * (counting from 1) to slot (n - 1) % slotCount, and `published` is raised to n
+ * (store-release) once the slot is complete. Each slot's sequence counter is
+ * odd while it is being written: readers load it (acquire), read the slot, fence
+ * and start over if it differs or was odd. A reader thus has slotCount - 1 frame
+ * intervals to read a slot in place before it is reused.
+ *
+ * While an export is open, every frame captured by a capture session of this
+ * process is published to it; lc4j_export_publish adds JPEGs encoded
+ * elsewhere. lc4j_export_attach maps an existing export read-only, and
+ * lc4j_export_map returns the mapping's address and size in out2[0..1] for
+ * either kind of handle. Opening an export replaces any object left under its
+ * name with a new one and closing it unlinks it; processes that still have the
+ * old one mapped keep reading its last frames until they attach again. */
+#define LC4J_EXPORT_RAW  0x1            /* publish captured planes */
+#define LC4J_EXPORT_JPEG 0x2            /* publish JPEG encodings */
+
+typedef struct lc4j_export_header {
+    char     magic[8];          /* "LC4JEXP1" */
+    uint32_t version;
+    uint32_t slotCount;
+    uint64_t slotSize;          /* bytes per slot, lc4j_export_slot included */
+    uint64_t published;         /* frames published so far */
+    uint32_t flags;             /* LC4J_EXPORT_* */
+    uint32_t reserved0;
+    uint64_t reserved[3];
+} lc4j_export_header;           /* slots follow directly */
+
+typedef struct lc4j_export_slot {
+    uint64_t sequence;          /* seqlock counter */
+    uint64_t number;            /* publish number of the frame, from 1 */
+    int64_t  timestampNs;       /* sensor timestamp, 0 if unknown */
+    int64_t  frameSequence;     /* camera frame sequence, 0 if unknown */
+    uint32_t fourcc;            /* of the planes, 0 if none were published */
+    int32_t  width;             /* of the planes */
+    int32_t  height;
+    int32_t  strides[3];
+    int64_t  planeOffsets[3];   /* from the start of the slot's data, -1 if absent */
+    int64_t  rawBytes;          /* all planes */
+    int32_t  jpegWidth;         /* after the session's transform */
+    int32_t  jpegHeight;
+    int64_t  jpegOffset;        /* from the start of the slot's data */
+    int64_t  jpegBytes;         /* 0 if no JPEG was published */
+    int64_t  publishedMs;       /* wall-clock time of publishing */
+    int64_t  reserved;
+} lc4j_export_slot;             /* slot data follows directly */
+
+int64_t lc4j_export_open(const char* name, int32_t slotCount, int64_t slotSize, int32_t flags);
+int64_t lc4j_export_attach(const char* name);
+void    lc4j_export_close(int64_t handle);
+int32_t lc4j_export_map(int64_t handle, int64_t* out2);
+int32_t lc4j_export_publish(int64_t handle, int64_t timestampNs, int32_t width, int32_t height,
+                            const void* jpeg, int64_t length);
+
+/* ---- FrameServer ----
+ * Hands the dmabufs of captured frames to subscriber processes without
+ * copying them. The server listens on a SOCK_SEQPACKET Unix socket at `path`.
+ * For every YUV frame a capture session completes, each subscriber receives
+ * one lc4j_served_frame message carrying the frame's dmabuf fds (SCM_RIGHTS,
+ * in the order the planes' fdIndex refers to); it maps them read-only, and
+ * when done closes them and sends the frame's token back as an
+ * lc4j_frame_release message. The camera driver's buffers are a scarce pool,
+ * so a subscriber that holds maxOutstanding frames gets no further frames
+ * until it releases one. Subscribers that disconnect release everything.
+ * lc4j_server_subscribers returns the number connected. */
+#define LC4J_SERVED_FRAME_MAGIC 0x4d52464a   /* "JFRM" */
+
+typedef struct lc4j_served_plane {
+    int32_t  fdIndex;           /* into the fds of the message */
+    int32_t  stride;
+    uint32_t offset;            /* into the dmabuf */
+    uint32_t length;
+} lc4j_served_plane;
+
+typedef struct lc4j_served_frame {
+    uint32_t magic;             /* LC4J_SERVED_FRAME_MAGIC */
+    uint32_t planeCount;
+    uint64_t token;             /* send back to release the frame */
+    int64_t  timestampNs;       /* sensor timestamp */
+    int64_t  sequence;          /* camera frame sequence */
+    uint32_t fourcc;
+    int32_t  width;
+    int32_t  height;
+    int32_t  fdCount;
+    lc4j_served_plane planes[3];
+} lc4j_served_frame;
+
+typedef struct lc4j_frame_release {
+    uint64_t token;
+} lc4j_frame_release;
+
+int64_t lc4j_server_open(const char* path, int32_t maxOutstanding);
+void    lc4j_server_close(int64_t handle);
+int32_t lc4j_server_subscribers(int64_t handle);
+
+/* ---- DngStream ----
+ * A raw capture read out as a DNG in pieces, for sending it somewhere without
+ * ever holding the whole file. lc4j_capture_to_dng_stream captures like
+ * lc4j_capture_to_file with LC4J_CAPTURE_DNG, but keeps only the packed sensor
+ * rows and stores a stream handle in *streamOut (out->bytes is the DNG size);
+ * each lc4j_dng_stream_read then fills up to capacity bytes of the next part of
+ * the file, unpacking rows as it goes, and returns how many it wrote (0 at the
+ * end). The bytes are the same as the file lc4j_capture_to_file writes. */
+int32_t lc4j_capture_to_dng_stream(int64_t handle, int64_t* streamOut, lc4j_capture_result* out);
+int64_t lc4j_dng_stream_size(int64_t handle);
+int64_t lc4j_dng_stream_read(int64_t handle, void* buffer, int64_t capacity);
+void    lc4j_dng_stream_close(int64_t handle);
+
+/* ---- Timelapse frames ----
+ * Reads the frames of a timelapse from a FrameStore in order, correcting them
+ * on their way to the video encoder (timelapse_frames.cpp). With
+ * LC4J_TIMELAPSE_DEFLICKER the brightness of each frame is evened out against
+ * the deflickerWindow frames around it: their mean luma is measured at 1/8
+ * scale, and the frame's luma is pulled towards the geometric mean of the
+ * window by a power-law tone curve. With LC4J_TIMELAPSE_STABILIZE the shake of
+ * the camera is taken out: the rotation and shift from each frame to the next
+ * are registered on downscaled luma, and every frame is warped to the mean
+ * path of the view over the stabilizeWindow frames around it, the uncovered
+ * border repeating the edge. Corrected frames are re-encoded at `quality`;
+ * changes slower than the windows pass through, and corrections are limited
+ * to what flicker and shake can explain. Only the measurements of the windows
+ * and a few frames are kept, so memory does not grow with the length of the
+ * range. Frames are measured and corrected a batch at a time on several
+ * threads. Frames that need no correction keep their stored bytes.
+ *
+ * lc4j_timelapse_next prepares the next frame and returns its size, 0 after the
+ * last one; frames that can no longer be read are skipped. lc4j_timelapse_read
+ * copies the prepared frame out and returns its size, or -ENOSPC if capacity is
+ * too small. Returns 0 from lc4j_timelapse_open if the parameters are invalid. */
+#define LC4J_TIMELAPSE_DEFLICKER    0x1
+#define LC4J_TIMELAPSE_STABILIZE    0x2
+#define LC4J_TIMELAPSE_MAX_WINDOW   61
+
+typedef struct lc4j_timelapse_params {
+    int32_t flags;              /* LC4J_TIMELAPSE_* */
+    int32_t quality;            /* JPEG quality of corrected frames */
+    int32_t deflickerWindow;    /* frames, odd, 3 to LC4J_TIMELAPSE_MAX_WINDOW */
+    int32_t stabilizeWindow;    /* frames, odd, 3 to LC4J_TIMELAPSE_MAX_WINDOW */
+} lc4j_timelapse_params;
+
+int64_t lc4j_timelapse_open(int64_t storeHandle, const int64_t* timestamps, int32_t count,
+                            const lc4j_timelapse_params* params);
+int64_t lc4j_timelapse_next(int64_t handle);
+int64_t lc4j_timelapse_read(int64_t handle, void* buffer, int64_t capacity);
+void    lc4j_timelapse_close(int64_t handle);
+
 #ifdef __cplusplus
 }
 #endif
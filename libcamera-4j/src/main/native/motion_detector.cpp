@@ -0,0 +1,616 @@
+/*
+ * libcamera4j - motion detection on a low-resolution stream.
+ *
+ * A camera that only captures on a fixed schedule misses whatever happens in
+ * between, and capturing full-resolution frames continuously just to compare
+ * them is far too expensive on a Pi. The detector instead looks at a small
+ * stream (320x240 or so), averaged further down to a grid of at most 160x160
+ * cells, and keeps a running-average background of it in 8.8 fixed point.
+ * Cells that differ from the background are opened with a 3x3 erode and dilate
+ * to drop sensor noise and rippling single cells, and what is left is grouped
+ * into 8-connected blobs. Blobs large enough in a few consecutive frames raise
+ * an event, which Java picks up through lc4j_motion_poll or, from a poll loop
+ * of its own, the detector's eventfd.
+ *
+ * The same stream can also schedule the captures: each frame's perceptual
+ * hash is compared with that of the frame at the last scheduled event, and a
+ * new one is raised when the scene has changed as much as the nightly thinning
+ * of the timelapse would keep, or when it has not for too long. A still night
+ * then stores a frame every few minutes instead of every few seconds.
+ *
+ * The whole pass is a few hundred microseconds, so it runs on the thread that
+ * delivers the frames.
+ */
+
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <bitset>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace {
+
+static_assert(sizeof(lc4j_motion_params) == 24, "lc4j_motion_params layout");
+static_assert(sizeof(lc4j_motion_event) == 160, "lc4j_motion_event layout");
+static_assert(sizeof(lc4j_scene_schedule) == 16, "lc4j_scene_schedule layout");
+
+constexpr int64_t kNsPerMs = 1000000;
+
+constexpr int32_t kMaxGridSide = 160;
+constexpr int32_t kMinGridSide = 3;
+constexpr size_t kMaxQueuedEvents = 64;
+
+constexpr int32_t kDefaultThreshold = 20;
+constexpr int32_t kDefaultLearnShift = 4;
+constexpr int32_t kDefaultMinAreaPermille = 2;
+constexpr int32_t kDefaultTriggerFrames = 2;
+constexpr int32_t kDefaultHoldoffFrames = 25;
+
+// Cells under motion learn this much slower, so a slow walker is not absorbed
+// into the background before the event triggers.
+constexpr int32_t kForegroundLearnPenalty = 2;
+
+struct Blob {
+    int32_t minX, minY, maxX, maxY;
+    int32_t area;
+};
+
+class MotionDetector {
+public:
+    explicit MotionDetector(const lc4j_motion_params* params) {
+        if (params != nullptr) {
+            params_ = *params;
+        }
+        auto orDefault = [](int32_t& value, int32_t fallback) {
+            if (value <= 0) {
+                value = fallback;
+            }
+        };
+        orDefault(params_.threshold, kDefaultThreshold);
+        orDefault(params_.learnShift, kDefaultLearnShift);
+        orDefault(params_.minAreaPermille, kDefaultMinAreaPermille);
+        orDefault(params_.triggerFrames, kDefaultTriggerFrames);
+        orDefault(params_.holdoffFrames, kDefaultHoldoffFrames);
+        params_.learnShift = std::min(params_.learnShift, 8);
+        eventFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+
+    ~MotionDetector() {
+        if (eventFd_ >= 0) {
+            ::close(eventFd_);
+        }
+    }
+
+    MotionDetector(const MotionDetector&) = delete;
+    MotionDetector& operator=(const MotionDetector&) = delete;
+
+    int eventFd() const {
+        return eventFd_;
+    }
+
+    int32_t setMask(const uint8_t* mask, int32_t width, int32_t height) {
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        if (mask == nullptr) {
+            mask_.clear();
+            maskWidth_ = maskHeight_ = 0;
+        } else {
+            mask_.assign(mask, mask + static_cast<size_t>(width) * height);
+            maskWidth_ = width;
+            maskHeight_ = height;
+        }
+        resampleMask();
+        return 0;
+    }
+
+    int32_t setSchedule(const lc4j_scene_schedule* schedule) {
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        scheduled_ = schedule != nullptr;
+        if (scheduled_) {
+            schedule_ = *schedule;
+        }
+        // The next frame is due
+        haveReference_ = false;
+        return 0;
+    }
+
+    int32_t process(const lc4j::FrameView& frame, int64_t sequence, int64_t timestampNs) {
+        int32_t offset;
+        int32_t step;
+        if (!lc4j::lumaSampling(frame.fourcc, offset, step)) {
+            return -ENOTSUP;
+        }
+        const int32_t factor = std::max((frame.width + kMaxGridSide - 1) / kMaxGridSide,
+                                        (frame.height + kMaxGridSide - 1) / kMaxGridSide);
+        const int32_t gridW = frame.width / factor;
+        const int32_t gridH = frame.height / factor;
+        if (gridW < kMinGridSide || gridH < kMinGridSide) {
+            return -EINVAL;
+        }
+
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        // Whatever the motion detection makes of the frame
+        const int32_t raised = scheduled_ && schedule(frame, sequence, timestampNs) ? 1 : 0;
+        const bool reseed = gridW != gridW_ || gridH != gridH_ || factor != factor_;
+        if (reseed) {
+            gridW_ = gridW;
+            gridH_ = gridH;
+            factor_ = factor;
+            const size_t cells = static_cast<size_t>(gridW) * gridH;
+            current_.assign(cells, 0);
+            background_.assign(cells, 0);
+            changed_.assign(cells, 0);
+            opened_.assign(cells, 0);
+            labels_.assign(cells, 0);
+            resampleMask();
+            consecutive_ = 0;
+            holdoff_ = 0;
+        }
+        average(frame, offset, step);
+        if (reseed) {
+            seedBackground();
+            return raised;
+        }
+
+        // Cells that differ from the background, outside the mask
+        const int32_t threshold = params_.threshold;
+        int32_t changedCount = 0;
+        int32_t considered = 0;
+        for (size_t i = 0; i < current_.size(); ++i) {
+            if (!maskGrid_.empty() && maskGrid_[i]) {
+                changed_[i] = 0;
+                continue;
+            }
+            considered++;
+            changed_[i] = std::abs(static_cast<int32_t>(current_[i]) - (background_[i] >> 8)) > threshold;
+            changedCount += changed_[i];
+        }
+        // Most of the frame changing at once is light, not motion
+        if (considered == 0 || changedCount * 2 > considered) {
+            seedBackground();
+            consecutive_ = 0;
+            return raised;
+        }
+        learn();
+        open();
+        std::vector<Blob> blobs;
+        label(blobs);
+
+        const int64_t gridArea = static_cast<int64_t>(gridW_) * gridH_;
+        const int64_t minArea = std::max<int64_t>(1, (gridArea * params_.minAreaPermille + 999) / 1000);
+        blobs.erase(std::remove_if(blobs.begin(), blobs.end(),
+                                   [minArea](const Blob& b) { return b.area < minArea; }),
+                    blobs.end());
+        // The holdoffFrames frames after an event raise none
+        const bool heldOff = holdoff_ > 0;
+        if (heldOff) {
+            holdoff_--;
+        }
+        if (blobs.empty()) {
+            consecutive_ = 0;
+            return raised;
+        }
+        consecutive_++;
+        if (consecutive_ < params_.triggerFrames || heldOff) {
+            return raised;
+        }
+        consecutive_ = 0;
+        holdoff_ = params_.holdoffFrames;
+
+        std::sort(blobs.begin(), blobs.end(), [](const Blob& a, const Blob& b) { return a.area > b.area; });
+        lc4j_motion_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.trigger = LC4J_MOTION_TRIGGER_MOTION;
+        event.hashDistance = -1;
+        event.sequence = sequence;
+        event.timestampNs = timestampNs;
+        int64_t area = 0;
+        for (const Blob& blob : blobs) {
+            area += blob.area;
+        }
+        event.changedPercent = static_cast<float>(100.0 * area / gridArea);
+        event.boxCount = static_cast<int32_t>(std::min<size_t>(blobs.size(), LC4J_MOTION_MAX_BOXES));
+        for (int32_t i = 0; i < event.boxCount; ++i) {
+            const Blob& blob = blobs[i];
+            lc4j_motion_box& box = event.boxes[i];
+            box.x = blob.minX * factor_;
+            box.y = blob.minY * factor_;
+            box.width = std::min(frame.width - box.x, (blob.maxX - blob.minX + 1) * factor_);
+            box.height = std::min(frame.height - box.y, (blob.maxY - blob.minY + 1) * factor_);
+        }
+        raise(event);
+        return 1;
+    }
+
+    int32_t poll(lc4j_motion_event* out, int32_t max, int32_t timeoutMs) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto ready = [this] { return !events_.empty() || closed_; };
+        if (timeoutMs < 0) {
+            eventsCv_.wait(lock, ready);
+        } else if (timeoutMs > 0) {
+            eventsCv_.wait_for(lock, std::chrono::milliseconds(timeoutMs), ready);
+        }
+        if (events_.empty()) {
+            return closed_ ? -1 : 0;
+        }
+        int32_t n = 0;
+        while (n < max && !events_.empty()) {
+            out[n++] = events_.front();
+            events_.pop_front();
+        }
+        if (events_.empty() && eventFd_ >= 0) {
+            // Drained: make the eventfd unreadable again
+            uint64_t count;
+            (void) !::read(eventFd_, &count, sizeof(count));
+        }
+        return n;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        eventsCv_.notify_all();
+    }
+
+private:
+    lc4j_motion_params params_{};
+    int eventFd_ = -1;
+
+    // Detection state, guarded by stateMutex_
+    std::mutex stateMutex_;
+    int32_t gridW_ = 0;
+    int32_t gridH_ = 0;
+    int32_t factor_ = 0;
+    std::vector<uint8_t> current_;
+    std::vector<uint16_t> background_;      // 8.8 fixed point
+    std::vector<uint8_t> changed_;
+    std::vector<uint8_t> opened_;
+    std::vector<int32_t> labels_;
+    std::vector<uint8_t> mask_;             // as given, any size
+    int32_t maskWidth_ = 0;
+    int32_t maskHeight_ = 0;
+    std::vector<uint8_t> maskGrid_;         // resampled to the grid, empty if none
+    int32_t consecutive_ = 0;
+    int32_t holdoff_ = 0;
+    bool scheduled_ = false;
+    lc4j_scene_schedule schedule_{};
+    bool haveReference_ = false;
+    uint64_t referenceHash_ = 0;
+    int64_t referenceNs_ = 0;
+
+    // Event queue, guarded by mutex_
+    std::mutex mutex_;
+    std::condition_variable eventsCv_;
+    std::deque<lc4j_motion_event> events_;
+    bool closed_ = false;
+
+    void resampleMask() {
+        maskGrid_.clear();
+        if (mask_.empty() || gridW_ == 0) {
+            return;
+        }
+        maskGrid_.resize(static_cast<size_t>(gridW_) * gridH_);
+        for (int32_t gy = 0; gy < gridH_; ++gy) {
+            const int32_t my = static_cast<int32_t>((2 * static_cast<int64_t>(gy) + 1) * maskHeight_ / (2 * gridH_));
+            for (int32_t gx = 0; gx < gridW_; ++gx) {
+                const int32_t mx = static_cast<int32_t>((2 * static_cast<int64_t>(gx) + 1) * maskWidth_
+                                                        / (2 * gridW_));
+                maskGrid_[static_cast<size_t>(gy) * gridW_ + gx] =
+                        mask_[static_cast<size_t>(my) * maskWidth_ + mx] != 0;
+            }
+        }
+    }
+
+    // Box-averages the luma of the frame into current_.
+    void average(const lc4j::FrameView& frame, int32_t offset, int32_t step) {
+        std::vector<uint32_t> sums(gridW_);
+        const uint32_t count = static_cast<uint32_t>(factor_) * factor_;
+        for (int32_t gy = 0; gy < gridH_; ++gy) {
+            std::fill(sums.begin(), sums.end(), 0);
+            for (int32_t dy = 0; dy < factor_; ++dy) {
+                const uint8_t* row = frame.planes[0]
+                                   + static_cast<size_t>(gy * factor_ + dy) * frame.strides[0] + offset;
+                for (int32_t gx = 0; gx < gridW_; ++gx) {
+                    const uint8_t* p = row + static_cast<size_t>(gx) * factor_ * step;
+                    uint32_t sum = 0;
+                    for (int32_t dx = 0; dx < factor_; ++dx) {
+                        sum += p[static_cast<size_t>(dx) * step];
+                    }
+                    sums[gx] += sum;
+                }
+            }
+            uint8_t* out = current_.data() + static_cast<size_t>(gy) * gridW_;
+            for (int32_t gx = 0; gx < gridW_; ++gx) {
+                out[gx] = static_cast<uint8_t>((sums[gx] + count / 2) / count);
+            }
+        }
+    }
+
+    void seedBackground() {
+        for (size_t i = 0; i < current_.size(); ++i) {
+            background_[i] = static_cast<uint16_t>(current_[i] << 8);
+        }
+    }
+
+    void learn() {
+        for (size_t i = 0; i < current_.size(); ++i) {
+            const int32_t shift = params_.learnShift + (changed_[i] ? kForegroundLearnPenalty : 0);
+            const int32_t delta = (static_cast<int32_t>(current_[i]) << 8) - background_[i];
+            // Arithmetic shift rounds towards minus infinity; keep it symmetric
+            const int32_t step = delta >= 0 ? delta >> shift : -((-delta) >> shift);
+            background_[i] = static_cast<uint16_t>(background_[i] + step);
+        }
+    }
+
+    // 3x3 erode of changed_ into opened_, then 3x3 dilate back into changed_.
+    void open() {
+        const int32_t w = gridW_;
+        const int32_t h = gridH_;
+        for (int32_t y = 0; y < h; ++y) {
+            for (int32_t x = 0; x < w; ++x) {
+                uint8_t all = 1;
+                for (int32_t dy = -1; dy <= 1 && all; ++dy) {
+                    const int32_t yy = std::clamp(y + dy, 0, h - 1);
+                    for (int32_t dx = -1; dx <= 1; ++dx) {
+                        const int32_t xx = std::clamp(x + dx, 0, w - 1);
+                        if (!changed_[static_cast<size_t>(yy) * w + xx]) {
+                            all = 0;
+                            break;
+                        }
+                    }
+                }
+                opened_[static_cast<size_t>(y) * w + x] = all;
+            }
+        }
+        for (int32_t y = 0; y < h; ++y) {
+            for (int32_t x = 0; x < w; ++x) {
+                uint8_t any = 0;
+                for (int32_t dy = -1; dy <= 1 && !any; ++dy) {
+                    const int32_t yy = std::clamp(y + dy, 0, h - 1);
+                    for (int32_t dx = -1; dx <= 1; ++dx) {
+                        const int32_t xx = std::clamp(x + dx, 0, w - 1);
+                        if (opened_[static_cast<size_t>(yy) * w + xx]) {
+                            any = 1;
+                            break;
+                        }
+                    }
+                }
+                changed_[static_cast<size_t>(y) * w + x] = any;
+            }
+        }
+    }
+
+    // 8-connected components of changed_.
+    void label(std::vector<Blob>& blobs) {
+        const int32_t w = gridW_;
+        const int32_t h = gridH_;
+        std::fill(labels_.begin(), labels_.end(), 0);
+        std::vector<int32_t> stack;
+        for (int32_t start = 0; start < w * h; ++start) {
+            if (!changed_[start] || labels_[start] != 0) {
+                continue;
+            }
+            const int32_t id = static_cast<int32_t>(blobs.size()) + 1;
+            Blob blob{start % w, start / w, start % w, start / w, 0};
+            labels_[start] = id;
+            stack.push_back(start);
+            while (!stack.empty()) {
+                const int32_t cell = stack.back();
+                stack.pop_back();
+                const int32_t cx = cell % w;
+                const int32_t cy = cell / w;
+                blob.area++;
+                blob.minX = std::min(blob.minX, cx);
+                blob.maxX = std::max(blob.maxX, cx);
+                blob.minY = std::min(blob.minY, cy);
+                blob.maxY = std::max(blob.maxY, cy);
+                for (int32_t dy = -1; dy <= 1; ++dy) {
+                    for (int32_t dx = -1; dx <= 1; ++dx) {
+                        const int32_t nx = cx + dx;
+                        const int32_t ny = cy + dy;
+                        if (nx < 0 || ny < 0 || nx >= w || ny >= h) {
+                            continue;
+                        }
+                        const int32_t next = ny * w + nx;
+                        if (changed_[next] && labels_[next] == 0) {
+                            labels_[next] = id;
+                            stack.push_back(next);
+                        }
+                    }
+                }
+            }
+            blobs.push_back(blob);
+        }
+    }
+
+    // Raises a scheduled event if the frame is due, and makes it the reference
+    // for the next.
+    bool schedule(const lc4j::FrameView& frame, int64_t sequence, int64_t timestampNs) {
+        uint64_t hash;
+        if (lc4j::perceptualHash(frame, 0, hash) != 0) {
+            return false;
+        }
+        const int32_t distance = haveReference_
+                                 ? static_cast<int32_t>(std::bitset<64>(hash ^ referenceHash_).count()) : 64;
+        // Timestamps going back, as after a restarted stream, count as overdue
+        const int64_t elapsed = timestampNs - referenceNs_;
+        int32_t trigger;
+        if (!haveReference_ || elapsed < 0 || elapsed >= schedule_.maxIntervalMs * kNsPerMs) {
+            trigger = LC4J_MOTION_TRIGGER_INTERVAL;
+        } else if (distance > schedule_.hashDistance && elapsed >= schedule_.minIntervalMs * kNsPerMs) {
+            trigger = LC4J_MOTION_TRIGGER_SCENE;
+        } else {
+            return false;
+        }
+        haveReference_ = true;
+        referenceHash_ = hash;
+        referenceNs_ = timestampNs;
+
+        lc4j_motion_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.sequence = sequence;
+        event.timestampNs = timestampNs;
+        event.trigger = trigger;
+        event.hashDistance = distance;
+        raise(event);
+        return true;
+    }
+
+    void raise(const lc4j_motion_event& event) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (events_.size() >= kMaxQueuedEvents) {
+            events_.pop_front();
+        }
+        events_.push_back(event);
+        if (eventFd_ >= 0) {
+            const uint64_t one = 1;
+            (void) !::write(eventFd_, &one, sizeof(one));
+        }
+        eventsCv_.notify_all();
+    }
+};
+
+std::mutex g_detectorsMutex;
+std::map<int64_t, std::shared_ptr<MotionDetector>> g_detectors;
+
+std::shared_ptr<MotionDetector> findDetector(int64_t handle) {
+    std::lock_guard<std::mutex> lock(g_detectorsMutex);
+    auto it = g_detectors.find(handle);
+    return it == g_detectors.end() ? nullptr : it->second;
+}
+
+} // namespace
+
+int32_t lc4j::motionProcess(int64_t handle, const FrameView& frame, int64_t sequence, int64_t timestampNs) {
+    auto detector = findDetector(handle);
+    if (!detector) {
+        return -1;
+    }
+    if (frame.planes[0] == nullptr) {
+        return -EINVAL;
+    }
+    try {
+        return detector->process(frame, sequence, timestampNs);
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// MotionDetector
+// -----------------------------------------------------------------------------
+
+extern "C" {
+
+int64_t lc4j_motion_create(const lc4j_motion_params* params) {
+    try {
+        auto detector = std::make_shared<MotionDetector>(params);
+        if (detector->eventFd() < 0) {
+            return 0;
+        }
+        int64_t handle = lc4j::allocHandle();
+        std::lock_guard<std::mutex> lock(g_detectorsMutex);
+        g_detectors[handle] = std::move(detector);
+        return handle;
+    } catch (const std::exception&) {
+        return 0;
+    }
+}
+
+void lc4j_motion_close(int64_t handle) {
+    std::shared_ptr<MotionDetector> detector;
+    {
+        std::lock_guard<std::mutex> lock(g_detectorsMutex);
+        auto it = g_detectors.find(handle);
+        if (it == g_detectors.end()) {
+            return;
+        }
+        detector = it->second;
+        g_detectors.erase(it);
+    }
+    // Wakes pollers; whoever still holds a reference keeps the eventfd open
+    detector->close();
+}
+
+int32_t lc4j_motion_set_mask(int64_t handle, const uint8_t* mask, int32_t width, int32_t height) {
+    if (mask != nullptr && (width <= 0 || height <= 0)) {
+        return -EINVAL;
+    }
+    auto detector = findDetector(handle);
+    if (!detector) {
+        return -1;
+    }
+    try {
+        return detector->setMask(mask, width, height);
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+}
+
+int32_t lc4j_motion_set_schedule(int64_t handle, const lc4j_scene_schedule* schedule) {
+    if (schedule != nullptr && (schedule->hashDistance < 0 || schedule->hashDistance > 63
+                                || schedule->minIntervalMs < 0 || schedule->maxIntervalMs < schedule->minIntervalMs)) {
+        return -EINVAL;
+    }
+    auto detector = findDetector(handle);
+    if (!detector) {
+        return -1;
+    }
+    return detector->setSchedule(schedule);
+}
+
+int32_t lc4j_motion_process(int64_t handle, const void* plane, int64_t length, int32_t fourcc, int32_t width,
+                            int32_t height, int32_t stride, int64_t sequence, int64_t timestampNs) {
+    if (plane == nullptr || width <= 0 || height <= 0 || stride <= 0) {
+        return -EINVAL;
+    }
+    int32_t offset;
+    int32_t step;
+    if (!lc4j::lumaSampling(static_cast<uint32_t>(fourcc), offset, step)) {
+        return -ENOTSUP;
+    }
+    // The last luma sample must lie within the plane
+    const int64_t needed = static_cast<int64_t>(height - 1) * stride + offset
+                         + static_cast<int64_t>(width - 1) * step + 1;
+    if (length < needed) {
+        return -EINVAL;
+    }
+    lc4j::FrameView frame;
+    frame.fourcc = static_cast<uint32_t>(fourcc);
+    frame.width = width;
+    frame.height = height;
+    frame.planes[0] = static_cast<const uint8_t*>(plane);
+    frame.strides[0] = stride;
+    return lc4j::motionProcess(handle, frame, sequence, timestampNs);
+}
+
+int32_t lc4j_motion_poll(int64_t handle, lc4j_motion_event* out, int32_t max, int32_t timeoutMs) {
+    if (out == nullptr || max <= 0) {
+        return -1;
+    }
+    auto detector = findDetector(handle);
+    if (!detector) {
+        return -1;
+    }
+    return detector->poll(out, max, timeoutMs);
+}
+
+int32_t lc4j_motion_eventfd(int64_t handle) {
+    auto detector = findDetector(handle);
+    return detector ? detector->eventFd() : -1;
+}
+
+} // extern "C"
@@ -0,0 +1,139 @@
+/*
+ * libcamera4j - background re-encoding of aging frames in a frame store.
+ *
+ * Timelapse frames are kept at capture quality forever unless they are thinned
+ * out. Old ones are rarely looked at closely, so re-encoding them at a lower
+ * quality and resolution frees most of their space. A pass lists the frames of
+ * a time range, decodes each one at a reduced DCT scale (the IDCT does the
+ * downscaling, which is far cheaper than decoding at full size and scaling) and
+ * swaps the smaller encoding into the store with a conditional replace, so a
+ * frame deleted or compacted concurrently is left alone. The pass runs on its
+ * own thread with idle CPU and I/O priority so that captures and the web UI are
+ * not slowed down by it; the caller just waits.
+ */
+
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int32_t kListBatch = 256;
+
+// From linux/ioprio.h, which not every toolchain ships
+constexpr int kIoprioWhoProcess = 1;
+constexpr int kIoprioClassIdle = 3;
+constexpr int kIoprioClassShift = 13;
+
+// Lowers the calling thread to nice 19 and the idle I/O class. On Linux both
+// apply to the thread only, not to the whole JVM. Best effort.
+void lowerThreadPriority() {
+    const auto tid = static_cast<id_t>(syscall(SYS_gettid));
+    setpriority(PRIO_PROCESS, tid, 19);
+    syscall(SYS_ioprio_set, kIoprioWhoProcess, 0, kIoprioClassIdle << kIoprioClassShift);
+}
+
+int32_t recompressRange(int64_t storeHandle, int64_t fromMs, int64_t toMs, int32_t maxWidth, int32_t quality,
+                        lc4j_recompress_result& result) {
+    std::vector<lc4j_store_record> records(kListBatch);
+    std::vector<uint8_t> frame;
+    std::vector<uint8_t> encoded;
+    int64_t next = fromMs;
+    while (next <= toMs) {
+        int32_t n = lc4j_store_list(storeHandle, next, toMs, records.data(), kListBatch);
+        if (n <= 0) {
+            return n;
+        }
+        for (int32_t i = 0; i < n; ++i) {
+            const lc4j_store_record& record = records[i];
+            frame.resize(static_cast<size_t>(record.length));
+            int64_t length = lc4j_store_read(storeHandle, record.timestampMs, frame.data(), record.length);
+            if (length == -1) {
+                return -1;   // store closed
+            }
+            if (length != record.length) {
+                result.skipped++;   // replaced or deleted since it was listed
+                continue;
+            }
+            int32_t ret = lc4j::recompressJpeg(frame.data(), frame.size(), maxWidth, quality, encoded);
+            if (ret == -EALREADY) {
+                result.skipped++;
+                continue;
+            }
+            if (ret == -ENOMEM) {
+                return ret;
+            }
+            if (ret < 0) {
+                result.failed++;
+                continue;
+            }
+            if (encoded.size() >= frame.size()) {
+                result.skipped++;
+                continue;
+            }
+            ret = lc4j::storeReplace(storeHandle, record, encoded.data(), encoded.size());
+            if (ret == -ESTALE) {
+                result.skipped++;
+                continue;
+            }
+            if (ret < 0) {
+                return ret;
+            }
+            result.recompressed++;
+            result.bytesBefore += record.length;
+            result.bytesAfter += static_cast<int64_t>(encoded.size());
+        }
+        if (records[n - 1].timestampMs == INT64_MAX) {
+            break;
+        }
+        next = records[n - 1].timestampMs + 1;
+    }
+    return 0;
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// Recompressor
+// -----------------------------------------------------------------------------
+
+extern "C" {
+
+int32_t lc4j_store_recompress(int64_t handle, int64_t fromMs, int64_t toMs, int32_t maxWidth, int32_t quality,
+                              lc4j_recompress_result* out) {
+    if (maxWidth < 0 || quality < 1 || quality > 100) {
+        return -EINVAL;
+    }
+    lc4j_recompress_result result;
+    std::memset(&result, 0, sizeof(result));
+    int32_t ret = 0;
+    try {
+        std::thread worker([&] {
+            lowerThreadPriority();
+            try {
+                ret = recompressRange(handle, fromMs, toMs, maxWidth, quality, result);
+            } catch (const std::bad_alloc&) {
+                ret = -ENOMEM;
+            }
+        });
+        worker.join();
+    } catch (const std::system_error& e) {
+        return -e.code().value();
+    }
+    if (out != nullptr) {
+        *out = result;
+    }
+    return ret;
+}
+
+} // extern "C"
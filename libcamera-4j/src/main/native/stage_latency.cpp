@@ -0,0 +1,108 @@
+/*
+ * libcamera4j - where the time of a capture goes.
+ *
+ * A capture session times each stage of its captures, from configuring the
+ * camera to writing the encoded frame out, and adds them up per stage: count,
+ * sum, minimum and maximum, cheap enough to record for every frame. Times are
+ * taken on CLOCK_MONOTONIC, the clock of the V4L2 buffer timestamps, so the
+ * time from a frame's exposure to its completion can be told apart from the
+ * time the completed request then waited to be picked up. lc4j_stats_snapshot
+ * reads all of them in one call.
+ *
+ * Sums and extremes hide the tail, such as the occasional request that times
+ * out, so the latencies that matter most are also kept as log-linear
+ * histograms in the manner of HdrHistogram: buckets of microseconds, 16 per
+ * doubling, each counted with an atomic increment so that recording never
+ * waits. Percentiles are read off them in Java, and histograms of several
+ * sessions add up bucket by bucket.
+ */
+
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <algorithm>
+#include <ctime>
+
+static_assert(LC4J_STAGE_COUNT == lc4j::StageLatency::kStages, "stage count");
+static_assert(sizeof(lc4j_stats) == LC4J_STAGE_COUNT * 32, "lc4j_stats layout");
+static_assert(LC4J_HISTOGRAM_BUCKETS == lc4j::LatencyHistogram::kBuckets, "histogram buckets");
+static_assert(sizeof(lc4j_latency_histogram) == 16 + LC4J_HISTOGRAM_BUCKETS * 8, "lc4j_latency_histogram layout");
+
+namespace {
+
+constexpr int32_t kSubBucketBits = 4;    // 16 buckets per doubling
+constexpr int32_t kLinearBuckets = 2 << kSubBucketBits;
+
+} // namespace
+
+int64_t lc4j::monotonicNs() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+void lc4j::StageLatency::record(int32_t stage, int64_t ns) {
+    if (stage < 0 || stage >= kStages || ns < 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    Counter& counter = counters_[stage];
+    counter.minNs = counter.count == 0 ? ns : std::min(counter.minNs, ns);
+    counter.maxNs = std::max(counter.maxNs, ns);
+    counter.sumNs += ns;
+    counter.count++;
+}
+
+void lc4j::StageLatency::snapshot(lc4j_stats& out, bool reset) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int32_t i = 0; i < kStages; ++i) {
+        out.stages[i].count = counters_[i].count;
+        out.stages[i].sumNs = counters_[i].sumNs;
+        out.stages[i].minNs = counters_[i].minNs;
+        out.stages[i].maxNs = counters_[i].maxNs;
+        if (reset) {
+            counters_[i] = Counter{};
+        }
+    }
+}
+
+int32_t lc4j::LatencyHistogram::bucket(int64_t us) {
+    if (us < kLinearBuckets) {
+        return static_cast<int32_t>(std::max<int64_t>(us, 0));
+    }
+    // The top five bits of the value: the shift picks the doubling, the bits
+    // below the leading one the bucket within it
+    int32_t shift = 0;
+    while ((us >> shift) >= kLinearBuckets) {
+        ++shift;
+    }
+    const int64_t index = (static_cast<int64_t>(shift) << kSubBucketBits) + (us >> shift);
+    return static_cast<int32_t>(std::min<int64_t>(index, kBuckets - 1));
+}
+
+void lc4j::LatencyHistogram::record(int64_t ns) {
+    if (ns < 0) {
+        return;
+    }
+    buckets_[bucket(ns / 1000)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    int64_t max = maxNs_.load(std::memory_order_relaxed);
+    while (ns > max && !maxNs_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+}
+
+void lc4j::LatencyHistogram::snapshot(lc4j_latency_histogram& out, bool reset) {
+    if (reset) {
+        out.count = count_.exchange(0, std::memory_order_relaxed);
+        out.maxNs = maxNs_.exchange(0, std::memory_order_relaxed);
+        for (int32_t i = 0; i < kBuckets; ++i) {
+            out.buckets[i] = buckets_[i].exchange(0, std::memory_order_relaxed);
+        }
+    } else {
+        out.count = count_.load(std::memory_order_relaxed);
+        out.maxNs = maxNs_.load(std::memory_order_relaxed);
+        for (int32_t i = 0; i < kBuckets; ++i) {
+            out.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+        }
+    }
+}
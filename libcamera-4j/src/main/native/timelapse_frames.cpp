@@ -0,0 +1,394 @@
+/*
+ * libcamera4j - timelapse frames corrected on their way to the video encoder.
+ *
+ * A timelapse flickers: auto-exposure settles a little differently for every
+ * capture, so frames of an unchanging scene differ in brightness by a few
+ * percent, which the video turns into a shimmer. Here the frames of a range
+ * are read from the frame store in order and, with deflicker on, every frame's
+ * mean luma is pulled towards the geometric mean over the window of frames
+ * around it. The correction is a power-law tone curve on luma, which keeps
+ * black and white where they are so that nothing clips, applied while the
+ * frame is decoded and re-encoded. Dusk, clouds and other changes slower than
+ * the window pass through.
+ *
+ * A timelapse also wobbles when wind shakes the camera. With stabilize on,
+ * the motion from each frame to the next is registered on downscaled luma
+ * (frame_registration.cpp) and summed into the path of the view; every frame
+ * is warped from where the path has it to the mean of the path over its
+ * window, which takes out the shake and keeps deliberate turns of the camera.
+ *
+ * Levels and motions are measured on small decodes, where libjpeg reads little
+ * more than the DC coefficients, as the window moves ahead of the frames being
+ * corrected; only the window's measurements and a batch of frames are held,
+ * however long the range. Both the measuring and the correcting run a batch of
+ * frames at a time in parallel, since decoding and encoding a JPEG does not
+ * split across threads.
+ */
+
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace {
+
+constexpr int32_t kMaxWindow = LC4J_TIMELAPSE_MAX_WINDOW;
+// Tone curve exponents beyond these are the light changing, not flicker
+constexpr double kMinExponent = 0.8;
+constexpr double kMaxExponent = 1.25;
+// Frames this close to their target keep their stored bytes
+constexpr double kMinCorrection = 0.005;
+// Stabilizing warps are limited to shake: shifts in widths of the frame, angles in radians
+constexpr double kMaxWarpShift = 0.05;
+constexpr double kMaxWarpAngle = 0.02;
+constexpr double kMinWarp = 0.0002;
+// Frames are registered on luma decoded at least this wide
+constexpr int32_t kRegistrationWidth = 480;
+// Frames measured, and frames corrected, in parallel at a time
+constexpr size_t kMeasureBatch = 16;
+constexpr size_t kCorrectBatch = 4;
+
+struct Sample {
+    bool read = false;              // false if the frame could not be read
+    double level = 0.0;             // log of the mean luma
+    lc4j::RigidMotion path;         // summed motion of the view since the first frame
+};
+
+class TimelapseFrames {
+public:
+    TimelapseFrames(int64_t storeHandle, const int64_t* timestamps, int32_t count,
+                    const lc4j_timelapse_params& params)
+        : store_(storeHandle), timestamps_(timestamps, timestamps + count), quality_(params.quality),
+          deflickerRadius_((params.flags & LC4J_TIMELAPSE_DEFLICKER) ? params.deflickerWindow / 2 : 0),
+          stabilizeRadius_((params.flags & LC4J_TIMELAPSE_STABILIZE) ? params.stabilizeWindow / 2 : 0),
+          radius_(std::max(deflickerRadius_, stabilizeRadius_)) {}
+
+    int64_t next() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        frame_.clear();
+        while (ready_.empty() && next_ < timestamps_.size()) {
+            correctBatch();
+        }
+        if (ready_.empty()) {
+            return 0;
+        }
+        frame_.swap(ready_.front());
+        ready_.pop_front();
+        return static_cast<int64_t>(frame_.size());
+    }
+
+    int64_t read(uint8_t* buffer, size_t capacity) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (capacity < frame_.size()) {
+            return -ENOSPC;
+        }
+        std::memcpy(buffer, frame_.data(), frame_.size());
+        return static_cast<int64_t>(frame_.size());
+    }
+
+private:
+    std::mutex mutex_;
+    const int64_t store_;
+    const std::vector<int64_t> timestamps_;
+    const int32_t quality_;
+    const size_t deflickerRadius_;
+    const size_t stabilizeRadius_;
+    const size_t radius_;
+    // Measurements of the frames from samplesStart_ up to measured_
+    std::deque<Sample> samples_;
+    size_t samplesStart_ = 0;
+    size_t measured_ = 0;
+    // Luma of the last frame measured that could be read, to register the next one against
+    std::vector<uint8_t> lastLuma_;
+    int32_t lastWidth_ = 0;
+    int32_t lastHeight_ = 0;
+    size_t next_ = 0;
+    std::deque<std::vector<uint8_t>> ready_;
+    std::vector<uint8_t> frame_;
+
+    bool readFrame(size_t index, std::vector<uint8_t>& out) const {
+        lc4j_store_record record;
+        if (lc4j_store_find(store_, timestamps_[index], &record) != 0) {
+            return false;
+        }
+        try {
+            out.resize(static_cast<size_t>(record.length));
+        } catch (const std::bad_alloc&) {
+            return false;   // on a worker thread, where it cannot be thrown
+        }
+        return lc4j_store_read(store_, timestamps_[index], out.data(), record.length) == record.length;
+    }
+
+    // Measures the frames up to `end`, a batch at a time: the frames are read
+    // and decoded small in parallel, then each is registered against the one
+    // before it, also in parallel, and their paths summed in order.
+    void measureUntil(size_t end) {
+        struct Measured {
+            bool read = false;
+            double level = 0.0;
+            std::vector<uint8_t> luma;
+            int32_t width = 0;
+            int32_t height = 0;
+            bool moved = false;
+            lc4j::RigidMotion motion;
+        };
+        const int32_t decodeWidth = stabilizeRadius_ > 0 ? kRegistrationWidth : 1;
+        while (measured_ < end) {
+            const size_t first = measured_;
+            const auto count = static_cast<int32_t>(std::min(end - first, kMeasureBatch));
+            std::vector<Measured> batch(static_cast<size_t>(count));
+            lc4j::forRows(count, 1, [&](int32_t begin, int32_t stop) {
+                std::vector<uint8_t> jpeg;
+                for (int32_t i = begin; i < stop; ++i) {
+                    Measured& m = batch[i];
+                    if (!readFrame(first + i, jpeg)
+                        || lc4j::decodeJpegLuma(jpeg.data(), jpeg.size(), decodeWidth, m.luma, m.width, m.height) < 0
+                        || m.luma.empty()) {
+                        continue;
+                    }
+                    uint64_t sum = 0;
+                    for (uint8_t v : m.luma) {
+                        sum += v;
+                    }
+                    const double mean = static_cast<double>(sum) / static_cast<double>(m.luma.size());
+                    m.level = std::log(std::clamp(mean, 1.0, 254.0) / 255.0);
+                    m.read = true;
+                }
+            });
+            if (stabilizeRadius_ > 0) {
+                lc4j::forRows(count, 1, [&](int32_t begin, int32_t stop) {
+                    for (int32_t i = begin; i < stop; ++i) {
+                        Measured& m = batch[i];
+                        const Measured* previous = nullptr;
+                        for (int32_t j = i - 1; j >= 0 && previous == nullptr; --j) {
+                            previous = batch[j].read ? &batch[j] : nullptr;
+                        }
+                        const uint8_t* previousLuma = previous ? previous->luma.data() : lastLuma_.data();
+                        const int32_t pw = previous ? previous->width : lastWidth_;
+                        const int32_t ph = previous ? previous->height : lastHeight_;
+                        m.moved = m.read && pw == m.width && ph == m.height
+                               && lc4j::estimateMotion(previousLuma, m.luma.data(), m.width, m.height, m.motion);
+                    }
+                });
+            }
+            for (Measured& m : batch) {
+                Sample sample;
+                if (!samples_.empty()) {
+                    sample.path = samples_.back().path;
+                }
+                sample.read = m.read;
+                sample.level = m.level;
+                if (m.moved) {
+                    sample.path.shiftX += m.motion.shiftX;
+                    sample.path.shiftY += m.motion.shiftY;
+                    sample.path.angle += m.motion.angle;
+                }
+                samples_.push_back(sample);
+                if (m.read && stabilizeRadius_ > 0) {
+                    lastLuma_.swap(m.luma);
+                    lastWidth_ = m.width;
+                    lastHeight_ = m.height;
+                }
+            }
+            measured_ += static_cast<size_t>(count);
+        }
+    }
+
+    const Sample& sample(size_t index) const {
+        return samples_[index - samplesStart_];
+    }
+
+    // The exponent of the tone curve 255 * (v / 255)^e that takes the frame's
+    // mean luma to about the geometric mean of the window around it.
+    double deflickerExponent(size_t index) const {
+        const Sample& own = sample(index);
+        const size_t begin = index > deflickerRadius_ ? index - deflickerRadius_ : 0;
+        const size_t end = std::min(measured_, index + deflickerRadius_ + 1);
+        double sum = 0.0;
+        int32_t n = 0;
+        for (size_t i = begin; i < end; ++i) {
+            if (sample(i).read) {
+                sum += sample(i).level;
+                ++n;
+            }
+        }
+        if (!own.read || n == 0) {
+            return 1.0;
+        }
+        return std::clamp(sum / n / own.level, kMinExponent, kMaxExponent);
+    }
+
+    // The motion that takes the frame's view from where its path has it to
+    // the mean of the path over the window around it.
+    lc4j::RigidMotion stabilizeWarp(size_t index) const {
+        const size_t begin = index > stabilizeRadius_ ? index - stabilizeRadius_ : 0;
+        const size_t end = std::min(measured_, index + stabilizeRadius_ + 1);
+        lc4j::RigidMotion mean;
+        int32_t n = 0;
+        for (size_t i = begin; i < end; ++i) {
+            if (sample(i).read) {
+                mean.shiftX += sample(i).path.shiftX;
+                mean.shiftY += sample(i).path.shiftY;
+                mean.angle += sample(i).path.angle;
+                ++n;
+            }
+        }
+        lc4j::RigidMotion warp;
+        if (n > 0) {
+            const lc4j::RigidMotion& path = sample(index).path;
+            warp.shiftX = std::clamp(mean.shiftX / n - path.shiftX, -kMaxWarpShift, kMaxWarpShift);
+            warp.shiftY = std::clamp(mean.shiftY / n - path.shiftY, -kMaxWarpShift, kMaxWarpShift);
+            warp.angle = std::clamp(mean.angle / n - path.angle, -kMaxWarpAngle, kMaxWarpAngle);
+        }
+        return warp;
+    }
+
+    // Corrects the next batch of frames in parallel, queueing those that can
+    // still be read.
+    void correctBatch() {
+        struct Job {
+            uint8_t lut[256];
+            lc4j::RigidMotion warp;
+            lc4j::JpegCorrection correction;
+            std::vector<uint8_t> out;
+        };
+        const size_t first = next_;
+        const auto count = static_cast<int32_t>(std::min(timestamps_.size() - first, kCorrectBatch));
+        next_ += static_cast<size_t>(count);
+        if (deflickerRadius_ > 0 || stabilizeRadius_ > 0) {
+            measureUntil(std::min(timestamps_.size(), next_ + radius_));
+        }
+
+        std::vector<Job> jobs(static_cast<size_t>(count));
+        for (int32_t i = 0; i < count; ++i) {
+            Job& job = jobs[i];
+            if (deflickerRadius_ > 0) {
+                const double exponent = deflickerExponent(first + i);
+                if (std::abs(exponent - 1.0) >= kMinCorrection) {
+                    for (int v = 0; v < 256; ++v) {
+                        job.lut[v] = static_cast<uint8_t>(std::lround(255.0 * std::pow(v / 255.0, exponent)));
+                    }
+                    job.correction.lumaLut = job.lut;
+                }
+            }
+            if (stabilizeRadius_ > 0) {
+                job.warp = stabilizeWarp(first + i);
+                if (std::hypot(job.warp.shiftX, job.warp.shiftY) >= kMinWarp || std::abs(job.warp.angle) >= kMinWarp) {
+                    job.correction.warp = &job.warp;
+                }
+            }
+        }
+        // Measurements before the window of the next batch are no longer needed
+        while (samplesStart_ + radius_ < next_ && !samples_.empty()) {
+            samples_.pop_front();
+            ++samplesStart_;
+        }
+
+        lc4j::forRows(count, 1, [&](int32_t begin, int32_t end) {
+            std::vector<uint8_t> input;
+            for (int32_t i = begin; i < end; ++i) {
+                Job& job = jobs[i];
+                if (!readFrame(first + i, input)) {
+                    continue;
+                }
+                if (job.correction.lumaLut == nullptr && job.correction.warp == nullptr) {
+                    job.out.swap(input);
+                } else if (lc4j::correctJpeg(input.data(), input.size(), job.correction, quality_, job.out) < 0) {
+                    job.out.swap(input);    // as stored, rather than not at all
+                }
+            }
+        });
+        for (Job& job : jobs) {
+            if (!job.out.empty()) {
+                ready_.push_back(std::move(job.out));
+            }
+        }
+    }
+};
+
+std::mutex g_timelapsesMutex;
+std::map<int64_t, std::shared_ptr<TimelapseFrames>> g_timelapses;
+
+std::shared_ptr<TimelapseFrames> findTimelapse(int64_t handle) {
+    std::lock_guard<std::mutex> lock(g_timelapsesMutex);
+    auto it = g_timelapses.find(handle);
+    return it == g_timelapses.end() ? nullptr : it->second;
+}
+
+bool validWindow(int32_t window) {
+    return window >= 3 && window <= kMaxWindow && window % 2 == 1;
+}
+
+bool validParams(const lc4j_timelapse_params& params) {
+    if ((params.flags & ~(LC4J_TIMELAPSE_DEFLICKER | LC4J_TIMELAPSE_STABILIZE)) != 0 || params.quality < 1
+        || params.quality > 100) {
+        return false;
+    }
+    if ((params.flags & LC4J_TIMELAPSE_DEFLICKER) && !validWindow(params.deflickerWindow)) {
+        return false;
+    }
+    return !(params.flags & LC4J_TIMELAPSE_STABILIZE) || validWindow(params.stabilizeWindow);
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// TimelapseFrames
+// -----------------------------------------------------------------------------
+
+extern "C" {
+
+int64_t lc4j_timelapse_open(int64_t storeHandle, const int64_t* timestamps, int32_t count,
+                            const lc4j_timelapse_params* params) {
+    if (count < 0 || (count > 0 && timestamps == nullptr) || params == nullptr || !validParams(*params)) {
+        return 0;
+    }
+    try {
+        auto frames = std::make_shared<TimelapseFrames>(storeHandle, timestamps, count, *params);
+        int64_t handle = lc4j::allocHandle();
+        std::lock_guard<std::mutex> lock(g_timelapsesMutex);
+        g_timelapses[handle] = std::move(frames);
+        return handle;
+    } catch (const std::bad_alloc&) {
+        return 0;
+    }
+}
+
+int64_t lc4j_timelapse_next(int64_t handle) {
+    auto frames = findTimelapse(handle);
+    if (!frames) {
+        return -1;
+    }
+    try {
+        return frames->next();
+    } catch (const std::bad_alloc&) {
+        return -ENOMEM;
+    }
+}
+
+int64_t lc4j_timelapse_read(int64_t handle, void* buffer, int64_t capacity) {
+    if (buffer == nullptr || capacity < 0) {
+        return -EINVAL;
+    }
+    auto frames = findTimelapse(handle);
+    if (!frames) {
+        return -1;
+    }
+    return frames->read(static_cast<uint8_t*>(buffer), static_cast<size_t>(capacity));
+}
+
+void lc4j_timelapse_close(int64_t handle) {
+    std::lock_guard<std::mutex> lock(g_timelapsesMutex);
+    g_timelapses.erase(handle);
+}
+
+} // extern "C"
@@ -0,0 +1,168 @@
+/*
+ * libcamera4j - the waterline against the jetty posts.
+ *
+ * The distance sensor under the jetty measures the water level every few
+ * seconds, but it can drift or glitch, and the camera sees the same water
+ * meet the posts. In a region of the image around a post, set up once, the
+ * luma of every row is averaged across a few vertical strips: where the post
+ * enters the water its brightness changes, which shows as the strongest
+ * step of each strip's column profile. Ripples and reflections make steps
+ * too, but at different rows in different strips, so the waterline is taken
+ * where most strips agree, refined to a fraction of a row on their summed
+ * profiles. A linear calibration, two rows at which the level was known,
+ * turns the row into a level, so each capture measures it for free.
+ */
+
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// Transform bits, as in image_codec.cpp
+constexpr int32_t TRANSFORM_HFLIP = 1;
+constexpr int32_t TRANSFORM_VFLIP = 2;
+constexpr int32_t TRANSFORM_TRANSPOSE = 4;
+
+constexpr int32_t kStrips = 8;
+// Strips that must agree on the row
+constexpr int32_t kMinStrips = 3;
+// Columns averaged per strip at most, spread evenly
+constexpr int32_t kStripSamples = 32;
+// Smallest step, in luma levels, that counts as an edge
+constexpr float kMinStep = 6.0f;
+constexpr int32_t kMinRows = 16;
+// Rows either side of a boundary whose means it steps between, as a fraction
+// of the region and at most
+constexpr int32_t kSpanDivisor = 16;
+constexpr int32_t kMaxSpan = 16;
+
+// Step at each boundary between rows, from the mean of the `span` rows above
+// it to that of the `span` rows below: ripples average out, a step does not.
+// Boundary y is the top of row y.
+void steps(const std::vector<float>& profile, int32_t span, std::vector<float>& out) {
+    const auto rows = static_cast<int32_t>(profile.size());
+    std::vector<double> prefix(rows + 1, 0.0);
+    for (int32_t y = 0; y < rows; ++y) {
+        prefix[y + 1] = prefix[y] + profile[y];
+    }
+    out.assign(rows, 0.0f);
+    for (int32_t y = span; y + span <= rows; ++y) {
+        const double below = prefix[y + span] - prefix[y];
+        const double above = prefix[y] - prefix[y - span];
+        out[y] = static_cast<float>(std::abs(below - above) / span);
+    }
+}
+
+} // namespace
+
+bool lc4j::estimateWaterline(const FrameView& frame, int32_t transform, const lc4j_waterline_params& params,
+                             float& row, float& level, float& confidence) {
+    int32_t offset;
+    int32_t step;
+    if (frame.planes[0] == nullptr || !lumaSampling(frame.fourcc, offset, step)) {
+        return false;
+    }
+    // The region and the rows are those of the image as captured. Rather than
+    // turning the frame, each of its rows and columns is mapped to an offset
+    // in the sensor's plane, flips first and then a clockwise turn as in
+    // image_codec.cpp; a transposed row is a column of the sensor.
+    const bool hflip = (transform & TRANSFORM_HFLIP) != 0;
+    const bool vflip = (transform & TRANSFORM_VFLIP) != 0;
+    const bool transpose = (transform & TRANSFORM_TRANSPOSE) != 0;
+    const int32_t width = transpose ? frame.height : frame.width;
+    const int32_t height = transpose ? frame.width : frame.height;
+    const int32_t x0 = std::clamp(static_cast<int32_t>(std::floor(params.left * width)), 0, width);
+    const int32_t x1 = std::clamp(static_cast<int32_t>(std::ceil(params.right * width)), 0, width);
+    const int32_t y0 = std::clamp(static_cast<int32_t>(std::floor(params.top * height)), 0, height);
+    const int32_t y1 = std::clamp(static_cast<int32_t>(std::ceil(params.bottom * height)), 0, height);
+    const int32_t rows = y1 - y0;
+    if (x1 - x0 < kStrips || rows < kMinRows) {
+        return false;
+    }
+    const auto stride = static_cast<size_t>(frame.strides[0]);
+    std::vector<size_t> rowOffsets(rows);
+    for (int32_t y = 0; y < rows; ++y) {
+        const int32_t cy = y0 + y;
+        rowOffsets[y] = transpose ? static_cast<size_t>(hflip ? frame.width - 1 - cy : cy) * step
+                                  : static_cast<size_t>(vflip ? frame.height - 1 - cy : cy) * stride;
+    }
+    std::vector<size_t> columnOffsets(x1 - x0);
+    for (int32_t x = 0; x < x1 - x0; ++x) {
+        const int32_t cx = x0 + x;
+        columnOffsets[x] = transpose ? static_cast<size_t>(vflip ? cx : frame.height - 1 - cx) * stride
+                                     : static_cast<size_t>(hflip ? frame.width - 1 - cx : cx) * step;
+    }
+    const uint8_t* base = frame.planes[0] + offset;
+
+    // Column profile and steps of each strip
+    const int32_t span = std::clamp(rows / kSpanDivisor, 1, kMaxSpan);
+    std::vector<std::vector<float>> stripSteps(kStrips);
+    std::vector<int32_t> stripPeaks(kStrips, -1);
+    std::vector<int32_t> peaks;
+    std::vector<float> profile(rows);
+    for (int32_t s = 0; s < kStrips; ++s) {
+        const int32_t sx0 = (x1 - x0) * s / kStrips;
+        const int32_t sx1 = (x1 - x0) * (s + 1) / kStrips;
+        const int32_t every = std::max(1, (sx1 - sx0) / kStripSamples);
+        const int32_t samples = (sx1 - sx0 + every - 1) / every;
+        for (int32_t y = 0; y < rows; ++y) {
+            const uint8_t* line = base + rowOffsets[y];
+            uint32_t sum = 0;
+            for (int32_t x = sx0; x < sx1; x += every) {
+                sum += line[columnOffsets[x]];
+            }
+            profile[y] = static_cast<float>(sum) / samples;
+        }
+        steps(profile, span, stripSteps[s]);
+        const auto peak = std::max_element(stripSteps[s].begin(), stripSteps[s].end());
+        if (*peak >= kMinStep) {
+            stripPeaks[s] = static_cast<int32_t>(peak - stripSteps[s].begin());
+            peaks.push_back(stripPeaks[s]);
+        }
+    }
+    if (static_cast<int32_t>(peaks.size()) < kMinStrips) {
+        return false;
+    }
+
+    // Most strips agree on the waterline; reflections and ripples do not
+    std::vector<int32_t> sorted = peaks;
+    std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+    const int32_t median = sorted[sorted.size() / 2];
+    const int32_t tolerance = std::max(2, rows / 25);
+    std::vector<float> summed(rows, 0.0f);
+    int32_t agreeing = 0;
+    for (int32_t s = 0; s < kStrips; ++s) {
+        if (stripPeaks[s] >= 0 && std::abs(stripPeaks[s] - median) <= tolerance) {
+            ++agreeing;
+            for (int32_t y = 0; y < rows; ++y) {
+                summed[y] += stripSteps[s][y];
+            }
+        }
+    }
+    if (agreeing < kMinStrips) {
+        return false;
+    }
+    const int32_t from = std::max(1, median - tolerance);
+    const int32_t to = std::min(rows - 2, median + tolerance);
+    int32_t best = from;
+    for (int32_t y = from; y <= to; ++y) {
+        if (summed[y] > summed[best]) {
+            best = y;
+        }
+    }
+    // A step between the means of two spans peaks in a triangle; its apex
+    // through the peak and its neighbours
+    const float before = summed[best - 1];
+    const float after = summed[best + 1];
+    const float apex = summed[best] - std::min(before, after);
+    const float fraction = apex > 0.0f ? std::clamp(0.5f * (after - before) / apex, -0.5f, 0.5f) : 0.0f;
+
+    row = (static_cast<float>(y0 + best) + fraction) / height;
+    level = params.level0 + (row - params.row0) * (params.level1 - params.level0) / (params.row1 - params.row0);
+    confidence = static_cast<float>(agreeing) / kStrips;
+    return true;
+}
@@ -0,0 +1,151 @@
+package in.virit.libcamera4j;
+
+import org.junit.jupiter.api.BeforeAll;
+import org.junit.jupiter.api.Test;
+import org.junit.jupiter.api.io.TempDir;
+
+import java.nio.file.Path;
+import java.time.Instant;
+import java.util.ArrayList;
+import java.util.List;
+import java.util.concurrent.ThreadLocalRandom;
+import java.util.concurrent.atomic.AtomicBoolean;
+import java.util.concurrent.atomic.AtomicReference;
+
+import static org.junit.jupiter.api.Assertions.assertEquals;
+import static org.junit.jupiter.api.Assertions.assertNotNull;
+import static org.junit.jupiter.api.Assertions.assertNull;
+import static org.junit.jupiter.api.Assertions.assertTrue;
+import static org.junit.jupiter.api.Assumptions.assumeTrue;
+
+/**
+ * Tests that {@link FrameIndex} lookups stay consistent while the store
+ * changes underneath them.
+ *
+ * <p>The index is read in place from the native mapping, guarded only by the
+ * store's sequence counter, so a reader racing a delete or a compaction could
+ * see entries half moved. Every frame here has a length derived from its
+ * timestamp, which makes a torn entry visible, and every fourth frame is never
+ * touched, so it must be found by every lookup. Skipped where the native
+ * library cannot be loaded.</p>
+ */
+class FrameIndexTest {
+
+    private static final long DAY = Instant.parse("2026-01-01T00:00:00Z").toEpochMilli();
+    private static final int FRAMES = 2000;
+    private static final int ROUNDS = 50;
+    private static final int READERS = 3;
+
+    @TempDir
+    Path dir;
+
+    @BeforeAll
+    static void requireNativeLibrary() {
+        try {
+            NativeLoader.load();
+        } catch (UnsatisfiedLinkError e) {
+            // reported by the assumption below
+        }
+        assumeTrue(NativeLoader.isLoaded(), "native library not available");
+    }
+
+    private static long timestamp(int i) {
+        return DAY + i * 1000L;
+    }
+
+    private static int lengthOf(long timestampMs) {
+        return 16 + (int) ((timestampMs - DAY) / 1000 % 7) * 3;
+    }
+
+    private static boolean isAnchor(long timestampMs) {
+        return (timestampMs - DAY) / 1000 % 4 == 0;
+    }
+
+    private static void append(FrameStore store, int i) {
+        store.append(timestamp(i), new byte[lengthOf(timestamp(i))]);
+    }
+
+    @Test
+    void lookupsAreConsistentDuringDeletesAndCompaction() throws InterruptedException {
+        try (FrameStore store = FrameStore.open(dir)) {
+            for (int i = 0; i < FRAMES; i++) {
+                append(store, i);
+            }
+            FrameIndex index = store.index();
+            AtomicBoolean done = new AtomicBoolean();
+            AtomicReference<Throwable> failure = new AtomicReference<>();
+            List<Thread> readers = new ArrayList<>();
+            for (int r = 0; r < READERS; r++) {
+                readers.add(Thread.ofPlatform().start(() -> {
+                    try {
+                        while (!done.get()) {
+                            checkLookups(index);
+                        }
+                    } catch (Throwable t) {
+                        failure.compareAndSet(null, t);
+                    }
+                }));
+            }
+
+            // Delete a random half of the other frames, compact them away and
+            // append them again, which inserts into the middle of the index
+            ThreadLocalRandom random = ThreadLocalRandom.current();
+            for (int round = 0; round < ROUNDS && failure.get() == null; round++) {
+                List<Integer> removed = new ArrayList<>();
+                for (int i = 0; i < FRAMES; i++) {
+                    if (!isAnchor(timestamp(i)) && random.nextBoolean()) {
+                        removed.add(i);
+                    }
+                }
+                store.delete(removed.stream().mapToLong(FrameIndexTest::timestamp).toArray());
+                store.compact(0.0);
+                for (int i : removed) {
+                    append(store, i);
+                }
+            }
+            done.set(true);
+            for (Thread reader : readers) {
+                reader.join();
+            }
+            if (failure.get() != null) {
+                throw new AssertionError("Inconsistent lookup", failure.get());
+            }
+            assertEquals(FRAMES, index.size());
+        }
+    }
+
+    // Checks a range, a nearest and an exact lookup against the invariants.
+    private static void checkLookups(FrameIndex index) {
+        ThreadLocalRandom random = ThreadLocalRandom.current();
+        // Leaves an anchor after `from`, for the nearest lookup
+        int from = random.nextInt(FRAMES - 4);
+        int to = Math.min(FRAMES - 1, from + random.nextInt(200));
+
+        List<FrameStore.Entry> range = index.range(timestamp(from), timestamp(to));
+        long previous = Long.MIN_VALUE;
+        int anchors = 0;
+        for (FrameStore.Entry entry : range) {
+            assertTrue(entry.timestampMs() > previous, "range not sorted");
+            assertTrue(entry.timestampMs() >= timestamp(from) && entry.timestampMs() <= timestamp(to));
+            assertEquals(lengthOf(entry.timestampMs()), entry.length(), "torn entry");
+            previous = entry.timestampMs();
+            if (isAnchor(entry.timestampMs())) {
+                anchors++;
+            }
+        }
+        assertEquals((to / 4) - ((from + 3) / 4) + 1, anchors, "anchor missing from range");
+
+        // Halfway between two frames, the nearest is one of them
+        long between = timestamp(from) + 500;
+        FrameStore.Entry nearest = index.nearest(between);
+        assertNotNull(nearest);
+        assertEquals(lengthOf(nearest.timestampMs()), nearest.length(), "torn entry");
+        assertTrue(Math.abs(nearest.timestampMs() - between) <= 2000, "nearest skipped an anchor");
+
+        long anchor = timestamp(from / 4 * 4);
+        FrameStore.Entry found = index.find(anchor);
+        assertNotNull(found, "anchor not found");
+        assertEquals(lengthOf(anchor), found.length());
+        assertNull(index.find(between));
+    }
+}
@@ -0,0 +1,194 @@
+package in.virit.libcamera4j;
+
+import org.junit.jupiter.api.BeforeAll;
+import org.junit.jupiter.api.Test;
+import org.junit.jupiter.api.io.TempDir;
+
+import java.io.IOException;
+import java.nio.charset.StandardCharsets;
+import java.nio.file.Files;
+import java.nio.file.Path;
+import java.time.Instant;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.List;
+import java.util.concurrent.atomic.AtomicReference;
+import java.util.stream.Stream;
+
+import static org.junit.jupiter.api.Assertions.assertArrayEquals;
+import static org.junit.jupiter.api.Assertions.assertEquals;
+import static org.junit.jupiter.api.Assertions.assertFalse;
+import static org.junit.jupiter.api.Assertions.assertNull;
+import static org.junit.jupiter.api.Assertions.assertTrue;
+import static org.junit.jupiter.api.Assumptions.assumeTrue;
+
+/**
+ * Camera-free tests of {@link FrameStore} against a temporary directory.
+ *
+ * <p>The store is native, so these run only where {@code libcamera4j} can be
+ * loaded and are skipped elsewhere. Frames are arbitrary bytes; nothing here
+ * decodes them. All timestamps fall on 2026-01-01 UTC, i.e. in the day files
+ * {@code 20260101.*}, which the crash-leftover test relies on.</p>
+ */
+class FrameStoreTest {
+
+    private static final long DAY = Instant.parse("2026-01-01T00:00:00Z").toEpochMilli();
+    private static final long T1 = DAY + 1_000;
+    private static final long T2 = DAY + 2_000;
+    private static final long T3 = DAY + 3_000;
+
+    @TempDir
+    Path dir;
+
+    @BeforeAll
+    static void requireNativeLibrary() {
+        try {
+            NativeLoader.load();
+        } catch (UnsatisfiedLinkError e) {
+            // reported by the assumption below
+        }
+        assumeTrue(NativeLoader.isLoaded(), "native library not available");
+    }
+
+    private static byte[] frame(String content) {
+        return content.getBytes(StandardCharsets.US_ASCII);
+    }
+
+    private static byte[] filled(int length, char c) {
+        byte[] frame = new byte[length];
+        Arrays.fill(frame, (byte) c);
+        return frame;
+    }
+
+    @Test
+    void appendReplaceAndRemove() {
+        try (FrameStore store = FrameStore.open(dir)) {
+            store.append(T1, frame("first"));
+            store.append(T2, frame("second"));
+            assertArrayEquals(frame("first"), store.read(T1));
+            assertArrayEquals(frame("second"), store.read(T2));
+            assertEquals(2, store.index().size());
+
+            // Same timestamp: the frame is replaced, not added
+            store.append(T1, frame("first, again"));
+            assertArrayEquals(frame("first, again"), store.read(T1));
+            assertEquals(2, store.index().size());
+            assertEquals(frame("first, again").length, store.index().find(T1).length());
+
+            assertEquals(1, store.delete(T1, T3));
+            assertNull(store.read(T1));
+            assertNull(store.index().find(T1));
+            assertEquals(List.of(new FrameStore.Entry(T2, frame("second").length)), store.list());
+            assertEquals(0, store.delete(T1));
+        }
+    }
+
+    @Test
+    void compactionKeepsFramesAndTags() {
+        try (FrameStore store = FrameStore.open(dir)) {
+            store.append(T1, frame("one"));
+            store.append(T2, frame("two, to be deleted"));
+            store.append(T3, frame("three"));
+            assertEquals(3, store.setTags(new long[] {T1, T2, T3}, new long[] {0x1111, 0x2222, -1}));
+            assertEquals(1, store.delete(T2));
+
+            assertEquals(frame("two, to be deleted").length, store.compact(0.1));
+
+            assertArrayEquals(frame("one"), store.read(T1));
+            assertArrayEquals(frame("three"), store.read(T3));
+            assertEquals(List.of(
+                    new FrameStore.TaggedEntry(T1, frame("one").length, true, 0x1111),
+                    new FrameStore.TaggedEntry(T3, frame("three").length, true, -1)),
+                    store.listTags(DAY, T3));
+        }
+    }
+
+    @Test
+    void openRemovesCrashLeftovers() throws IOException {
+        try (FrameStore store = FrameStore.open(dir)) {
+            store.append(T1, frame("kept"));
+        }
+        // A compaction interrupted before and after writing its index, and a
+        // segment whose day index never made it to disk
+        Path staleSegment = Files.write(dir.resolve("20260101.1.seg"), frame("stale"));
+        Path unfinishedIndex = Files.write(dir.resolve("20260101.idx.tmp"), frame("unfinished"));
+        Path orphanSegment = Files.write(dir.resolve("20260102.0.seg"), frame("orphan"));
+
+        try (FrameStore store = FrameStore.open(dir)) {
+            assertFalse(Files.exists(staleSegment));
+            assertFalse(Files.exists(unfinishedIndex));
+            assertFalse(Files.exists(orphanSegment));
+            assertTrue(Files.exists(dir.resolve("20260101.0.seg")));
+            assertArrayEquals(frame("kept"), store.read(T1));
+        }
+    }
+
+    @Test
+    void timelineIsRebuiltFromDayIndexes() throws IOException {
+        try (FrameStore store = FrameStore.open(dir)) {
+            store.append(T1, frame("one"));
+            store.append(T2, frame("two"));
+            store.append(T3, frame("three"));
+            store.append(T2, frame("two, replaced"));
+            store.delete(T3);
+        }
+        List<FrameStore.Entry> expected = List.of(
+                new FrameStore.Entry(T1, frame("one").length),
+                new FrameStore.Entry(T2, frame("two, replaced").length));
+
+        // Lost, as after a crash before the first clean close
+        Files.delete(dir.resolve("timeline.map"));
+        try (FrameStore store = FrameStore.open(dir)) {
+            assertEquals(expected, store.index().range(Long.MIN_VALUE, Long.MAX_VALUE));
+            assertArrayEquals(frame("two, replaced"), store.read(T2));
+        }
+
+        // Not flagged clean: the header is overwritten with zeros
+        Files.write(dir.resolve("timeline.map"), new byte[64]);
+        try (FrameStore store = FrameStore.open(dir)) {
+            assertEquals(expected, store.index().range(Long.MIN_VALUE, Long.MAX_VALUE));
+            assertNull(store.read(T3));
+        }
+    }
+
+    @Test
+    void concurrentExportsToOnePath() throws Exception {
+        // Large enough that a copy takes a while, and of different lengths, so
+        // that one frame written over another would show
+        byte[] first = filled(3 << 20, 'a');
+        byte[] second = filled(2 << 20, 'b');
+        Path latest = dir.resolve("export").resolve("latest.jpg");
+        Files.createDirectories(latest.getParent());
+        try (FrameStore store = FrameStore.open(dir)) {
+            store.append(T1, first);
+            store.append(T2, second);
+
+            AtomicReference<Throwable> failure = new AtomicReference<>();
+            List<Thread> exporters = new ArrayList<>();
+            for (int t = 0; t < 4; t++) {
+                long timestamp = t % 2 == 0 ? T1 : T2;
+                exporters.add(Thread.ofPlatform().start(() -> {
+                    try {
+                        for (int i = 0; i < 25; i++) {
+                            store.export(timestamp, latest);
+                            byte[] read = Files.readAllBytes(latest);
+                            assertTrue(Arrays.equals(first, read) || Arrays.equals(second, read),
+                                    "torn export of " + read.length + " bytes");
+                        }
+                    } catch (Throwable e) {
+                        failure.compareAndSet(null, e);
+                    }
+                }));
+            }
+            for (Thread exporter : exporters) {
+                exporter.join();
+            }
+            if (failure.get() != null) {
+                throw new AssertionError("Concurrent export failed", failure.get());
+            }
+        }
+        try (Stream<Path> files = Files.list(latest.getParent())) {
+            assertEquals(List.of(latest), files.toList(), "temporary files left behind");
+        }
+    }
+}
@@ -0,0 +1,102 @@
+package in.virit.libcamera4j;
+
+import org.junit.jupiter.api.Test;
+
+import java.time.Duration;
+import java.util.List;
+
+import static org.junit.jupiter.api.Assertions.assertEquals;
+import static org.junit.jupiter.api.Assertions.assertTrue;
+
+/**
+ * Tests of the bucket layout and the percentiles of {@link LatencyHistogram}.
+ *
+ * <p>The buckets are filled natively ({@code LatencyHistogram::bucket} in
+ * stage_latency.cpp) and read back here by {@link LatencyHistogram#bucketStartUs},
+ * which duplicates that layout. The edges checked below are the same ones
+ * stage_latency_test.cpp checks on the native side, so a change to either
+ * breaks one of the two. Needs no native library.</p>
+ */
+class LatencyHistogramTest {
+
+    /**
+     * A histogram of {@code counts[i]} latencies in bucket {@code indexes[i]}.
+     */
+    private static LatencyHistogram histogram(long maxNs, int[] indexes, long[] counts) {
+        long[] buckets = new long[LatencyHistogram.BUCKETS];
+        long count = 0;
+        for (int i = 0; i < indexes.length; i++) {
+            buckets[indexes[i]] += counts[i];
+            count += counts[i];
+        }
+        return new LatencyHistogram(count, maxNs, buckets);
+    }
+
+    @Test
+    void bucketEdges() {
+        // One bucket per microsecond below 32
+        assertEquals(0, LatencyHistogram.bucketStartUs(0));
+        assertEquals(31, LatencyHistogram.bucketStartUs(31));
+        // Then 16 per doubling: 32 and 33 µs share bucket 32, 62 and 63 µs bucket 47
+        assertEquals(32, LatencyHistogram.bucketStartUs(32));
+        assertEquals(34, LatencyHistogram.bucketStartUs(33));
+        assertEquals(62, LatencyHistogram.bucketStartUs(47));
+        assertEquals(64, LatencyHistogram.bucketStartUs(48));
+        assertEquals(68, LatencyHistogram.bucketStartUs(49));
+        // The last bucket starts at 31 << 28 µs, about 2.3 hours
+        assertEquals(31L << 28, LatencyHistogram.bucketStartUs(LatencyHistogram.BUCKETS - 1));
+
+        for (int i = 1; i < LatencyHistogram.BUCKETS; i++) {
+            long width = LatencyHistogram.bucketStartUs(i) - LatencyHistogram.bucketStartUs(i - 1);
+            assertTrue(width >= 1, "bucket " + i + " does not start after the previous one");
+            // Known to within a sixteenth
+            assertTrue(i <= 32 || width * 16 <= LatencyHistogram.bucketStartUs(i - 1), "bucket " + i + " too wide");
+        }
+    }
+
+    @Test
+    void percentiles() {
+        // 90 latencies of 10 µs, 9 of 64-67 µs and one of 650 µs, in bucket 100 (640-671 µs)
+        LatencyHistogram histogram = histogram(650_000, new int[] {10, 48, 100}, new long[] {90, 9, 1});
+
+        assertEquals(Duration.ofNanos(10_999), histogram.percentile(0));
+        assertEquals(Duration.ofNanos(10_999), histogram.percentile(50));
+        assertEquals(Duration.ofNanos(10_999), histogram.percentile(90));
+        assertEquals(Duration.ofNanos(67_999), histogram.percentile(90.5));
+        assertEquals(Duration.ofNanos(67_999), histogram.percentile(99));
+        // The upper end of bucket 100 is 671.999 µs, but nothing took longer than the maximum
+        assertEquals(Duration.ofNanos(650_000), histogram.percentile(99.9));
+        assertEquals(Duration.ofNanos(650_000), histogram.percentile(100));
+        // Out of range percents are clamped
+        assertEquals(Duration.ofNanos(10_999), histogram.percentile(-5));
+        assertEquals(Duration.ofNanos(650_000), histogram.percentile(250));
+
+        assertEquals(List.of("p50", "p90", "p99", "p99.9", "max"), List.copyOf(histogram.percentiles().keySet()));
+        assertEquals(Duration.ofNanos(67_999), histogram.percentiles().get("p99"));
+        assertEquals(Duration.ofNanos(650_000), histogram.percentiles().get("max"));
+    }
+
+    @Test
+    void lastBucketReportsMaximum() {
+        // Everything beyond the last bucket's start lands in it; only the maximum tells how far
+        long maxNs = Duration.ofHours(5).toNanos();
+        LatencyHistogram histogram = histogram(maxNs, new int[] {LatencyHistogram.BUCKETS - 1}, new long[] {3});
+        assertEquals(Duration.ofNanos(maxNs), histogram.percentile(50));
+    }
+
+    @Test
+    void emptyAndSum() {
+        assertEquals(Duration.ZERO, LatencyHistogram.empty().percentile(99));
+
+        LatencyHistogram a = histogram(20_000, new int[] {10, 20}, new long[] {1, 1});
+        LatencyHistogram b = histogram(700_000, new int[] {10, 100}, new long[] {2, 1});
+        LatencyHistogram sum = a.plus(b).plus(LatencyHistogram.empty());
+        assertEquals(5, sum.count());
+        assertEquals(700_000, sum.maxNs());
+        assertEquals(3, sum.buckets()[10]);
+        assertEquals(1, sum.buckets()[20]);
+        assertEquals(1, sum.buckets()[100]);
+        assertEquals(Duration.ofNanos(10_999), sum.percentile(60));
+        assertEquals(Duration.ofNanos(20_999), sum.percentile(80));
+    }
+}
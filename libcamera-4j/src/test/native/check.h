@@ -0,0 +1,55 @@
+/*
+ * libcamera4j native tests - minimal checks.
+ *
+ * Each test is an executable of its own, registered with CTest. A failed CHECK
+ * or CHECK_EQ prints its location and lets the test go on; main returns
+ * lc4j_test::result() so that CTest sees whether any check failed.
+ */
+
+#ifndef LC4J_TEST_CHECK_H
+#define LC4J_TEST_CHECK_H
+
+#include <cstdio>
+#include <string>
+
+namespace lc4j_test {
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+inline void fail(const char* file, int line, const std::string& message) {
+    std::fprintf(stderr, "%s:%d: %s\n", file, line, message.c_str());
+    ++failures();
+}
+
+inline int result() {
+    if (failures() > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures());
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace lc4j_test
+
+#define CHECK(condition)                                                            \
+    do {                                                                            \
+        if (!(condition)) {                                                         \
+            lc4j_test::fail(__FILE__, __LINE__, "CHECK(" #condition ") failed");    \
+        }                                                                           \
+    } while (0)
+
+// For numbers: prints both values on failure
+#define CHECK_EQ(actual, expected)                                                  \
+    do {                                                                            \
+        const auto actual_ = (actual);                                              \
+        const auto expected_ = (expected);                                          \
+        if (!(actual_ == expected_)) {                                              \
+            lc4j_test::fail(__FILE__, __LINE__, #actual " is " + std::to_string(actual_) \
+                    + ", expected " + std::to_string(expected_));                   \
+        }                                                                           \
+    } while (0)
+
+#endif /* LC4J_TEST_CHECK_H */
@@ -0,0 +1,131 @@
+/*
+ * libcamera4j native tests - DirScanner.
+ *
+ * Builds a yyyy/MM/dd tree in a temporary directory with images next to names
+ * the scanner must skip, and checks the entries it returns. File names are
+ * local time; the test sets a time zone with daylight saving time so that the
+ * keys of a summer and a winter image differ in their offset.
+ */
+
+#include "check.h"
+#include "libcamera4j.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Finnish time without relying on an installed zoneinfo database
+constexpr const char* kTimeZone = "EET-2EEST,M3.5.0/3,M10.5.0/4";
+
+std::string g_root;
+
+void makeDirs(const std::string& relative) {
+    std::string path = g_root;
+    size_t start = 0;
+    while (start <= relative.size()) {
+        size_t end = relative.find('/', start);
+        if (end == std::string::npos) {
+            end = relative.size();
+        }
+        path += "/" + relative.substr(start, end - start);
+        mkdir(path.c_str(), 0755);
+        start = end + 1;
+    }
+}
+
+void writeFile(const std::string& relative, size_t size) {
+    std::ofstream(g_root + "/" + relative) << std::string(size, 'x');
+}
+
+// Milliseconds since the epoch of a UTC time
+int64_t utcMs(int year, int month, int day, int hour, int minute, int second) {
+    struct tm tm = {};
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = day;
+    tm.tm_hour = hour;
+    tm.tm_min = minute;
+    tm.tm_sec = second;
+    return static_cast<int64_t>(timegm(&tm)) * 1000;
+}
+
+void removeTree(const std::string& path) {
+    std::string command = "rm -rf '" + path + "'";
+    if (std::system(command.c_str()) != 0) {
+        std::fprintf(stderr, "could not remove %s\n", path.c_str());
+    }
+}
+
+void testScan() {
+    makeDirs("2026/01/15");
+    makeDirs("2026/03/29");
+    makeDirs("2026/3/30");          // month not two digits
+    makeDirs("2026/03/29/nested");
+    makeDirs("misc/01/01");
+
+    writeFile("2026/01/15/20260115_083000.jpg", 10);        // EET, UTC+2
+    writeFile("2026/03/29/20260329_120000.jpg", 20);        // EEST, UTC+3
+    writeFile("2026/03/29/20260329_000001.jpg", 30);        // EET before the switch at 03:00
+    writeFile("2026/03/29/20260329_120000.jpeg", 1);        // wrong extension
+    writeFile("2026/03/29/20260329-120000.jpg", 1);         // wrong separator
+    writeFile("2026/03/29/2026032_120000.jpg", 1);          // too short
+    writeFile("2026/03/29/20261329_120000.jpg", 1);         // month 13
+    writeFile("2026/03/29/20260329_240000.jpg", 1);         // hour 24
+    writeFile("2026/03/29/20260329_12000a.jpg", 1);         // not a number
+    writeFile("2026/03/29/latest.jpg", 1);
+    writeFile("2026/03/29/nested/20260329_130000.jpg", 1);  // below a day
+    writeFile("2026/3/30/20260330_120000.jpg", 1);
+    writeFile("misc/01/01/20260101_120000.jpg", 1);
+    writeFile("2026/20260101_120000.jpg", 1);               // above a day
+
+    int64_t scan = lc4j_scan_open(g_root.c_str(), 2);
+    CHECK(scan != 0);
+    if (scan == 0) {
+        return;
+    }
+    CHECK_EQ(lc4j_scan_count(scan), 3);
+    std::vector<lc4j_scan_entry> entries(4);
+    const int32_t count = lc4j_scan_entries(scan, entries.data(), static_cast<int32_t>(entries.size()));
+    CHECK_EQ(count, 3);
+    if (count == 3) {
+        // Sorted by timestamp
+        CHECK_EQ(entries[0].timestampMs, utcMs(2026, 1, 15, 6, 30, 0));
+        CHECK_EQ(entries[0].size, 10);
+        CHECK_EQ(entries[1].timestampMs, utcMs(2026, 3, 28, 22, 0, 1));
+        CHECK_EQ(entries[1].size, 30);
+        CHECK_EQ(entries[2].timestampMs, utcMs(2026, 3, 29, 9, 0, 0));
+        CHECK_EQ(entries[2].size, 20);
+
+        char dir[64];
+        CHECK(lc4j_scan_dir(scan, entries[0].dirId, dir, sizeof(dir)) > 0 && std::string(dir) == "2026/01/15");
+        CHECK(lc4j_scan_dir(scan, entries[2].dirId, dir, sizeof(dir)) > 0 && std::string(dir) == "2026/03/29");
+        CHECK_EQ(entries[1].dirId, entries[2].dirId);
+    }
+    lc4j_scan_close(scan);
+
+    CHECK_EQ(lc4j_scan_open((g_root + "/missing").c_str(), 1), 0);
+}
+
+} // namespace
+
+int main() {
+    setenv("TZ", kTimeZone, 1);
+    tzset();
+
+    char root[] = "/tmp/lc4j_dir_scanner_XXXXXX";
+    if (mkdtemp(root) == nullptr) {
+        std::perror("mkdtemp");
+        return 1;
+    }
+    g_root = root;
+    testScan();
+    removeTree(g_root);
+    return lc4j_test::result();
+}
@@ -0,0 +1,145 @@
+/*
+ * libcamera4j native tests - perceptual hashes.
+ *
+ * Captured frames are hashed from their mapped luma (perceptualHash); frames
+ * stored any other way are hashed later from the JPEG by
+ * lc4j_store_hash_frames. Thinning compares hashes of both kinds, so for the
+ * same image they have to agree to within a few bits, for every orientation
+ * the camera may be mounted in.
+ */
+
+#include "check.h"
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int32_t kWidth = 640;
+constexpr int32_t kHeight = 480;
+constexpr uint32_t kYuv420 = 'Y' | ('U' << 8) | ('1' << 16) | (static_cast<uint32_t>('2') << 24);
+// Most bits the two hashes of one image may differ in
+constexpr int kMaxDistance = 4;
+constexpr int64_t kFirstMs = 1767225600000;    // 2026-01-01T00:00:00Z
+constexpr uint32_t kScenes = 8;
+
+// A YUV420 frame of a dozen soft blobs on a gradient, placed from `seed`:
+// smooth like a photo, neither flat nor symmetric
+struct TestFrame {
+    std::vector<uint8_t> y, u, v;
+    lc4j::FrameView view;
+
+    TestFrame(uint32_t seed, bool inverted) : y(kWidth * kHeight), u(kWidth * kHeight / 4, 128), v(u) {
+        auto random = [&seed] {
+            seed = seed * 1664525u + 1013904223u;
+            return (seed >> 8) / 16777216.0;
+        };
+        struct Blob { double x, y, radius, amplitude; };
+        std::vector<Blob> blobs;
+        for (int32_t i = 0; i < 12; ++i) {
+            const double bx = random() * kWidth;
+            const double by = random() * kHeight;
+            const double radius = 20 + random() * 120;
+            blobs.push_back({bx, by, radius, (random() - 0.5) * 160});
+        }
+        const double slopeX = (random() - 0.5) * 0.3;
+        const double slopeY = (random() - 0.5) * 0.3;
+        for (int32_t row = 0; row < kHeight; ++row) {
+            for (int32_t col = 0; col < kWidth; ++col) {
+                double value = 128 + slopeX * (col - kWidth / 2) + slopeY * (row - kHeight / 2);
+                for (const Blob& b : blobs) {
+                    const double dx = col - b.x;
+                    const double dy = row - b.y;
+                    value += b.amplitude * std::exp(-(dx * dx + dy * dy) / (b.radius * b.radius));
+                }
+                value = inverted ? 255 - value : value;
+                y[row * kWidth + col] = static_cast<uint8_t>(std::lround(std::fmin(255, std::fmax(0, value))));
+            }
+        }
+        view.fourcc = kYuv420;
+        view.width = kWidth;
+        view.height = kHeight;
+        view.planes[0] = y.data();
+        view.planes[1] = u.data();
+        view.planes[2] = v.data();
+        view.strides[0] = kWidth;
+        view.strides[1] = kWidth / 2;
+        view.strides[2] = kWidth / 2;
+    }
+};
+
+int distance(uint64_t a, uint64_t b) {
+    return __builtin_popcountll(a ^ b);
+}
+
+void testCaptureAndBackfillAgree(const std::string& root, uint32_t scene) {
+    const TestFrame frame(scene, false);
+    // Identity, 180 degrees, and the two 90 degree turns
+    const int32_t transforms[] = {0, 3, 5, 6};
+    constexpr int32_t kTransforms = sizeof(transforms) / sizeof(transforms[0]);
+    uint64_t captured[kTransforms];
+
+    const int64_t firstMs = kFirstMs + scene * 86400000LL;
+    int64_t store = lc4j_store_open(root.c_str());
+    CHECK(store != 0);
+    if (store == 0) {
+        return;
+    }
+    for (int32_t i = 0; i < kTransforms; ++i) {
+        CHECK_EQ(lc4j::perceptualHash(frame.view, transforms[i], captured[i]), 0);
+        std::vector<uint8_t> jpeg;
+        CHECK_EQ(lc4j::encodeJpeg(frame.view, transforms[i], 90, jpeg), 0);
+        // Stored untagged, as by Java or the legacy migration
+        CHECK_EQ(lc4j_store_append(store, firstMs + i * 1000, jpeg.data(), static_cast<int64_t>(jpeg.size())), 0);
+    }
+    CHECK_EQ(lc4j_store_hash_frames(store, firstMs, firstMs + kTransforms * 1000), kTransforms);
+
+    lc4j_store_record records[kTransforms];
+    const int32_t count = lc4j_store_list_tags(store, firstMs, firstMs + kTransforms * 1000, records, kTransforms);
+    CHECK_EQ(count, kTransforms);
+    for (int32_t i = 0; i < count; ++i) {
+        CHECK(records[i].flags & LC4J_STORE_TAGGED);
+        const uint64_t backfilled = static_cast<uint64_t>(records[i].tag);
+        if (distance(captured[i], backfilled) > kMaxDistance) {
+            lc4j_test::fail(__FILE__, __LINE__, "scene " + std::to_string(scene) + ", transform "
+                    + std::to_string(transforms[i]) + ": hashes differ in "
+                    + std::to_string(distance(captured[i], backfilled)) + " bits");
+        }
+    }
+    // The orientations are told apart, or agreeing would prove nothing
+    CHECK(distance(captured[0], captured[1]) > 16);
+    CHECK(distance(captured[2], captured[3]) > 16);
+
+    // Hashing again skips frames already tagged
+    CHECK_EQ(lc4j_store_hash_frames(store, firstMs, firstMs + kTransforms * 1000), 0);
+    lc4j_store_close(store);
+}
+
+void testDifferentImagesDiffer() {
+    uint64_t hash, inverted, other;
+    CHECK_EQ(lc4j::perceptualHash(TestFrame(1, false).view, 0, hash), 0);
+    CHECK_EQ(lc4j::perceptualHash(TestFrame(1, true).view, 0, inverted), 0);
+    CHECK_EQ(lc4j::perceptualHash(TestFrame(2, false).view, 0, other), 0);
+    CHECK(distance(hash, inverted) > 32);
+    CHECK(distance(hash, other) > 16);
+}
+
+} // namespace
+
+int main() {
+    char root[] = "/tmp/lc4j_frame_hasher_XXXXXX";
+    if (mkdtemp(root) == nullptr) {
+        std::perror("mkdtemp");
+        return 1;
+    }
+    for (uint32_t scene = 1; scene <= kScenes; ++scene) {
+        testCaptureAndBackfillAgree(root, scene);
+    }
+    testDifferentImagesDiffer();
+    std::system((std::string("rm -rf '") + root + "'").c_str());
+    return lc4j_test::result();
+}
@@ -0,0 +1,174 @@
+/*
+ * libcamera4j native tests - frame registration.
+ *
+ * A textured plane is sampled twice, the second time with its content moved
+ * by a known fraction of a pixel or turned slightly about the centre, and
+ * estimateMotion must measure that motion back, also with part of the frame
+ * moving its own way. Frames it cannot tell apart, flat ones or two different
+ * scenes, must be refused rather than guessed at.
+ */
+
+#include "check.h"
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int32_t kWidth = 640;
+constexpr int32_t kHeight = 480;
+// How close the measured motion must be, in pixels at the frame's edge
+constexpr double kTolerance = 0.25;
+
+// Waves of random direction, wavelength and phase, placed from `seed`: a
+// texture without a period that is defined between the pixels too
+class Texture {
+public:
+    explicit Texture(uint32_t seed) : seed_(seed) {
+        for (int32_t i = 0; i < 40; ++i) {
+            const double direction = random() * 6.283185307179586;
+            const double frequency = 0.03 + random() * 0.4;
+            waves_.push_back({std::cos(direction) * frequency, std::sin(direction) * frequency,
+                              random() * 6.283185307179586});
+        }
+    }
+
+    double operator()(double x, double y) const {
+        double value = 0;
+        for (const Wave& w : waves_) {
+            value += std::sin(w.fx * x + w.fy * y + w.phase);
+        }
+        return 128 + value * 12;
+    }
+
+private:
+    struct Wave {
+        double fx, fy, phase;
+    };
+
+    uint32_t seed_;
+    std::vector<Wave> waves_;
+
+    double random() {
+        seed_ = seed_ * 1664525u + 1013904223u;
+        return (seed_ >> 8) / 16777216.0;
+    }
+};
+
+// Luma of the texture with its content turned by `angle` about the centre
+// and then moved by (dx, dy) pixels, scaled by `gain`
+std::vector<uint8_t> luma(const Texture& texture, double dx, double dy, double angle = 0.0, double gain = 1.0) {
+    std::vector<uint8_t> plane(static_cast<size_t>(kWidth) * kHeight);
+    const double cx = kWidth * 0.5;
+    const double cy = kHeight * 0.5;
+    const double c = std::cos(angle);
+    const double s = std::sin(angle);
+    for (int32_t y = 0; y < kHeight; ++y) {
+        for (int32_t x = 0; x < kWidth; ++x) {
+            // Where the content at (x, y) came from
+            const double qx = x - cx - dx;
+            const double qy = y - cy - dy;
+            const double px = c * qx + s * qy + cx;
+            const double py = -s * qx + c * qy + cy;
+            const double value = texture(px, py) * gain;
+            plane[static_cast<size_t>(y) * kWidth + x] =
+                    static_cast<uint8_t>(std::lround(std::fmin(255, std::fmax(0, value))));
+        }
+    }
+    return plane;
+}
+
+void checkMotion(const lc4j::RigidMotion& motion, double dx, double dy, double angle, const std::string& what) {
+    const double errorX = std::fabs(motion.shiftX * kWidth - dx);
+    const double errorY = std::fabs(motion.shiftY * kWidth - dy);
+    // The angle's error, as the distance it moves a corner
+    const double errorAngle = std::fabs(motion.angle - angle) * std::hypot(kWidth, kHeight) * 0.5;
+    if (errorX > kTolerance || errorY > kTolerance || errorAngle > kTolerance) {
+        lc4j_test::fail(__FILE__, __LINE__, what + ": measured (" + std::to_string(motion.shiftX * kWidth) + ", "
+                + std::to_string(motion.shiftY * kWidth) + ") turned " + std::to_string(motion.angle)
+                + ", expected (" + std::to_string(dx) + ", " + std::to_string(dy) + ") turned "
+                + std::to_string(angle));
+    }
+}
+
+void testShift() {
+    const Texture texture(5);
+    const std::vector<uint8_t> previous = luma(texture, 0, 0);
+    const double shifts[][2] = {{2.3, -1.6}, {-0.4, 0.7}, {7.75, 3.25}, {0, 0}};
+    for (const auto& shift : shifts) {
+        const std::vector<uint8_t> current = luma(texture, shift[0], shift[1]);
+        lc4j::RigidMotion motion;
+        CHECK(lc4j::estimateMotion(previous.data(), current.data(), kWidth, kHeight, motion));
+        checkMotion(motion, shift[0], shift[1], 0.0, "shift " + std::to_string(shift[0]) + ", "
+                + std::to_string(shift[1]));
+    }
+}
+
+void testRotation() {
+    const Texture texture(9);
+    const std::vector<uint8_t> previous = luma(texture, 0, 0);
+    // A third of a degree, a couple of pixels at the tiles
+    for (double angle : {0.006, -0.004}) {
+        const std::vector<uint8_t> current = luma(texture, 1.5, -0.5, angle);
+        lc4j::RigidMotion motion;
+        CHECK(lc4j::estimateMotion(previous.data(), current.data(), kWidth, kHeight, motion));
+        checkMotion(motion, 1.5, -0.5, angle, "angle " + std::to_string(angle));
+    }
+}
+
+void testOutlier() {
+    // A boat crossing the top left corner, moving its own way
+    const Texture texture(17);
+    const std::vector<uint8_t> previous = luma(texture, 0, 0);
+    std::vector<uint8_t> current = luma(texture, 1.5, -0.5, 0.004);
+    const std::vector<uint8_t> boat = luma(texture, 7.5, 3.5);
+    for (int32_t y = 40; y < 260; ++y) {
+        for (int32_t x = 40; x < 260; ++x) {
+            current[static_cast<size_t>(y) * kWidth + x] = boat[static_cast<size_t>(y) * kWidth + x];
+        }
+    }
+    lc4j::RigidMotion motion;
+    CHECK(lc4j::estimateMotion(previous.data(), current.data(), kWidth, kHeight, motion));
+    checkMotion(motion, 1.5, -0.5, 0.004, "boat");
+}
+
+void testBrightnessChange() {
+    // The cloud moved off the sun between the frames
+    const Texture texture(13);
+    const std::vector<uint8_t> previous = luma(texture, 0, 0);
+    const std::vector<uint8_t> current = luma(texture, -1.25, 2.5, 0.0, 1.4);
+    lc4j::RigidMotion motion;
+    CHECK(lc4j::estimateMotion(previous.data(), current.data(), kWidth, kHeight, motion));
+    checkMotion(motion, -1.25, 2.5, 0.0, "brighter");
+}
+
+void testRefuses() {
+    lc4j::RigidMotion motion;
+    // Flat, as in the dark
+    const std::vector<uint8_t> flat(static_cast<size_t>(kWidth) * kHeight, 40);
+    CHECK(!lc4j::estimateMotion(flat.data(), flat.data(), kWidth, kHeight, motion));
+    const std::vector<uint8_t> textured = luma(Texture(5), 0, 0);
+    CHECK(!lc4j::estimateMotion(flat.data(), textured.data(), kWidth, kHeight, motion));
+
+    // Another scene altogether
+    const std::vector<uint8_t> other = luma(Texture(21), 0, 0);
+    CHECK(!lc4j::estimateMotion(textured.data(), other.data(), kWidth, kHeight, motion));
+
+    // Smaller than two tiles
+    CHECK(!lc4j::estimateMotion(textured.data(), textured.data(), 200, 200, motion));
+}
+
+} // namespace
+
+int main() {
+    testShift();
+    testRotation();
+    testOutlier();
+    testBrightnessChange();
+    testRefuses();
+    return lc4j_test::result();
+}
@@ -0,0 +1,177 @@
+/*
+ * libcamera4j native tests - frame sequence tracking.
+ *
+ * Feeds FrameSequence::record known sequence numbers and timestamps, as the
+ * completion handlers do for every buffer, and checks the dropped, duplicate
+ * and late counts and the interval statistics read back from it.
+ */
+
+#include "check.h"
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <cmath>
+#include <cstdint>
+
+namespace {
+
+constexpr int64_t kMs = 1000000;
+constexpr int64_t kInterval = 33 * kMs;
+constexpr int64_t kDelay = 5 * kMs;
+
+// Within a nanosecond: the means are kept in floating point
+#define CHECK_NEAR(actual, expected) CHECK(std::fabs((actual) - (expected)) < 1.0)
+
+lc4j_sequence_stats snapshot(lc4j::FrameSequence& sequence, bool reset = false) {
+    lc4j_sequence_stats stats;
+    sequence.snapshot(stats, reset);
+    return stats;
+}
+
+// Frames first..last, exposed kInterval apart and completed kDelay later
+void recordSteady(lc4j::FrameSequence& sequence, uint32_t first, uint32_t last, int64_t startNs = kInterval) {
+    for (uint32_t n = first; n <= last; ++n) {
+        const int64_t timestampNs = startNs + (n - first) * kInterval;
+        sequence.record(n, timestampNs, timestampNs + kDelay);
+    }
+}
+
+void testSteady() {
+    lc4j::FrameSequence sequence;
+    recordSteady(sequence, 0, 9);
+    const lc4j_sequence_stats stats = snapshot(sequence);
+    CHECK_EQ(stats.frames, 10);
+    CHECK_EQ(stats.dropped, 0);
+    CHECK_EQ(stats.duplicates, 0);
+    CHECK_EQ(stats.late, 0);
+    CHECK_EQ(stats.lastSequence, 9);
+    CHECK_EQ(stats.intervals, 9);
+    CHECK_NEAR(stats.meanIntervalNs, kInterval);
+    CHECK_NEAR(stats.jitterNs, 0.0);
+    CHECK_EQ(stats.minIntervalNs, kInterval);
+    CHECK_EQ(stats.maxIntervalNs, kInterval);
+    CHECK_NEAR(stats.meanLatencyNs, kDelay);
+}
+
+void testDropped() {
+    lc4j::FrameSequence sequence;
+    // 3 and 4 skipped, then 7
+    for (uint32_t n : {0u, 1u, 2u, 5u, 6u, 8u}) {
+        sequence.record(n, kInterval * (n + 1), kInterval * (n + 1) + kDelay);
+    }
+    const lc4j_sequence_stats stats = snapshot(sequence);
+    CHECK_EQ(stats.frames, 6);
+    CHECK_EQ(stats.dropped, 3);
+    CHECK_EQ(stats.duplicates, 0);
+    // Only between consecutive frames: 0-1, 1-2 and 5-6
+    CHECK_EQ(stats.intervals, 3);
+    CHECK_NEAR(stats.meanIntervalNs, kInterval);
+    CHECK_EQ(stats.maxIntervalNs, kInterval);
+}
+
+void testDuplicates() {
+    lc4j::FrameSequence sequence;
+    // 1 handed back twice, then a number going back
+    for (uint32_t n : {0u, 1u, 1u, 2u, 0u, 3u}) {
+        sequence.record(n, kInterval * (n + 1), kInterval * (n + 1) + kDelay);
+    }
+    const lc4j_sequence_stats stats = snapshot(sequence);
+    CHECK_EQ(stats.frames, 4);
+    CHECK_EQ(stats.duplicates, 2);
+    CHECK_EQ(stats.dropped, 0);
+    CHECK_EQ(stats.lastSequence, 3);
+    CHECK_EQ(stats.intervals, 3);
+}
+
+void testLate() {
+    lc4j::FrameSequence sequence;
+    recordSteady(sequence, 0, 9);
+    // Within one frame interval of the usual delay: not late
+    int64_t timestampNs = 11 * kInterval;
+    sequence.record(10, timestampNs, timestampNs + kDelay + kInterval - kMs);
+    // After the next frame should have completed: late
+    timestampNs += kInterval;
+    sequence.record(11, timestampNs, timestampNs + kDelay + kInterval + 5 * kMs);
+    CHECK_EQ(snapshot(sequence).late, 1);
+
+    // Not before a few intervals are known
+    lc4j::FrameSequence warmingUp;
+    recordSteady(warmingUp, 0, 2);
+    warmingUp.record(3, 4 * kInterval, 4 * kInterval + kDelay + 3 * kInterval);
+    CHECK_EQ(snapshot(warmingUp).late, 0);
+}
+
+void testJitter() {
+    lc4j::FrameSequence sequence;
+    // Intervals alternating 30 and 36 ms: mean 33 ms, standard deviation 3 ms
+    int64_t timestampNs = kInterval;
+    for (uint32_t n = 0; n <= 8; ++n) {
+        sequence.record(n, timestampNs, timestampNs + kDelay);
+        timestampNs += n % 2 == 0 ? 30 * kMs : 36 * kMs;
+    }
+    const lc4j_sequence_stats stats = snapshot(sequence);
+    CHECK_EQ(stats.intervals, 8);
+    CHECK_NEAR(stats.meanIntervalNs, kInterval);
+    CHECK_NEAR(stats.jitterNs, 3.0 * kMs);
+    CHECK_EQ(stats.minIntervalNs, 30 * kMs);
+    CHECK_EQ(stats.maxIntervalNs, 36 * kMs);
+    CHECK_EQ(stats.late, 0);
+}
+
+void testRestart() {
+    lc4j::FrameSequence sequence;
+    recordSteady(sequence, 100, 109);
+    // The camera started again: numbers start over, counts are kept
+    sequence.restart();
+    recordSteady(sequence, 0, 4, 20 * kInterval);
+    lc4j_sequence_stats stats = snapshot(sequence);
+    CHECK_EQ(stats.frames, 15);
+    CHECK_EQ(stats.duplicates, 0);
+    CHECK_EQ(stats.dropped, 0);
+    CHECK_EQ(stats.intervals, 13);
+
+    // Reconfigured to 10 fps with a longer delay: what was learned at 30 fps
+    // would make every frame late
+    sequence.restart(true);
+    for (uint32_t n = 0; n < 10; ++n) {
+        const int64_t timestampNs = 40 * kInterval + n * 100 * kMs;
+        sequence.record(n, timestampNs, timestampNs + 60 * kMs);
+    }
+    stats = snapshot(sequence);
+    CHECK_EQ(stats.frames, 25);
+    CHECK_EQ(stats.late, 0);
+    CHECK_EQ(stats.intervals, 9);
+    CHECK_NEAR(stats.meanIntervalNs, 100.0 * kMs);
+    CHECK_EQ(stats.minIntervalNs, 100 * kMs);
+    CHECK_NEAR(stats.meanLatencyNs, 60.0 * kMs);
+}
+
+void testReset() {
+    lc4j::FrameSequence sequence;
+    recordSteady(sequence, 0, 4);
+    const lc4j_sequence_stats before = snapshot(sequence, true);
+    CHECK_EQ(before.frames, 5);
+    const lc4j_sequence_stats cleared = snapshot(sequence);
+    CHECK_EQ(cleared.frames, 0);
+    CHECK_EQ(cleared.intervals, 0);
+    CHECK_EQ(cleared.lastSequence, 4);
+
+    // The last frame is kept, so a gap across the reset still counts
+    sequence.record(7, 8 * kInterval, 8 * kInterval + kDelay);
+    const lc4j_sequence_stats after = snapshot(sequence);
+    CHECK_EQ(after.frames, 1);
+    CHECK_EQ(after.dropped, 2);
+}
+
+} // namespace
+
+int main() {
+    testSteady();
+    testDropped();
+    testDuplicates();
+    testLate();
+    testJitter();
+    testRestart();
+    testReset();
+    return lc4j_test::result();
+}
@@ -0,0 +1,380 @@
+/*
+ * libcamera4j native tests - burst averaging.
+ *
+ * Frames of one synthetic scene, moved by known whole pixels, go through
+ * FrameStack as the frames of a burst would: the shift of each must be found,
+ * in whole Bayer quads for raw, and the average of the aligned frames must be
+ * the first frame again. The average of differing frames is checked against
+ * rounding to nearest, and a full burst of samples near the top of the raw
+ * range against overflowing the 16-bit sums.
+ */
+
+#include "check.h"
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr int32_t kWidth = 640;
+constexpr int32_t kHeight = 480;
+constexpr uint32_t kYuv420 = lc4j::fourcc('Y', 'U', '1', '2');
+constexpr uint32_t kBayer16 = lc4j::fourcc('B', 'Y', 'R', '2');
+// Rows of the test frames are padded, as libcamera's often are
+constexpr int32_t kPadding = 64;
+// Largest shift used below; the edges within it are replicated, not compared
+constexpr int32_t kMargin = 16;
+
+// Soft blobs with a fine texture on top, placed from `seed`, at any integer
+// position: something the pyramid search can line up
+class Scene {
+public:
+    explicit Scene(uint32_t seed) : seed_(seed) {
+        for (int32_t i = 0; i < 12; ++i) {
+            const double bx = random() * kWidth;
+            const double by = random() * kHeight;
+            const double radius = 20 + random() * 120;
+            blobs_.push_back({bx, by, radius, (random() - 0.5) * 160});
+        }
+    }
+
+    uint8_t operator()(int32_t x, int32_t y) const {
+        double value = 128;
+        for (const Blob& b : blobs_) {
+            const double dx = x - b.x;
+            const double dy = y - b.y;
+            value += b.amplitude * std::exp(-(dx * dx + dy * dy) / (b.radius * b.radius));
+        }
+        const uint32_t hash = (static_cast<uint32_t>(x) * 73856093u) ^ (static_cast<uint32_t>(y) * 19349663u);
+        value += static_cast<int32_t>((hash >> 7) % 17) - 8;
+        return static_cast<uint8_t>(std::lround(std::fmin(255, std::fmax(0, value))));
+    }
+
+private:
+    struct Blob {
+        double x, y, radius, amplitude;
+    };
+
+    uint32_t seed_;
+    std::vector<Blob> blobs_;
+
+    double random() {
+        seed_ = seed_ * 1664525u + 1013904223u;
+        return (seed_ >> 8) / 16777216.0;
+    }
+};
+
+// Sample of plane 0-2 at (x, y) of that plane
+using YuvSamples = std::function<uint8_t(int32_t plane, int32_t x, int32_t y)>;
+
+struct YuvFrame {
+    std::vector<uint8_t> planes[3];
+    lc4j::FrameView view;
+
+    explicit YuvFrame(const YuvSamples& samples) {
+        view.fourcc = kYuv420;
+        view.width = kWidth;
+        view.height = kHeight;
+        for (int32_t p = 0; p < 3; ++p) {
+            const int32_t w = p == 0 ? kWidth : kWidth / 2;
+            const int32_t h = p == 0 ? kHeight : kHeight / 2;
+            const int32_t stride = w + kPadding;
+            planes[p].assign(static_cast<size_t>(stride) * h, 0);
+            for (int32_t y = 0; y < h; ++y) {
+                for (int32_t x = 0; x < w; ++x) {
+                    planes[p][static_cast<size_t>(y) * stride + x] = samples(p, x, y);
+                }
+            }
+            view.planes[p] = planes[p].data();
+            view.strides[p] = stride;
+        }
+    }
+};
+
+// The scene with its content moved by (dx, dy) pixels; chroma by half as
+// much, so whole only for even shifts
+YuvSamples moved(const Scene& scene, int32_t dx, int32_t dy) {
+    return [&scene, dx, dy](int32_t plane, int32_t x, int32_t y) -> uint8_t {
+        if (plane == 0) {
+            return scene(x - dx, y - dy);
+        }
+        const uint8_t luma = scene(2 * x - dx, 2 * y - dy);
+        return static_cast<uint8_t>(plane == 1 ? 64 + luma / 2 : 192 - luma / 2);
+    };
+}
+
+// Unpacked 16-bit Bayer samples
+struct RawFrame {
+    std::vector<uint8_t> bytes;
+    lc4j::FrameView view;
+
+    explicit RawFrame(const std::function<uint16_t(int32_t x, int32_t y)>& samples) {
+        const int32_t stride = kWidth * 2 + kPadding;
+        bytes.assign(static_cast<size_t>(stride) * kHeight, 0);
+        for (int32_t y = 0; y < kHeight; ++y) {
+            for (int32_t x = 0; x < kWidth; ++x) {
+                const uint16_t sample = samples(x, y);
+                bytes[static_cast<size_t>(y) * stride + x * 2] = static_cast<uint8_t>(sample);
+                bytes[static_cast<size_t>(y) * stride + x * 2 + 1] = static_cast<uint8_t>(sample >> 8);
+            }
+        }
+        view.fourcc = kBayer16;
+        view.width = kWidth;
+        view.height = kHeight;
+        view.planes[0] = bytes.data();
+        view.strides[0] = stride;
+    }
+};
+
+lc4j::RawInfo rawInfo(int32_t bitDepth) {
+    lc4j::RawInfo info;
+    info.bitDepth = bitDepth;
+    info.packing = lc4j::RawPacking::Unpacked16;
+    return info;
+}
+
+// Bayer position of a sample, 0-3 row-major in its quad
+int32_t colourOf(int32_t x, int32_t y) {
+    return (x & 1) + (y & 1) * 2;
+}
+
+// 10-bit Bayer of the scene moved by (dx, dy) pixels, one scene pixel per
+// quad, each colour in a range of its own
+std::function<uint16_t(int32_t, int32_t)> movedRaw(const Scene& scene, int32_t dx, int32_t dy) {
+    return [&scene, dx, dy](int32_t x, int32_t y) {
+        return static_cast<uint16_t>(colourOf(x, y) * 200 + scene((x - dx) >> 1, (y - dy) >> 1) / 2);
+    };
+}
+
+uint16_t rawSample(const lc4j::OwnedFrame& out, int32_t x, int32_t y) {
+    const uint8_t* p = out.view.planes[0] + static_cast<size_t>(y) * out.view.strides[0] + x * 2;
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+// Counts samples of `out` off from `expected` within the margin, per plane
+void checkYuv(const lc4j::OwnedFrame& out, const YuvSamples& expected, int32_t margin, const std::string& what) {
+    for (int32_t p = 0; p < 3; ++p) {
+        const int32_t w = p == 0 ? kWidth : kWidth / 2;
+        const int32_t h = p == 0 ? kHeight : kHeight / 2;
+        const int32_t m = p == 0 ? margin : margin / 2;
+        int32_t wrong = 0;
+        for (int32_t y = m; y < h - m; ++y) {
+            for (int32_t x = m; x < w - m; ++x) {
+                wrong += out.view.planes[p][static_cast<size_t>(y) * out.view.strides[p] + x] != expected(p, x, y);
+            }
+        }
+        if (wrong != 0) {
+            lc4j_test::fail(__FILE__, __LINE__, what + ": " + std::to_string(wrong) + " samples of plane "
+                    + std::to_string(p) + " wrong");
+        }
+    }
+}
+
+void testAlignYuv() {
+    const Scene scene(7);
+    lc4j::FrameStack stack;
+    CHECK_EQ(stack.begin(YuvFrame(moved(scene, 0, 0)).view, nullptr, 4, true), 0);
+    const int32_t shifts[][2] = {{6, -4}, {-5, 3}, {12, 10}};
+    for (const auto& shift : shifts) {
+        CHECK_EQ(stack.add(YuvFrame(moved(scene, shift[0], shift[1])).view), 0);
+        CHECK_EQ(stack.shiftX(), shift[0]);
+        CHECK_EQ(stack.shiftY(), shift[1]);
+    }
+    CHECK_EQ(stack.count(), 4);
+
+    // Aligned, frames moved by even shifts add up to the first one again
+    lc4j::FrameStack even;
+    CHECK_EQ(even.begin(YuvFrame(moved(scene, 0, 0)).view, nullptr, 4, true), 0);
+    for (const auto& shift : {std::make_pair(6, -4), std::make_pair(-8, 2), std::make_pair(14, 16)}) {
+        CHECK_EQ(even.add(YuvFrame(moved(scene, shift.first, shift.second)).view), 0);
+    }
+    lc4j::OwnedFrame out;
+    CHECK_EQ(even.average(out, nullptr), 0);
+    CHECK_EQ(out.view.fourcc, kYuv420);
+    checkYuv(out, moved(scene, 0, 0), kMargin, "aligned");
+}
+
+void testAlignRaw() {
+    const Scene scene(11);
+    const lc4j::RawInfo info = rawInfo(10);
+    lc4j::FrameStack stack;
+    CHECK_EQ(stack.begin(RawFrame(movedRaw(scene, 0, 0)).view, &info, 3, true), 0);
+    // Shifts in whole quads, found on the quad pyramid
+    CHECK_EQ(stack.add(RawFrame(movedRaw(scene, 4, -6)).view), 0);
+    CHECK_EQ(stack.shiftX(), 4);
+    CHECK_EQ(stack.shiftY(), -6);
+    CHECK_EQ(stack.add(RawFrame(movedRaw(scene, -8, 2)).view), 0);
+    CHECK_EQ(stack.shiftX(), -8);
+    CHECK_EQ(stack.shiftY(), 2);
+
+    // Three frames gain a bit of precision: twice the first frame
+    lc4j::OwnedFrame out;
+    lc4j::RawInfo outInfo;
+    CHECK_EQ(stack.average(out, &outInfo), 0);
+    CHECK_EQ(outInfo.bitDepth, 11);
+    CHECK(outInfo.packing == lc4j::RawPacking::Unpacked16);
+    const auto first = movedRaw(scene, 0, 0);
+    int32_t wrong = 0;
+    for (int32_t y = kMargin; y < kHeight - kMargin; ++y) {
+        for (int32_t x = kMargin; x < kWidth - kMargin; ++x) {
+            wrong += rawSample(out, x, y) != first(x, y) * 2;
+        }
+    }
+    CHECK_EQ(wrong, 0);
+    // The edges are repeated a quad at a time, keeping every sample's colour
+    wrong = 0;
+    for (int32_t y = 0; y < kHeight; ++y) {
+        for (int32_t x = 0; x < kWidth; ++x) {
+            const int32_t level = rawSample(out, x, y) / 2 - colourOf(x, y) * 200;
+            wrong += level < 0 || level > 127;
+        }
+    }
+    CHECK_EQ(wrong, 0);
+}
+
+void testRawHeadroom() {
+    // A full burst of 14-bit samples near white would overflow 16-bit sums
+    // but for the two bits dropped as they are added
+    const auto bright = [](int32_t x, int32_t y) { return static_cast<uint16_t>(16383 - (x * 3 + y) % 29); };
+    const lc4j::RawInfo info = rawInfo(14);
+    const RawFrame frame(bright);
+    lc4j::FrameStack stack;
+    CHECK_EQ(stack.begin(frame.view, &info, LC4J_BURST_MAX_FRAMES, false), 0);
+    for (int32_t i = 1; i < LC4J_BURST_MAX_FRAMES; ++i) {
+        CHECK_EQ(stack.add(frame.view), 0);
+    }
+    CHECK_EQ(stack.add(frame.view), -ENOSPC);
+    lc4j::OwnedFrame out;
+    lc4j::RawInfo outInfo;
+    CHECK_EQ(stack.average(out, &outInfo), 0);
+    CHECK_EQ(outInfo.bitDepth, 16);
+    int32_t wrong = 0;
+    for (int32_t y = 0; y < kHeight; ++y) {
+        for (int32_t x = 0; x < kWidth; ++x) {
+            wrong += rawSample(out, x, y) != ((bright(x, y) >> 2) << 4);
+        }
+    }
+    CHECK_EQ(wrong, 0);
+
+    // 12 bits fit as they are: the input, four bits up
+    const lc4j::RawInfo info12 = rawInfo(12);
+    const auto bright12 = [&bright](int32_t x, int32_t y) { return static_cast<uint16_t>(bright(x, y) >> 2); };
+    const RawFrame frame12(bright12);
+    CHECK_EQ(stack.begin(frame12.view, &info12, LC4J_BURST_MAX_FRAMES, false), 0);
+    for (int32_t i = 1; i < LC4J_BURST_MAX_FRAMES; ++i) {
+        stack.add(frame12.view);
+    }
+    CHECK_EQ(stack.average(out, &outInfo), 0);
+    CHECK_EQ(outInfo.bitDepth, 16);
+    wrong = 0;
+    for (int32_t y = 0; y < kHeight; ++y) {
+        for (int32_t x = 0; x < kWidth; ++x) {
+            wrong += rawSample(out, x, y) != bright12(x, y) << 4;
+        }
+    }
+    CHECK_EQ(wrong, 0);
+}
+
+void testRounding() {
+    // Frames of independent samples over the whole range: every sum of n of
+    // them is divided to the nearest, halves up
+    for (int32_t n : {2, 3, 5, 7, LC4J_BURST_MAX_FRAMES}) {
+        auto sample = [](int32_t frame, int32_t plane, int32_t x, int32_t y) {
+            uint32_t h = static_cast<uint32_t>(frame * 7919 + plane * 104729) ^ (static_cast<uint32_t>(x) * 73856093u)
+                       ^ (static_cast<uint32_t>(y) * 19349663u);
+            h = (h ^ (h >> 13)) * 0x5bd1e995u;
+            return static_cast<uint8_t>(h >> 24);
+        };
+        lc4j::FrameStack stack;
+        for (int32_t i = 0; i < n; ++i) {
+            const YuvFrame frame([&](int32_t p, int32_t x, int32_t y) { return sample(i, p, x, y); });
+            CHECK_EQ(i == 0 ? stack.begin(frame.view, nullptr, n, false) : stack.add(frame.view), 0);
+        }
+        lc4j::OwnedFrame out;
+        CHECK_EQ(stack.average(out, nullptr), 0);
+        checkYuv(out, [&](int32_t p, int32_t x, int32_t y) {
+            int32_t sum = 0;
+            for (int32_t i = 0; i < n; ++i) {
+                sum += sample(i, p, x, y);
+            }
+            return static_cast<uint8_t>((sum + n / 2) / n);
+        }, 0, std::to_string(n) + " frames");
+    }
+
+    // Two frames of 10 and 11 average to 11
+    lc4j::FrameStack stack;
+    CHECK_EQ(stack.begin(YuvFrame([](int32_t, int32_t, int32_t) { return uint8_t{10}; }).view, nullptr, 2, false), 0);
+    CHECK_EQ(stack.add(YuvFrame([](int32_t, int32_t, int32_t) { return uint8_t{11}; }).view), 0);
+    lc4j::OwnedFrame out;
+    CHECK_EQ(stack.average(out, nullptr), 0);
+    CHECK_EQ(out.view.planes[0][0], 11);
+
+    // So do raw samples, at the precision gained: 3 frames of 100, 100 and
+    // 101 make 100.33, or 200.67 with the extra bit
+    const lc4j::RawInfo info = rawInfo(10);
+    const RawFrame low([](int32_t, int32_t) { return uint16_t{100}; });
+    const RawFrame high([](int32_t, int32_t) { return uint16_t{101}; });
+    CHECK_EQ(stack.begin(low.view, &info, 3, false), 0);
+    CHECK_EQ(stack.add(low.view), 0);
+    CHECK_EQ(stack.add(high.view), 0);
+    lc4j::RawInfo outInfo;
+    CHECK_EQ(stack.average(out, &outInfo), 0);
+    CHECK_EQ(outInfo.bitDepth, 11);
+    CHECK_EQ(rawSample(out, 0, 0), 201);
+}
+
+void testIdentical() {
+    // A full burst of one frame, aligned: nothing moves and nothing changes
+    const Scene scene(3);
+    const YuvFrame frame(moved(scene, 0, 0));
+    lc4j::FrameStack stack;
+    CHECK_EQ(stack.begin(frame.view, nullptr, LC4J_BURST_MAX_FRAMES, true), 0);
+    for (int32_t i = 1; i < LC4J_BURST_MAX_FRAMES; ++i) {
+        CHECK_EQ(stack.add(frame.view), 0);
+        CHECK_EQ(stack.shiftX(), 0);
+        CHECK_EQ(stack.shiftY(), 0);
+    }
+    lc4j::OwnedFrame out;
+    CHECK_EQ(stack.average(out, nullptr), 0);
+    checkYuv(out, moved(scene, 0, 0), 0, "identical");
+}
+
+void testRejects() {
+    const YuvFrame frame([](int32_t, int32_t, int32_t) { return uint8_t{128}; });
+    lc4j::FrameStack stack;
+    CHECK_EQ(stack.add(frame.view), -EINVAL);
+    CHECK_EQ(stack.begin(frame.view, nullptr, LC4J_BURST_MAX_FRAMES + 1, false), -EINVAL);
+    lc4j::FrameView rgb = frame.view;
+    rgb.fourcc = lc4j::fourcc('R', 'G', '2', '4');
+    CHECK_EQ(stack.begin(rgb, nullptr, 2, false), -ENOTSUP);
+
+    CHECK_EQ(stack.begin(frame.view, nullptr, 2, false), 0);
+    lc4j::FrameView smaller = frame.view;
+    smaller.width -= 2;
+    CHECK_EQ(stack.add(smaller), -EINVAL);
+    // A raw stack needs somewhere to say what its average is
+    const lc4j::RawInfo info = rawInfo(10);
+    const RawFrame raw([](int32_t, int32_t) { return uint16_t{512}; });
+    CHECK_EQ(stack.begin(raw.view, &info, 2, false), 0);
+    lc4j::OwnedFrame out;
+    CHECK_EQ(stack.average(out, nullptr), -EINVAL);
+}
+
+} // namespace
+
+int main() {
+    testAlignYuv();
+    testAlignRaw();
+    testRawHeadroom();
+    testRounding();
+    testIdentical();
+    testRejects();
+    return lc4j_test::result();
+}
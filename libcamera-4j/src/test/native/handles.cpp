@@ -0,0 +1,14 @@
+/*
+ * libcamera4j native tests - the handle allocator of libcamera4j.cpp, which
+ * cannot be built without libcamera.
+ */
+
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <atomic>
+
+int64_t lc4j::allocHandle() {
+    static std::atomic<int64_t> next{1};
+    return next++;
+}
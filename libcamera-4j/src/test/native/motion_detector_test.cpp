@@ -0,0 +1,355 @@
+/*
+ * libcamera4j native tests - the motion detector.
+ *
+ * Synthetic luma planes go through lc4j_motion_process as a monitor stream
+ * would hand them over: a flat scene that seeds the background, then bright
+ * squares at known places. The events polled back must come after the given
+ * number of frames, not during the holdoff, not from under the ignore mask or
+ * from a change of the whole frame, and with boxes in frame pixels.
+ *
+ * With a scene schedule, frames are gradients whose hashes are a known number
+ * of bits apart, given at chosen timestamps.
+ */
+
+#include "check.h"
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int32_t kYuv420 = 'Y' | ('U' << 8) | ('1' << 16) | (static_cast<int32_t>('2') << 24);
+constexpr int64_t kFrameNs = 33000000;
+
+struct Square {
+    int32_t x, y, width, height;
+};
+
+// A luma plane, given pixel by pixel or as `level` with bright squares on it
+// and rows `stride` apart
+class Frame {
+public:
+    Frame(int32_t width, int32_t height, const std::function<uint8_t(int32_t x, int32_t y)>& luma)
+            : width_(width), height_(height), stride_(width), luma_(static_cast<size_t>(width) * height) {
+        for (int32_t y = 0; y < height; ++y) {
+            for (int32_t x = 0; x < width; ++x) {
+                luma_[static_cast<size_t>(y) * width + x] = luma(x, y);
+            }
+        }
+    }
+
+    Frame(int32_t width, int32_t height, uint8_t level, std::vector<Square> squares = {}, int32_t stride = 0)
+            : width_(width), height_(height), stride_(stride > 0 ? stride : width),
+              luma_(static_cast<size_t>(stride_) * height, level) {
+        for (const Square& s : squares) {
+            for (int32_t y = s.y; y < s.y + s.height; ++y) {
+                for (int32_t x = s.x; x < s.x + s.width; ++x) {
+                    luma_[static_cast<size_t>(y) * stride_ + x] = 220;
+                }
+            }
+        }
+    }
+
+    int32_t process(int64_t handle, int64_t sequence, int64_t timestampNs) const {
+        return lc4j_motion_process(handle, luma_.data(), static_cast<int64_t>(luma_.size()), kYuv420, width_,
+                                   height_, stride_, sequence, timestampNs);
+    }
+
+private:
+    int32_t width_;
+    int32_t height_;
+    int32_t stride_;
+    std::vector<uint8_t> luma_;
+};
+
+int64_t create(int32_t triggerFrames, int32_t holdoffFrames) {
+    lc4j_motion_params params{};
+    params.triggerFrames = triggerFrames;
+    params.holdoffFrames = holdoffFrames;
+    const int64_t handle = lc4j_motion_create(&params);
+    CHECK(handle != 0);
+    return handle;
+}
+
+std::vector<lc4j_motion_event> poll(int64_t handle) {
+    std::vector<lc4j_motion_event> events(LC4J_MOTION_MAX_BOXES);
+    const int32_t n = lc4j_motion_poll(handle, events.data(), static_cast<int32_t>(events.size()), 0);
+    events.resize(n > 0 ? n : 0);
+    return events;
+}
+
+// Feeds `frame` as frames first..last and checks which of them raised an event
+void feed(int64_t handle, const Frame& frame, int64_t first, int64_t last, const std::vector<int64_t>& raising = {}) {
+    for (int64_t n = first; n <= last; ++n) {
+        bool expected = false;
+        for (int64_t r : raising) {
+            expected |= r == n;
+        }
+        const int32_t raised = frame.process(handle, n, n * kFrameNs);
+        if (raised != (expected ? 1 : 0)) {
+            lc4j_test::fail(__FILE__, __LINE__, "frame " + std::to_string(n) + " returned "
+                    + std::to_string(raised));
+        }
+    }
+}
+
+const Frame kQuiet(320, 240, 100);
+const Frame kMoving(320, 240, 100, {{100, 60, 40, 40}});
+
+void testTriggerFrames() {
+    const int64_t handle = create(3, 1);
+    feed(handle, kQuiet, 0, 4);
+    // Two frames of motion, then none: not enough
+    feed(handle, kMoving, 5, 6);
+    feed(handle, kQuiet, 7, 7);
+    CHECK(poll(handle).empty());
+    // The third consecutive one raises
+    feed(handle, kMoving, 8, 10, {10});
+    const std::vector<lc4j_motion_event> events = poll(handle);
+    CHECK_EQ(events.size(), 1u);
+    if (!events.empty()) {
+        CHECK_EQ(events[0].trigger, LC4J_MOTION_TRIGGER_MOTION);
+        CHECK_EQ(events[0].sequence, 10);
+        CHECK_EQ(events[0].timestampNs, 10 * kFrameNs);
+        CHECK_EQ(events[0].hashDistance, -1);
+    }
+    lc4j_motion_close(handle);
+}
+
+void testHoldoff() {
+    const int64_t handle = create(1, 5);
+    feed(handle, kQuiet, 0, 2);
+    // Motion in every frame, but after an event the next five are quiet
+    feed(handle, kMoving, 3, 15, {3, 9, 15});
+    CHECK_EQ(poll(handle).size(), 3u);
+    lc4j_motion_close(handle);
+}
+
+void testIgnoreMask() {
+    const int64_t handle = create(1, 1);
+    // A 4x4 mask over the frame; the square lies within its cell (1, 1)
+    uint8_t mask[16] = {};
+    mask[1 * 4 + 1] = 1;
+    CHECK_EQ(lc4j_motion_set_mask(handle, mask, 4, 4), 0);
+    const Frame masked(320, 240, 100, {{100, 70, 40, 40}});
+    feed(handle, kQuiet, 0, 2);
+    feed(handle, masked, 3, 8);
+    CHECK(poll(handle).empty());
+
+    // Cells under the mask still learn the background, so the square
+    // leaving is not motion either
+    feed(handle, kQuiet, 9, 40);
+    CHECK(poll(handle).empty());
+
+    // The same square in the next cell is seen
+    const Frame beside(320, 240, 100, {{180, 70, 40, 40}});
+    feed(handle, beside, 41, 41, {41});
+    CHECK_EQ(poll(handle).size(), 1u);
+
+    // And without the mask, the first one too
+    CHECK_EQ(lc4j_motion_set_mask(handle, nullptr, 0, 0), 0);
+    feed(handle, kQuiet, 42, 43);
+    feed(handle, masked, 44, 44, {44});
+    CHECK_EQ(poll(handle).size(), 1u);
+    lc4j_motion_close(handle);
+}
+
+void testBrightnessJump() {
+    const int64_t handle = create(1, 1);
+    feed(handle, kQuiet, 0, 4);
+    // Exposure changed: the whole frame 60 levels brighter, square and all
+    const Frame brighter(320, 240, 160, {{100, 60, 40, 40}});
+    feed(handle, brighter, 5, 10);
+    CHECK(poll(handle).empty());
+    // The background is the brighter frame now, so motion on it is seen
+    const Frame moved(320, 240, 160, {{100, 60, 40, 40}, {220, 150, 40, 40}});
+    feed(handle, moved, 11, 11, {11});
+    CHECK_EQ(poll(handle).size(), 1u);
+    lc4j_motion_close(handle);
+}
+
+void testBoxes() {
+    // 480x360 is averaged by 3 to 160x120 cells; rows padded to 512 bytes
+    const int64_t handle = create(1, 1);
+    const Frame quiet(480, 360, 100, {}, 512);
+    const Frame moving(480, 360, 100, {{99, 60, 42, 42}, {300, 210, 30, 45}}, 512);
+    feed(handle, quiet, 0, 2);
+    feed(handle, moving, 3, 3, {3});
+    const std::vector<lc4j_motion_event> events = poll(handle);
+    CHECK_EQ(events.size(), 1u);
+    if (events.empty()) {
+        return;
+    }
+    const lc4j_motion_event& event = events[0];
+    CHECK_EQ(event.boxCount, 2);
+    // Largest first, in frame pixels
+    CHECK_EQ(event.boxes[0].x, 99);
+    CHECK_EQ(event.boxes[0].y, 60);
+    CHECK_EQ(event.boxes[0].width, 42);
+    CHECK_EQ(event.boxes[0].height, 42);
+    CHECK_EQ(event.boxes[1].x, 300);
+    CHECK_EQ(event.boxes[1].y, 210);
+    CHECK_EQ(event.boxes[1].width, 30);
+    CHECK_EQ(event.boxes[1].height, 45);
+    // 14x14 and 10x15 of the 160x120 cells
+    CHECK_EQ(event.changedPercent, static_cast<float>(100.0 * (14 * 14 + 10 * 15) / (160 * 120)));
+    lc4j_motion_close(handle);
+}
+
+// The top `reversed` eighths darken to the right, the others brighten: the
+// hashes of two such frames are 8 bits apart per eighth that differs.
+Frame bands(int32_t reversed, int32_t brighter = 0) {
+    return Frame(320, 240, [=](int32_t x, int32_t y) {
+        const int32_t level = y * 8 / 240 < reversed ? 200 - x / 2 : 40 + x / 2;
+        return static_cast<uint8_t>(level + brighter);
+    });
+}
+
+// A detector that only schedules: no difference in luma counts as motion
+int64_t createScheduled(int32_t hashDistance, int32_t minIntervalMs, int32_t maxIntervalMs) {
+    lc4j_motion_params params{};
+    params.threshold = 255;
+    const int64_t handle = lc4j_motion_create(&params);
+    CHECK(handle != 0);
+    const lc4j_scene_schedule schedule{hashDistance, minIntervalMs, maxIntervalMs, 0};
+    CHECK_EQ(lc4j_motion_set_schedule(handle, &schedule), 0);
+    return handle;
+}
+
+int32_t at(int64_t handle, const Frame& frame, int64_t ms) {
+    return frame.process(handle, ms, ms * 1000000);
+}
+
+// The one event polled, or one with trigger -1
+lc4j_motion_event scheduled(int64_t handle) {
+    const std::vector<lc4j_motion_event> events = poll(handle);
+    CHECK_EQ(events.size(), 1u);
+    lc4j_motion_event event{};
+    event.trigger = -1;
+    return events.size() == 1 ? events[0] : event;
+}
+
+void testScheduleInterval() {
+    const int64_t handle = createScheduled(16, 1000, 5000);
+    // The first frame is due
+    CHECK_EQ(at(handle, bands(0), 0), 1);
+    lc4j_motion_event event = scheduled(handle);
+    CHECK_EQ(event.trigger, LC4J_MOTION_TRIGGER_INTERVAL);
+    CHECK_EQ(event.hashDistance, 64);
+    CHECK_EQ(event.timestampNs, 0);
+    CHECK_EQ(event.boxCount, 0);
+
+    // The same scene, a little brighter, until the maximum interval is up
+    CHECK_EQ(at(handle, bands(0), 1000), 0);
+    CHECK_EQ(at(handle, bands(0, 10), 3000), 0);
+    CHECK_EQ(at(handle, bands(0), 4999), 0);
+    CHECK_EQ(at(handle, bands(0), 5000), 1);
+    event = scheduled(handle);
+    CHECK_EQ(event.trigger, LC4J_MOTION_TRIGGER_INTERVAL);
+    CHECK_EQ(event.hashDistance, 0);
+    CHECK_EQ(event.sequence, 5000);
+    // Counted from that event
+    CHECK_EQ(at(handle, bands(0), 9999), 0);
+    CHECK_EQ(at(handle, bands(0), 10000), 1);
+    CHECK_EQ(scheduled(handle).trigger, LC4J_MOTION_TRIGGER_INTERVAL);
+    lc4j_motion_close(handle);
+}
+
+void testScheduleSceneChange() {
+    const int64_t handle = createScheduled(16, 1000, 60000);
+    CHECK_EQ(at(handle, bands(0), 0), 1);
+    CHECK_EQ(scheduled(handle).trigger, LC4J_MOTION_TRIGGER_INTERVAL);
+    // 16 bits apart is not more than hashDistance
+    CHECK_EQ(at(handle, bands(2), 2000), 0);
+    CHECK_EQ(at(handle, bands(3), 2500), 1);
+    lc4j_motion_event event = scheduled(handle);
+    CHECK_EQ(event.trigger, LC4J_MOTION_TRIGGER_SCENE);
+    CHECK_EQ(event.hashDistance, 24);
+    CHECK_EQ(event.timestampNs, 2500 * 1000000LL);
+    // Compared with that frame now, not the first
+    CHECK_EQ(at(handle, bands(1), 4000), 0);
+    CHECK_EQ(at(handle, bands(0), 4500), 1);
+    event = scheduled(handle);
+    CHECK_EQ(event.trigger, LC4J_MOTION_TRIGGER_SCENE);
+    CHECK_EQ(event.hashDistance, 24);
+    lc4j_motion_close(handle);
+}
+
+void testScheduleMinInterval() {
+    const int64_t handle = createScheduled(16, 1000, 60000);
+    CHECK_EQ(at(handle, bands(0), 0), 1);
+    CHECK_EQ(scheduled(handle).trigger, LC4J_MOTION_TRIGGER_INTERVAL);
+    // Changed, but too soon after the last event
+    CHECK_EQ(at(handle, bands(8), 500), 0);
+    CHECK_EQ(at(handle, bands(8), 999), 0);
+    CHECK(poll(handle).empty());
+    CHECK_EQ(at(handle, bands(8), 1000), 1);
+    const lc4j_motion_event event = scheduled(handle);
+    CHECK_EQ(event.trigger, LC4J_MOTION_TRIGGER_SCENE);
+    CHECK_EQ(event.hashDistance, 64);
+    // And again from that one
+    CHECK_EQ(at(handle, bands(0), 1999), 0);
+    CHECK_EQ(at(handle, bands(0), 2000), 1);
+    CHECK_EQ(scheduled(handle).trigger, LC4J_MOTION_TRIGGER_SCENE);
+    lc4j_motion_close(handle);
+}
+
+void testScheduleTimestampBack() {
+    const int64_t handle = createScheduled(16, 1000, 5000);
+    CHECK_EQ(at(handle, bands(0), 100000), 1);
+    scheduled(handle);
+    // The stream restarted and its clock with it: overdue, whatever the scene
+    CHECK_EQ(at(handle, bands(0), 50000), 1);
+    const lc4j_motion_event event = scheduled(handle);
+    CHECK_EQ(event.trigger, LC4J_MOTION_TRIGGER_INTERVAL);
+    CHECK_EQ(event.hashDistance, 0);
+    // The intervals run from there
+    CHECK_EQ(at(handle, bands(0), 51000), 0);
+    CHECK_EQ(at(handle, bands(0), 55000), 1);
+    scheduled(handle);
+    lc4j_motion_close(handle);
+}
+
+void testSetSchedule() {
+    const int64_t handle = createScheduled(16, 1000, 5000);
+    CHECK_EQ(at(handle, bands(0), 0), 1);
+    scheduled(handle);
+    // A new schedule makes the next frame due
+    const lc4j_scene_schedule schedule{8, 0, 1000, 0};
+    CHECK_EQ(lc4j_motion_set_schedule(handle, &schedule), 0);
+    CHECK_EQ(at(handle, bands(0), 10), 1);
+    CHECK_EQ(scheduled(handle).trigger, LC4J_MOTION_TRIGGER_INTERVAL);
+
+    // Out of range
+    const lc4j_scene_schedule wide{64, 0, 1000, 0};
+    CHECK_EQ(lc4j_motion_set_schedule(handle, &wide), -EINVAL);
+    const lc4j_scene_schedule inverted{8, 2000, 1000, 0};
+    CHECK_EQ(lc4j_motion_set_schedule(handle, &inverted), -EINVAL);
+
+    // Turned off
+    CHECK_EQ(lc4j_motion_set_schedule(handle, nullptr), 0);
+    CHECK_EQ(at(handle, bands(8), 20000), 0);
+    CHECK(poll(handle).empty());
+    lc4j_motion_close(handle);
+}
+
+} // namespace
+
+int main() {
+    testTriggerFrames();
+    testHoldoff();
+    testIgnoreMask();
+    testBrightnessJump();
+    testBoxes();
+    testScheduleInterval();
+    testScheduleSceneChange();
+    testScheduleMinInterval();
+    testScheduleTimestampBack();
+    testSetSchedule();
+    return lc4j_test::result();
+}
@@ -0,0 +1,83 @@
+/*
+ * libcamera4j native tests - latency histogram buckets.
+ *
+ * Buckets are filled here by LatencyHistogram::bucket and read back in Java by
+ * LatencyHistogram.bucketStartUs, which duplicates the layout. The edges below
+ * are the ones LatencyHistogramTest checks on the Java side.
+ */
+
+#include "check.h"
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <cstdint>
+#include <limits>
+
+namespace {
+
+using lc4j::LatencyHistogram;
+
+// As LatencyHistogram.bucketStartUs in Java
+int64_t bucketStartUs(int32_t index) {
+    return index < 32 ? index : static_cast<int64_t>(16 + index % 16) << (index / 16 - 1);
+}
+
+void testBucketEdges() {
+    CHECK_EQ(LatencyHistogram::bucket(-5), 0);
+    CHECK_EQ(LatencyHistogram::bucket(0), 0);
+    // One bucket per microsecond below 32, then 16 per doubling
+    CHECK_EQ(LatencyHistogram::bucket(31), 31);
+    CHECK_EQ(LatencyHistogram::bucket(32), 32);
+    CHECK_EQ(LatencyHistogram::bucket(33), 32);
+    CHECK_EQ(LatencyHistogram::bucket(34), 33);
+    CHECK_EQ(LatencyHistogram::bucket(62), 47);
+    CHECK_EQ(LatencyHistogram::bucket(63), 47);
+    CHECK_EQ(LatencyHistogram::bucket(64), 48);
+    CHECK_EQ(LatencyHistogram::bucket(67), 48);
+    CHECK_EQ(LatencyHistogram::bucket(68), 49);
+    CHECK_EQ(LatencyHistogram::bucket(650), 100);
+    // The last bucket starts at 31 << 28 µs and holds everything beyond
+    constexpr int32_t last = LatencyHistogram::kBuckets - 1;
+    CHECK_EQ(LatencyHistogram::bucket((31LL << 28) - 1), last - 1);
+    CHECK_EQ(LatencyHistogram::bucket(31LL << 28), last);
+    CHECK_EQ(LatencyHistogram::bucket(32LL << 28), last);
+    CHECK_EQ(LatencyHistogram::bucket(std::numeric_limits<int64_t>::max()), last);
+}
+
+void testBucketsMatchJava() {
+    for (int32_t i = 0; i < LatencyHistogram::kBuckets; ++i) {
+        CHECK_EQ(LatencyHistogram::bucket(bucketStartUs(i)), i);
+        if (i + 1 < LatencyHistogram::kBuckets) {
+            CHECK_EQ(LatencyHistogram::bucket(bucketStartUs(i + 1) - 1), i);
+        }
+    }
+}
+
+void testRecordAndSnapshot() {
+    LatencyHistogram histogram;
+    histogram.record(10'500);       // 10 µs
+    histogram.record(63'999);       // 63 µs
+    histogram.record(64'000);
+    histogram.record(-1);           // ignored
+    lc4j_latency_histogram out;
+    histogram.snapshot(out, true);
+    CHECK_EQ(out.count, 3);
+    CHECK_EQ(out.maxNs, 64'000);
+    CHECK_EQ(out.buckets[10], 1u);
+    CHECK_EQ(out.buckets[47], 1u);
+    CHECK_EQ(out.buckets[48], 1u);
+
+    histogram.snapshot(out, false);
+    CHECK_EQ(out.count, 0);
+    CHECK_EQ(out.maxNs, 0);
+    CHECK_EQ(out.buckets[48], 0u);
+}
+
+} // namespace
+
+int main() {
+    testBucketEdges();
+    testBucketsMatchJava();
+    testRecordAndSnapshot();
+    return lc4j_test::result();
+}
@@ -0,0 +1,186 @@
+/*
+ * libcamera4j native tests - the waterline.
+ *
+ * A synthetic post meets the water at a known row of the image as captured:
+ * bright above, dark below, the row in between half way so that the edge lies
+ * half a row lower. The sensor plane is laid out so that the session's
+ * transform turns it into that image, and the estimate must find the edge,
+ * for every transform, to a fraction of a row.
+ */
+
+#include "check.h"
+#include "libcamera4j.h"
+#include "lc4j_internal.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int32_t kWidth = 640;
+constexpr int32_t kHeight = 480;
+constexpr uint32_t kYuv420 = 'Y' | ('U' << 8) | ('1' << 16) | (static_cast<uint32_t>('2') << 24);
+constexpr int32_t kHflip = 1;
+constexpr int32_t kVflip = 2;
+constexpr int32_t kTranspose = 4;
+// Strips of the region, as in waterline.cpp
+constexpr int32_t kStrips = 8;
+
+// Luma at column x, row y of the image as captured
+using Scene = std::function<uint8_t(int32_t x, int32_t y, int32_t width, int32_t height)>;
+
+// A YUV420 sensor frame that `transform` turns into `scene`
+struct TestFrame {
+    std::vector<uint8_t> y, u, v;
+    lc4j::FrameView view;
+
+    TestFrame(const Scene& scene, int32_t transform)
+            : y(kWidth * kHeight), u(kWidth * kHeight / 4, 128), v(u) {
+        const bool transpose = (transform & kTranspose) != 0;
+        const bool hflip = (transform & kHflip) != 0;
+        const bool vflip = (transform & kVflip) != 0;
+        const int32_t width = transpose ? kHeight : kWidth;
+        const int32_t height = transpose ? kWidth : kHeight;
+        for (int32_t sy = 0; sy < kHeight; ++sy) {
+            for (int32_t sx = 0; sx < kWidth; ++sx) {
+                // Flips first, then a clockwise turn, as transformPlane
+                int32_t x, y;
+                if (!transpose) {
+                    x = hflip ? kWidth - 1 - sx : sx;
+                    y = vflip ? kHeight - 1 - sy : sy;
+                } else {
+                    x = vflip ? sy : kHeight - 1 - sy;
+                    y = hflip ? kWidth - 1 - sx : sx;
+                }
+                this->y[sy * kWidth + sx] = scene(x, y, width, height);
+            }
+        }
+        view.fourcc = kYuv420;
+        view.width = kWidth;
+        view.height = kHeight;
+        view.planes[0] = this->y.data();
+        view.planes[1] = u.data();
+        view.planes[2] = v.data();
+        view.strides[0] = kWidth;
+        view.strides[1] = kWidth / 2;
+        view.strides[2] = kWidth / 2;
+    }
+};
+
+lc4j_waterline_params params() {
+    lc4j_waterline_params p{};
+    // Off centre, so that a region not flipped with the image misses
+    p.left = 0.1f;
+    p.right = 0.5f;
+    p.top = 0.15f;
+    p.bottom = 0.75f;
+    // Level 100 at 30% of the height, 50 at 70%
+    p.row0 = 0.3f;
+    p.level0 = 100.0f;
+    p.row1 = 0.7f;
+    p.level1 = 50.0f;
+    return p;
+}
+
+// Strip of the region that column x of a `width` wide image falls in, -1 outside
+int32_t stripOf(int32_t x, int32_t width) {
+    const lc4j_waterline_params p = params();
+    const auto x0 = static_cast<int32_t>(std::floor(p.left * width));
+    const auto x1 = static_cast<int32_t>(std::ceil(p.right * width));
+    if (x < x0 || x >= x1) {
+        return -1;
+    }
+    return (x - x0) * kStrips / (x1 - x0);
+}
+
+// Bright above the waterline at `edge` (a fraction of the height, landing
+// half way through a row) and dark below, with a weak texture that is not
+// the same in every strip. Strips for which `wet(strip)` is false have no
+// waterline. Decoys outside the region: another waterline at 35% beside it
+// and a stronger step at 80% below it.
+uint8_t post(int32_t x, int32_t y, int32_t width, int32_t height, double edge,
+             const std::function<bool(int32_t)>& wet) {
+    const int32_t texture = static_cast<int32_t>((x * 7 + y * 13) % 5) - 2;
+    if (y >= 0.8 * height) {
+        return static_cast<uint8_t>(250 + texture);
+    }
+    const int32_t strip = stripOf(x, width);
+    if (strip >= 0 && !wet(strip)) {
+        return static_cast<uint8_t>(120 + texture);
+    }
+    const double row = (strip < 0 ? 0.35 : edge) * height;
+    const double cover = std::clamp(row - y, 0.0, 1.0);     // share of row y above the line
+    return static_cast<uint8_t>(std::lround(60 + 110 * cover) + texture);
+}
+
+void testFindsRow(int32_t transform) {
+    // Half way through row 216 of 480, or of 640 when transposed
+    const int32_t height = (transform & kTranspose) ? kWidth : kHeight;
+    const double edge = (0.45 * height + 0.5) / height;
+    const TestFrame frame([&](int32_t x, int32_t y, int32_t w, int32_t h) {
+        return post(x, y, w, h, edge, [](int32_t) { return true; });
+    }, transform);
+
+    float row = 0, level = 0, confidence = 0;
+    const std::string where = "transform " + std::to_string(transform);
+    CHECK(lc4j::estimateWaterline(frame.view, transform, params(), row, level, confidence));
+    if (std::fabs(row - edge) * height > 0.25) {
+        lc4j_test::fail(__FILE__, __LINE__, where + ": row " + std::to_string(row * height) + ", expected "
+                + std::to_string(edge * height));
+    }
+    const double expectedLevel = 100.0 + (row - 0.3) * (50.0 - 100.0) / (0.7 - 0.3);
+    CHECK(std::fabs(level - expectedLevel) < 1e-3);
+    // 45% lies between the calibration rows
+    CHECK(level < 100.0f && level > 50.0f);
+    CHECK_EQ(confidence, 1.0f);
+}
+
+void testPartlyAgreeing(int32_t transform) {
+    // Three strips see the post, the others nothing
+    const int32_t height = (transform & kTranspose) ? kWidth : kHeight;
+    const double edge = (0.6 * height + 0.5) / height;
+    const TestFrame frame([&](int32_t x, int32_t y, int32_t w, int32_t h) {
+        return post(x, y, w, h, edge, [](int32_t strip) { return strip == 1 || strip == 4 || strip == 6; });
+    }, transform);
+    float row = 0, level = 0, confidence = 0;
+    CHECK(lc4j::estimateWaterline(frame.view, transform, params(), row, level, confidence));
+    CHECK(std::fabs(row - edge) * height < 0.5);
+    CHECK_EQ(confidence, 3.0f / kStrips);
+}
+
+void testRejectsTooFewStrips(int32_t transform) {
+    // Two strips are not enough
+    const TestFrame two([&](int32_t x, int32_t y, int32_t w, int32_t h) {
+        return post(x, y, w, h, 0.5, [](int32_t strip) { return strip == 2 || strip == 5; });
+    }, transform);
+    float row = 0, level = 0, confidence = 0;
+    CHECK(!lc4j::estimateWaterline(two.view, transform, params(), row, level, confidence));
+
+    // Nor are steps in every strip that no three agree on
+    const TestFrame scattered([&](int32_t x, int32_t y, int32_t w, int32_t h) {
+        const int32_t strip = stripOf(x, w);
+        const double edge = 0.25 + strip * 0.07;
+        return post(x, y, w, h, edge, [](int32_t) { return true; });
+    }, transform);
+    CHECK(!lc4j::estimateWaterline(scattered.view, transform, params(), row, level, confidence));
+
+    // Nor a flat region
+    const TestFrame flat([](int32_t, int32_t, int32_t, int32_t) { return uint8_t{100}; }, transform);
+    CHECK(!lc4j::estimateWaterline(flat.view, transform, params(), row, level, confidence));
+}
+
+} // namespace
+
+int main() {
+    // Identity, 180 degrees, and the two 90 degree turns
+    for (int32_t transform : {0, kHflip | kVflip, kTranspose | kHflip, kTranspose | kVflip}) {
+        testFindsRow(transform);
+        testPartlyAgreeing(transform);
+        testRejectsTooFewStrips(transform);
+    }
+    return lc4j_test::result();
+}